@@ -198,12 +198,17 @@ bool CActiveMasternode::SendMasternodePing(std::string& errorMessage)
         }
 
         pmn->lastPing = mnp;
-        mnodeman.mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
 
         //mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
         CMasternodeBroadcast mnb(*pmn);
         uint256 hash = mnb.GetHash();
-        if (mnodeman.mapSeenMasternodeBroadcast.count(hash)) mnodeman.mapSeenMasternodeBroadcast[hash].lastPing = mnp;
+        {
+            LOCK(mnodeman.cs);
+            mnodeman.mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
+            std::map<uint256, CMasternodeBroadcast>::iterator it = mnodeman.mapSeenMasternodeBroadcast.find(hash);
+            if (it != mnodeman.mapSeenMasternodeBroadcast.end())
+                it->second.lastPing = mnp;
+        }
 
         mnp.Relay();
 
@@ -0,0 +1,204 @@
+// Copyright (c) 2015-2016 The Bitcoin Core developers
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "tinyformat.h"
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <regex>
+
+#include <univalue.h>
+
+std::atomic<uint64_t> benchmark::nAllocations(0);
+
+static double gettimedouble()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+namespace {
+
+class ConsolePrinter : public benchmark::Printer
+{
+public:
+    void Header() override
+    {
+        std::cout << strprintf("%-32s %12s %14s %14s %14s %12s %10s", "#Benchmark", "count", "ns/op", "min ns/op", "max ns/op", "allocs/op", "MB/s") << std::endl;
+    }
+    void Add(const benchmark::Result& r) override
+    {
+        const std::string strThroughput = r.nBytesPerOp ? strprintf("%.1f", r.MBPerSec()) : "-";
+        std::cout << strprintf("%-32s %12u %14.1f %14.1f %14.1f %12.2f %10s", r.name, r.nIterations, r.NsPerOp(), r.nsMin, r.nsMax, r.allocsPerOp, strThroughput) << std::endl;
+    }
+};
+
+class CsvPrinter : public benchmark::Printer
+{
+public:
+    void Header() override
+    {
+        std::cout << "name,iterations,ns_per_op,min_ns_per_op,max_ns_per_op,allocs_per_op,mb_per_s" << std::endl;
+    }
+    void Add(const benchmark::Result& r) override
+    {
+        const std::string strThroughput = r.nBytesPerOp ? strprintf("%.1f", r.MBPerSec()) : "";
+        std::cout << strprintf("%s,%u,%.1f,%.1f,%.1f,%.2f,%s", r.name, r.nIterations, r.NsPerOp(), r.nsMin, r.nsMax, r.allocsPerOp, strThroughput) << std::endl;
+    }
+};
+
+class JsonPrinter : public benchmark::Printer
+{
+    UniValue results{UniValue::VARR};
+
+public:
+    void Add(const benchmark::Result& r) override
+    {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("name", r.name));
+        obj.push_back(Pair("iterations", (uint64_t)r.nIterations));
+        obj.push_back(Pair("ns_per_op", r.NsPerOp()));
+        obj.push_back(Pair("min_ns_per_op", r.nsMin));
+        obj.push_back(Pair("max_ns_per_op", r.nsMax));
+        obj.push_back(Pair("allocs_per_op", r.allocsPerOp));
+        if (r.nBytesPerOp)
+            obj.push_back(Pair("mb_per_s", r.MBPerSec()));
+        results.push_back(obj);
+    }
+    void Footer() override
+    {
+        UniValue root(UniValue::VOBJ);
+        root.push_back(Pair("benchmarks", results));
+        std::cout << root.write(2) << std::endl;
+    }
+};
+
+bool ParseFilter(const std::string& strFilter, std::regex& reFilter)
+{
+    try {
+        reFilter = std::regex(strFilter);
+    } catch (const std::regex_error& e) {
+        std::cerr << "Invalid -filter " << strFilter << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<benchmark::Printer> MakePrinter(const std::string& strPrinter)
+{
+    if (strPrinter == "console")
+        return std::unique_ptr<benchmark::Printer>(new ConsolePrinter());
+    if (strPrinter == "csv")
+        return std::unique_ptr<benchmark::Printer>(new CsvPrinter());
+    if (strPrinter == "json")
+        return std::unique_ptr<benchmark::Printer>(new JsonPrinter());
+    return nullptr;
+}
+
+}
+
+benchmark::BenchRunner::BenchmarkMap& benchmark::BenchRunner::benchmarks()
+{
+    static std::map<std::string, benchmark::BenchFunction> benchmarks_map;
+    return benchmarks_map;
+}
+
+benchmark::BenchRunner::BenchRunner(const std::string& name, benchmark::BenchFunction func)
+{
+    benchmarks().insert(std::make_pair(name, func));
+}
+
+std::vector<std::string> benchmark::BenchRunner::List(const std::string& strFilter)
+{
+    std::vector<std::string> names;
+    std::regex reFilter;
+    if (!ParseFilter(strFilter, reFilter))
+        return names;
+    for (const auto& p : benchmarks()) {
+        if (std::regex_search(p.first, reFilter))
+            names.push_back(p.first);
+    }
+    return names;
+}
+
+bool benchmark::BenchRunner::RunAll(const std::string& strFilter, const std::string& strPrinter, double elapsedTimeForOne)
+{
+    std::regex reFilter;
+    if (!ParseFilter(strFilter, reFilter))
+        return false;
+    std::unique_ptr<Printer> printer = MakePrinter(strPrinter);
+    if (!printer) {
+        std::cerr << "Unknown -printer " << strPrinter << std::endl;
+        return false;
+    }
+
+    printer->Header();
+    for (const auto& p : benchmarks()) {
+        if (!std::regex_search(p.first, reFilter))
+            continue;
+        State state(p.first, elapsedTimeForOne);
+        p.second(state);
+        printer->Add(state.GetResult());
+    }
+    printer->Footer();
+    return true;
+}
+
+bool benchmark::State::KeepRunning()
+{
+    if (count & countMask) {
+        ++count;
+        return true;
+    }
+    double now;
+    if (count == 0) {
+        lastTime = beginTime = now = gettimedouble();
+        beginAllocations = nAllocations.load(std::memory_order_relaxed);
+    } else {
+        now = gettimedouble();
+        double elapsed = now - lastTime;
+        double elapsedOne = elapsed * countMaskInv;
+        if (elapsedOne < minTime) minTime = elapsedOne;
+        if (elapsedOne > maxTime) maxTime = elapsedOne;
+
+        // We only use relative values, so don't have to handle 64-bit wrap-around specially
+        if (elapsed * 128 < maxElapsed) {
+            // If the execution was much too fast (1/128th of maxElapsed), increase the count mask by 8x and restart timing.
+            // The restart avoids including the overhead of this code in the measurement.
+            countMask = ((countMask << 3) | 7) & ((1LL << 60) - 1);
+            countMaskInv = 1. / (countMask + 1);
+            count = 0;
+            minTime = std::numeric_limits<double>::max();
+            maxTime = 0;
+            return true;
+        }
+        if (elapsed * 16 < maxElapsed) {
+            uint64_t newCountMask = ((countMask << 1) | 1) & ((1LL << 60) - 1);
+            if ((count & newCountMask) == 0) {
+                countMask = newCountMask;
+                countMaskInv = 1. / (countMask + 1);
+            }
+        }
+    }
+    lastTime = now;
+    ++count;
+
+    if (now - beginTime < maxElapsed) return true; // Keep going
+
+    --count;
+
+    assert(count != 0 && "count == 0 => (now == 0 && beginTime == 0) => return above");
+
+    // Output results
+    result.nIterations = count;
+    result.nsTotal = (now - beginTime) * 1e9;
+    result.nsMin = minTime * 1e9;
+    result.nsMax = maxTime * 1e9;
+    result.allocsPerOp = double(nAllocations.load(std::memory_order_relaxed) - beginAllocations) / count;
+    return false;
+}
@@ -0,0 +1,116 @@
+// Copyright (c) 2015-2016 The Bitcoin Core developers
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BTCU_BENCH_BENCH_H
+#define BTCU_BENCH_BENCH_H
+
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/preprocessor/cat.hpp>
+#include <boost/preprocessor/stringize.hpp>
+
+// Simple micro-benchmarking framework; API mostly matches a subset of the Google Benchmark
+// framework (see https://github.com/google/benchmark)
+// Why not use the Google Benchmark framework? Because adding Yet Another Dependency
+// (that uses cmake as its build system and has lots of features we don't need) isn't
+// worth it.
+
+/*
+ * Usage:
+
+static void CODE_TO_TIME(benchmark::State& state)
+{
+    ... do any setup needed...
+    while (state.KeepRunning()) {
+       ... do stuff you want to time...
+    }
+    ... do any cleanup needed...
+}
+
+BENCHMARK(CODE_TO_TIME);
+
+ */
+
+namespace benchmark {
+
+/** Heap allocations made by the process so far, counted by bench_btcu's operator new */
+extern std::atomic<uint64_t> nAllocations;
+
+/** Outcome of one benchmark, all times in nanoseconds per iteration */
+struct Result {
+    std::string name;
+    uint64_t nIterations;
+    double nsTotal;
+    double nsMin;
+    double nsMax;
+    double allocsPerOp;
+    /** Bytes each iteration processes, 0 when the benchmark does not report throughput */
+    uint64_t nBytesPerOp;
+
+    double NsPerOp() const { return nIterations ? nsTotal / nIterations : 0; }
+    double MBPerSec() const { return nsTotal ? 1e3 * nBytesPerOp * nIterations / nsTotal : 0; }
+};
+
+class State
+{
+    std::string name;
+    double maxElapsed;
+    double beginTime;
+    double lastTime, minTime, maxTime, countMaskInv;
+    uint64_t count;
+    uint64_t countMask;
+    uint64_t beginAllocations;
+    Result result;
+
+public:
+    State(const std::string& _name, double _maxElapsed) : name(_name), maxElapsed(_maxElapsed), beginTime(0), lastTime(0),
+                                                         minTime(std::numeric_limits<double>::max()), maxTime(0),
+                                                         countMaskInv(1), count(0), countMask(0), beginAllocations(0)
+    {
+        result = Result{name, 0, 0, 0, 0, 0, 0};
+    }
+    bool KeepRunning();
+    /** Report throughput for the benchmark, each iteration processing nBytes */
+    void SetBytesPerIteration(uint64_t nBytes) { result.nBytesPerOp = nBytes; }
+    const Result& GetResult() const { return result; }
+};
+
+typedef std::function<void(State&)> BenchFunction;
+
+/** Writes the results in one of the supported formats */
+class Printer
+{
+public:
+    virtual ~Printer() {}
+    virtual void Header() {}
+    virtual void Add(const Result& result) = 0;
+    virtual void Footer() {}
+};
+
+class BenchRunner
+{
+    typedef std::map<std::string, BenchFunction> BenchmarkMap;
+    static BenchmarkMap& benchmarks();
+
+public:
+    BenchRunner(const std::string& name, BenchFunction func);
+
+    /** Names of the registered benchmarks, in the order they run */
+    static std::vector<std::string> List(const std::string& strFilter);
+    /** Run every benchmark whose name matches the regular expression, false on a bad filter or printer */
+    static bool RunAll(const std::string& strFilter, const std::string& strPrinter, double elapsedTimeForOne = 1.0);
+};
+}
+
+// BENCHMARK(foo) expands to:  benchmark::BenchRunner bench_11foo("foo", foo);
+#define BENCHMARK(n) \
+    benchmark::BenchRunner BOOST_PP_CAT(bench_, BOOST_PP_CAT(__LINE__, n))(BOOST_PP_STRINGIZE(n), n);
+
+#endif // BTCU_BENCH_BENCH_H
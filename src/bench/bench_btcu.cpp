@@ -0,0 +1,86 @@
+// Copyright (c) 2015-2016 The Bitcoin Core developers
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bench_chain.h"
+
+#include "chainparams.h"
+#include "crypto/sha256.h"
+#include "key.h"
+#include "random.h"
+#include "util.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+// Every heap allocation of the process goes through here, so the benchmarks can report allocations per iteration
+void* operator new(size_t nSize)
+{
+    benchmark::nAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(nSize ? nSize : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t nSize)
+{
+    return operator new(nSize);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+static const char* DEFAULT_BENCH_FILTER = ".*";
+static const char* DEFAULT_BENCH_PRINTER = "console";
+static const int64_t DEFAULT_BENCH_TIME_MS = 1000;
+
+static std::string HelpMessage()
+{
+    std::string strUsage = "Usage: bench_btcu [options]\n\nOptions:\n";
+    strUsage += HelpMessageOpt("-?", "Print this help message and exit");
+    strUsage += HelpMessageOpt("-list", "List the benchmarks -filter selects and exit");
+    strUsage += HelpMessageOpt("-filter=<regex>", strprintf("Run the benchmarks whose name matches the regular expression (default: %s)", DEFAULT_BENCH_FILTER));
+    strUsage += HelpMessageOpt("-printer=<format>", strprintf("Result format: console, csv or json (default: %s)", DEFAULT_BENCH_PRINTER));
+    strUsage += HelpMessageOpt("-time=<ms>", strprintf("Time spent on each benchmark, in milliseconds (default: %u)", DEFAULT_BENCH_TIME_MS));
+    return strUsage;
+}
+
+int main(int argc, char** argv)
+{
+    ParseParameters(argc, argv);
+    if (mapArgs.count("-?") || mapArgs.count("-h") || mapArgs.count("-help")) {
+        std::cout << HelpMessage();
+        return EXIT_SUCCESS;
+    }
+
+    const std::string strFilter = GetArg("-filter", DEFAULT_BENCH_FILTER);
+    if (GetBoolArg("-list", false)) {
+        for (const std::string& name : benchmark::BenchRunner::List(strFilter))
+            std::cout << name << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    SHA256AutoDetect();
+    RandomInit();
+    ECC_Start();
+    SetupEnvironment();
+    fPrintToDebugLog = false; // don't want to write to debug.log file
+    SelectParams(CBaseChainParams::REGTEST);
+
+    bool fOk = benchmark::BenchRunner::RunAll(strFilter, GetArg("-printer", DEFAULT_BENCH_PRINTER),
+                                              GetArg("-time", DEFAULT_BENCH_TIME_MS) / 1000.0);
+
+    BenchChain::Shutdown();
+    ECC_Stop();
+    return fOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,160 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench/bench_chain.h"
+
+#include "chainparams.h"
+#include "contract.h"
+#include "init.h"
+#include "main.h"
+#include "miner.h"
+#include "pow.h"
+#include "random.h"
+#include "script/sign.h"
+#include "script/standard.h"
+#include "txdb.h"
+#include "util.h"
+#include "validationinterface.h"
+#ifdef ENABLE_LEASING_MANAGER
+#include "leasing/leasingmanager.h"
+#endif
+
+#include <cassert>
+#include <memory>
+
+#include <boost/filesystem/operations.hpp>
+
+static std::unique_ptr<BenchChain> pBenchChain;
+
+BenchChain& BenchChain::Get()
+{
+    if (!pBenchChain)
+        pBenchChain.reset(new BenchChain());
+    return *pBenchChain;
+}
+
+void BenchChain::Shutdown()
+{
+    pBenchChain.reset();
+}
+
+BenchChain::BenchChain()
+{
+    ClearDatadirCache();
+    pathTemp = GetTempPath() / strprintf("bench_btcu_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+    boost::filesystem::create_directories(pathTemp);
+    mapArgs["-datadir"] = pathTemp.string();
+    pblocktree = new CBlockTreeDB(1 << 20, true);
+    pcoinsdbview = new CCoinsViewDB(1 << 23, true);
+    pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+    InitBlockIndex();
+
+    const CChainParams& chainparams = Params();
+    dev::eth::NoProof::init();
+    const std::string dirQtum((GetDataDir() / "stateQtum").string());
+    const dev::h256 hashDB(dev::sha3(dev::rlp("")));
+    globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), QtumState::openDB(dirQtum, hashDB, dev::WithExisting::Trust), dirQtum, dev::eth::BaseState::Empty));
+    auto geni = chainparams.EVMGenesisInfo(dev::eth::Network::qtumNetwork);
+    dev::eth::ChainParams cp((geni));
+    globalSealEngine = std::unique_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
+    globalState->setRoot(dev::sha3(dev::rlp("")));
+    globalState->setRootUTXO(uintToh256(chainparams.GenesisBlock().hashUTXORoot));
+    globalState->populateFrom(cp.genesisState);
+    globalState->db().commit();
+    globalState->dbUtxo().commit();
+
+#ifdef ENABLE_LEASING_MANAGER
+    pleasingManagerMain = new CLeasingManager();
+    RegisterValidationInterface(pleasingManagerMain);
+#endif
+
+    {
+        CValidationState state;
+        bool ok = ActivateBestChain(state);
+        assert(ok);
+    }
+
+    coinbaseKey.MakeNewKey(true);
+    leaserKey.MakeNewKey(true);
+    keystore.AddKey(coinbaseKey);
+    scriptCoinbase = GetScriptForDestination(PKHash(coinbaseKey.GetPubKey()));
+
+    std::vector<CTransaction> vCoinbases;
+    const int nMaturity = chainparams.COINBASE_MATURITY();
+    for (int i = 0; i < nMaturity + 100; i++) {
+        CBlock block = CreateBlock({});
+        vCoinbases.push_back(*block.vtx[0]);
+        CValidationState state;
+        bool ok = ProcessNewBlock(state, nullptr, &block);
+        assert(ok);
+    }
+
+    // the coinbase of height h is mature from block h + nMaturity on
+    const CScript scriptLeasing = GetScriptForLeasing(leaserKey.GetPubKey().GetID(), coinbaseKey.GetPubKey().GetID());
+    std::vector<CMutableTransaction> vLeasingTxs;
+    for (size_t i = 0; i < BENCH_LEASING_OUTPUTS; i++) {
+        vLeasingTxs.push_back(SpendCoinbase(vCoinbases[i], scriptLeasing));
+        vLeasingPoints.emplace_back(COutPoint(vLeasingTxs.back().GetHash(), 0), coinbaseKey.GetPubKey().GetID());
+    }
+    bool ok = CreateAndProcessBlock(vLeasingTxs);
+    assert(ok);
+
+    // still mature for the block on top of the tip
+    vSpendable.assign(vCoinbases.begin() + BENCH_LEASING_OUTPUTS, vCoinbases.begin() + nMaturity);
+}
+
+BenchChain::~BenchChain()
+{
+#ifdef ENABLE_LEASING_MANAGER
+    UnregisterValidationInterface(pleasingManagerMain);
+    delete pleasingManagerMain;
+    pleasingManagerMain = nullptr;
+#endif
+    UnloadBlockIndex();
+    delete pcoinsTip;
+    pcoinsTip = nullptr;
+    delete pcoinsdbview;
+    delete pblocktree;
+    pblocktree = nullptr;
+    globalState.reset();
+    globalSealEngine.reset();
+    boost::filesystem::remove_all(pathTemp);
+}
+
+CBlock BenchChain::CreateBlock(const std::vector<CMutableTransaction>& txns)
+{
+    std::unique_ptr<CBlockTemplate> pblocktemplate(CreateNewBlock(scriptCoinbase, nullptr, false));
+    assert(pblocktemplate);
+    CBlock block = pblocktemplate->block;
+
+    // the mempool stays empty, so the template holds just the coinbase
+    block.vtx.resize(1);
+    for (const CMutableTransaction& tx : txns)
+        block.vtx.push_back(MakeTransactionRef(tx));
+    unsigned int nExtraNonce = 0;
+    IncrementExtraNonce(&block, chainActive.Tip(), nExtraNonce);
+
+    while (!CheckProofOfWork(block.GetHash(), block.nBits))
+        ++block.nNonce;
+    return block;
+}
+
+bool BenchChain::CreateAndProcessBlock(const std::vector<CMutableTransaction>& txns)
+{
+    CBlock block = CreateBlock(txns);
+    CValidationState state;
+    return ProcessNewBlock(state, nullptr, &block);
+}
+
+CMutableTransaction BenchChain::SpendCoinbase(const CTransaction& txFrom, const CScript& scriptPubKey, int nOutputs) const
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(txFrom.GetHash(), 0);
+    for (int i = 0; i < nOutputs; i++)
+        tx.vout.push_back(CTxOut(txFrom.vout[0].nValue / nOutputs, scriptPubKey));
+    bool ok = SignSignature(keystore, txFrom, tx, 0, SIGHASH_ALL);
+    assert(ok);
+    return tx;
+}
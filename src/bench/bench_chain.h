@@ -0,0 +1,63 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BTCU_BENCH_BENCH_CHAIN_H
+#define BTCU_BENCH_BENCH_CHAIN_H
+
+#include "key.h"
+#include "keystore.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "script/script.h"
+
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+class CCoinsViewDB;
+
+/** Leasing outputs created by the fixture chain */
+static const size_t BENCH_LEASING_OUTPUTS = 20;
+
+/**
+ * Regtest chain built in-process for the benchmarks that need chain state.
+ *
+ * It runs on a temporary data directory with the coins, block tree, EVM state and
+ * leasing manager set up as btcud does. It mines COINBASE_MATURITY + 100 blocks,
+ * then a block that leases BENCH_LEASING_OUTPUTS of the coinbases out. The chain is
+ * built on first use and torn down by bench_btcu before exit.
+ */
+class BenchChain
+{
+public:
+    ~BenchChain();
+
+    static BenchChain& Get();
+    static void Shutdown();
+
+    CKey coinbaseKey;
+    CKey leaserKey;
+    CBasicKeyStore keystore;
+    CScript scriptCoinbase;
+    /** Mature coinbases left unspent on the chain, for the benchmarks to spend */
+    std::vector<CTransaction> vSpendable;
+    /** Leasing outputs on the chain, with the key their rewards are paid to */
+    std::vector<std::pair<COutPoint, CKeyID>> vLeasingPoints;
+
+    /** Block on top of the tip with the given transactions after the coinbase, with valid proof of work */
+    CBlock CreateBlock(const std::vector<CMutableTransaction>& txns);
+    /** Create a block with the given transactions and connect it */
+    bool CreateAndProcessBlock(const std::vector<CMutableTransaction>& txns);
+    /** Signed transaction spending a coinbase of the fixture into nOutputs equal outputs */
+    CMutableTransaction SpendCoinbase(const CTransaction& txFrom, const CScript& scriptPubKey, int nOutputs = 1) const;
+
+private:
+    BenchChain();
+
+    boost::filesystem::path pathTemp;
+    CCoinsViewDB* pcoinsdbview;
+};
+
+#endif // BTCU_BENCH_BENCH_CHAIN_H
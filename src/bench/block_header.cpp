@@ -0,0 +1,68 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "main.h"
+#include "primitives/block.h"
+#include "random.h"
+
+#include <vector>
+
+/** Serialized size of a legacy header, the bytes Quark hashes */
+static const size_t BENCH_HEADER_BYTES = 80;
+
+static CBlockHeader RandomHeader(FastRandomContext& rand, int32_t nVersion)
+{
+    CBlockHeader header;
+    header.nVersion = nVersion;
+    header.hashPrevBlock = rand.rand256();
+    header.hashMerkleRoot = rand.rand256();
+    header.nTime = rand.rand32();
+    header.nBits = 0x1e0ffff0;
+    header.nNonce = rand.rand32();
+    return header;
+}
+
+static void QuarkHeaderHash(benchmark::State& state)
+{
+    FastRandomContext rand(true);
+    CBlockHeader header = RandomHeader(rand, 3);
+    state.SetBytesPerIteration(BENCH_HEADER_BYTES);
+    while (state.KeepRunning()) {
+        // A new nonce every iteration, so the header hash cache never answers
+        header.nNonce++;
+        header.GetHash();
+    }
+}
+
+// A full "headers" message of legacy headers, hashed stage by stage
+static void QuarkHeaderHashBatch(benchmark::State& state)
+{
+    FastRandomContext rand(true);
+    std::vector<CBlockHeader> headers;
+    for (unsigned int i = 0; i < MAX_HEADERS_RESULTS; i++)
+        headers.push_back(RandomHeader(rand, 3));
+    state.SetBytesPerIteration(BENCH_HEADER_BYTES * headers.size());
+    while (state.KeepRunning()) {
+        for (CBlockHeader& header : headers)
+            header.nNonce++;
+        GetBlockHeaderHashes(headers);
+    }
+}
+
+static void SHA256HeaderHash(benchmark::State& state)
+{
+    FastRandomContext rand(true);
+    CBlockHeader header = RandomHeader(rand, CBlockHeader::CURRENT_VERSION);
+    state.SetBytesPerIteration(BENCH_HEADER_BYTES);
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        header.GetHash();
+    }
+}
+
+BENCHMARK(QuarkHeaderHash);
+BENCHMARK(QuarkHeaderHashBatch);
+BENCHMARK(SHA256HeaderHash);
@@ -0,0 +1,70 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "coins.h"
+#include "random.h"
+#include "script/standard.h"
+
+#include <cassert>
+#include <vector>
+
+/** Transactions whose outputs the coins cache benchmarks keep */
+static const size_t COINS_CACHE_TXS = 10000;
+
+static std::vector<CTransaction> CreateCoinsTxs(size_t nCount)
+{
+    FastRandomContext rand(true);
+    std::vector<CTransaction> vtx;
+    vtx.reserve(nCount);
+    for (size_t i = 0; i < nCount; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(rand.rand256(), 0);
+        tx.vout.resize(2);
+        for (CTxOut& out : tx.vout) {
+            out.nValue = rand.randrange(100 * COIN);
+            out.scriptPubKey = GetScriptForDestination(PKHash(uint160(rand.randbytes(20))));
+        }
+        vtx.push_back(CTransaction(tx));
+    }
+    return vtx;
+}
+
+// Lookups of coins held by a CCoinsViewCache, as done for every input of a block
+static void CoinsCacheAccess(benchmark::State& state)
+{
+    const std::vector<CTransaction> vtx = CreateCoinsTxs(COINS_CACHE_TXS);
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    for (const CTransaction& tx : vtx)
+        view.ModifyCoins(tx.GetHash())->FromTx(tx, 1);
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        const CCoins* coins = view.AccessCoins(vtx[i].GetHash());
+        assert(coins);
+        if (++i == vtx.size())
+            i = 0;
+    }
+}
+
+// Adding a block's worth of coins to a child cache and flushing it into its parent
+static void CoinsCacheFlush(benchmark::State& state)
+{
+    const std::vector<CTransaction> vtx = CreateCoinsTxs(1000);
+    CCoinsView viewDummy;
+    CCoinsViewCache viewParent(&viewDummy);
+    while (state.KeepRunning()) {
+        CCoinsViewCache view(&viewParent);
+        for (const CTransaction& tx : vtx)
+            view.ModifyCoins(tx.GetHash())->FromTx(tx, 1);
+        bool ok = view.Flush();
+        assert(ok);
+    }
+}
+
+BENCHMARK(CoinsCacheAccess);
+BENCHMARK(CoinsCacheFlush);
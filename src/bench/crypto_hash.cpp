@@ -0,0 +1,74 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "consensus/merkle.h"
+#include "crypto/sha256.h"
+#include "random.h"
+#include "uint256.h"
+
+#include <vector>
+
+/** Input of the streaming SHA-256 benchmarks */
+static const size_t BENCH_SHA256_BYTES = 1000 * 1000;
+/** 64-byte blocks hashed per iteration by the double SHA-256 benchmarks */
+static const size_t BENCH_SHA256D64_BLOCKS = 1024;
+/** Leaves of the merkle root benchmark, about a full block of small transactions */
+static const size_t BENCH_MERKLE_LEAVES = 4000;
+
+// Each benchmark restricts SHA256AutoDetect to one backend and restores the full choice afterwards.
+// On a CPU without that backend it falls back to, and so measures, the portable code.
+
+static void BenchSHA256(benchmark::State& state, sha256_implementation::UseImplementation use)
+{
+    SHA256AutoDetect(use);
+    std::vector<unsigned char> in(BENCH_SHA256_BYTES, 0);
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    state.SetBytesPerIteration(in.size());
+    while (state.KeepRunning())
+        CSHA256().Write(in.data(), in.size()).Finalize(hash);
+    SHA256AutoDetect();
+}
+
+static void BenchSHA256D64(benchmark::State& state, sha256_implementation::UseImplementation use)
+{
+    SHA256AutoDetect(use);
+    std::vector<unsigned char> in(64 * BENCH_SHA256D64_BLOCKS, 0);
+    state.SetBytesPerIteration(in.size());
+    while (state.KeepRunning())
+        SHA256D64(in.data(), in.data(), BENCH_SHA256D64_BLOCKS);
+    SHA256AutoDetect();
+}
+
+static void SHA256_STANDARD(benchmark::State& state) { BenchSHA256(state, sha256_implementation::STANDARD); }
+static void SHA256_SHANI(benchmark::State& state) { BenchSHA256(state, sha256_implementation::USE_SHANI); }
+
+static void SHA256D64_1024_STANDARD(benchmark::State& state) { BenchSHA256D64(state, sha256_implementation::STANDARD); }
+static void SHA256D64_1024_SSE41(benchmark::State& state) { BenchSHA256D64(state, sha256_implementation::USE_SSE41); }
+static void SHA256D64_1024_AVX2(benchmark::State& state) { BenchSHA256D64(state, sha256_implementation::USE_AVX2); }
+static void SHA256D64_1024_SHANI(benchmark::State& state) { BenchSHA256D64(state, sha256_implementation::USE_SHANI); }
+
+// Merkle root of a block's worth of txids with the backends btcud would pick
+static void MerkleRoot(benchmark::State& state)
+{
+    FastRandomContext rand(true);
+    std::vector<uint256> leaves(BENCH_MERKLE_LEAVES);
+    for (uint256& leaf : leaves)
+        leaf = rand.rand256();
+    state.SetBytesPerIteration(leaves.size() * sizeof(uint256));
+    while (state.KeepRunning()) {
+        bool mutated;
+        uint256 root = ComputeMerkleRoot(leaves, &mutated);
+        leaves[0] = root;
+    }
+}
+
+BENCHMARK(SHA256_STANDARD);
+BENCHMARK(SHA256_SHANI);
+BENCHMARK(SHA256D64_1024_STANDARD);
+BENCHMARK(SHA256D64_1024_SSE41);
+BENCHMARK(SHA256D64_1024_AVX2);
+BENCHMARK(SHA256D64_1024_SHANI);
+BENCHMARK(MerkleRoot);
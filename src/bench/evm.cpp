@@ -0,0 +1,90 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bench_chain.h"
+
+#include "contract.h"
+#include "main.h"
+#include "script/standard.h"
+#include "utilstrencodings.h"
+
+#include <cassert>
+
+// Contract whose code increments storage slot 0 on every call:
+// PUSH1 0 SLOAD PUSH1 1 ADD PUSH1 0 SSTORE STOP, behind a constructor returning it
+static const char* BENCH_CONTRACT_CODE = "600a80600b6000396000f360005460010160005500";
+
+static const uint64_t BENCH_GAS_LIMIT = 1000000;
+
+static QtumTransaction CreateBenchQtumTx(const dev::bytes& data, const dev::Address& dest, uint32_t nOut)
+{
+    QtumTransaction tx;
+    if (dest == dev::Address())
+        tx = QtumTransaction(0, 40, BENCH_GAS_LIMIT, data, dev::u256(0));
+    else
+        tx = QtumTransaction(0, 40, BENCH_GAS_LIMIT, dest, data, dev::u256(0));
+    tx.forceSender(dev::Address("0101010101010101010101010101010101010101"));
+    tx.setHashWith(dev::h256(nOut + 1));
+    tx.setNVout(nOut);
+    tx.setVersion(VersionVM::GetEVMDefault());
+    return tx;
+}
+
+static CBlock CreateBenchEVMBlock()
+{
+    CMutableTransaction txCoinbase;
+    txCoinbase.vin.resize(1);
+    txCoinbase.vin[0].prevout.SetNull();
+    txCoinbase.vout.push_back(CTxOut(0, BenchChain::Get().scriptCoinbase));
+    CBlock block;
+    block.nTime = chainActive.Tip()->nTime + 1;
+    block.nBits = chainActive.Tip()->nBits;
+    block.vtx.push_back(MakeTransactionRef(txCoinbase));
+    return block;
+}
+
+// Execution and result processing of a contract creation, without committing it
+static void EVMContractCreate(benchmark::State& state)
+{
+    BenchChain::Get();
+    LOCK(cs_main);
+    const CBlock block = CreateBenchEVMBlock();
+    const std::vector<QtumTransaction> txs{CreateBenchQtumTx(ParseHex(BENCH_CONTRACT_CODE), dev::Address(), 0)};
+    TemporaryState tmpState(globalState);
+    while (state.KeepRunning()) {
+        ByteCodeExec exec(block, txs, BENCH_GAS_LIMIT, chainActive.Tip());
+        bool ok = exec.performByteCode(dev::eth::Permanence::Reverted);
+        ByteCodeExecResult result;
+        ok &= exec.processingResults(result);
+        assert(ok);
+    }
+}
+
+// A call doing one storage read and write on a deployed contract, without committing it
+static void EVMContractCall(benchmark::State& state)
+{
+    BenchChain::Get();
+    LOCK(cs_main);
+    const CBlock block = CreateBenchEVMBlock();
+    TemporaryState tmpState(globalState);
+
+    ByteCodeExec deploy(block, {CreateBenchQtumTx(ParseHex(BENCH_CONTRACT_CODE), dev::Address(), 0)}, BENCH_GAS_LIMIT, chainActive.Tip());
+    bool ok = deploy.performByteCode();
+    assert(ok);
+    const dev::Address contract = deploy.getResult()[0].execRes.newAddress;
+    assert(contract != dev::Address());
+
+    const std::vector<QtumTransaction> txs{CreateBenchQtumTx(dev::bytes(), contract, 1)};
+    while (state.KeepRunning()) {
+        ByteCodeExec exec(block, txs, BENCH_GAS_LIMIT, chainActive.Tip());
+        ok = exec.performByteCode(dev::eth::Permanence::Reverted);
+        ByteCodeExecResult result;
+        ok &= exec.processingResults(result);
+        assert(ok);
+    }
+}
+
+BENCHMARK(EVMContractCreate);
+BENCHMARK(EVMContractCall);
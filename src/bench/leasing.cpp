@@ -0,0 +1,78 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bench_chain.h"
+
+#include "init.h"
+#include "leasing/leasing_tiers.h"
+#include "leasing/leasingmanager.h"
+
+#include <cassert>
+
+// Tier lookups of a full reward computation, over the whole range of every schedule
+static void LeasingTierLookup(benchmark::State& state)
+{
+    int64_t nValue = 0;
+    int64_t nSum = 0;
+    while (state.KeepRunning()) {
+        nSum += GetLeasingTierPct(LEASING_HEIGHT_TIERS, nValue * 7);
+        nSum += GetLeasingTierPct(LEASING_SUPPLY_TIERS, nValue * 11);
+        nSum += GetLeasingTierPct(LEASING_AMOUNT_TIERS, nValue);
+        nSum += GetLeasingTierPct(LEASING_AGE_TIERS, nValue);
+        nValue = (nValue + 9973) % 2000000;
+    }
+    assert(nSum > 0);
+}
+
+#ifdef ENABLE_LEASING_MANAGER
+// Rewards of every leasing output of the fixture chain, as checked for a leasing reward transaction
+static void LeasingCalcRewards(benchmark::State& state)
+{
+    BenchChain& chain = BenchChain::Get();
+    assert(pleasingManagerMain);
+    std::vector<CTxOut> vRewards;
+    while (state.KeepRunning()) {
+        vRewards.clear();
+        pleasingManagerMain->CalcLeasingRewards(chain.vLeasingPoints, vRewards);
+    }
+    assert(vRewards.size() == chain.vLeasingPoints.size());
+}
+
+// Same rewards as LeasingCalcRewards, one CalcLeasingReward call per output
+static void LeasingCalcRewardEach(benchmark::State& state)
+{
+    BenchChain& chain = BenchChain::Get();
+    assert(pleasingManagerMain);
+    std::vector<CTxOut> vRewards;
+    while (state.KeepRunning()) {
+        vRewards.clear();
+        for (const auto& point : chain.vLeasingPoints)
+            vRewards.emplace_back(pleasingManagerMain->CalcLeasingReward(point.first, point.second));
+    }
+
+    std::vector<CTxOut> vBatch;
+    pleasingManagerMain->CalcLeasingRewards(chain.vLeasingPoints, vBatch);
+    assert(vRewards == vBatch);
+}
+
+// Selection and computation of the rewards a validator pays out in a block
+static void LeasingGetRewards(benchmark::State& state)
+{
+    BenchChain& chain = BenchChain::Get();
+    assert(pleasingManagerMain);
+    const CKeyID leaserID = chain.leaserKey.GetPubKey().GetID();
+    std::vector<CTxOut> vRewards;
+    while (state.KeepRunning()) {
+        vRewards.clear();
+        pleasingManagerMain->GetLeasingRewards(LeaserType::ValidatorNode, leaserID, BENCH_LEASING_OUTPUTS, vRewards);
+    }
+}
+
+BENCHMARK(LeasingCalcRewards);
+BENCHMARK(LeasingCalcRewardEach);
+BENCHMARK(LeasingGetRewards);
+#endif // ENABLE_LEASING_MANAGER
+
+BENCHMARK(LeasingTierLookup);
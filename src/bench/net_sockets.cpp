@@ -0,0 +1,115 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "net.h"
+#include "netbase.h"
+#include "protocol.h"
+#include "random.h"
+#include "streams.h"
+#include "utiltime.h"
+#include "version.h"
+
+#include <cassert>
+#include <thread>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+/** Peers of the swarm that stay connected without sending anything */
+static const int SWARM_IDLE_PEERS = 200;
+
+static size_t CountNodes()
+{
+    LOCK(cs_vNodes);
+    return vNodes.size();
+}
+
+static void WaitForNodes(size_t nCount)
+{
+    while (CountNodes() != nCount)
+        MilliSleep(1);
+}
+
+static SOCKET ConnectLoopback(const CService& addr)
+{
+    SOCKET hSocket = INVALID_SOCKET;
+    bool fConnected = ConnectSocket(addr, hSocket, DEFAULT_CONNECT_TIMEOUT);
+    assert(fConnected);
+    return hSocket;
+}
+
+// A swarm of loopback peers is connected to the socket handler and one of them pings it.
+// Every iteration is timed until the handler has received the message, so the cost of a
+// pass of the handler shows, including whatever it spends on the idle peers.
+
+static void NetSocketSwarm(benchmark::State& state)
+{
+    const int nMaxConnectionsOld = nMaxConnections;
+    nMaxConnections = 2 * SWARM_IDLE_PEERS;
+
+    // Listen on a loopback port nobody else uses
+    struct in_addr ipLoopback;
+    ipLoopback.s_addr = htonl(INADDR_LOOPBACK);
+    CService addrBind;
+    std::string strError;
+    bool fBound = false;
+    for (int i = 0; i < 16 && !fBound; i++) {
+        addrBind = CService(ipLoopback, 20000 + GetRand(20000));
+        fBound = BindListenPort(addrBind, strError);
+    }
+    assert(fBound);
+    boost::thread threadSocket(&ThreadSocketHandler);
+
+    SOCKET hActive = ConnectLoopback(addrBind);
+    WaitForNodes(1);
+    CNode* pnode;
+    {
+        LOCK(cs_vNodes);
+        pnode = vNodes.front()->AddRef();
+    }
+    std::vector<SOCKET> vIdle;
+    for (int i = 0; i < SWARM_IDLE_PEERS; i++)
+        vIdle.push_back(ConnectLoopback(addrBind));
+    WaitForNodes(SWARM_IDLE_PEERS + 1);
+
+    CDataStream ssPing(SER_NETWORK, PROTOCOL_VERSION);
+    uint64_t nonce = 0;
+    ssPing << CMessageHeader("ping", sizeof(nonce)) << nonce;
+    state.SetBytesPerIteration(ssPing.size());
+    while (state.KeepRunning()) {
+        int nBytes = send(hActive, &ssPing[0], ssPing.size(), MSG_NOSIGNAL);
+        assert(nBytes == (int)ssPing.size());
+
+        // Stand in for the message handler, taking the message and making room for the next one
+        bool fReceived = false;
+        while (!fReceived) {
+            {
+                LOCK(pnode->cs_vRecvMsg);
+                fReceived = !pnode->vRecvMsg.empty() && pnode->vRecvMsg.front().complete();
+                if (fReceived) {
+                    pnode->vRecvMsg.clear();
+                    pnode->UpdateRecvInterest();
+                }
+            }
+            if (!fReceived)
+                std::this_thread::yield();
+        }
+    }
+
+    {
+        LOCK(cs_vNodes);
+        pnode->Release();
+    }
+    CloseSocket(hActive);
+    for (SOCKET& hSocket : vIdle)
+        CloseSocket(hSocket);
+    WaitForNodes(0);
+    threadSocket.interrupt();
+    threadSocket.join();
+    nMaxConnections = nMaxConnectionsOld;
+}
+
+BENCHMARK(NetSocketSwarm);
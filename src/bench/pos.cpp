@@ -0,0 +1,76 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bench_chain.h"
+
+#include "kernel.h"
+#include "main.h"
+#include "script/sign.h"
+#include "stakeinput.h"
+
+#include <cassert>
+
+// Block on top of the tip staking the last spendable coinbase of the fixture chain
+static CBlock CreateBenchStakeBlock()
+{
+    BenchChain& chain = BenchChain::Get();
+    const CTransaction& txFrom = chain.vSpendable.back();
+
+    CMutableTransaction txCoinStake;
+    txCoinStake.vin.emplace_back(COutPoint(txFrom.GetHash(), 0));
+    txCoinStake.vout.resize(2);
+    txCoinStake.vout[0].SetEmpty();
+    txCoinStake.vout[1] = CTxOut(txFrom.vout[0].nValue, chain.scriptCoinbase);
+    bool ok = SignSignature(chain.keystore, txFrom, txCoinStake, 0, SIGHASH_ALL);
+    assert(ok);
+
+    CMutableTransaction txCoinbase;
+    txCoinbase.vin.resize(1);
+    txCoinbase.vin[0].prevout.SetNull();
+    txCoinbase.vout.resize(1);
+    txCoinbase.vout[0].SetEmpty();
+
+    LOCK(cs_main);
+    CBlock block;
+    block.hashPrevBlock = chainActive.Tip()->GetBlockHash();
+    block.nTime = GetTimeSlot(chainActive.Tip()->nTime) + 60;
+    block.nBits = chainActive.Tip()->nBits;
+    block.vtx.push_back(MakeTransactionRef(txCoinbase));
+    block.vtx.push_back(MakeTransactionRef(txCoinStake));
+    return block;
+}
+
+// Stake input lookup, coinstake signature check and kernel hash of a PoS block.
+// Whether the kernel meets the target does not matter, the work is the same.
+static void CheckProofOfStakeP2PKH(benchmark::State& state)
+{
+    const CBlock block = CreateBenchStakeBlock();
+    LOCK(cs_main);
+    const int nPreviousBlockHeight = chainActive.Height();
+    while (state.KeepRunning()) {
+        uint256 hashProofOfStake;
+        std::unique_ptr<CStakeInput> stake;
+        CheckProofOfStake(block, hashProofOfStake, stake, nPreviousBlockHeight);
+    }
+}
+
+// Kernel hash of a stake input alone, as done for every stakeable output while staking
+static void StakeKernelHash(benchmark::State& state)
+{
+    BenchChain& chain = BenchChain::Get();
+    CBTCUStake stake;
+    bool ok = stake.SetInput(chain.vSpendable.back(), 0);
+    assert(ok);
+    LOCK(cs_main);
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    const unsigned int nTime = GetTimeSlot(pindexPrev->nTime) + 60;
+    while (state.KeepRunning()) {
+        uint256 hashProofOfStake;
+        CheckStakeKernelHash(pindexPrev, pindexPrev->nBits, &stake, nTime, hashProofOfStake, true);
+    }
+}
+
+BENCHMARK(CheckProofOfStakeP2PKH);
+BENCHMARK(StakeKernelHash);
@@ -0,0 +1,100 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "key.h"
+#include "masternode-validators.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "version.h"
+
+#include <cassert>
+
+/** Transactions of the block the serialization benchmarks round-trip */
+static const size_t SERIALIZE_BLOCK_TXS = 1000;
+/** Candidates voted on by the validator vote transaction */
+static const size_t SERIALIZE_VALIDATOR_VOTES = 50;
+
+static CBlock CreateSerializeBlock()
+{
+    FastRandomContext rand(true);
+    CBlock block;
+    block.nVersion = CBlockHeader::CURRENT_VERSION;
+    block.hashPrevBlock = rand.rand256();
+    for (size_t i = 0; i < SERIALIZE_BLOCK_TXS; i++) {
+        CMutableTransaction tx;
+        tx.vin.emplace_back(COutPoint(rand.rand256(), rand.randrange(4)), CScript() << rand.randbytes(72) << rand.randbytes(33));
+        for (int j = 0; j < 2; j++)
+            tx.vout.emplace_back(rand.randrange(100 * COIN), GetScriptForDestination(PKHash(uint160(rand.randbytes(20)))));
+        block.vtx.push_back(MakeTransactionRef(tx));
+    }
+    return block;
+}
+
+static CTransaction CreateValidatorVoteTx()
+{
+    FastRandomContext rand(true);
+    CKey key;
+    key.MakeNewKey(true);
+    std::vector<MNVote> votes;
+    for (size_t i = 0; i < SERIALIZE_VALIDATOR_VOTES; i++) {
+        CTxIn vinCandidate(COutPoint(rand.rand256(), 0));
+        votes.emplace_back(vinCandidate, (i % 3 == 0) ? VoteNo : VoteYes);
+    }
+    CValidatorVote vote(CTxIn(COutPoint(rand.rand256(), 0)), key.GetPubKey(), votes);
+    bool ok = vote.Sign(key);
+    assert(ok);
+
+    CMutableTransaction tx;
+    tx.nVersion = CTransaction::BTCU_START_VERSION;
+    tx.vin.emplace_back(COutPoint(rand.rand256(), 0));
+    tx.vout.emplace_back(COIN, GetScriptForDestination(PKHash(key.GetPubKey())));
+    tx.validatorVote.push_back(vote);
+    return CTransaction(tx);
+}
+
+static void DeserializeBlock(benchmark::State& state)
+{
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << CreateSerializeBlock();
+    const std::string strBlock = ssBlock.str();
+    while (state.KeepRunning()) {
+        CDataStream stream(strBlock.data(), strBlock.data() + strBlock.size(), SER_NETWORK, PROTOCOL_VERSION);
+        CBlock block;
+        stream >> block;
+        assert(block.vtx.size() == SERIALIZE_BLOCK_TXS);
+    }
+}
+
+static void SerializeBlock(benchmark::State& state)
+{
+    const CBlock block = CreateSerializeBlock();
+    while (state.KeepRunning()) {
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << block;
+        assert(!stream.empty());
+    }
+}
+
+// Round trip and signature check of a transaction carrying a validator vote
+static void ValidatorVoteRoundTrip(benchmark::State& state)
+{
+    const CTransaction txVote = CreateValidatorVoteTx();
+    while (state.KeepRunning()) {
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << txVote;
+        CTransaction tx;
+        stream >> tx;
+        const CValidatorVote& vote = tx.validatorVote.front();
+        bool ok = vote.Verify(vote.pubKey);
+        assert(ok);
+    }
+}
+
+BENCHMARK(DeserializeBlock);
+BENCHMARK(SerializeBlock);
+BENCHMARK(ValidatorVoteRoundTrip);
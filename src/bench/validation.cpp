@@ -0,0 +1,53 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bench_chain.h"
+
+#include "main.h"
+#include "policy/policy.h"
+#include "script/standard.h"
+
+#include <cassert>
+
+/** Transactions of the block connected by the ConnectBlock benchmark */
+static const size_t CONNECT_BLOCK_TXS = 50;
+
+// Full contextual check and ConnectBlock of a block spending mature coinbases,
+// against a throwaway view on top of the tip
+static void ConnectBlockP2PKH(benchmark::State& state)
+{
+    BenchChain& chain = BenchChain::Get();
+    assert(chain.vSpendable.size() >= CONNECT_BLOCK_TXS);
+    std::vector<CMutableTransaction> txns;
+    for (size_t i = 0; i < CONNECT_BLOCK_TXS; i++)
+        txns.push_back(chain.SpendCoinbase(chain.vSpendable[i], chain.scriptCoinbase, 2));
+    const CBlock block = chain.CreateBlock(txns);
+
+    LOCK(cs_main);
+    while (state.KeepRunning()) {
+        CValidationState valState;
+        bool ok = TestBlockValidity(valState, block, chainActive.Tip(), false, true);
+        assert(ok);
+    }
+}
+
+// Script and amount checks of a single P2PKH spend
+static void CheckInputsP2PKH(benchmark::State& state)
+{
+    BenchChain& chain = BenchChain::Get();
+    const CTransaction tx(chain.SpendCoinbase(chain.vSpendable.front(), chain.scriptCoinbase));
+
+    LOCK(cs_main);
+    CCoinsViewCache view(pcoinsTip);
+    while (state.KeepRunning()) {
+        CValidationState valState;
+        PrecomputedTransactionData txdata;
+        bool ok = CheckInputs(tx, valState, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, false, txdata);
+        assert(ok);
+    }
+}
+
+BENCHMARK(ConnectBlockP2PKH);
+BENCHMARK(CheckInputsP2PKH);
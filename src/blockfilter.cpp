@@ -0,0 +1,206 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "crypto/common.h"
+#include "crypto/siphash.h"
+#include "primitives/block.h"
+#include "script/standard.h"
+#include "undo.h"
+
+#include <algorithm>
+#include <ios>
+
+namespace {
+/** Appends bits to a byte vector, most significant bit first */
+class CBitWriter
+{
+private:
+    std::vector<unsigned char>& vch;
+    uint8_t nBuffer = 0;
+    int nBits = 0;
+
+public:
+    explicit CBitWriter(std::vector<unsigned char>& vchIn) : vch(vchIn) {}
+
+    //! Write the nCount (at most 64) low bits of data
+    void Write(uint64_t data, int nCount)
+    {
+        while (nCount > 0) {
+            const int nWrite = std::min(8 - nBits, nCount);
+            nBuffer |= ((data >> (nCount - nWrite)) & ((1 << nWrite) - 1)) << (8 - nBits - nWrite);
+            nBits += nWrite;
+            nCount -= nWrite;
+            if (nBits == 8)
+                Flush();
+        }
+    }
+
+    void Flush()
+    {
+        if (nBits == 0)
+            return;
+        vch.push_back(nBuffer);
+        nBuffer = 0;
+        nBits = 0;
+    }
+};
+
+/** Reads bits written by CBitWriter */
+class CBitReader
+{
+private:
+    const std::vector<unsigned char>& vch;
+    size_t nPos;
+    uint8_t nBuffer = 0;
+    int nBits = 0;
+
+public:
+    CBitReader(const std::vector<unsigned char>& vchIn, size_t nPosIn) : vch(vchIn), nPos(nPosIn) {}
+
+    uint64_t Read(int nCount)
+    {
+        uint64_t data = 0;
+        while (nCount > 0) {
+            if (nBits == 0) {
+                if (nPos >= vch.size())
+                    throw std::ios_base::failure("CBitReader::Read() : end of data");
+                nBuffer = vch[nPos++];
+                nBits = 8;
+            }
+            const int nRead = std::min(nBits, nCount);
+            data <<= nRead;
+            data |= (nBuffer >> (nBits - nRead)) & ((1 << nRead) - 1);
+            nBits -= nRead;
+            nCount -= nRead;
+        }
+        return data;
+    }
+};
+
+void GolombRiceEncode(CBitWriter& writer, uint64_t x)
+{
+    // Quotient in unary, then the remainder in BLOCK_FILTER_P bits
+    uint64_t q = x >> BLOCK_FILTER_P;
+    while (q > 0) {
+        const int nOnes = std::min<uint64_t>(q, 64);
+        writer.Write(~0ULL, nOnes);
+        q -= nOnes;
+    }
+    writer.Write(0, 1);
+    writer.Write(x, BLOCK_FILTER_P);
+}
+
+uint64_t GolombRiceDecode(CBitReader& reader)
+{
+    uint64_t q = 0;
+    while (reader.Read(1) == 1)
+        q++;
+    return (q << BLOCK_FILTER_P) + reader.Read(BLOCK_FILTER_P);
+}
+
+/** Map x uniformly into [0, n), as (x * n) >> 64 */
+uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+#ifdef __SIZEOF_INT128__
+    return (static_cast<unsigned __int128>(x) * static_cast<unsigned __int128>(n)) >> 64;
+#else
+    const uint64_t x_hi = x >> 32, x_lo = x & 0xFFFFFFFF;
+    const uint64_t n_hi = n >> 32, n_lo = n & 0xFFFFFFFF;
+    const uint64_t ac = x_hi * n_hi, ad = x_hi * n_lo, bc = x_lo * n_hi, bd = x_lo * n_lo;
+    const uint64_t mid34 = (bd >> 32) + (bc & 0xFFFFFFFF) + (ad & 0xFFFFFFFF);
+    return ac + (bc >> 32) + (ad >> 32) + (mid34 >> 32);
+#endif
+}
+}
+
+GCSFilter::GCSFilter(const uint256& hashKey, const ElementSet& elements)
+    : nSipHashK0(ReadLE64(hashKey.begin())), nSipHashK1(ReadLE64(hashKey.begin() + 8)), nN(elements.size())
+{
+    vEncoded.resize(4);
+    WriteLE32(vEncoded.data(), nN);
+
+    const std::vector<uint64_t> vHashes = HashElements(elements);
+    CBitWriter writer(vEncoded);
+    uint64_t nLast = 0;
+    for (uint64_t nHash : vHashes) {
+        GolombRiceEncode(writer, nHash - nLast);
+        nLast = nHash;
+    }
+    writer.Flush();
+}
+
+GCSFilter::GCSFilter(const uint256& hashKey, const std::vector<unsigned char>& vEncodedIn)
+    : nSipHashK0(ReadLE64(hashKey.begin())), nSipHashK1(ReadLE64(hashKey.begin() + 8)), nN(0), vEncoded(vEncodedIn)
+{
+    if (vEncoded.size() >= 4)
+        nN = ReadLE32(vEncoded.data());
+}
+
+std::vector<uint64_t> GCSFilter::HashElements(const ElementSet& elements) const
+{
+    const uint64_t nF = static_cast<uint64_t>(nN) * BLOCK_FILTER_M;
+    std::vector<uint64_t> vHashes;
+    vHashes.reserve(elements.size());
+    for (const Element& element : elements) {
+        const uint64_t nHash = CSipHasher(nSipHashK0, nSipHashK1).Write(element.data(), element.size()).Finalize();
+        vHashes.push_back(MapIntoRange(nHash, nF));
+    }
+    std::sort(vHashes.begin(), vHashes.end());
+    return vHashes;
+}
+
+bool GCSFilter::MatchAny(const ElementSet& elements) const
+{
+    if (vEncoded.size() < 4)
+        return true;
+    if (nN == 0 || elements.empty())
+        return false;
+
+    const std::vector<uint64_t> vQuery = HashElements(elements);
+    try {
+        CBitReader reader(vEncoded, 4);
+        uint64_t nValue = 0;
+        auto it = vQuery.begin();
+        for (uint32_t i = 0; i < nN; i++) {
+            nValue += GolombRiceDecode(reader);
+            while (it != vQuery.end() && *it < nValue)
+                ++it;
+            if (it == vQuery.end())
+                return false;
+            if (*it == nValue)
+                return true;
+        }
+    } catch (const std::ios_base::failure&) {
+        return true;
+    }
+    return false;
+}
+
+void ExtractScriptFilterElements(const CScript& script, GCSFilter::ElementSet& elements)
+{
+    if (script.empty())
+        return;
+    elements.insert(GCSFilter::Element(script.begin(), script.end()));
+
+    std::vector<uint160> vHashes;
+    ExtractScriptKeyHashes(script, vHashes);
+    for (const uint160& hash : vHashes)
+        elements.insert(GCSFilter::Element(hash.begin(), hash.end()));
+}
+
+GCSFilter BuildBlockFilter(const CBlock& block, const CBlockUndo& blockundo)
+{
+    GCSFilter::ElementSet elements;
+    for (const CTransactionRef& tx : block.vtx) {
+        for (const CTxOut& out : tx->vout)
+            ExtractScriptFilterElements(out.scriptPubKey, elements);
+    }
+    for (const CTxUndo& txundo : blockundo.vtxundo) {
+        for (const CTxInUndo& prevout : txundo.vprevout)
+            ExtractScriptFilterElements(prevout.txout.scriptPubKey, elements);
+    }
+    return GCSFilter(block.GetHash(), elements);
+}
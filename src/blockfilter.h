@@ -0,0 +1,62 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTER_H
+#define BITCOIN_BLOCKFILTER_H
+
+#include "uint256.h"
+
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+class CScript;
+
+/** Golomb-Rice parameter of block filters: remainders take this many bits */
+static const uint8_t BLOCK_FILTER_P = 19;
+/** Inverse false positive rate of block filters, per queried element */
+static const uint32_t BLOCK_FILTER_M = 784931;
+
+/**
+ * Golomb-coded set (as in BIP 158): a compact probabilistic set of byte strings.
+ * Elements are hashed with SipHash keyed by a block hash into [0, N * M), and the
+ * sorted hashes are stored as Golomb-Rice coded differences. A query for an element
+ * that was added always matches; any other element matches with probability 1/M.
+ */
+class GCSFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::set<Element> ElementSet;
+
+    //! Build the filter of a set of elements
+    GCSFilter(const uint256& hashKey, const ElementSet& elements);
+    //! Load a filter from its encoding
+    GCSFilter(const uint256& hashKey, const std::vector<unsigned char>& vEncodedIn);
+
+    //! Whether the filter may contain any of the elements; a corrupt filter matches everything
+    bool MatchAny(const ElementSet& elements) const;
+
+    uint32_t GetN() const { return nN; }
+    const std::vector<unsigned char>& GetEncoded() const { return vEncoded; }
+
+private:
+    uint64_t nSipHashK0;
+    uint64_t nSipHashK1;
+    uint32_t nN;
+    //! Element count (4 bytes, little endian) followed by the coded hashes
+    std::vector<unsigned char> vEncoded;
+
+    std::vector<uint64_t> HashElements(const ElementSet& elements) const;
+};
+
+/** Add what a script can be matched by to a block filter: the script and its key hashes (see ExtractScriptKeyHashes) */
+void ExtractScriptFilterElements(const CScript& script, GCSFilter::ElementSet& elements);
+
+/** Filter over the scripts a block pays to and the scripts of the outputs it spends */
+GCSFilter BuildBlockFilter(const CBlock& block, const CBlockUndo& blockundo);
+
+#endif // BITCOIN_BLOCKFILTER_H
@@ -312,7 +312,7 @@ public:
 
         if (block.IsProofOfStake()) {
             SetProofOfStake();
-            prevoutStake = block.vtx[1].vin[0].prevout;
+            prevoutStake = block.vtx[1]->vin[0].prevout;
             nStakeTime = block.nTime;
         }
     }
@@ -532,16 +532,20 @@ class CDiskBlockIndex : public CBlockIndex
 public:
     uint256 hashPrev;
     uint256 hashNext;
+    //! Hash of the header when known, from the index or the block tree DB key; not serialized
+    uint256 hashBlock;
 
     CDiskBlockIndex()
     {
         hashPrev = uint256();
         hashNext = uint256();
+        hashBlock = uint256();
     }
 
     explicit CDiskBlockIndex(const CBlockIndex* pindex) : CBlockIndex(*pindex)
     {
         hashPrev = (pprev ? pprev->GetBlockHash() : uint256(0));
+        hashBlock = (pindex->phashBlock ? *pindex->phashBlock : uint256());
     }
 
     ADD_SERIALIZE_METHODS;
@@ -606,6 +610,9 @@ public:
 
     uint256 GetBlockHash() const
     {
+        if (!hashBlock.IsNull())
+            return hashBlock;
+
         CBlockHeader block;
         block.nVersion = nVersion;
         block.hashPrevBlock = hashPrev;
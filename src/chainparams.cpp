@@ -264,7 +264,7 @@ public:
             txNew.validatorRegister.push_back(validatorReg);
         }
         
-        genesis.vtx.push_back(txNew);
+        genesis.vtx.push_back(MakeTransactionRef(txNew));
         genesis.hashPrevBlock = 0;
         genesis.hashMerkleRoot = BlockMerkleRoot(genesis);
         genesis.nVersion = 8;
@@ -416,7 +416,7 @@ public:
         genesis.nNonce = 7611948;
 
         //! Modify genesis testnet validators pubkeys
-        CMutableTransaction txNew = genesis.vtx[0];
+        CMutableTransaction txNew = *genesis.vtx[0];
         txNew.validatorRegister.clear();
 
         std::vector<std::string> validatorsPubkeys = {
@@ -434,7 +434,7 @@ public:
            validatorReg.nTime = 0;
            txNew.validatorRegister.push_back(validatorReg);
         }
-        genesis.vtx[0] = txNew;
+        genesis.vtx[0] = MakeTransactionRef(txNew);
         genesis.hashMerkleRoot = BlockMerkleRoot(genesis);
 
         hashGenesisBlock = genesis.GetHash();
@@ -537,7 +537,7 @@ public:
         genesis.nNonce = 3055395;
 
         //! Modify genesis regtest validators pubkeys
-        CMutableTransaction txNew = genesis.vtx[0];
+        CMutableTransaction txNew = *genesis.vtx[0];
         txNew.validatorRegister.clear();
 
         std::vector<std::string> validatorsPubkeys = {
@@ -553,7 +553,7 @@ public:
            validatorReg.nTime = 0;
            txNew.validatorRegister.push_back(validatorReg);
         }
-        genesis.vtx[0] = txNew;
+        genesis.vtx[0] = MakeTransactionRef(txNew);
         genesis.hashMerkleRoot = BlockMerkleRoot(genesis);
 
         hashGenesisBlock = genesis.GetHash();
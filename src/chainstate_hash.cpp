@@ -0,0 +1,251 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainstate_hash.h"
+
+#include "clientversion.h"
+#include "crypto/sha256.h"
+#include "hash.h"
+#include "streams.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <atomic>
+#include <map>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+static const int CHAINSTATE_HASH_VERSION = 2;
+
+/** SHA-256 digest of one .ldb file, valid while the file keeps its name, size and mtime */
+class CChainstateFileDigest
+{
+public:
+    std::string strName;
+    uint64_t nSize;
+    int64_t nTime;
+    uint256 digest;
+
+    CChainstateFileDigest() : nSize(0), nTime(0) {}
+
+    bool SameFile(const CChainstateFileDigest& other) const
+    {
+        return strName == other.strName && nSize == other.nSize && nTime == other.nTime;
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(strName);
+        READWRITE(nSize);
+        READWRITE(nTime);
+        READWRITE(digest);
+    }
+};
+
+/** Read-only view of a whole chainstate file, memory mapped where available */
+class CChainstateFileView
+{
+private:
+    const unsigned char* pdata;
+    size_t nSize;
+    bool fMapped;
+    std::vector<unsigned char> vchBuffer;
+
+public:
+    CChainstateFileView() : pdata(nullptr), nSize(0), fMapped(false) {}
+    CChainstateFileView(const CChainstateFileView&) = delete;
+    CChainstateFileView& operator=(const CChainstateFileView&) = delete;
+
+    ~CChainstateFileView()
+    {
+#ifndef WIN32
+        if (fMapped)
+            munmap(const_cast<unsigned char*>(pdata), nSize);
+#endif
+    }
+
+    const unsigned char* data() const { return pdata; }
+    size_t size() const { return nSize; }
+
+    /** Map (or read) the whole file */
+    bool Load(const boost::filesystem::path& p)
+    {
+#ifndef WIN32
+        int fd = open(p.string().c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return false;
+        }
+        nSize = st.st_size;
+        if (nSize > 0) {
+            void* addr = mmap(nullptr, nSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                pdata = static_cast<const unsigned char*>(addr);
+                fMapped = true;
+                madvise(addr, nSize, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+        if (fMapped || nSize == 0)
+            return true;
+#endif
+        FILE* file = fopen(p.string().c_str(), "rb");
+        if (!file)
+            return false;
+        vchBuffer.clear();
+        unsigned char buffer[32768];
+        size_t nRead = 0;
+        while ((nRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            vchBuffer.insert(vchBuffer.end(), buffer, buffer + nRead);
+        bool fError = ferror(file);
+        fclose(file);
+        pdata = vchBuffer.data();
+        nSize = vchBuffer.size();
+        return !fError;
+    }
+};
+
+boost::filesystem::path GetChainstateHashFile()
+{
+    return GetDataDir() / "chainstate_hash.dat";
+}
+
+std::vector<CChainstateFileDigest> ReadChainstateDigests()
+{
+    std::vector<CChainstateFileDigest> vDigests;
+    FILE* file = fopen(GetChainstateHashFile().string().c_str(), "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return vDigests;
+
+    try {
+        int nFileVersion = 0;
+        filein >> nFileVersion;
+        if (nFileVersion != CHAINSTATE_HASH_VERSION)
+            return vDigests;
+        filein >> vDigests;
+    } catch (const std::exception& e) {
+        LogPrintf("%s : Deserialize or I/O error - %s\n", __func__, e.what());
+        vDigests.clear();
+    }
+    return vDigests;
+}
+
+bool WriteChainstateDigests(const std::vector<CChainstateFileDigest>& vDigests)
+{
+    boost::filesystem::path pathHashes = GetChainstateHashFile();
+    boost::filesystem::path pathTmp = pathHashes;
+    pathTmp += ".new";
+
+    FILE* file = fopen(pathTmp.string().c_str(), "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s : Failed to open file %s", __func__, pathTmp.string());
+
+    try {
+        fileout << CHAINSTATE_HASH_VERSION << vDigests;
+    } catch (const std::exception& e) {
+        return error("%s : Serialize or I/O error - %s", __func__, e.what());
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    return RenameOver(pathTmp, pathHashes);
+}
+} // anon namespace
+
+int HashChainstate(std::string &strHash)
+{
+    const int64_t nStart = GetTimeMillis();
+    const boost::filesystem::path& path = GetDataDir() / "chainstate";
+    if (!boost::filesystem::exists(path)) {
+        boost::filesystem::create_directories(path);
+    }
+
+    std::vector<boost::filesystem::path> vPathes;
+    boost::filesystem::recursive_directory_iterator dir_itr { path };
+    std::copy_if(begin(dir_itr), end(dir_itr), std::back_inserter(vPathes),
+                 [](const boost::filesystem::directory_entry& entry) {
+                    return (entry.path().string().find(".ldb") != std::string::npos);
+                 });
+
+    std::sort(begin(vPathes), end(vPathes));
+
+    std::vector<CChainstateFileDigest> vDigests(vPathes.size());
+    for (size_t i = 0; i < vPathes.size(); ++i) {
+        vDigests[i].strName = vPathes[i].lexically_relative(path).string();
+        vDigests[i].nSize = boost::filesystem::file_size(vPathes[i]);
+        vDigests[i].nTime = boost::filesystem::last_write_time(vPathes[i]);
+    }
+
+    // Reuse the digest of every file left as it was, whatever changed around it
+    std::map<std::string, CChainstateFileDigest> mapCached;
+    for (const CChainstateFileDigest& cached : ReadChainstateDigests())
+        mapCached[cached.strName] = cached;
+    std::vector<size_t> vChanged;
+    for (size_t i = 0; i < vDigests.size(); ++i) {
+        std::map<std::string, CChainstateFileDigest>::const_iterator it = mapCached.find(vDigests[i].strName);
+        if (it != mapCached.end() && it->second.SameFile(vDigests[i]))
+            vDigests[i].digest = it->second.digest;
+        else
+            vChanged.push_back(i);
+    }
+
+    // Files are digested independently, so the changed ones are spread over all cores
+    std::atomic<size_t> nNextChanged(0);
+    std::atomic<uint64_t> nBytesHashed(0);
+    std::atomic<bool> fFailed(false);
+    auto digestFiles = [&]() {
+        size_t n;
+        while (!fFailed && (n = nNextChanged++) < vChanged.size()) {
+            const size_t i = vChanged[n];
+            CChainstateFileView view;
+            if (!view.Load(vPathes[i])) {
+                fFailed = true;
+                return;
+            }
+            CSHA256().Write(view.data(), view.size()).Finalize(vDigests[i].digest.begin());
+            nBytesHashed += view.size();
+        }
+    };
+    const size_t nThreads = std::min<size_t>(vChanged.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> vThreads;
+    for (size_t i = 0; i < nThreads; ++i)
+        vThreads.emplace_back(digestFiles);
+    for (std::thread& thread : vThreads)
+        thread.join();
+    if (fFailed)
+        return -534;
+
+    if (!vChanged.empty() || mapCached.size() != vDigests.size())
+        WriteChainstateDigests(vDigests);
+
+    CSHA256 sha256;
+    for (const CChainstateFileDigest& file : vDigests)
+        sha256.Write(file.digest.begin(), file.digest.size());
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    sha256.Finalize(hash);
+    std::string input (reinterpret_cast<const char *> (hash),sizeof (hash) / sizeof (hash[0]));
+    strHash = Hash(input);
+
+    LogPrintf("%s: hashed %u bytes in %u of %u chainstate files in %dms\n", __func__,
+              (uint64_t)nBytesHashed, vChanged.size(), vDigests.size(), GetTimeMillis() - nStart);
+    return 0;
+}
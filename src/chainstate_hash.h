@@ -0,0 +1,18 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BTCU_CHAINSTATE_HASH_H
+#define BTCU_CHAINSTATE_HASH_H
+
+#include <string>
+
+/**
+ * Compute the 256-bit fingerprint of the chainstate directory: SHA-256 over the
+ * SHA-256 digests of all .ldb files in path order, hex-encoded and hashed again.
+ * The digest of every file is cached in chainstate_hash.dat keyed by file
+ * name/size/mtime, so only new or changed files are read, on all cores.
+ */
+int HashChainstate(std::string &strHash);
+
+#endif // BTCU_CHAINSTATE_HASH_H
@@ -63,6 +63,7 @@ bool CCoinsViewIterator::GetTrxHash(uint256&, bool) const { return false; }
 bool CCoinsViewIterator::GetCoins(CCoins&, bool) const { return false; };
 bool CCoinsViewIterator::Valid() const { return false; }
 void CCoinsViewIterator::Next() const { }
+std::unique_ptr<CCoinsViewIterator> CCoinsViewIterator::NewIterator(const uint256& txid) const { return std::unique_ptr<CCoinsViewIterator>(new CCoinsViewIterator()); }
 
 
 bool CCoinsView::GetCoins(const uint256& txid, CCoins& coins) const { return false; }
@@ -342,6 +342,8 @@ public:
     virtual bool Valid() const;
     virtual void Next() const;
 
+    //! Open another, independent cursor over the same view, positioned at the first txid not below txid
+    virtual std::unique_ptr<CCoinsViewIterator> NewIterator(const uint256& txid) const;
 };
 
 /** Abstract view on the open txout dataset. */
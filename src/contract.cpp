@@ -106,9 +106,9 @@ bool CheckSenderScript(const CCoinsViewCache& view, const CTransaction& tx, cons
            if(pblock)
            {
               for (unsigned int i = 0; i < pblock->vtx.size(); i++) {
-                 if(tx.vin[0].prevout.hash == pblock->vtx[i].GetHash())
+                 if(tx.vin[0].prevout.hash == pblock->vtx[i]->GetHash())
                  {
-                    txPrev = pblock->vtx[i];
+                    txPrev = *pblock->vtx[i];
                     break;
                  }
               }
@@ -179,8 +179,7 @@ std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::v
     }
     dev::Address senderAddress = sender == dev::Address() ? dev::Address("ffffffffffffffffffffffffffffffffffffffff") : sender;
     tx.vout.push_back(CTxOut(0, CScript() << OP_DUP << OP_HASH160 << senderAddress.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG));
-    //block.vtx.push_back(MakeTransactionRef(CTransaction(tx)));
-    block.vtx.push_back(CTransaction(tx));
+    block.vtx.push_back(MakeTransactionRef(tx));
 
     QtumTransaction callTransaction(0, 1, dev::u256(gasLimit), addrContract, opcode, dev::u256(0));
     callTransaction.forceSender(senderAddress);
@@ -204,7 +203,7 @@ bool CheckMinGasPrice(std::vector<EthTransactionParams>& etps, const uint64_t& m
 bool CheckReward(const CBlock& block, CValidationState& state, int nHeight, const CChainParams& consensusParams, CAmount nFees, CAmount gasRefunds, CAmount nActualStakeReward, const std::vector<CTxOut>& vouts)
 {
    size_t offset = block.IsProofOfStake() ? 1 : 0;
-   std::vector<CTxOut> vTempVouts=block.vtx[offset].vout;
+   std::vector<CTxOut> vTempVouts=block.vtx[offset]->vout;
    std::vector<CTxOut>::iterator it;
    for(size_t i = 0; i < vouts.size(); i++){
       it=std::find(vTempVouts.begin(), vTempVouts.end(), vouts[i]);
@@ -221,9 +220,9 @@ bool CheckReward(const CBlock& block, CValidationState& state, int nHeight, cons
       // Check proof-of-work reward
       //CAmount blockReward = nFees + GetBlockSubsidy(nHeight, consensusParams);
       CAmount blockReward = nFees + GetBlockValue(nHeight);
-      if (block.vtx[offset].GetValueOut() > blockReward)
+      if (block.vtx[offset]->GetValueOut() > blockReward)
          return state.Invalid(error("CheckReward(): coinbase pays too much (actual=%d vs limit=%d)",
-                                                                        block.vtx[offset].GetValueOut(), blockReward), REJECT_INVALID, "bad-cb-amount");
+                                                                        block.vtx[offset]->GetValueOut(), blockReward), REJECT_INVALID, "bad-cb-amount");
    }
    else
    {
@@ -481,6 +480,91 @@ bool ByteCodeExec::processingResults(ByteCodeExecResult& resultBCE){
     return true;
 }
 
+BlockContractExecutor::~BlockContractExecutor(){
+    if(thread.joinable()){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fNoMore = true;
+            fAbort = true;
+        }
+        cond.notify_one();
+        thread.join();
+    }
+}
+
+void BlockContractExecutor::Add(unsigned int nTx, std::vector<QtumTransaction>&& txs){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.emplace_back();
+        jobs.back().nTx = nTx;
+        jobs.back().txs = std::move(txs);
+    }
+    if(!thread.joinable())
+        thread = std::thread(&BlockContractExecutor::Thread, this);
+    else
+        cond.notify_one();
+}
+
+bool BlockContractExecutor::Wait(){
+    if(thread.joinable()){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fNoMore = true;
+        }
+        cond.notify_one();
+        thread.join();
+    }
+    return !fFailed;
+}
+
+void BlockContractExecutor::Thread(){
+    RenameThread("btcu-contracts");
+    while(true){
+        ContractExecJob* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this]{ return fAbort || fNoMore || nNext < jobs.size(); });
+            if(fAbort || nNext == jobs.size())
+                return;
+            job = &jobs[nNext++];
+        }
+        // after a failure the block is invalid, the remaining jobs are only drained
+        if(!fFailed && !Execute(*job))
+            fFailed = true;
+    }
+}
+
+bool BlockContractExecutor::Execute(ContractExecJob& job){
+    const CTransaction& tx = *block.vtx[job.nTx];
+    try{
+        ByteCodeExec exec(block, job.txs, blockGasLimit, pindex);
+        if(!exec.performByteCode()){
+            strError = "ConnectBlock(): Unknown error during contract execution";
+            return false;
+        }
+        if(!exec.processingResults(job.result)){
+            strError = "ConnectBlock(): Error processing VM execution results";
+            return false;
+        }
+        usedGas += job.result.usedGas;
+        if(usedGas > blockGasLimit){
+            strError = "ConnectBlock(): Block exceeds gas limit";
+            fGasLimitExceeded = true;
+            return false;
+        }
+        for(const CTxOut& refundVout : job.result.refundOutputs){
+            refunds += refundVout.nValue;
+        }
+        if(fLogOpcodes){
+            writeVMlog(exec.getResult(), tx, block);
+        }
+    } catch(const std::exception& e){
+        strError = strprintf("ConnectBlock(): Exception during contract execution of %s: %s", tx.GetHash().ToString(), e.what());
+        return false;
+    }
+    return true;
+}
+
 dev::eth::EnvInfo ByteCodeExec::BuildEVMEnvironment(){
     CBlockIndex* tip = pindex;
     dev::eth::BlockHeader header;
@@ -492,9 +576,9 @@ dev::eth::EnvInfo ByteCodeExec::BuildEVMEnvironment(){
     lastHashes.set(tip);
 
     if(block.IsProofOfStake()){
-        header.setAuthor(EthAddrFromScript(block.vtx[1].vout[1].scriptPubKey));
+        header.setAuthor(EthAddrFromScript(block.vtx[1]->vout[1].scriptPubKey));
     }else {
-        header.setAuthor(EthAddrFromScript(block.vtx[0].vout[0].scriptPubKey));
+        header.setAuthor(EthAddrFromScript(block.vtx[0]->vout[0].scriptPubKey));
     }
     dev::u256 gasUsed;
     dev::eth::EnvInfo env(header, lastHashes, gasUsed, globalSealEngine->chainParams().chainID);
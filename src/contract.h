@@ -15,6 +15,11 @@
 #include "script/interpreter.h"
 #include "chainparams.h"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 class CCoinsViewCache;
 class CBlockIndex;
 
@@ -75,7 +80,8 @@ class QtumTxConverter{
 
 public:
 
-    QtumTxConverter(CTransaction tx, CCoinsViewCache* v = NULL, const std::vector<CTransactionRef>* blockTxs = NULL, unsigned int flags = SCRIPT_EXEC_BYTE_CODE) : txBit(tx), view(v), blockTransactions(blockTxs), sender(false), nFlags(flags){}
+    /** tx is referenced, not copied, and has to outlive the converter */
+    QtumTxConverter(const CTransaction& tx, CCoinsViewCache* v = NULL, const std::vector<CTransactionRef>* blockTxs = NULL, unsigned int flags = SCRIPT_EXEC_BYTE_CODE) : txBit(tx), view(v), blockTransactions(blockTxs), sender(false), nFlags(flags){}
 
     bool extractionQtumTransactions(ExtractQtumTX& qtumTx);
 
@@ -89,7 +95,7 @@ private:
 
     size_t correctedStackSize(size_t size);
 
-    const CTransaction txBit;
+    const CTransaction& txBit;
     const CCoinsViewCache* view;
     std::vector<valtype> stack;
     opcodetype opcode;
@@ -99,6 +105,66 @@ private:
     unsigned int nFlags;
 };
 
+/** Contract executions of one transaction of a block */
+struct ContractExecJob{
+    unsigned int nTx;
+    std::vector<QtumTransaction> txs;
+    ByteCodeExecResult result;
+};
+
+/**
+ * Runs the contract transactions of a block being connected on a dedicated thread,
+ * in block order, while ConnectBlock goes on with inputs, scripts and coins of the
+ * rest of the block. The EVM state is only touched by that thread until Wait() returns.
+ */
+class BlockContractExecutor{
+
+public:
+
+    BlockContractExecutor(const CBlock& _block, const uint64_t _blockGasLimit, CBlockIndex* _pindex, bool _fLogOpcodes) :
+        block(_block), blockGasLimit(_blockGasLimit), pindex(_pindex), fLogOpcodes(_fLogOpcodes) {}
+
+    ~BlockContractExecutor();
+
+    /** Queue the contract executions of block.vtx[nTx], the thread starts with the first one */
+    void Add(unsigned int nTx, std::vector<QtumTransaction>&& txs);
+
+    /** Wait for every queued execution, false if one failed or the block went over its gas limit */
+    bool Wait();
+
+    bool GasLimitExceeded() const { return fGasLimitExceeded; }
+    const std::string& GetError() const { return strError; }
+    uint64_t GetUsedGas() const { return usedGas; }
+    CAmount GetRefunds() const { return refunds; }
+    const std::deque<ContractExecJob>& GetJobs() const { return jobs; }
+
+private:
+
+    void Thread();
+    bool Execute(ContractExecJob& job);
+
+    const CBlock& block;
+    const uint64_t blockGasLimit;
+    CBlockIndex* pindex;
+    const bool fLogOpcodes;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread thread;
+    // jobs are only appended, so references to executed ones stay valid
+    std::deque<ContractExecJob> jobs;
+    size_t nNext = 0;
+    bool fNoMore = false;
+    bool fAbort = false;
+
+    // written by the thread, read once it is joined
+    bool fFailed = false;
+    bool fGasLimitExceeded = false;
+    std::string strError;
+    uint64_t usedGas = 0;
+    CAmount refunds = 0;
+};
+
 class LastHashes: public dev::eth::LastBlockHashesFace
 {
 public:
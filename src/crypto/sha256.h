@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
 
 /** A hasher class for SHA-256. */
 class CSHA256
@@ -25,4 +26,23 @@ public:
     CSHA256& Reset();
 };
 
+namespace sha256_implementation {
+/** Backends SHA256AutoDetect may pick from, when the CPU supports them */
+enum UseImplementation : uint8_t {
+    STANDARD = 0,
+    USE_SSE41 = 1 << 0,
+    USE_AVX2 = 1 << 1,
+    USE_SHANI = 1 << 2,
+    USE_ALL = USE_SSE41 | USE_AVX2 | USE_SHANI,
+};
+}
+
+/** Autodetect the fastest SHA-256 backends the CPU supports, self-test them and return a description of the choice.
+ *  Call it once at startup before any hashing; until then the portable implementation is used. */
+std::string SHA256AutoDetect(sha256_implementation::UseImplementation use_implementation = sha256_implementation::USE_ALL);
+
+/** Compute the double SHA-256 of each of a number of 64-byte blocks, writing 32 bytes per block to out.
+ *  out may alias in, as the merkle tree computation relies on. */
+void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
@@ -5,6 +5,7 @@
 
 #include "Account.h"
 #include "SecureTrieDB.h"
+#include "StateCache.h"
 #include "ValidationSchemes.h"
 #include <libdevcore/JsonUtils.h>
 #include <libdevcore/OverlayDB.h>
@@ -44,10 +45,15 @@ u256 Account::originalStorageValue(u256 const& _key, OverlayDB const& _db) const
     if (it != m_storageOriginal.end())
         return it->second;
 
-    // Not in the original values cache - go to the DB.
-    SecureTrieDB<h256, OverlayDB> const memdb(const_cast<OverlayDB*>(&_db), m_storageRoot);
-    std::string const payload = memdb.at(_key);
-    auto const value = payload.size() ? RLP(payload).toInt<u256>() : 0;
+    // Not in the original values cache - go to the versioned cache, then to the DB.
+    u256 value;
+    if (!StateCache::instance().storage(m_storageRoot, _key, value))
+    {
+        SecureTrieDB<h256, OverlayDB> const memdb(const_cast<OverlayDB*>(&_db), m_storageRoot);
+        std::string const payload = memdb.at(_key);
+        value = payload.size() ? RLP(payload).toInt<u256>() : 0;
+        StateCache::instance().storeStorage(m_storageRoot, _key, value);
+    }
     m_storageOriginal[_key] = value;
     return value;
 }
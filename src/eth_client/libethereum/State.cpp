@@ -5,6 +5,7 @@
 #include "State.h"
 
 #include "ExtVM.h"
+#include "StateCache.h"
 #include "DatabasePaths.h"
 #include <libdevcore/Assertions.h>
 #include <libdevcore/DBFactory.h>
@@ -164,8 +165,15 @@ Account* State::account(Address const& _addr)
     if (m_nonExistingAccountsCache.count(_addr))
         return nullptr;
 
-    // Populate basic info.
-    string stateBack = m_state.at(_addr);
+    // Populate basic info, the trie is only read if no state with this root had it decoded before.
+    StateCache& stateCache = StateCache::instance();
+    h256 const root = m_state.root();
+    string stateBack;
+    if (!stateCache.account(root, _addr, stateBack))
+    {
+        stateBack = m_state.at(_addr);
+        stateCache.storeAccount(root, _addr, stateBack);
+    }
     if (stateBack.empty())
     {
         m_nonExistingAccountsCache.insert(_addr);
@@ -520,7 +528,13 @@ bytes const& State::code(Address const& _addr) const
     {
         // Load the code from the backend.
         Account* mutableAccount = const_cast<Account*>(a);
-        mutableAccount->noteCode(m_db.lookup(a->codeHash()));
+        bytes code;
+        if (!StateCache::instance().code(a->codeHash(), code))
+        {
+            code = asBytes(m_db.lookup(a->codeHash()));
+            StateCache::instance().storeCode(a->codeHash(), code);
+        }
+        mutableAccount->noteCode(bytesConstRef(&code));
         CodeSizeCache::instance().store(a->codeHash(), a->code().size());
     }
 
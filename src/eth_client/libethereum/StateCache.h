@@ -0,0 +1,177 @@
+// Aleth: Ethereum C++ client, tools and libraries.
+// Copyright 2015-2019 Aleth Authors.
+// Licensed under the GNU General Public License, Version 3.
+
+#pragma once
+
+#include <type_traits>
+#include <map>
+#include <string>
+#include <libdevcore/Address.h>
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Thread-safe cache of decoded trie lookups, keyed by the root they were read under.
+ * Everything reachable from a trie root is immutable, so entries stay valid when the state
+ * is switched to another root and back, e.g. by block validation, template creation or a reorg.
+ * If a cache is full, a random element is removed.
+ */
+class StateCache
+{
+public:
+	struct Stats
+	{
+		uint64_t accountHits = 0;
+		uint64_t accountMisses = 0;
+		uint64_t storageHits = 0;
+		uint64_t storageMisses = 0;
+		uint64_t codeHits = 0;
+		uint64_t codeMisses = 0;
+		uint64_t utxoHits = 0;
+		uint64_t utxoMisses = 0;
+
+		Stats operator-(Stats const& _s) const
+		{
+			Stats r;
+			r.accountHits = accountHits - _s.accountHits;
+			r.accountMisses = accountMisses - _s.accountMisses;
+			r.storageHits = storageHits - _s.storageHits;
+			r.storageMisses = storageMisses - _s.storageMisses;
+			r.codeHits = codeHits - _s.codeHits;
+			r.codeMisses = codeMisses - _s.codeMisses;
+			r.utxoHits = utxoHits - _s.utxoHits;
+			r.utxoMisses = utxoMisses - _s.utxoMisses;
+			return r;
+		}
+	};
+
+	/// RLP of the account at @a _addr in the state trie with root @a _root, empty if there is none.
+	bool account(h256 const& _root, Address const& _addr, std::string& o_rlp) const
+	{
+		return find(m_accounts, std::make_pair(_root, _addr), o_rlp, m_stats.accountHits, m_stats.accountMisses);
+	}
+	void storeAccount(h256 const& _root, Address const& _addr, std::string const& _rlp)
+	{
+		store(m_accounts, std::make_pair(_root, _addr), _rlp, c_maxAccounts);
+	}
+
+	/// Value of @a _key in the storage trie with root @a _root.
+	bool storage(h256 const& _root, u256 const& _key, u256& o_value) const
+	{
+		return find(m_storage, std::make_pair(_root, h256(_key)), o_value, m_stats.storageHits, m_stats.storageMisses);
+	}
+	void storeStorage(h256 const& _root, u256 const& _key, u256 const& _value)
+	{
+		store(m_storage, std::make_pair(_root, h256(_key)), _value, c_maxStorage);
+	}
+
+	/// Contract code with hash @a _codeHash.
+	bool code(h256 const& _codeHash, bytes& o_code) const
+	{
+		return find(m_code, _codeHash, o_code, m_stats.codeHits, m_stats.codeMisses);
+	}
+	void storeCode(h256 const& _codeHash, bytes const& _code)
+	{
+		store(m_code, _codeHash, _code, c_maxCode);
+	}
+
+	/// RLP of the contract UTXO at @a _addr in the UTXO trie with root @a _root, empty if there is none.
+	bool utxo(h256 const& _root, Address const& _addr, std::string& o_rlp) const
+	{
+		return find(m_utxos, std::make_pair(_root, _addr), o_rlp, m_stats.utxoHits, m_stats.utxoMisses);
+	}
+	void storeUtxo(h256 const& _root, Address const& _addr, std::string const& _rlp)
+	{
+		store(m_utxos, std::make_pair(_root, _addr), _rlp, c_maxAccounts);
+	}
+
+	/// Counters since the start.
+	Stats stats() const
+	{
+		UniqueGuard g(x_cache);
+		return m_stats;
+	}
+
+	/// Counters of the last block, as marked by markBlock().
+	Stats blockStats() const
+	{
+		UniqueGuard g(x_cache);
+		return m_blockStats;
+	}
+
+	/// Close the counters of the block just connected.
+	void markBlock()
+	{
+		UniqueGuard g(x_cache);
+		m_blockStats = m_stats - m_markStats;
+		m_markStats = m_stats;
+	}
+
+	static StateCache& instance() { static StateCache cache; return cache; }
+
+private:
+	template <class Map, class Key, class Value>
+	bool find(Map const& _map, Key const& _key, Value& o_value, uint64_t& _hits, uint64_t& _misses) const
+	{
+		UniqueGuard g(x_cache);
+		auto it = _map.find(_key);
+		if (it == _map.end())
+		{
+			++_misses;
+			return false;
+		}
+		++_hits;
+		o_value = it->second;
+		return true;
+	}
+
+	template <class Map, class Key, class Value>
+	void store(Map& _map, Key const& _key, Value const& _value, size_t _maxSize)
+	{
+		UniqueGuard g(x_cache);
+		if (_map.size() >= _maxSize)
+			removeRandomElement(_map);
+		_map[_key] = _value;
+	}
+
+	/// Removes a random element from the cache.
+	template <class Map>
+	static void removeRandomElement(Map& _map)
+	{
+		if (!_map.empty())
+		{
+			auto it = _map.lower_bound(randomKey<typename Map::key_type>());
+			if (it == _map.end())
+				it = _map.begin();
+			_map.erase(it);
+		}
+	}
+
+	template <class Key>
+	static typename std::enable_if<std::is_same<Key, h256>::value, Key>::type randomKey() { return h256::random(); }
+	template <class Key>
+	static typename std::enable_if<!std::is_same<Key, h256>::value, Key>::type randomKey() { return Key(h256::random(), typename Key::second_type()); }
+
+	static const size_t c_maxAccounts = 100000;
+	static const size_t c_maxStorage = 200000;
+	static const size_t c_maxCode = 2000;
+
+	mutable Mutex x_cache;
+	std::map<std::pair<h256, Address>, std::string> m_accounts;
+	std::map<std::pair<h256, h256>, u256> m_storage;
+	std::map<h256, bytes> m_code;
+	std::map<std::pair<h256, Address>, std::string> m_utxos;
+	mutable Stats m_stats;
+	Stats m_markStats;
+	Stats m_blockStats;
+};
+
+}
+}
@@ -182,49 +182,6 @@ inline std::string Hash(std::string input)
     return ss.str();
 }
 
-/**Compute the 256-bit hash from directory*/
-inline int HashChainstate(std::string &strHash)
-{
-
-   const boost::filesystem::path& path = GetDataDir() / "chainstate";
-   if (!boost::filesystem::exists(path)) {
-      boost::filesystem::create_directories(path);
-   }
-   unsigned char hash[SHA256_DIGEST_LENGTH];
-   SHA256_CTX sha256;
-   SHA256_Init(&sha256);
-   const int bufSize = 32768;
-   unsigned char *buffer = (unsigned char *) malloc(bufSize);
-   int bytesRead = 0;
-   if(!buffer) return ENOMEM;
-
-   std::vector<boost::filesystem::path> vPathes;
-   boost::filesystem::recursive_directory_iterator dir_itr { path };
-   std::copy_if(begin(dir_itr), end(dir_itr), std::back_inserter(vPathes),
-                [](const boost::filesystem::directory_entry& entry) {
-                   return (entry.path().string().find(".ldb") != std::string::npos);
-                });
-
-   std::sort(begin(vPathes), end(vPathes));
-
-   //Iterate files in directory
-   for(auto & p : vPathes)
-   {
-      FILE* file = fopen(p.string().c_str(), "rb");
-      if(!file) return -534;
-      while((bytesRead = fread(buffer, 1, bufSize, file)))
-      {
-         SHA256_Update(&sha256, buffer, bytesRead);
-      }
-      fclose(file);
-   }
-   free(buffer);
-   SHA256_Final(hash, &sha256);
-   std::string input (reinterpret_cast<const char *> (hash),sizeof (hash) / sizeof (hash[0]));
-   strHash = Hash(input);
-   return 0;
-}
-
 /** Compute the 256-bit hash of a void pointer */
 inline void Hash(void* in, unsigned int len, unsigned char* out)
 {
@@ -506,6 +463,81 @@ inline uint256 HashQuark(const T1 pbegin, const T1 pend)
     return hash[8].trim256();
 }
 
+/** One 512-bit hash function of the Quark chain, as the sph interface exposes it */
+struct CQuarkStage {
+    void (*init)(void*);
+    void (*update)(void*, const void*, size_t);
+    void (*close)(void*, void*);
+};
+
+/** Run a Quark stage from vIn[i] into vOut[i], for every i or only where (*pvSelect)[i] == fWhen */
+inline void HashQuarkStage(const CQuarkStage& stage, const std::vector<uint512>& vIn, std::vector<uint512>& vOut, const std::vector<bool>* pvSelect = nullptr, bool fWhen = true)
+{
+    union {
+        sph_blake512_context blake;
+        sph_bmw512_context bmw;
+        sph_groestl512_context groestl;
+        sph_jh512_context jh;
+        sph_keccak512_context keccak;
+        sph_skein512_context skein;
+    } ctx;
+    for (size_t i = 0; i < vIn.size(); i++) {
+        if (pvSelect && (*pvSelect)[i] != fWhen)
+            continue;
+        stage.init(&ctx);
+        stage.update(&ctx, vIn[i].begin(), 64);
+        stage.close(&ctx, vOut[i].begin());
+    }
+}
+
+/**
+ * Quark hash of a batch of inputs of nLen bytes each, equal to calling HashQuark on each.
+ * The chain runs one stage at a time over the whole batch, so each function's code and
+ * tables stay in cache, and the two branching stages run as two selective passes.
+ */
+inline void HashQuarkBatch(const std::vector<const unsigned char*>& vInputs, size_t nLen, std::vector<uint256>& vHashesRet)
+{
+    static const CQuarkStage blake = {sph_blake512_init, sph_blake512, sph_blake512_close};
+    static const CQuarkStage bmw = {sph_bmw512_init, sph_bmw512, sph_bmw512_close};
+    static const CQuarkStage groestl = {sph_groestl512_init, sph_groestl512, sph_groestl512_close};
+    static const CQuarkStage jh = {sph_jh512_init, sph_jh512, sph_jh512_close};
+    static const CQuarkStage keccak = {sph_keccak512_init, sph_keccak512, sph_keccak512_close};
+    static const CQuarkStage skein = {sph_skein512_init, sph_skein512, sph_skein512_close};
+
+    const size_t nCount = vInputs.size();
+    std::vector<uint512> a(nCount), b(nCount);
+    std::vector<bool> vSelect(nCount);
+    const auto select = [&](const std::vector<uint512>& v) {
+        for (size_t i = 0; i < nCount; i++)
+            vSelect[i] = (v[i].GetLow64() & 8) != 0;
+    };
+
+    sph_blake512_context ctx_blake;
+    for (size_t i = 0; i < nCount; i++) {
+        sph_blake512_init(&ctx_blake);
+        sph_blake512(&ctx_blake, vInputs[i], nLen);
+        sph_blake512_close(&ctx_blake, a[i].begin());
+    }
+    HashQuarkStage(bmw, a, b);
+    select(b);
+    HashQuarkStage(groestl, b, a, &vSelect, true);
+    HashQuarkStage(skein, b, a, &vSelect, false);
+    HashQuarkStage(groestl, a, b);
+    HashQuarkStage(jh, b, a);
+    select(a);
+    HashQuarkStage(blake, a, b, &vSelect, true);
+    HashQuarkStage(bmw, a, b, &vSelect, false);
+    HashQuarkStage(keccak, b, a);
+    HashQuarkStage(skein, a, b);
+    select(b);
+    HashQuarkStage(keccak, b, a, &vSelect, true);
+    HashQuarkStage(jh, b, a, &vSelect, false);
+
+    vHashesRet.resize(nCount);
+    for (size_t i = 0; i < nCount; i++)
+        vHashesRet[i] = a[i].trim256();
+}
+
 void scrypt_hash(const char* pass, unsigned int pLen, const char* salt, unsigned int sLen, char* output, unsigned int N, unsigned int r, unsigned int p, unsigned int dkLen);
 
 #endif // BTCU_HASH_H
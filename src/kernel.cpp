@@ -8,6 +8,11 @@
 
 #include <boost/assign/list_of.hpp>
 
+#include <atomic>
+#include <deque>
+
+#include "checkqueue.h"
+#include "crypto/common.h"
 #include "db.h"
 #include "kernel.h"
 #include "script/interpreter.h"
@@ -22,13 +27,13 @@
  * PoS Validation
  */
 
-bool GetHashProofOfStake(const CBlockIndex* pindexPrev, CStakeInput* stake, const unsigned int nTimeTx, const bool fVerify, uint256& hashProofOfStakeRet) {
+bool GetStakeKernelPreimage(const CBlockIndex* pindexPrev, CStakeInput* stake, CDataStream& ssPreimageRet)
+{
     // Grab the stake data
     CBlockIndex* pindexfrom = stake->GetIndexFrom();
     if (!pindexfrom) return error("%s : Failed to find the block index for stake origin", __func__);
     const CDataStream& ssUniqueID = stake->GetUniqueness();
     const unsigned int nTimeBlockFrom = pindexfrom->nTime;
-    CDataStream modifier_ss(SER_GETHASH, 0);
 
     // Hash the modifier
     if (!Params().IsStakeModifierV2(pindexPrev->nHeight + 1)) {
@@ -36,24 +41,44 @@ bool GetHashProofOfStake(const CBlockIndex* pindexPrev, CStakeInput* stake, cons
         uint64_t nStakeModifier = 0;
         if (!GetOldStakeModifier(stake, nStakeModifier))
             return error("%s : Failed to get kernel stake modifier", __func__);
-        modifier_ss << nStakeModifier;
+        ssPreimageRet << nStakeModifier;
     } else {
         // Modifier v2
-        modifier_ss << pindexPrev->nStakeModifierV2;
+        ssPreimageRet << pindexPrev->nStakeModifierV2;
     }
 
-    CDataStream ss(modifier_ss);
+    ssPreimageRet << nTimeBlockFrom << ssUniqueID;
+    return true;
+}
+
+bool GetHashProofOfStake(const CBlockIndex* pindexPrev, CStakeInput* stake, const unsigned int nTimeTx, const bool fVerify, uint256& hashProofOfStakeRet) {
+    CDataStream ss(SER_GETHASH, 0);
+    if (!GetStakeKernelPreimage(pindexPrev, stake, ss))
+        return false;
+
     // Calculate hash
-    ss << nTimeBlockFrom << ssUniqueID << nTimeTx;
+    ss << nTimeTx;
     hashProofOfStakeRet = Hash(ss.begin(), ss.end());
 
     if (fVerify) {
-        LogPrint("staking", "%s : nStakeModifier=%s\nnTimeBlockFrom=%d\nssUniqueIDD=%s\n-->DATA=%s",
-            __func__, HexStr(modifier_ss), nTimeBlockFrom, HexStr(ssUniqueID), HexStr(ss));
+        LogPrint("staking", "%s : nTimeTx=%d\n-->DATA=%s", __func__, nTimeTx, HexStr(ss));
     }
     return true;
 }
 
+bool CheckStakeKernelTarget(const uint256& hashProofOfStake, const unsigned int nBits, const CAmount nValueIn, uint256& bnTargetRet)
+{
+    // Base target
+    bnTargetRet.SetCompact(nBits);
+
+    // Weighted target
+    uint256 bnWeight = uint256(nValueIn) / 100;
+    bnTargetRet *= bnWeight;
+
+    // Check if proof-of-stake hash meets target protocol
+    return hashProofOfStake < bnTargetRet;
+}
+
 bool CheckStakeKernelHash(const CBlockIndex* pindexPrev, const unsigned int nBits, CStakeInput* stake, const unsigned int nTimeTx, uint256& hashProofOfStake, const bool fVerify)
 {
     // Calculate the proof of stake hash
@@ -62,20 +87,11 @@ bool CheckStakeKernelHash(const CBlockIndex* pindexPrev, const unsigned int nBit
     }
 
     const CAmount& nValueIn = stake->GetValue();
-    const CDataStream& ssUniqueID = stake->GetUniqueness();
-
-    // Base target
     uint256 bnTarget;
-    bnTarget.SetCompact(nBits);
-
-    // Weighted target
-    uint256 bnWeight = uint256(nValueIn) / 100;
-    bnTarget *= bnWeight;
-
-    // Check if proof-of-stake hash meets target protocol
-    const bool res = (hashProofOfStake < bnTarget);
+    const bool res = CheckStakeKernelTarget(hashProofOfStake, nBits, nValueIn, bnTarget);
 
     if (fVerify || res) {
+        const CDataStream& ssUniqueID = stake->GetUniqueness();
         LogPrint("staking", "%s : Proof Of Stake:"
                             "\nssUniqueID=%s"
                             "\nnTimeTx=%d"
@@ -95,13 +111,12 @@ bool CheckProofOfStake(const CBlock& block, uint256& hashProofOfStake, std::uniq
     if(!initStakeInput(block, stake, nPreviousBlockHeight))
         return error("%s : stake input object initialization failed", __func__);
 
-    const CTransaction tx = block.vtx[1];
+    const CTransaction& tx = *block.vtx[1];
     // Kernel (input 0) must match the stake hash target per coin age (nBits)
     const CTxIn& txin = tx.vin[0];
 
-    uint256 hashBlock;
-    CTransaction txPrev;
-    if (GetTransaction(txin.prevout.hash, txPrev, hashBlock, true) && hashBlock == Params().HashGenesisBlock())
+    CStakeInputInfo info;
+    if (!txin.IsZerocoinSpend() && GetStakeInputInfo(txin.prevout, info) && info.hashBlockFrom == Params().HashGenesisBlock())
         return true;
 
     CBlockIndex* pindexPrev = mapBlockIndex[block.hashPrevBlock];
@@ -129,7 +144,7 @@ bool CheckProofOfStake(const CBlock& block, uint256& hashProofOfStake, std::uniq
 
 // Initialize the stake input object
 bool initStakeInput(const CBlock& block, std::unique_ptr<CStakeInput>& stake, int nPreviousBlockHeight) {
-    const CTransaction tx = block.vtx[1];
+    const CTransaction& tx = *block.vtx[1];
     if (!tx.IsCoinStake())
         return error("%s : called on non-coinstake %s", __func__, tx.GetHash().ToString().c_str());
 
@@ -158,18 +173,17 @@ bool initStakeInput(const CBlock& block, std::unique_ptr<CStakeInput>& stake, in
             return error("%s : accum. checksum at height %d is wrong.", __func__, (nPreviousBlockHeight+1));
 
     } else {
-        // First try finding the previous transaction in database
-        uint256 hashBlock;
-        CTransaction txPrev;
-        if (!GetTransaction(txin.prevout.hash, txPrev, hashBlock, true))
+        // Find the spent output, from memory when possible
+        CStakeInputInfo info;
+        if (!GetStakeInputInfo(txin.prevout, info))
             return error("%s : INFO: read txPrev failed, tx id prev: %s, block id %s",
                          __func__, txin.prevout.hash.GetHex(), block.GetHash().GetHex());
 
         //verify signature and script
         ScriptError serror;
-        const CAmount& amount = txPrev.vout[txin.prevout.n].nValue;
+        const CAmount& amount = info.txout.nValue;
 
-        if (!VerifyScript(txin.scriptSig, txPrev.vout[txin.prevout.n].scriptPubKey, &txin.scriptWitness, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0, amount, MissingDataBehavior::ASSERT_FAIL), &serror)) {
+        if (!VerifyScript(txin.scriptSig, info.txout.scriptPubKey, &txin.scriptWitness, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0, amount, MissingDataBehavior::ASSERT_FAIL), &serror)) {
             std::string strErr = "";
             if (serror && ScriptErrorString(serror))
                 strErr = strprintf("with the following error: %s", ScriptErrorString(serror));
@@ -177,12 +191,100 @@ bool initStakeInput(const CBlock& block, std::unique_ptr<CStakeInput>& stake, in
         }
 
         CBTCUStake* btcuInput = new CBTCUStake();
-        btcuInput->SetInput(txPrev, txin.prevout.n);
+        btcuInput->SetInput(txin.prevout, info.txout, info.pindexFrom);
         stake = std::unique_ptr<CStakeInput>(btcuInput);
     }
     return true;
 }
 
+/*
+ * Stake input cache: outputs that stakes spend, so that checking a PoS block
+ * does not need to read the previous transaction from the block files.
+ * Entries only hold the hash of the creating block and are ignored while that
+ * block is off the active chain. The oldest entries are evicted first.
+ */
+static CCriticalSection cs_stakeinputs;
+static std::map<COutPoint, std::pair<CTxOut, uint256> > mapStakeInputs;
+static std::deque<COutPoint> dequeStakeInputs;
+
+static void AddStakeInput(const COutPoint& prevout, const CTxOut& txout, const uint256& hashBlockFrom)
+{
+    AssertLockHeld(cs_stakeinputs);
+    auto it = mapStakeInputs.find(prevout);
+    if (it != mapStakeInputs.end()) {
+        it->second = std::make_pair(txout, hashBlockFrom);
+        return;
+    }
+    mapStakeInputs.emplace(prevout, std::make_pair(txout, hashBlockFrom));
+    dequeStakeInputs.push_back(prevout);
+    while (dequeStakeInputs.size() > MAX_STAKE_INPUT_CACHE) {
+        mapStakeInputs.erase(dequeStakeInputs.front());
+        dequeStakeInputs.pop_front();
+    }
+}
+
+static CBlockIndex* LookupActiveIndex(const uint256& hashBlock)
+{
+    BlockMap::const_iterator mi = mapBlockIndex.find(hashBlock);
+    if (mi == mapBlockIndex.end() || !chainActive.Contains(mi->second))
+        return nullptr;
+    return mi->second;
+}
+
+bool GetStakeInputInfo(const COutPoint& prevout, CStakeInputInfo& infoRet)
+{
+    LOCK2(cs_main, cs_stakeinputs);
+
+    auto it = mapStakeInputs.find(prevout);
+    if (it != mapStakeInputs.end()) {
+        CBlockIndex* pindex = LookupActiveIndex(it->second.second);
+        if (pindex) {
+            infoRet.txout = it->second.first;
+            infoRet.hashBlockFrom = it->second.second;
+            infoRet.pindexFrom = pindex;
+            return true;
+        }
+        // the creating block was reorganized away, look the output up again
+    }
+
+    // An unspent output is in the coins view along with the height that created it
+    const CCoins* coins = pcoinsTip->AccessCoins(prevout.hash);
+    if (coins && coins->IsAvailable(prevout.n)) {
+        infoRet.txout = coins->vout[prevout.n];
+        if (coins->nVersion == CTransaction::BITCOIN_VERSION) {
+            infoRet.hashBlockFrom = Params().HashGenesisBlock();
+        } else {
+            CBlockIndex* pindex = chainActive[coins->nHeight];
+            if (pindex)
+                infoRet.hashBlockFrom = pindex->GetBlockHash();
+        }
+        infoRet.pindexFrom = LookupActiveIndex(infoRet.hashBlockFrom);
+        if (infoRet.pindexFrom)
+            AddStakeInput(prevout, infoRet.txout, infoRet.hashBlockFrom);
+        return true;
+    }
+
+    // Spent or unconfirmed: the slow path through the transaction itself
+    CTransaction txPrev;
+    uint256 hashBlock;
+    if (!GetTransaction(prevout.hash, txPrev, hashBlock, true) || prevout.n >= txPrev.vout.size())
+        return false;
+    infoRet.txout = txPrev.vout[prevout.n];
+    infoRet.hashBlockFrom = hashBlock;
+    infoRet.pindexFrom = LookupActiveIndex(hashBlock);
+    return true;
+}
+
+void CacheStakeInputs(const CTransaction& tx, const CBlockIndex* pindex)
+{
+    LOCK(cs_stakeinputs);
+    const uint256& hashTx = tx.GetHash();
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        if (!tx.vout[i].IsNull() && !tx.vout[i].IsEmpty())
+            AddStakeInput(COutPoint(hashTx, i), tx.vout[i], pindex->GetBlockHash());
+    }
+}
+
 // Stake Modifier (hash modifier of proof-of-stake):
 // The purpose of stake modifier is to prevent a txout (coin) owner from
 // computing future proof-of-stake generated by this txout at the time
@@ -205,11 +307,10 @@ uint256 ComputeStakeModifier(const CBlockIndex* pindexPrev, const uint256& kerne
     return ss.GetHash();
 }
 
-bool Stake(const CBlockIndex* pindexPrev, CStakeInput* stakeInput, unsigned int nBits, int64_t& nTimeTx, uint256& hashProofOfStake)
+bool InitStakeKernel(const CBlockIndex* pindexPrev, CStakeInput* stake, CStakeKernel& kernelRet)
 {
     const int nHeight = pindexPrev->nHeight + 1;
-    // get stake input pindex
-    CBlockIndex* pindexFrom = stakeInput->GetIndexFrom();
+    CBlockIndex* pindexFrom = stake->GetIndexFrom();
     if (!pindexFrom) return error("%s : no pindexfrom", __func__);
 
     // check required min depth for stake
@@ -217,13 +318,110 @@ bool Stake(const CBlockIndex* pindexPrev, CStakeInput* stakeInput, unsigned int
     if (nHeightBlockFrom > 0 && nHeight < nHeightBlockFrom + Params().COINSTAKE_MIN_DEPTH())
         return error("%s : min depth violation, nHeight=%d, nHeightBlockFrom=%d", __func__, nHeight, nHeightBlockFrom);
 
-    const bool fRegTest = Params().IsRegTestNet();
-    nTimeTx = (fRegTest ? GetAdjustedTime() : GetCurrentTimeSlot());
-    // double check that we are not on the same slot as prev block
-    if (nTimeTx <= pindexPrev->nTime && !fRegTest) return false;
+    CDataStream ssPreimage(SER_GETHASH, 0);
+    if (!GetStakeKernelPreimage(pindexPrev, stake, ssPreimage))
+        return false;
+
+    kernelRet.hasher.Reset().Write((const unsigned char*)ssPreimage.data(), ssPreimage.size());
+    kernelRet.nValue = stake->GetValue();
+    return true;
+}
+
+int nStakeKernelThreads = 0;
+
+namespace {
+
+/** Outcome of a kernel search shared by the checks of one time slot */
+struct CStakeKernelResult
+{
+    std::atomic<int> nFound;
+    std::atomic<unsigned int> nEvaluated;
+    uint256 hashProofOfStake;
+
+    CStakeKernelResult() : nFound(-1), nEvaluated(0) {}
+};
+
+/**
+ * Hash one kernel at a given transaction time. The check fails once any kernel
+ * meets its target, which makes the queue drop the rest of the slot's work.
+ */
+class CStakeKernelCheck
+{
+private:
+    const CStakeKernel* kernel;
+    int nIndex;
+    unsigned int nBits;
+    unsigned int nTimeTx;
+    CStakeKernelResult* result;
+
+public:
+    CStakeKernelCheck() : kernel(nullptr), nIndex(-1), nBits(0), nTimeTx(0), result(nullptr) {}
+    CStakeKernelCheck(const CStakeKernel* kernelIn, int nIndexIn, unsigned int nBitsIn, unsigned int nTimeTxIn, CStakeKernelResult* resultIn) :
+        kernel(kernelIn), nIndex(nIndexIn), nBits(nBitsIn), nTimeTx(nTimeTxIn), result(resultIn) {}
+
+    bool operator()()
+    {
+        if (result->nFound.load(std::memory_order_relaxed) >= 0)
+            return false;
+
+        unsigned char vchTime[4];
+        WriteLE32(vchTime, nTimeTx);
+        uint256 hashProofOfStake;
+        CHash256(kernel->hasher).Write(vchTime, sizeof(vchTime)).Finalize((unsigned char*)&hashProofOfStake);
+        result->nEvaluated++;
+
+        uint256 bnTarget;
+        if (!CheckStakeKernelTarget(hashProofOfStake, nBits, kernel->nValue, bnTarget))
+            return true;
+
+        int nNone = -1;
+        if (result->nFound.compare_exchange_strong(nNone, nIndex))
+            result->hashProofOfStake = hashProofOfStake;
+        return false;
+    }
+
+    void swap(CStakeKernelCheck& check)
+    {
+        std::swap(kernel, check.kernel);
+        std::swap(nIndex, check.nIndex);
+        std::swap(nBits, check.nBits);
+        std::swap(nTimeTx, check.nTimeTx);
+        std::swap(result, check.result);
+    }
+};
+
+CCheckQueue<CStakeKernelCheck> stakekernelqueue(128);
+
+}
+
+void ThreadStakeKernelCheck()
+{
+    RenameThread("btcu-stakecheck");
+    stakekernelqueue.Thread();
+}
+
+int SearchStakeKernels(const std::vector<CStakeKernel>& vKernels, const unsigned int nBits, const unsigned int nTimeTx, uint256& hashProofOfStakeRet, unsigned int& nEvaluatedRet)
+{
+    CStakeKernelResult result;
+    std::vector<CStakeKernelCheck> vChecks;
+    vChecks.reserve(vKernels.size());
+    for (size_t i = 0; i < vKernels.size(); i++)
+        vChecks.emplace_back(&vKernels[i], (int)i, nBits, nTimeTx, &result);
+
+    if (nStakeKernelThreads) {
+        CCheckQueueControl<CStakeKernelCheck> control(&stakekernelqueue);
+        control.Add(vChecks);
+        control.Wait();
+    } else {
+        for (CStakeKernelCheck& check : vChecks)
+            if (!check()) break;
+    }
 
-    // check stake kernel
-    return CheckStakeKernelHash(pindexPrev, nBits, stakeInput, nTimeTx, hashProofOfStake);
+    nEvaluatedRet = result.nEvaluated;
+    const int nFound = result.nFound;
+    if (nFound >= 0)
+        hashProofOfStakeRet = result.hashProofOfStake;
+    return nFound;
 }
 
 
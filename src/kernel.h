@@ -9,19 +9,67 @@
 #ifndef BTCU_KERNEL_H
 #define BTCU_KERNEL_H
 
+#include "hash.h"
 #include "main.h"
 #include "stakeinput.h"
 
+/** Maximum number of stake kernel search threads */
+static const int MAX_STAKE_THREADS = 16;
+/** -stakethreads default (0 = auto) */
+static const int DEFAULT_STAKE_THREADS = 0;
+
+extern int nStakeKernelThreads;
+
+/**
+ * Kernel of a stake input with everything but the transaction time hashed in.
+ * The staker keeps these between time slots, so each slot costs one hash
+ * finalization per input instead of a modifier lookup and a full preimage.
+ */
+struct CStakeKernel
+{
+    //! double SHA256 midstate over the stake modifier, block-from time and uniqueness
+    CHash256 hasher;
+    CAmount nValue;
+
+    CStakeKernel() : nValue(0) {}
+};
+
+/** Stake input descriptors kept for validation */
+static const unsigned int MAX_STAKE_INPUT_CACHE = 50000;
+
+/** Output spent by a stake, with the block that created it */
+struct CStakeInputInfo
+{
+    CTxOut txout;
+    //! block the output was created in, the genesis block for the imported Bitcoin state
+    uint256 hashBlockFrom;
+    //! index of hashBlockFrom if it is on the active chain
+    CBlockIndex* pindexFrom;
+
+    CStakeInputInfo() : pindexFrom(nullptr) {}
+};
+
 /* PoS Validation */
 bool GetHashProofOfStake(const CBlockIndex* pindexPrev, CStakeInput* stake, const unsigned int nTimeTx, const bool fVerify, uint256& hashProofOfStakeRet);
 bool CheckStakeKernelHash(const CBlockIndex* pindexPrev, const unsigned int nBits, CStakeInput* stake, const unsigned int nTimeTx, uint256& hashProofOfStake, const bool fVerify = false);
 bool CheckProofOfStake(const CBlock& block, uint256& hashProofOfStake, std::unique_ptr<CStakeInput>& stake, int nPreviousBlockHeight);
+// Look up the output a stake spends: in the stake input cache, then the coins view, then the block files
+bool GetStakeInputInfo(const COutPoint& prevout, CStakeInputInfo& infoRet);
+// Remember the outputs of a connected coinstake, they are the likely inputs of later stakes
+void CacheStakeInputs(const CTransaction& tx, const CBlockIndex* pindex);
 // Initialize the stake input object
 bool initStakeInput(const CBlock& block, std::unique_ptr<CStakeInput>& stake, int nPreviousBlockHeight);
 // (New) Stake Modifier
 uint256 ComputeStakeModifier(const CBlockIndex* pindexPrev, const uint256& kernel);
-// Stake (find valid kernel)
-bool Stake(const CBlockIndex* pindexPrev, CStakeInput* stakeInput, unsigned int nBits, int64_t& nTimeTx, uint256& hashProofOfStake);
+// Kernel hash preimage of a stake input up to (not including) the transaction time
+bool GetStakeKernelPreimage(const CBlockIndex* pindexPrev, CStakeInput* stake, CDataStream& ssPreimageRet);
+// Check a proof of stake hash against the target weighted by the staked value
+bool CheckStakeKernelTarget(const uint256& hashProofOfStake, const unsigned int nBits, const CAmount nValueIn, uint256& bnTargetRet);
+// Prepare the kernel of a stake input for hashing at any transaction time on top of pindexPrev
+bool InitStakeKernel(const CBlockIndex* pindexPrev, CStakeInput* stake, CStakeKernel& kernelRet);
+// Hash the kernels at nTimeTx on the stake kernel threads, return the index of one meeting the target or -1
+int SearchStakeKernels(const std::vector<CStakeKernel>& vKernels, const unsigned int nBits, const unsigned int nTimeTx, uint256& hashProofOfStakeRet, unsigned int& nEvaluatedRet);
+void ThreadStakeKernelCheck();
 
 /* Utils */
 int64_t GetTimeSlot(const int64_t nTime);
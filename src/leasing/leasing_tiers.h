@@ -0,0 +1,81 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BTCU_LEASING_TIERS_H
+#define BTCU_LEASING_TIERS_H
+
+#include "amount.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+
+
+
+/** Percent paid for values below nUpperBound (and not below the previous tier's bound) */
+struct CLeasingTier {
+   int64_t nUpperBound;
+   int64_t nPct;
+};
+
+/** Upper bound of the last tier of every schedule */
+static constexpr int64_t LEASING_TIER_MAX = std::numeric_limits<int64_t>::max();
+
+/** Base leasing percent by block height */
+static constexpr CLeasingTier LEASING_HEIGHT_TIERS[] = {
+   {500000, 15}, {1000000, 14}, {1500000, 13}, {2000000, 12}, {2500000, 11},
+   {3000000, 10}, {3500000, 9}, {4000000, 8}, {4500000, 7}, {5000000, 6},
+   {5500000, 5}, {6000000, 4}, {6500000, 3}, {7000000, 2}, {LEASING_TIER_MAX, 1}
+};
+
+/** Share of the base percent paid by total leasing supply, in coins */
+static constexpr CLeasingTier LEASING_SUPPLY_TIERS[] = {
+   {500000, 100}, {1000000, 95}, {2000000, 90}, {3000000, 85}, {4000000, 80},
+   {5000000, 75}, {6000000, 70}, {7000000, 65}, {8000000, 60}, {9000000, 55},
+   {10000000, 50}, {LEASING_TIER_MAX, 45}
+};
+
+/** Share paid by leased amount of a single output, in coins */
+static constexpr CLeasingTier LEASING_AMOUNT_TIERS[] = {
+   {5000, 100}, {10000, 95}, {20000, 90}, {50000, 85}, {100000, 80},
+   {200000, 75}, {300000, 70}, {400000, 65}, {500000, 60}, {1000000, 55},
+   {LEASING_TIER_MAX, 50}
+};
+
+/** Share paid by age of a single output, in blocks */
+static constexpr CLeasingTier LEASING_AGE_TIERS[] = {
+   {30000, 100}, {90000, 110}, {180000, 120}, {270000, 130}, {360000, 140},
+   {540000, 150}, {720000, 160}, {1080000, 170}, {1440000, 180}, {1800000, 190},
+   {LEASING_TIER_MAX, 200}
+};
+
+/** Percent a validator node gets of the total leased to it, in coins */
+static constexpr CLeasingTier LEASING_VALIDATOR_TIERS[] = {
+   {30000, 20}, {90000, 18}, {180000, 16}, {270000, 14}, {360000, 12},
+   {540000, 10}, {720000, 8}, {1080000, 6}, {1440000, 4}, {1800000, 2},
+   {LEASING_TIER_MAX, 0}
+};
+
+/** Percent a masternode gets of the total leased to it, in coins */
+static constexpr CLeasingTier LEASING_MASTERNODE_TIERS[] = {
+   {30000, 10}, {90000, 9}, {180000, 8}, {270000, 7}, {360000, 6},
+   {540000, 5}, {720000, 4}, {1080000, 3}, {1440000, 2}, {1800000, 1},
+   {LEASING_TIER_MAX, 0}
+};
+
+/** Tier the value falls into, the last tier if it is beyond every bound */
+template <size_t N>
+inline const CLeasingTier& FindLeasingTier(const CLeasingTier (&tiers)[N], const int64_t nValue) {
+   auto itr = std::upper_bound(std::begin(tiers), std::end(tiers), nValue,
+      [](const int64_t v, const CLeasingTier& tier) { return v < tier.nUpperBound; });
+   return (std::end(tiers) != itr) ? *itr : tiers[N - 1];
+}
+
+template <size_t N>
+inline int64_t GetLeasingTierPct(const CLeasingTier (&tiers)[N], const int64_t nValue) {
+   return FindLeasingTier(tiers, nValue).nPct;
+}
+
+#endif // BTCU_LEASING_TIERS_H
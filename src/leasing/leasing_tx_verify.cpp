@@ -35,6 +35,10 @@ bool CheckLeasingRewardTransaction(const uint256& blockHash, const CTransaction&
     }
 
     LeasingLogPrint("validate leasing reward for %s", tx.GetHash().ToString());
+    std::vector<std::pair<COutPoint, CKeyID>> vPoints;
+    std::vector<const CTxOut*> vTxOuts;
+    vPoints.reserve(tx.vout.size());
+    vTxOuts.reserve(tx.vout.size());
     for (auto& txOut: tx.vout) {
         if (!txOut.IsLeasingReward())
             continue;
@@ -44,9 +48,17 @@ bool CheckLeasingRewardTransaction(const uint256& blockHash, const CTransaction&
         if (!ExtractLeasingPoint(txOut, point, keyID))
             return state.DoS(10, error("CheckLeasingRewardTransaction(): no leasing point"), REJECT_INVALID, "bad-txns-leasing-point");
 
+        vPoints.emplace_back(point, keyID);
+        vTxOuts.push_back(&txOut);
+    }
 
-        auto calcTxOut = leasingManager.CalcLeasingReward(point, keyID);
+    // all rewards of the transaction are computed under a single lock of the leasing manager
+    std::vector<CTxOut> vCalcTxOuts;
+    leasingManager.CalcLeasingRewards(vPoints, vCalcTxOuts);
 
+    for (size_t i = 0; i < vTxOuts.size(); ++i) {
+        const CTxOut& calcTxOut = vCalcTxOuts[i];
+        const CTxOut& txOut = *vTxOuts[i];
         if (calcTxOut != txOut)
             return state.DoS(10, error("CheckLeasingRewardTransaction(): wrong leasing reward value: calcTxOut=%s, txOut=%s", calcTxOut.ToString(), txOut.ToString()), REJECT_INVALID, "bad-txns-leasing-reward-value");
     }
@@ -3,10 +3,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "leasing/leasingmanager.h"
+#include "leasing/leasing_tiers.h"
 
 #ifdef ENABLE_LEASING_MANAGER
 
 #include <limits>
+#include <set>
 #include <tuple>
 
 #include "script/standard.h"
@@ -138,15 +140,27 @@ struct CLeasingSpend {
 
 
 
+// Live (unspent) leasing outputs are kept under their own prefix so the startup
+// scan never touches spent ones, which are only needed to undo their spending.
 enum class LeasingDBType: char {
    Output = 'O',
+   Unspent = 'U',
    Reward = 'R',
    Spend = 'S',
+   Balance = 'B',
    Flag = 'F'
 };
 
 namespace {
    static const std::string _shutdown = "shutdown";
+   static const std::string _supply = "supply";
+   static const std::string _layout = "layout";
+
+   // 0 - every output under 'O'; 1 - unspent outputs under 'U', balances and supply persisted
+   static constexpr int _nLayoutVersion = 1;
+
+   // flush the migration batch once it grows that big
+   static constexpr size_t _nMigrateBatchSize = 16 << 20;
 }
 
 class CLeasingDB : public CLevelDBWrapper {
@@ -159,15 +173,51 @@ public:
    { }
 
    bool WriteLeasingOutput(const CLeasingOutput& leasingOut) {
-      return Write(GetKey(LeasingDBType::Output, leasingOut), leasingOut);
+      CLevelDBBatch batch(*this);
+      WriteLeasingOutput(batch, leasingOut);
+      return WriteBatch(batch);
+   }
+
+   // moves the output between the unspent and the spent prefix as its spending height says
+   void WriteLeasingOutput(CLevelDBBatch& batch, const CLeasingOutput& leasingOut) {
+      const bool fUnspent = (leasingOut.nSpendingHeight == _nonRewardHeight);
+      batch.Write(GetKey(fUnspent ? LeasingDBType::Unspent : LeasingDBType::Output, leasingOut), leasingOut);
+      batch.Erase(GetKey(fUnspent ? LeasingDBType::Output : LeasingDBType::Unspent, leasingOut));
    }
 
    bool EraseLeasingOutput(const CLeasingOutput& leasingOut) {
-      return Erase(GetKey(LeasingDBType::Output, leasingOut));
+      CLevelDBBatch batch(*this);
+      batch.Erase(GetKey(LeasingDBType::Unspent, leasingOut));
+      batch.Erase(GetKey(LeasingDBType::Output, leasingOut));
+      return WriteBatch(batch);
    }
 
    bool ReadLeasingOutput(CLeasingOutput& leasingOut) {
-      return Read(GetKey(LeasingDBType::Output, leasingOut), leasingOut);
+      return Read(GetKey(LeasingDBType::Output, leasingOut), leasingOut) ||
+         Read(GetKey(LeasingDBType::Unspent, leasingOut), leasingOut);
+   }
+
+   void WriteLeasingBalance(CLevelDBBatch& batch, const CKeyID& kLeaserID, const CAmount aAmount) {
+      if (aAmount)
+         batch.Write(std::make_pair(char(LeasingDBType::Balance), kLeaserID), aAmount);
+      else
+         batch.Erase(std::make_pair(char(LeasingDBType::Balance), kLeaserID));
+   }
+
+   void WriteLeasingSupply(CLevelDBBatch& batch, const CAmount aSupply) {
+      batch.Write(std::make_pair(char(LeasingDBType::Flag), _supply), aSupply);
+   }
+
+   bool ReadLeasingSupply(CAmount& aSupply) {
+      return Read(std::make_pair(char(LeasingDBType::Flag), _supply), aSupply);
+   }
+
+   bool WriteLayoutVersion(int nVersion) {
+      return Write(std::make_pair(char(LeasingDBType::Flag), _layout), nVersion);
+   }
+
+   bool ReadLayoutVersion(int& nVersion) {
+      return Read(std::make_pair(char(LeasingDBType::Flag), _layout), nVersion);
    }
 
    bool WriteLeasingReward(const CLeasingReward& leasingReward) {
@@ -222,6 +272,7 @@ public:
    }
 
    ~CImpl() {
+      FlushBalances();
       leasingDB.WriteShutdown(true);
       leasingDB.Flush();
    }
@@ -426,6 +477,7 @@ public:
       nBlockHeight = height;
       nBlockHash = hash;
       CalcLeasingHeightPct();
+      FlushBalances();
       leasingDB.Flush();
    }
 
@@ -473,13 +525,14 @@ public:
    ) {
       LOCK(cs_leasing);
 
+      const int64_t nLeasingPct = GetLeasingPct();
       auto& idxRewards = mapOutputs.get<byLeasingReward>();
       auto itr = idxRewards.lower_bound(leaserID);
       size_t i = 0;
 
       vRewards.reserve(vRewards.size() + nLimit + 1);
       for (; itr != idxRewards.end() && itr->kLeaserID == leaserID && itr->nNextRewardHeight <= nBlockHeight; ++itr) {
-         auto txOut = CalcLeasingReward(*itr);
+         auto txOut = CalcLeasingReward(*itr, nBlockHeight, nLeasingPct);
          if (!txOut.IsEmpty()) {
             vRewards.emplace_back(std::move(txOut));
             if (++i >= nLimit)
@@ -539,17 +592,74 @@ public:
       return CalcLeasingReward(*itr);
    }
 
+   void CalcLeasingRewards(const std::vector<std::pair<COutPoint, CKeyID>>& vPoints, std::vector<CTxOut>& vRewards) const {
+      LOCK(cs_leasing);
+
+      const int64_t nLeasingPct = GetLeasingPct();
+      auto& idxTrxHash = mapOutputs.get<byTrxHash>();
+
+      vRewards.reserve(vRewards.size() + vPoints.size());
+      for (const auto& point: vPoints) {
+         if (point.first.hash.IsNull()) {
+            vRewards.emplace_back(CalcLeasingReward(point.first, point.second));
+            continue;
+         }
+
+         auto itr = idxTrxHash.find(std::make_tuple(point.first.hash, point.first.n));
+         if (idxTrxHash.end() == itr)
+            vRewards.emplace_back(); // empty
+         else
+            vRewards.emplace_back(CalcLeasingReward(*itr, nBlockHeight, nLeasingPct));
+      }
+   }
+
 private:
    void OpenDB() {
       bool fLastShutdown = false;
-      bool wasShutdown = (!leasingDB.ReadShutdown(fLastShutdown) || !fLastShutdown);
+      bool wasShutdown = (leasingDB.ReadShutdown(fLastShutdown) && fLastShutdown);
       LogPrintf("%s: Last shutdown was prepared: %s\n", __func__, wasShutdown);
 
+      int nLayoutVersion = 0;
+      leasingDB.ReadLayoutVersion(nLayoutVersion);
+
       leasingDB.WriteShutdown(false);
       leasingDB.Flush();
 
+      int64_t nStart = GetTimeMillis();
+
+      if (nLayoutVersion < _nLayoutVersion)
+         MigrateOutputs();
+
+      size_t nOutputs = 0;
+      ForEachRecord(LeasingDBType::Unspent, [&](CDataStream& ssKey, CLevelDBIterator& cursor) {
+         CLeasingOutput leasingOutput;
+         cursor.GetValue(leasingOutput, true);
+
+         ssKey >> leasingOutput.nTrxHash;
+         ssKey >> leasingOutput.nPosition;
+         if (!mapOutputs.insert(leasingOutput).second) {
+            LeasingError("duplicate of leasing for %s:%d",
+               leasingOutput.nTrxHash.ToString(), leasingOutput.nPosition);
+         } else {
+            ++nOutputs;
+         }
+      });
+
+      // the persisted balances are only trusted when they were flushed on a prepared shutdown
+      if (!wasShutdown || nLayoutVersion < _nLayoutVersion || !LoadBalances())
+         RebuildBalances();
+
+      CalcLeasingSupplyPct();
+
+      LogPrintf("%s: loaded %u leasing outputs of %u leasers in %dms\n", __func__,
+         nOutputs, mapBalance.size(), GetTimeMillis() - nStart);
+   }
+
+   // calls fn(ssKey, cursor) for every record of the given type, ssKey positioned past the type
+   template <typename TRecordAction>
+   void ForEachRecord(const LeasingDBType type, TRecordAction&& fn) {
       auto pCursor = leasingDB.NewIterator();
-      pCursor->SeekToFirst();
+      pCursor->Seek(char(type));
       while (pCursor->Valid()) {
          boost::this_thread::interruption_point();
          try {
@@ -557,39 +667,102 @@ private:
             CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
             char chType;
             ssKey >> chType;
-            switch (static_cast<LeasingDBType>(chType)) {
-               case LeasingDBType::Output: {
-                  CLeasingOutput leasingOutput;
-                  pCursor->GetValue(leasingOutput, true);
-
-                  ssKey >> leasingOutput.nTrxHash;
-                  ssKey >> leasingOutput.nPosition;
-                  if (leasingOutput.nSpendingHeight == _nonRewardHeight) {
-                     if (!mapOutputs.insert(leasingOutput).second) {
-                        LeasingError("duplicate of leasing for %s:%d",
-                           leasingOutput.nTrxHash.ToString(), leasingOutput.nPosition);
-                     } else {
-                        nLeasingSupply += leasingOutput.nValue;
-                        auto itr = mapBalance.emplace(leasingOutput.kLeaserID, 0).first;
-                        (*itr).second += leasingOutput.nValue;
-                     }
-                  }
-                  break;
-               }
-               case LeasingDBType::Reward:
-               case LeasingDBType::Spend:
-               case LeasingDBType::Flag:
-               default:
-                  break;
-            }
+            if (static_cast<LeasingDBType>(chType) != type)
+               break;
+            fn(ssKey, *pCursor);
             pCursor->Next();
          } catch (const std::exception& e) {
             LeasingError("deserialize or I/O error - %s", e.what());
             break;
          }
       }
+   }
+
+   // one-time move of the unspent outputs of the old layout under their own prefix
+   void MigrateOutputs() {
+      LogPrintf("%s: upgrading leasing database layout, this could take a while...\n", __func__);
+
+      size_t nMoved = 0;
+      CLevelDBBatch batch(leasingDB);
+      ForEachRecord(LeasingDBType::Output, [&](CDataStream& ssKey, CLevelDBIterator& cursor) {
+         CLeasingOutput leasingOutput;
+         cursor.GetValue(leasingOutput, true);
+
+         if (leasingOutput.nSpendingHeight != _nonRewardHeight)
+            return;
+
+         ssKey >> leasingOutput.nTrxHash;
+         ssKey >> leasingOutput.nPosition;
+         leasingDB.WriteLeasingOutput(batch, leasingOutput);
+         ++nMoved;
+
+         if (batch.SizeEstimate() > _nMigrateBatchSize) {
+            leasingDB.WriteBatch(batch);
+            batch.Clear();
+         }
+      });
+      leasingDB.WriteBatch(batch, true);
+      leasingDB.WriteLayoutVersion(_nLayoutVersion);
+
+      LogPrintf("%s: moved %u unspent leasing outputs\n", __func__, nMoved);
+   }
+
+   bool LoadBalances() {
+      CAmount aSupply = 0;
+      if (!leasingDB.ReadLeasingSupply(aSupply))
+         return false;
+
+      CAmount aTotal = 0;
+      mapBalance.clear();
+      ForEachRecord(LeasingDBType::Balance, [&](CDataStream& ssKey, CLevelDBIterator& cursor) {
+         CKeyID kLeaserID;
+         CAmount aAmount = 0;
+         ssKey >> kLeaserID;
+         cursor.GetValue(aAmount, true);
+         mapBalance.emplace(kLeaserID, aAmount);
+         aTotal += aAmount;
+      });
+
+      if (aTotal != aSupply) {
+         LogPrintf("%s: persisted leasing balances don't match the supply, rebuilding\n", __func__);
+         return false;
+      }
 
-      CalcLeasingSupplyPct();
+      nLeasingSupply = aSupply;
+      return true;
+   }
+
+   // sum the balances up from the loaded outputs and replace the persisted ones
+   void RebuildBalances() {
+      CLevelDBBatch batch(leasingDB);
+      ForEachRecord(LeasingDBType::Balance, [&](CDataStream& ssKey, CLevelDBIterator& cursor) {
+         CKeyID kLeaserID;
+         ssKey >> kLeaserID;
+         batch.Erase(std::make_pair(char(LeasingDBType::Balance), kLeaserID));
+      });
+      leasingDB.WriteBatch(batch);
+
+      mapBalance.clear();
+      setDirtyBalances.clear();
+      nLeasingSupply = 0;
+      for (const auto& leasingOutput: mapOutputs) {
+         nLeasingSupply += leasingOutput.nValue;
+         mapBalance[leasingOutput.kLeaserID] += leasingOutput.nValue;
+         setDirtyBalances.insert(leasingOutput.kLeaserID);
+      }
+      FlushBalances();
+   }
+
+   // write the balances changed since the last flush together with the supply
+   void FlushBalances() {
+      CLevelDBBatch batch(leasingDB);
+      for (const auto& kLeaserID: setDirtyBalances) {
+         auto itr = mapBalance.find(kLeaserID);
+         leasingDB.WriteLeasingBalance(batch, kLeaserID, mapBalance.end() != itr ? (*itr).second : 0);
+      }
+      leasingDB.WriteLeasingSupply(batch, nLeasingSupply);
+      leasingDB.WriteBatch(batch);
+      setDirtyBalances.clear();
    }
 
    void IncLeasingSupply(const CKeyID& kLeaserID, const CAmount aAmount) {
@@ -598,6 +771,7 @@ private:
 
       auto itr = mapBalance.emplace(kLeaserID, 0).first;
       (*itr).second += aAmount;
+      setDirtyBalances.insert(kLeaserID);
    }
 
    void DecLeasingSupply(const CKeyID& kLeaserID, const CAmount aAmount) {
@@ -608,6 +782,7 @@ private:
          } else {
             (*btr).second -= aAmount;
          }
+         setDirtyBalances.insert(kLeaserID);
       }
 
       nLeasingSupply -= aAmount;
@@ -629,144 +804,47 @@ private:
    }
 
    void CalcLeasingHeightPct() {
-      nHeightLeasingPct = 15;
-
-      if (nBlockHeight  < 500000)
-         nHeightLeasingPct = 15;
-      else if (nBlockHeight  < 1000000)
-         nHeightLeasingPct = 14;
-      else if (nBlockHeight  < 1500000)
-         nHeightLeasingPct = 13;
-      else if (nBlockHeight  < 2000000)
-         nHeightLeasingPct = 12;
-      else if (nBlockHeight  < 2500000)
-         nHeightLeasingPct = 11;
-      else if (nBlockHeight  < 3000000)
-         nHeightLeasingPct = 10;
-      else if (nBlockHeight  < 3500000)
-         nHeightLeasingPct = 9;
-      else if (nBlockHeight  < 4000000)
-         nHeightLeasingPct = 8;
-      else if (nBlockHeight  < 4500000)
-         nHeightLeasingPct = 7;
-      else if (nBlockHeight  < 5000000)
-         nHeightLeasingPct = 6;
-      else if (nBlockHeight  < 5500000)
-         nHeightLeasingPct = 5;
-      else if (nBlockHeight  < 6000000)
-         nHeightLeasingPct = 4;
-      else if (nBlockHeight  < 6500000)
-         nHeightLeasingPct = 3;
-      else if (nBlockHeight  < 7000000)
-         nHeightLeasingPct = 2;
-      else
-         nHeightLeasingPct = 1;
-
-      nHeightLeasingPct *= _1pct;
+      nHeightLeasingPct = GetLeasingTierPct(LEASING_HEIGHT_TIERS, nBlockHeight) * _1pct;
    }
 
+   // the supply changes with every leasing output, its tier only rarely
    void CalcLeasingSupplyPct() {
-      nSupplyLeasingPct = 100;
       auto supply = nLeasingSupply / COIN;
+      if (supply >= nSupplyTierLow && supply < nSupplyTierHigh)
+         return;
 
-      if (supply < 500000)
-         nSupplyLeasingPct = 100;
-      else if (supply < 1000000)
-         nSupplyLeasingPct = 95;
-      else if (supply < 2000000)
-         nSupplyLeasingPct = 90;
-      else if (supply < 3000000)
-         nSupplyLeasingPct = 85;
-      else if (supply < 4000000)
-         nSupplyLeasingPct = 80;
-      else if (supply < 5000000)
-         nSupplyLeasingPct = 75;
-      else if (supply < 6000000)
-         nSupplyLeasingPct = 70;
-      else if (supply < 7000000)
-         nSupplyLeasingPct = 65;
-      else if (supply < 8000000)
-         nSupplyLeasingPct = 60;
-      else if (supply < 9000000)
-         nSupplyLeasingPct = 55;
-      else if (supply < 10000000)
-         nSupplyLeasingPct = 50;
-      else
-         nSupplyLeasingPct = 45;
-
-      nSupplyLeasingPct *= _1pct;
+      const CLeasingTier& tier = FindLeasingTier(LEASING_SUPPLY_TIERS, supply);
+      nSupplyTierLow = (&tier == std::begin(LEASING_SUPPLY_TIERS)) ?
+         std::numeric_limits<int64_t>::min() : (&tier - 1)->nUpperBound;
+      nSupplyTierHigh = tier.nUpperBound;
+      nSupplyLeasingPct = tier.nPct * _1pct;
    }
 
    CTxOut CalcLeasingReward(const CLeasingOutput& leasingOut) const {
-      CAmount aAmount = leasingOut.nValue / COIN;
-
-      int64_t nAmountPct = 100;
-      if (aAmount < 5000)
-         nAmountPct = 100;
-      else if (aAmount < 10000)
-         nAmountPct = 95;
-      else if (aAmount < 20000)
-         nAmountPct = 90;
-      else if (aAmount < 50000)
-         nAmountPct = 85;
-      else if (aAmount < 100000)
-         nAmountPct = 80;
-      else if (aAmount < 200000)
-         nAmountPct = 75;
-      else if (aAmount < 300000)
-         nAmountPct = 70;
-      else if (aAmount < 400000)
-         nAmountPct = 65;
-      else if (aAmount < 500000)
-         nAmountPct = 60;
-      else if (aAmount < 1000000)
-         nAmountPct = 55;
-      else
-         nAmountPct = 50;
-      nAmountPct *= _1pct;
-
-      int64_t nAge = GetBlockHeight() - leasingOut.nInitHeight;
-      int64_t nAgePct = 100;
-      if (nAge < 30000)
-         nAgePct = 100;
-      else if (nAge < 90000)
-         nAgePct = 110;
-      else if (nAge < 180000)
-         nAgePct = 120;
-      else if (nAge < 270000)
-         nAgePct = 130;
-      else if (nAge < 360000)
-         nAgePct = 140;
-      else if (nAge < 540000)
-         nAgePct = 150;
-      else if (nAge < 720000)
-         nAgePct = 160;
-      else if (nAge < 1080000)
-         nAgePct = 170;
-      else if (nAge < 1440000)
-         nAgePct = 180;
-      else if (nAge < 1800000)
-         nAgePct = 190;
-      else
-         nAgePct = 200;
-      nAgePct *= _1pct;
+      return CalcLeasingReward(leasingOut, GetBlockHeight(), GetLeasingPct());
+   }
 
-      int64_t nPct = nAmountPct * nAgePct * GetLeasingPct() / _100pct / _100pct;
-      int64_t aResAmount = leasingOut.nValue * nPct / _100pct;
-      int64_t nRewardAge = (GetBlockHeight() - leasingOut.nLastRewardHeight);
+   // nHeight and nLeasingPct are the same for every output of a block, so batches compute them once
+   CTxOut CalcLeasingReward(const CLeasingOutput& leasingOut, const int nHeight, const int64_t nLeasingPct) const {
+      int64_t nAmountPct = GetLeasingTierPct(LEASING_AMOUNT_TIERS, leasingOut.nValue / COIN) * _1pct;
+      int64_t nAgePct = GetLeasingTierPct(LEASING_AGE_TIERS, nHeight - leasingOut.nInitHeight) * _1pct;
 
-      LeasingLogPrint("nHeight=%d", GetBlockHeight());
-      LeasingLogPrint("nLastRewardHeight=%d", leasingOut.nLastRewardHeight);
+      int64_t nPct = nAmountPct * nAgePct * nLeasingPct / _100pct / _100pct;
+      int64_t aResAmount = leasingOut.nValue * nPct / _100pct;
+      int64_t nRewardAge = (nHeight - leasingOut.nLastRewardHeight);
 
       aResAmount = aResAmount * nRewardAge / (365 * 24 * 60); // 1 year
 
       auto outPoint = COutPoint(leasingOut.nTrxHash, leasingOut.nPosition);
       auto outScript = GetScriptForLeasingReward(outPoint, PKHash(leasingOut.kOwnerID));
 
-      LeasingLogPrint("nPct=%d, aResAmount=%d, nRewardAge=%d", nPct, aResAmount, nRewardAge);
-      LeasingLogPrint("outPoint=%s", outPoint.ToString());
-      LeasingLogPrint("outScript=%s", outScript.ToString());
-
+      if (LogAcceptCategory("leasing")) {
+         LeasingLogPrint("nHeight=%d", nHeight);
+         LeasingLogPrint("nLastRewardHeight=%d", leasingOut.nLastRewardHeight);
+         LeasingLogPrint("nPct=%d, aResAmount=%d, nRewardAge=%d", nPct, aResAmount, nRewardAge);
+         LeasingLogPrint("outPoint=%s", outPoint.ToString());
+         LeasingLogPrint("outScript=%s", outScript.ToString());
+      }
 
       return CTxOut(aResAmount, outScript);
    }
@@ -790,57 +868,11 @@ private:
    }
 
    int64_t GetValidatorNodeLeasingPct(CAmount aAmount) const {
-      aAmount /= COIN;
-
-      if (aAmount < 30000)
-         return 20;
-      else if (aAmount < 90000)
-         return 18;
-      else if (aAmount < 180000)
-         return 16;
-      else if (aAmount < 270000)
-         return 14;
-      else if (aAmount < 360000)
-         return 12;
-      else if (aAmount < 540000)
-         return 10;
-      else if (aAmount < 720000)
-         return 8;
-      else if (aAmount < 1080000)
-         return 6;
-      else if (aAmount < 1440000)
-         return 4;
-      else if (aAmount < 1800000)
-         return 2;
-
-      return 0;
+      return GetLeasingTierPct(LEASING_VALIDATOR_TIERS, aAmount / COIN);
    }
 
    int64_t GetMasterNodeLeasingPct(CAmount aAmount) const {
-      aAmount /= COIN;
-
-      if (aAmount < 30000)
-         return 10;
-      else if (aAmount < 90000)
-         return 9;
-      else if (aAmount < 180000)
-         return 8;
-      else if (aAmount < 270000)
-         return 7;
-      else if (aAmount < 360000)
-         return 6;
-      else if (aAmount < 540000)
-         return 5;
-      else if (aAmount < 720000)
-         return 4;
-      else if (aAmount < 1080000)
-         return 3;
-      else if (aAmount < 1440000)
-         return 2;
-      else if (aAmount < 1800000)
-         return 1;
-
-      return 0;
+      return GetLeasingTierPct(LEASING_MASTERNODE_TIERS, aAmount / COIN);
    }
 
    bool ExtractLeasingPoint(const CTxOut& txout, COutPoint& point) const {
@@ -860,11 +892,16 @@ private:
    CLeasingDB leasingDB;
    CLeasingOutputMap mapOutputs;
    std::map<CKeyID, CAmount> mapBalance;
+   // leasers whose balance changed since it was last written to the DB
+   std::set<CKeyID> setDirtyBalances;
    int nBlockHeight = 0;
    uint256 nBlockHash;
    CAmount nLeasingSupply = 0;
    int64_t nHeightLeasingPct = 15 * _1pct;
    int64_t nSupplyLeasingPct = _100pct;
+   // supply range in coins nSupplyLeasingPct holds for, empty until computed
+   int64_t nSupplyTierLow = 1;
+   int64_t nSupplyTierHigh = 0;
 };
 
 
@@ -939,6 +976,10 @@ CTxOut CLeasingManager::CalcLeasingReward(const COutPoint& point, const CKeyID&
    return pImpl->CalcLeasingReward(point, keyID);
 }
 
+void CLeasingManager::CalcLeasingRewards(const std::vector<std::pair<COutPoint, CKeyID>>& vPoints, std::vector<CTxOut>& vRewards) const {
+   pImpl->CalcLeasingRewards(vPoints, vRewards);
+}
+
 CTxOut CLeasingManager::CalcLeasingReward(const LeaserType type, const CKeyID& leaserID, const CAmount aAmount) const {
    return pImpl->CalcLeasingRewardTest(type, leaserID, aAmount);
 }
@@ -36,6 +36,8 @@ public:
 
     bool GetLeasingRewards(const LeaserType type, const CKeyID& leaserID, const size_t nLimit, std::vector<CTxOut>& vRewards) const;
     CTxOut CalcLeasingReward(const COutPoint& point, const CKeyID& keyID) const;
+    // rewards for many leasing points at once, in the same order, empty outputs for unknown points
+    void CalcLeasingRewards(const std::vector<std::pair<COutPoint, CKeyID>>& vPoints, std::vector<CTxOut>& vRewards) const;
     void GetAllAmountsLeasedTo(CPubKey &pubKey, CAmount &amount) const;
     void GetAllAmountsLeasedFrom(CPubKey &pubKey, CAmount &amount) const;
 
@@ -14,6 +14,8 @@
 #include "addrman.h"
 #include "alert.h"
 #include "amount.h"
+#include "blockencodings.h"
+#include "blockfilter.h"
 #include "blocksignature.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -45,6 +47,7 @@
 #include "leasing/leasing_tx_verify.h"
 #include "blockrewards.h"
 #include "contract.h"
+#include <libethereum/StateCache.h>
 #include "validation.h"
 
 #include "zbtcu/zerocoin.h"
@@ -84,9 +87,11 @@ uint256 g_best_block;
 uint256 g_hashChainstate;
 
 int nScriptCheckThreads = 0;
+int nMasternodeMessageThreads = 0;
 std::atomic<bool> fImporting{false};
 std::atomic<bool> fReindex{false};
 bool fTxIndex = true;
+bool fBlockFilterIndex = DEFAULT_BLOCKFILTERINDEX;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fVerifyingBlocks = false;
@@ -107,7 +112,7 @@ CFeeRate minRelayTxFee = CFeeRate(100);
 CTxMemPool mempool(::minRelayTxFee);
 
 struct COrphanTx {
-    CTransaction tx;
+    CTransactionRef tx;
     NodeId fromPeer;
 };
 std::map<uint256, COrphanTx> mapOrphanTransactions;
@@ -198,6 +203,25 @@ std::set<CBlockIndex*> setDirtyBlockIndex;
 
 /** Dirty block file entries. */
 std::set<int> setDirtyFileInfo;
+
+/**
+ * Masternode, budget, spork and swifttx messages are processed by their own threads so a
+ * broadcast storm of them does not hold back block and transaction relay. Messages of a peer
+ * are processed in the order received, by one thread at a time.
+ */
+boost::mutex csMasternodeLane;
+boost::condition_variable condMasternodeLane;
+std::deque<CMasternodeLaneMessage> queueMasternodeLane;
+/** Messages of each peer in queueMasternodeLane. */
+std::map<NodeId, size_t> mapMasternodeLaneQueued;
+/** Peers with a message being processed by a masternode lane thread. */
+std::set<NodeId> setMasternodeLaneBusy;
+
+CCriticalSection cs_messageLaneStats;
+CMessageLaneStats statsGeneralLane;
+CMessageLaneStats statsMasternodeLane;
+/** Messages left in the receive buffer of each peer, making up the general lane queue depth. */
+std::map<NodeId, size_t> mapGeneralLanePending;
 } // anon namespace
 
 CValidatorsState g_ValidatorsState;
@@ -325,6 +349,12 @@ struct CNodeState {
     int nBlocksInFlight;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
+    //! Whether this peer can reconstruct blocks from cmpctblock messages.
+    bool fProvidesHeaderAndIDs;
+    //! Whether this peer wants new blocks announced as cmpctblock instead of inv.
+    bool fPreferHeaderAndIDs;
+    //! Block this peer sent as cmpctblock, waiting for the blocktxn with its missing transactions.
+    std::shared_ptr<PartiallyDownloadedBlock> partialBlock;
 
     CNodeBlocks nodeBlocks;
 
@@ -340,12 +370,17 @@ struct CNodeState {
         nStallingSince = 0;
         nBlocksInFlight = 0;
         fPreferredDownload = false;
+        fProvidesHeaderAndIDs = false;
+        fPreferHeaderAndIDs = false;
     }
 };
 
 /** Map maintaining per-node state. Requires cs_main. */
 std::map<NodeId, CNodeState> mapNodeState;
 
+/** Peers we asked to announce new blocks as cmpctblock, oldest first. Requires cs_main. */
+std::list<NodeId> lNodesAnnouncingHeaderAndIDs;
+
 // Requires cs_main.
 CNodeState* State(NodeId pnode)
 {
@@ -401,8 +436,46 @@ void FinalizeNode(NodeId nodeid)
         mapBlocksInFlight.erase(entry.hash);
     EraseOrphansFor(nodeid);
     nPreferredDownload -= state->fPreferredDownload;
+    lNodesAnnouncingHeaderAndIDs.remove(nodeid);
 
     mapNodeState.erase(nodeid);
+
+    LOCK(cs_messageLaneStats);
+    mapGeneralLanePending.erase(nodeid);
+}
+
+// Requires cs_main.
+void MaybeSetPeerAsAnnouncingHeaderAndIDs(CNode* pfrom)
+{
+    CNodeState* nodestate = State(pfrom->GetId());
+    // Whitelisted peers were asked to announce with cmpctblock on connect
+    if (!nodestate || !nodestate->fProvidesHeaderAndIDs || pfrom->fWhitelisted)
+        return;
+
+    for (std::list<NodeId>::iterator it = lNodesAnnouncingHeaderAndIDs.begin(); it != lNodesAnnouncingHeaderAndIDs.end(); it++) {
+        if (*it == pfrom->GetId()) {
+            lNodesAnnouncingHeaderAndIDs.erase(it);
+            lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
+            return;
+        }
+    }
+
+    // Only the last few peers that gave us a new tip first announce with cmpctblock
+    if (lNodesAnnouncingHeaderAndIDs.size() >= MAX_CMPCTBLOCK_ANNOUNCING_PEERS) {
+        NodeId nodeid = lNodesAnnouncingHeaderAndIDs.front();
+        {
+            LOCK(cs_vNodes);
+            for (CNode* pnode : vNodes) {
+                if (pnode->GetId() == nodeid) {
+                    pnode->PushMessage("sendcmpct", false, CMPCTBLOCKS_VERSION);
+                    break;
+                }
+            }
+        }
+        lNodesAnnouncingHeaderAndIDs.pop_front();
+    }
+    pfrom->PushMessage("sendcmpct", true, CMPCTBLOCKS_VERSION);
+    lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
 }
 
 // Requires cs_main.
@@ -634,8 +707,9 @@ CSporkDB* pSporkDB = NULL;
 // mapOrphanTransactions
 //
 
-bool AddOrphanTx(const CTransaction& tx, NodeId peer)
+bool AddOrphanTx(const CTransactionRef& ptx, NodeId peer)
 {
+    const CTransaction& tx = *ptx;
     uint256 hash = tx.GetHash();
     if (mapOrphanTransactions.count(hash))
         return false;
@@ -653,7 +727,7 @@ bool AddOrphanTx(const CTransaction& tx, NodeId peer)
         return false;
     }
 
-    mapOrphanTransactions[hash].tx = tx;
+    mapOrphanTransactions[hash].tx = ptx;
     mapOrphanTransactions[hash].fromPeer = peer;
     for (const CTxIn& txin : tx.vin)
         mapOrphanTransactionsByPrev[txin.prevout.hash].insert(hash);
@@ -668,7 +742,7 @@ void static EraseOrphanTx(uint256 hash)
     std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
     if (it == mapOrphanTransactions.end())
         return;
-    for (const CTxIn& txin : it->second.tx.vin) {
+    for (const CTxIn& txin : it->second.tx->vin) {
         std::map<uint256, std::set<uint256> >::iterator itPrev = mapOrphanTransactionsByPrev.find(txin.prevout.hash);
         if (itPrev == mapOrphanTransactionsByPrev.end())
             continue;
@@ -686,7 +760,7 @@ void EraseOrphansFor(NodeId peer)
     while (iter != mapOrphanTransactions.end()) {
         std::map<uint256, COrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
         if (maybeErase->second.fromPeer == peer) {
-            EraseOrphanTx(maybeErase->second.tx.GetHash());
+            EraseOrphanTx(maybeErase->second.tx->GetHash());
             ++nErased;
         }
     }
@@ -867,6 +941,7 @@ int GetIXConfirmations(uint256 nTXHash)
 {
     int sigs = 0;
 
+    LOCK(cs_swifttx);
     std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
     if (i != mapTxLocks.end()) {
         sigs = (*i).second.CountSignatures();
@@ -1120,8 +1195,33 @@ int GetSpendHeight(const CCoinsViewCache& inputs)
    return pindexPrev->nHeight + 1;
 }
 
-bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
+void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age)
+{
+    std::vector<uint256> vRemoved;
+    int expired = pool.Expire(GetTime() - age, &vRemoved);
+    if (expired != 0)
+        LogPrint("mempool", "Expired %i transactions from the memory pool\n", expired);
+
+    pool.TrimToSize(limit, NULL, &vRemoved);
+
+    // Wallets count their unconfirmed transactions only while they are in the mempool
+    for (const uint256& hash : vRemoved)
+        GetMainSignals().UpdatedTransaction(hash);
+}
+
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees, bool fOverrideMempoolLimit)
+{
+    return AcceptToMemoryPool(pool, state, MakeTransactionRef(tx), fLimitFree, pfMissingInputs, fRejectInsaneFee, ignoreFees, fOverrideMempoolLimit);
+}
+
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees, bool fOverrideMempoolLimit)
 {
+    return AcceptToMemoryPoolWithTime(pool, state, ptx, fLimitFree, pfMissingInputs, GetTime(), fRejectInsaneFee, ignoreFees, fOverrideMempoolLimit);
+}
+
+bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx, bool fLimitFree, bool* pfMissingInputs, int64_t nAcceptTime, bool fRejectInsaneFee, bool ignoreFees, bool fOverrideMempoolLimit)
+{
+    const CTransaction& tx = *ptx;
     AssertLockHeld(cs_main);
     if (pfMissingInputs)
         *pfMissingInputs = false;
@@ -1172,9 +1272,11 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
     // ----------- swiftTX transaction scanning -----------
 
-    for (const CTxIn& in : tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
+    {
+        LOCK(cs_swifttx);
+        for (const CTxIn& in : tx.vin) {
+            std::map<COutPoint, uint256>::const_iterator it = mapLockedInputs.find(in.prevout);
+            if (it != mapLockedInputs.end() && it->second != tx.GetHash()) {
                 return state.DoS(0,
                     error("%s : conflicts with existing transaction lock: %s",
                             __func__, reason), REJECT_INVALID, "tx-lock-conflict");
@@ -1276,8 +1378,8 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
            //check validator transaction
            std::vector<CTransaction> validatorTransactions;
-           for(auto &t: pool.mapTx){
-              const CTransaction &valTx = t.second.GetTx();
+           for(const CTxMemPoolEntry &t: pool.mapTx){
+              const CTransaction &valTx = t.GetTx();
               if(valTx.IsValidatorVote() || valTx.IsValidatorRegister())
                  validatorTransactions.push_back(valTx);
            }
@@ -1403,7 +1505,7 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
        ////////////////////////////////////////////////////////////
 
 
-        CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainHeight);
+        CTxMemPoolEntry entry(ptx, nFees, nAcceptTime, dPriority, chainHeight);
         unsigned int nSize = entry.GetTxSize();
 
         // Don't accept it if it can't get into a block
@@ -1411,6 +1513,11 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
         if (mapObfuscationBroadcastTxes.count(hash)) {
             mempool.PrioritiseTransaction(hash, hash.ToString(), 1000, 0.1 * COIN);
         } else if (!ignoreFees) {
+            CAmount mempoolRejectFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+            if (mempoolRejectFee > 0 && nFees < mempoolRejectFee && !hasZcSpendInputs)
+                return state.DoS(0, error("%s : mempool min fee not met %s, %d < %d",
+                        __func__, hash.ToString(), nFees, mempoolRejectFee), REJECT_INSUFFICIENTFEE, "mempool min fee not met");
+
             CAmount txMinFee = GetMinRelayFee(tx, nSize, true);
             if (fLimitFree && nFees < txMinFee && !hasZcSpendInputs)
                 return state.DoS(0, error("%s : not enough fees %s, %d < %d",
@@ -1449,6 +1556,19 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
             return state.DoS(0, error("%s : insane fees %s, %d > %d",
                                       __func__, hash.ToString(), nFees, ::minRelayTxFee.GetFee(nSize) * 1000000), REJECT_INSANE, "insane fee");
 
+        // Calculate in-mempool ancestors, up to a limit.
+        CTxMemPool::setEntries setAncestors;
+        {
+            LOCK(pool.cs);
+            size_t nLimitAncestors = GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
+            size_t nLimitAncestorSize = GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT) * 1000;
+            size_t nLimitDescendants = GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
+            size_t nLimitDescendantSize = GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT) * 1000;
+            std::string errString;
+            if (!pool.CalculateMemPoolAncestors(entry, setAncestors, nLimitAncestors, nLimitAncestorSize, nLimitDescendants, nLimitDescendantSize, errString))
+                return state.DoS(0, error("%s : %s %s", __func__, hash.ToString(), errString), REJECT_NONSTANDARD, "too-long-mempool-chain");
+        }
+
 
         // As zero fee transactions are not going to be accepted in the near future (4.0) and the code will be fully refactored soon.
         // This is just a quick inline towards that goal, the mempool by default will not accept them. Blocking
@@ -1488,7 +1608,14 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
         }
 
         // Store transaction in memory
-        pool.addUnchecked(hash, entry);
+        pool.addUnchecked(hash, entry, setAncestors);
+
+        // Trim the pool and check whether the transaction made it
+        if (!fOverrideMempoolLimit) {
+            LimitMempoolSize(pool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+            if (!pool.exists(hash))
+                return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
+        }
     }
 
     SyncWithWallets(tx, nullptr);
@@ -1496,6 +1623,120 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
     return true;
 }
 
+static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+
+bool LoadMempool()
+{
+    const int64_t nExpiryTimeout = GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+    FILE* filestr = fopen((GetDataDir() / "mempool.dat").string().c_str(), "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
+        return false;
+    }
+
+    int64_t count = 0;
+    int64_t expired = 0;
+    int64_t failed = 0;
+    int64_t nNow = GetTime();
+
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != MEMPOOL_DUMP_VERSION)
+            return error("%s : unknown mempool file version %d", __func__, version);
+
+        // The deltas come first, so the transactions enter the pool with them applied
+        std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+        file >> mapDeltas;
+        for (const auto& i : mapDeltas)
+            mempool.PrioritiseTransaction(i.first, i.first.ToString(), i.second.first, i.second.second);
+
+        uint64_t num;
+        file >> num;
+        while (num--) {
+            CTransactionRef tx;
+            int64_t nTime;
+            file >> tx;
+            file >> nTime;
+
+            if (nTime + nExpiryTimeout > nNow) {
+                CValidationState state;
+                LOCK(cs_main);
+                if (AcceptToMemoryPoolWithTime(mempool, state, tx, true, NULL, nTime))
+                    ++count;
+                else
+                    ++failed;
+            } else {
+                ++expired;
+            }
+            if (ShutdownRequested())
+                return false;
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+
+    LogPrintf("Imported mempool transactions from disk: %i successes, %i failed, %i expired\n", count, failed, expired);
+    return true;
+}
+
+bool DumpMempool()
+{
+    // The scheduler and the savemempool RPC would otherwise write the same temporary file
+    static CCriticalSection cs_dump;
+    LOCK(cs_dump);
+
+    int64_t start = GetTimeMicros();
+
+    std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+    std::vector<CTxMemPool::txiter> vEntries;
+    std::vector<std::pair<CTransactionRef, int64_t> > vInfo;
+    {
+        LOCK(mempool.cs);
+        mapDeltas = mempool.mapDeltas;
+        vEntries.reserve(mempool.mapTx.size());
+        for (CTxMemPool::txiter it = mempool.mapTx.begin(); it != mempool.mapTx.end(); ++it)
+            vEntries.push_back(it);
+        // Parents go first, so the transactions can be accepted again in file order
+        std::sort(vEntries.begin(), vEntries.end(), [](const CTxMemPool::txiter& a, const CTxMemPool::txiter& b) {
+            return a->GetCountWithAncestors() < b->GetCountWithAncestors();
+        });
+        vInfo.reserve(vEntries.size());
+        for (const CTxMemPool::txiter& it : vEntries)
+            vInfo.emplace_back(it->GetSharedTx(), it->GetTime());
+    }
+
+    int64_t mid = GetTimeMicros();
+
+    try {
+        FILE* filestr = fopen((GetDataDir() / "mempool.dat.new").string().c_str(), "wb");
+        if (!filestr)
+            return error("%s : failed to open mempool.dat.new", __func__);
+
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+
+        uint64_t version = MEMPOOL_DUMP_VERSION;
+        file << version;
+        file << mapDeltas;
+        file << (uint64_t)vInfo.size();
+        for (const auto& i : vInfo) {
+            file << i.first;
+            file << i.second;
+        }
+        FileCommit(file.Get());
+        file.fclose();
+        RenameOver(GetDataDir() / "mempool.dat.new", GetDataDir() / "mempool.dat");
+        int64_t last = GetTimeMicros();
+        LogPrintf("Dumped mempool: %gs to copy, %gs to dump, %u transactions\n", (mid - start) * 0.000001, (last - mid) * 0.000001, vInfo.size());
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump mempool: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+    return true;
+}
+
 bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool isDSTX)
 {
     AssertLockHeld(cs_main);
@@ -1533,9 +1774,11 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
 
     // ----------- swiftTX transaction scanning -----------
 
-    for (const CTxIn& in : tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
+    {
+        LOCK(cs_swifttx);
+        for (const CTxIn& in : tx.vin) {
+            std::map<COutPoint, uint256>::const_iterator it = mapLockedInputs.find(in.prevout);
+            if (it != mapLockedInputs.end() && it->second != tx.GetHash()) {
                 return state.DoS(0,
                     error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
                     REJECT_INVALID, "tx-lock-conflict");
@@ -1778,7 +2021,8 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock
     if (pindexSlow) {
         CBlock block;
         if (ReadBlockFromDisk(block, pindexSlow)) {
-            for (const CTransaction& tx : block.vtx) {
+            for (const CTransactionRef& ptx : block.vtx) {
+                const CTransaction& tx = *ptx;
                 if (tx.GetHash() == hash) {
                     txOut = tx;
                     hashBlock = pindexSlow->GetBlockHash();
@@ -2055,7 +2299,8 @@ std::map<COutPoint, COutPoint> mapInvalidOutPoints;
 std::map<CBigNum, CAmount> mapInvalidSerials;
 void AddInvalidSpendsToMap(const CBlock& block)
 {
-    for (const CTransaction& tx : block.vtx) {
+    for (const CTransactionRef& ptx : block.vtx) {
+        const CTransaction& tx = *ptx;
         if (!tx.ContainsZerocoins())
             continue;
 
@@ -2331,7 +2576,7 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
     
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
-        const CTransaction& tx = block.vtx[i];
+        const CTransaction& tx = *block.vtx[i];
 
         /** UNDO ZEROCOIN DATABASING
          * note we only undo zerocoin databasing in the following statement, value to and from BTCU
@@ -2442,6 +2687,7 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
         }
         UpdateValidatorsVotingState(tx, false);
     }
+    CommitValidatorsVotingState(pindex, false);
 
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
@@ -2628,7 +2874,8 @@ bool RecalculateBTCUSupply(int nHeightStart)
 
         CAmount nValueIn = 0;
         CAmount nValueOut = 0;
-        for (const CTransaction& tx : block.vtx) {
+        for (const CTransactionRef& ptx : block.vtx) {
+            const CTransaction& tx = *ptx;
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 if (tx.IsCoinBase() || tx.IsLeasingReward())
                     break;
@@ -2714,12 +2961,12 @@ bool UpdateZBTCUSupply(const CBlock& block, CBlockIndex* pindex, bool fJustCheck
                     pwalletMain->UpdateMint(m.GetValue(), pindex->nHeight, m.GetTxHash(), m.GetDenomination());
 
                     // Add the transaction to the wallet
-                    for (auto& tx : block.vtx) {
-                        uint256 txid = tx.GetHash();
+                    for (const CTransactionRef& tx : block.vtx) {
+                        uint256 txid = tx->GetHash();
                         if (setAddedToWallet.count(txid))
                             continue;
                         if (txid == m.GetTxHash()) {
-                            CWalletTx wtx(pwalletMain, tx);
+                            CWalletTx wtx(pwalletMain, *tx);
                             wtx.nTimeReceived = block.GetBlockTime();
                             wtx.SetMerkleBranch(block);
                             pwalletMain->AddToWallet(wtx, false, nullptr);
@@ -2863,11 +3110,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     std::vector<CTransaction> validatorTransactions;
     uint64_t countCumulativeGasUsed = 0;
     //std::map<dev::Address, std::pair<CHeightTxIndexKey, std::vector<uint256> > > heightIndexes;
-    uint64_t blockGasUsed = 0;
     CAmount gasRefunds = 0;
+    // contract transactions execute on their own thread, joined before the block value and state root checks
+    BlockContractExecutor contractExec(block, blockGasLimit, pindex->pprev, fRecordLogOpcodes && !fJustCheck);
 
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
-        const CTransaction& tx = block.vtx[i];
+        const CTransaction& tx = *block.vtx[i];
 
         // First check for BIP30.
         // Do not allow blocks that contain transactions which 'overwrite' older transactions,
@@ -2988,7 +3236,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             //For contract sender suport add this flag
             flags |= SCRIPT_OUTPUT_SENDER;
 
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, false, txsdata[i], (hasOpSpend || tx.HasCreateOrCall()) ? nullptr: ( nScriptCheckThreads ? /*&vChecks*/nullptr : nullptr)))
+            // contract transactions keep verifying inline, the scripts of the others go to the check queue
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags, false, txsdata[i], (hasOpSpend || tx.HasCreateOrCall()) ? nullptr : (nScriptCheckThreads ? &vChecks : nullptr)))
                 return false;
 
             control.Add(vChecks);
@@ -3033,9 +3282,6 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
        if(!CheckOpSender(tx, Params(), pindex->nHeight)){
           state.Invalid(false, REJECT_INVALID, "bad-txns-invalid-sender");
        }
-       if(!tx.HasOpSpend()){
-          checkBlock.vtx.push_back(block.vtx[i]);
-       }
 
         //checks for smart contracts trxs
         bool bSCValidatorFound = true;
@@ -3081,7 +3327,6 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
 
               dev::u256 gasAllTxs = dev::u256(0);
-              ByteCodeExec exec(block, resultConvertQtumTX.first, blockGasLimit, pindex->pprev);
               //validate VM version and other ETH params before execution
               //Reject anything unknown (could be changed later by DGP)
               //TODO evaluate if this should be relaxed for soft-fork purposes
@@ -3141,33 +3386,30 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
               }
 
               if (fAlreadyChecked || fVerifyDB) {
-
-                 if (!exec.performByteCode()) {
-                    return state.Error("ConnectBlock(): Unknown error during contract execution");
-                 }
-
-                 std::vector<ResultExecute> resultExec(exec.getResult());
-                 ByteCodeExecResult bcer;
-                 if (!exec.processingResults(bcer)) {
-                    return state.Error("ConnectBlock(): Error processing VM execution results");
-                 }
-                 blockGasUsed += bcer.usedGas;
-                 if (blockGasUsed > blockGasLimit) {
-                    return state.Invalid("ConnectBlock(): Block exceeds gas limit");
-                 }
-                 for (CTxOut refundVout : bcer.refundOutputs) {
-                    gasRefunds += refundVout.nValue;
-                 }
-                 for(CTransaction& t : bcer.valueTransfers){
-                    checkBlock.vtx.push_back(t);
-                 }
-                 if (fRecordLogOpcodes && !fJustCheck) {
-                    writeVMlog(resultExec, tx, block);
-                 }
+                 contractExec.Add(i, std::move(resultConvertQtumTX.first));
               }
            }
     }
 
+    if (!contractExec.Wait()) {
+        if (contractExec.GasLimitExceeded())
+            return state.Invalid(error("%s", contractExec.GetError()), REJECT_INVALID, "bad-blk-gaslimit");
+        return state.Error(contractExec.GetError());
+    }
+    gasRefunds = contractExec.GetRefunds();
+
+    // the block as the AAL expects it: every non OP_SPEND transaction followed by the value transfers its contracts made
+    const std::deque<ContractExecJob>& contractJobs = contractExec.GetJobs();
+    auto itContractJob = contractJobs.begin();
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        if (!block.vtx[i]->HasOpSpend())
+            checkBlock.vtx.push_back(block.vtx[i]);
+        for (; itContractJob != contractJobs.end() && itContractJob->nTx == i; ++itContractJob) {
+            for (const CTransaction& t : itContractJob->result.valueTransfers)
+                checkBlock.vtx.push_back(MakeTransactionRef(t));
+        }
+    }
+
     //Track zBTCU money supply in the block index
     if (!UpdateZBTCUSupply(block, pindex, fJustCheck))
         return state.DoS(100, error("%s: Failed to calculate new zBTCU supply for block=%s height=%d", __func__,
@@ -3213,6 +3455,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         UpdateValidatorsVotingState(tx, true);
     }
     UpdateValidators(pindex);
+    CommitValidatorsVotingState(pindex);
     
     // Write undo information to disk
     if (pindex->GetUndoPos().IsNull() || !pindex->IsValid(BLOCK_VALID_SCRIPTS)) {
@@ -3248,7 +3491,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
                     continue;
 
                 //Search block for matching tx, turn into wtx, set merkle branch, add to wallet
-                for (const CTransaction& tx : block.vtx) {
+                for (const CTransactionRef& ptx : block.vtx) {
+                    const CTransaction& tx = *ptx;
                     if (tx.GetHash() == pSpend.second) {
                         CWalletTx wtx(pwalletMain, tx);
                         wtx.nTimeReceived = pindex->GetBlockTime();
@@ -3272,6 +3516,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
+    if (fBlockFilterIndex)
+        if (!pblocktree->WriteBlockFilter(pindex->GetBlockHash(), BuildBlockFilter(block, blockundo)))
+            return AbortNode(state, "Failed to write block filter");
+
 
 
    ////////////////////////////////////////////////////////////////// // qtum
@@ -3290,12 +3538,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             LogPrintf("Unexpected AAL transactions in block. Actual txs: %i, expected txs: %i\n", block.vtx.size(), checkBlock.vtx.size());
             for(size_t i=0;i<block.vtx.size();i++){
                if(i > checkBlock.vtx.size()-1){
-                  LogPrintf("Unexpected transaction: %s\n", block.vtx[i].ToString());
+                  LogPrintf("Unexpected transaction: %s\n", block.vtx[i]->ToString());
                }else {
-                  if (block.vtx[i].GetHash() != checkBlock.vtx[i].GetHash()) {
+                  if (block.vtx[i]->GetHash() != checkBlock.vtx[i]->GetHash()) {
                      LogPrintf("Mismatched transaction at entry %i\n", i);
-                     LogPrintf("Actual: %s\n", block.vtx[i].ToString());
-                     LogPrintf("Expected: %s\n", checkBlock.vtx[i].ToString());
+                     LogPrintf("Actual: %s\n", block.vtx[i]->ToString());
+                     LogPrintf("Expected: %s\n", checkBlock.vtx[i]->ToString());
                   }
                }
             }
@@ -3303,22 +3551,22 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             LogPrintf("Actual block is missing AAL transactions. Actual txs: %i, expected txs: %i\n", block.vtx.size(), checkBlock.vtx.size());
             for(size_t i=0;i<checkBlock.vtx.size();i++){
                if(i > block.vtx.size()-1){
-                  LogPrintf("Missing transaction: %s\n", checkBlock.vtx[i].ToString());
+                  LogPrintf("Missing transaction: %s\n", checkBlock.vtx[i]->ToString());
                }else {
-                  if (block.vtx[i].GetHash() != checkBlock.vtx[i].GetHash()) {
+                  if (block.vtx[i]->GetHash() != checkBlock.vtx[i]->GetHash()) {
                      LogPrintf("Mismatched transaction at entry %i\n", i);
-                     LogPrintf("Actual: %s\n", block.vtx[i].ToString());
-                     LogPrintf("Expected: %s\n", checkBlock.vtx[i].ToString());
+                     LogPrintf("Actual: %s\n", block.vtx[i]->ToString());
+                     LogPrintf("Expected: %s\n", checkBlock.vtx[i]->ToString());
                   }
                }
             }
          }else{
             //count is correct, but a tx is wrong
             for(size_t i=0;i<checkBlock.vtx.size();i++){
-               if (block.vtx[i].GetHash() != checkBlock.vtx[i].GetHash()) {
+               if (block.vtx[i]->GetHash() != checkBlock.vtx[i]->GetHash()) {
                   LogPrintf("Mismatched transaction at entry %i\n", i);
-                  LogPrintf("Actual: %s\n", block.vtx[i].ToString());
-                  LogPrintf("Expected: %s\n", checkBlock.vtx[i].ToString());
+                  LogPrintf("Actual: %s\n", block.vtx[i]->ToString());
+                  LogPrintf("Expected: %s\n", checkBlock.vtx[i]->ToString());
                }
             }
          }
@@ -3350,6 +3598,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
+    // Later stakes are likely to spend the coinstake outputs, keep them at hand for CheckProofOfStake
+    if (block.IsProofOfStake())
+        CacheStakeInputs(*block.vtx[1], pindex);
+
     int64_t nTime3 = GetTimeMicros();
     nTimeIndex += nTime3 - nTime2;
     LogPrint("bench", "    - Index writing: %.2fms [%.2fs]\n", 0.001 * (nTime3 - nTime2), nTimeIndex * 0.000001);
@@ -3357,7 +3609,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     // Watch for changes to the previous coinbase transaction.
     static uint256 hashPrevBestCoinBase;
     GetMainSignals().UpdatedTransaction(hashPrevBestCoinBase);
-    hashPrevBestCoinBase = block.vtx[0].GetHash();
+    hashPrevBestCoinBase = block.vtx[0]->GetHash();
 
     int64_t nTime4 = GetTimeMicros();
     nTimeCallbacks += nTime4 - nTime3;
@@ -3519,20 +3771,32 @@ bool static DisconnectTip(CValidationState& state)
     if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS))
         return false;
     // Resurrect mempool transactions from the disconnected block.
-    for (const CTransaction& tx : block.vtx) {
+    std::vector<uint256> vHashUpdate;
+    for (const CTransactionRef& ptx : block.vtx) {
+        const CTransaction& tx = *ptx;
         // ignore validation errors in resurrected transactions
         std::list<CTransaction> removed;
         CValidationState stateDummy;
-        if (tx.IsCoinBase() || tx.IsCoinStake() || tx.IsLeasingReward() || !AcceptToMemoryPool(mempool, stateDummy, tx, false, NULL))
+        if (tx.IsCoinBase() || tx.IsCoinStake() || tx.IsLeasingReward() || !AcceptToMemoryPool(mempool, stateDummy, ptx, false, NULL, false, false, true))
             mempool.remove(tx, removed, true);
-    }
+        else if (mempool.exists(tx.GetHash()))
+            vHashUpdate.push_back(tx.GetHash());
+    }
+    // AcceptToMemoryPool/addUnchecked all assume that new mempool entries have
+    // no in-mempool children, which is generally not true when adding
+    // previously-confirmed transactions back to the mempool.
+    // UpdateTransactionsFromBlock finds descendants of any transactions in this
+    // block that were added back and cleans up the mempool state.
+    mempool.UpdateTransactionsFromBlock(vHashUpdate);
     mempool.removeCoinbaseSpends(pcoinsTip, pindexDelete->nHeight);
+    LimitMempoolSize(mempool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
     mempool.check(pcoinsTip);
     // Update chainActive and related variables.
     UpdateTip(pindexDelete->pprev);
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
-    for (const CTransaction& tx : block.vtx) {
+    for (const CTransactionRef& ptx : block.vtx) {
+        const CTransaction& tx = *ptx;
         SyncWithWallets(tx, NULL);
     }
     return true;
@@ -3587,6 +3851,7 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
             return error("ConnectTip() : ConnectBlock %s failed", pindexNew->GetBlockHash().ToString());
         }
         mapBlockSource.erase(inv.hash);
+        dev::eth::StateCache::instance().markBlock();
         nTime3 = GetTimeMicros();
         nTimeConnectTotal += nTime3 - nTime2;
         LogPrint("bench", "  - Connect total: %.2fms [%.2fs]\n", (nTime3 - nTime2) * 0.001, nTimeConnectTotal * 0.000001);
@@ -3618,7 +3883,8 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
         SyncWithWallets(tx, NULL);
     }
     // ... and about transactions that got confirmed:
-    for (const CTransaction& tx : pblock->vtx) {
+    for (const CTransactionRef& ptx : pblock->vtx) {
+        const CTransaction& tx = *ptx;
         SyncWithWallets(tx, pblock);
     }
 
@@ -3711,7 +3977,8 @@ bool DisconnectBlockAndInputs(CValidationState& state, CTransaction txLock)
         // Queue memory transactions to resurrect.
         // We only do this for blocks after the last checkpoint (reorganisation before that
         // point should only happen with -reindex/-loadblock, or a misbehaving peer.
-        for (const CTransaction& tx : block.vtx) {
+        for (const CTransactionRef& ptx : block.vtx) {
+            const CTransaction& tx = *ptx;
             if (!tx.IsCoinBase() && !tx.IsLeasingReward()) {
                 for (const CTxIn& in1 : txLock.vin) {
                     for (const CTxIn& in2 : tx.vin) {
@@ -3936,14 +4203,42 @@ bool ActivateBestChain(CValidationState& state, CBlock* pblock, bool fAlreadyChe
             // Notifications/callbacks that can run without cs_main
             if (!fInitialDownload) {
                 uint256 hashNewTip = pindexNewTip->GetBlockHash();
+                const CInv invNewTip(MSG_BLOCK, hashNewTip);
+                // Peers that asked for it get the block we just connected as cmpctblock right away
+                std::set<NodeId> setCmpctPeers;
+                if (pblock && pblock->GetHash() == hashNewTip) {
+                    LOCK(cs_main);
+                    for (const auto& it : mapNodeState)
+                        if (it.second.fPreferHeaderAndIDs)
+                            setCmpctPeers.insert(it.first);
+                }
+                std::unique_ptr<CBlockHeaderAndShortTxIDs> pcmpctblock;
                 // Relay inventory, but don't relay old inventory during initial block download.
                 int nBlockEstimate = Checkpoints::GetTotalBlocksEstimate();
                 {
                     LOCK(cs_vNodes);
-                    for (CNode *pnode : vNodes)
-                        if (chainActive.Height() >
+                    for (CNode *pnode : vNodes) {
+                        if (chainActive.Height() <=
                             (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : nBlockEstimate))
-                            pnode->PushInventory(CInv(MSG_BLOCK, hashNewTip));
+                            continue;
+
+                        if (setCmpctPeers.count(pnode->GetId())) {
+                            bool fKnown;
+                            {
+                                LOCK(pnode->cs_inventory);
+                                fKnown = pnode->setInventoryKnown.count(invNewTip);
+                            }
+                            if (!fKnown) {
+                                if (!pcmpctblock)
+                                    pcmpctblock.reset(new CBlockHeaderAndShortTxIDs(*pblock));
+                                LogPrint("cmpctblock", "%s: sending cmpctblock %s to peer=%d\n", __func__, hashNewTip.ToString(), pnode->id);
+                                pnode->PushMessage("cmpctblock", *pcmpctblock);
+                                pnode->AddInventoryKnown(invNewTip);
+                            }
+                        } else {
+                            pnode->PushInventory(invNewTip);
+                        }
+                    }
                 }
 
 
@@ -4087,7 +4382,7 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
             pindexNew->nStakeModifierChecksum = GetStakeModifierChecksum(pindexNew);
         } else {
             // compute v2 stake modifier
-            pindexNew->nStakeModifierV2 = ComputeStakeModifier(pindexNew->pprev, block.vtx[1].vin[0].prevout.hash);
+            pindexNew->nStakeModifierV2 = ComputeStakeModifier(pindexNew->pprev, block.vtx[1]->vin[0].prevout.hash);
         }
     }
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
@@ -4369,43 +4664,44 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
             REJECT_INVALID, "bad-blk-length");
 
     // First transaction must be coinbase, the rest must not be
-    if (block.vtx.empty() || !block.vtx[0].IsCoinBase())
+    if (block.vtx.empty() || !block.vtx[0]->IsCoinBase())
         return state.DoS(100, error("%s : first tx is not coinbase", __func__),
             REJECT_INVALID, "bad-cb-missing");
     for (unsigned int i = 1; i < block.vtx.size(); i++)
-        if (block.vtx[i].IsCoinBase())
+        if (block.vtx[i]->IsCoinBase())
             return state.DoS(100, error("%s : more than one coinbase", __func__),
                 REJECT_INVALID, "bad-cb-multiple");
 
     if (IsPoS) {
         // Coinbase output should be empty if proof-of-stake block
-        if (block.vtx[0].vout.size() != 1 || !block.vtx[0].vout[0].IsEmpty())
+        if (block.vtx[0]->vout.size() != 1 || !block.vtx[0]->vout[0].IsEmpty())
             return state.DoS(100, error("%s : coinbase output not empty for proof-of-stake block", __func__));
 
         // Second transaction must be coinstake, the rest must not be
-        if (block.vtx.empty() || !block.vtx[1].IsCoinStake())
+        if (block.vtx.empty() || !block.vtx[1]->IsCoinStake())
             return state.DoS(100, error("%s : second tx is not coinstake", __func__));
         for (unsigned int i = 2; i < block.vtx.size(); i++)
-            if (block.vtx[i].IsCoinStake())
+            if (block.vtx[i]->IsCoinStake())
                 return state.DoS(100, error("%s : more than one coinstake", __func__));
-            else if (i > 2 && block.vtx[i].IsLeasingReward())
+            else if (i > 2 && block.vtx[i]->IsLeasingReward())
                 return state.DoS(100, error("%s : more than one leasing reward", __func__));
     }
 
     // ----------- swiftTX transaction scanning -----------
     if (sporkManager.IsSporkActive(SPORK_3_SWIFTTX_BLOCK_FILTERING)) {
-        for (const CTransaction& tx : block.vtx) {
+        LOCK(cs_swifttx);
+        for (const CTransactionRef& ptx : block.vtx) {
+            const CTransaction& tx = *ptx;
             if (!tx.IsCoinBase() && !tx.IsLeasingReward()) {
                 //only reject blocks when it's based on complete consensus
                 for (const CTxIn& in : tx.vin) {
-                    if (mapLockedInputs.count(in.prevout)) {
-                        if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                            mapRejectedBlocks.insert(std::make_pair(block.GetHash(), GetTime()));
-                            LogPrintf("%s : found conflicting transaction with transaction lock %s %s\n", __func__,
-                                    mapLockedInputs[in.prevout].ToString(), tx.GetHash().GetHex());
-                            return state.DoS(0, error("%s : found conflicting transaction with transaction lock", __func__),
-                                REJECT_INVALID, "conflicting-tx-ix");
-                        }
+                    std::map<COutPoint, uint256>::const_iterator it = mapLockedInputs.find(in.prevout);
+                    if (it != mapLockedInputs.end() && it->second != tx.GetHash()) {
+                        mapRejectedBlocks.insert(std::make_pair(block.GetHash(), GetTime()));
+                        LogPrintf("%s : found conflicting transaction with transaction lock %s %s\n", __func__,
+                                it->second.ToString(), tx.GetHash().GetHex());
+                        return state.DoS(0, error("%s : found conflicting transaction with transaction lock", __func__),
+                            REJECT_INVALID, "conflicting-tx-ix");
                     }
                 }
             }
@@ -4443,14 +4739,14 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
         // that this block is invalid, so don't issue an outright ban.
         if (nHeight != 0 && !IsInitialBlockDownload()) {
             // Last output of Cold-Stake is not abused
-            if (IsPoS && !CheckColdStakeFreeOutput(block.vtx[1], nHeight)) {
+            if (IsPoS && !CheckColdStakeFreeOutput(*block.vtx[1], nHeight)) {
                 mapRejectedBlocks.insert(std::make_pair(block.GetHash(), GetTime()));
                 return state.DoS(0, error("%s : Cold stake outputs not valid", __func__),
                         REJECT_INVALID, "bad-p2cs-outs");
             }
 
             // Last output of Leasing is not abused
-            if (IsPoS && !CheckLeasingFreeOutput(block.vtx[1], nHeight)) {
+            if (IsPoS && !CheckLeasingFreeOutput(*block.vtx[1], nHeight)) {
                 mapRejectedBlocks.insert(std::make_pair(block.GetHash(), GetTime()));
                 return state.DoS(0, error("%s : Leasing outputs not valid", __func__),
                                  REJECT_INVALID, "bad-p2l-outs");
@@ -4478,7 +4774,8 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
     std::vector<CBigNum> vBlockSerials;
     // TODO: Check if this is ok... blockHeight is always the tip or should we look for the prevHash and get the height?
     int blockHeight = chainActive.Height() + 1;
-    for (const CTransaction& tx : block.vtx) {
+    for (const CTransactionRef& ptx : block.vtx) {
+        const CTransaction& tx = *ptx;
         if (!CheckTransaction(
                 tx,
                 fZerocoinActive,
@@ -4521,7 +4818,8 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
     }
 
     unsigned int nSigOps = 0;
-    for (const CTransaction& tx : block.vtx) {
+    for (const CTransactionRef& ptx : block.vtx) {
+        const CTransaction& tx = *ptx;
         nSigOps += GetLegacySigOpCount(tx);
     }
     unsigned int nMaxBlockSigOps = fZerocoinActive ? MAX_BLOCK_SIGOPS_CURRENT : MAX_BLOCK_SIGOPS_LEGACY;
@@ -4662,16 +4960,16 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
     const int nHeight = pindexPrev == nullptr ? 0 : pindexPrev->nHeight + 1;
 
     // Check that all transactions are finalized
-    for (const CTransaction& tx : block.vtx)
-        if (!IsFinalTx(tx, nHeight, block.GetBlockTime())) {
+    for (const CTransactionRef& tx : block.vtx)
+        if (!IsFinalTx(*tx, nHeight, block.GetBlockTime())) {
             return state.DoS(10, error("%s : contains a non-final transaction", __func__), REJECT_INVALID, "bad-txns-nonfinal");
         }
 
     // Enforce block.nVersion=2 rule that the coinbase starts with serialized block height
     if (pindexPrev) { // pindexPrev is only null on the first block which is a version 1 block.
         CScript expect = CScript() << nHeight;
-        if (block.vtx[0].vin[0].scriptSig.size() < expect.size() ||
-            !std::equal(expect.begin(), expect.end(), block.vtx[0].vin[0].scriptSig.begin())) {
+        if (block.vtx[0]->vin[0].scriptSig.size() < expect.size() ||
+            !std::equal(expect.begin(), expect.end(), block.vtx[0]->vin[0].scriptSig.begin())) {
             return state.DoS(100, error("%s : block height mismatch in coinbase", __func__), REJECT_INVALID,
                              "bad-cb-height");
         }
@@ -4819,7 +5117,7 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
         bool isBlockFromFork = pindexPrev != nullptr && chainActive.Tip() != pindexPrev;
 
         // Coin stake
-        CTransaction &stakeTxIn = block.vtx[1];
+        const CTransaction& stakeTxIn = *block.vtx[1];
 
         // Inputs
         std::vector<CTxIn> btcuInputs;
@@ -4839,7 +5137,8 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
         // Check for serial double spent on the same block, TODO: Move this to the proper method..
 
         std::vector<CBigNum> inBlockSerials;
-        for (const CTransaction& tx : block.vtx) {
+        for (const CTransactionRef& ptx : block.vtx) {
+            const CTransaction& tx = *ptx;
             for (const CTxIn& in: tx.vin) {
                 if(nHeight >= Params().Zerocoin_StartHeight()) {
                     bool isPublicSpend = in.IsZerocoinPublicSpend();
@@ -4908,9 +5207,9 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
                 }
 
                 // Loop through every tx of this block
-                for (const CTransaction& t : bl.vtx) {
+                for (const CTransactionRef& t : bl.vtx) {
                     // Loop through every input of this tx
-                    for (const CTxIn& in: t.vin) {
+                    for (const CTxIn& in: t->vin) {
                         // If this input is a zerocoin spend, and the coinstake has zerocoin inputs
                         // then store the serials for later check
                         if(hasZBTCUInputs && in.IsZerocoinSpend())
@@ -5865,6 +6164,34 @@ std::string GetWarnings(std::string strFor)
 //
 
 
+/** Whether a relay map of the masternode, budget or payment managers has an entry, under the lock guarding it */
+template <typename T>
+static bool HaveSeen(CCriticalSection& cs, const std::map<uint256, T>& mapSeen, const uint256& hash)
+{
+    LOCK(cs);
+    return mapSeen.count(hash) > 0;
+}
+
+/** Serialize an entry of such a relay map for getdata under its lock, false if there is none */
+template <typename T>
+static bool SerializeSeen(CCriticalSection& cs, const std::map<uint256, T>& mapSeen, const uint256& hash, CDataStream& ss)
+{
+    LOCK(cs);
+    typename std::map<uint256, T>::const_iterator it = mapSeen.find(hash);
+    if (it == mapSeen.end())
+        return false;
+    ss.reserve(1000);
+    ss << it->second;
+    return true;
+}
+
+/** Whether the block itself is stored, not only its header. Requires cs_main. */
+static bool HaveBlockData(const uint256& hash)
+{
+    BlockMap::iterator mi = mapBlockIndex.find(hash);
+    return mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA);
+}
+
 bool static AlreadyHave(const CInv& inv)
 {
     switch (inv.type) {
@@ -5877,52 +6204,59 @@ bool static AlreadyHave(const CInv& inv)
     case MSG_DSTX:
         return mapObfuscationBroadcastTxes.count(inv.hash);
     case MSG_BLOCK:
-        return mapBlockIndex.count(inv.hash);
-    case MSG_TXLOCK_REQUEST:
+        // A header alone, e.g. from a cmpctblock still being rebuilt, does not make the block
+        return HaveBlockData(inv.hash);
+    case MSG_TXLOCK_REQUEST: {
+        LOCK(cs_swifttx);
         return mapTxLockReq.count(inv.hash) ||
                mapTxLockReqRejected.count(inv.hash);
-    case MSG_TXLOCK_VOTE:
+    }
+    case MSG_TXLOCK_VOTE: {
+        LOCK(cs_swifttx);
         return mapTxLockVote.count(inv.hash);
-    case MSG_SPORK:
-        return mapSporks.count(inv.hash);
+    }
+    case MSG_SPORK: {
+        CSporkMessage spork;
+        return sporkManager.GetSporkByHash(inv.hash, spork);
+    }
     case MSG_MASTERNODE_WINNER:
-        if (masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
+        if (HaveSeen(cs_mapMasternodePayeeVotes, masternodePayments.mapMasternodePayeeVotes, inv.hash)) {
             masternodeSync.AddedMasternodeWinner(inv.hash);
             return true;
         }
         return false;
     case MSG_BUDGET_VOTE:
-        if (budget.mapSeenMasternodeBudgetVotes.count(inv.hash)) {
+        if (HaveSeen(budget.cs, budget.mapSeenMasternodeBudgetVotes, inv.hash)) {
             masternodeSync.AddedBudgetItem(inv.hash);
             return true;
         }
         return false;
     case MSG_BUDGET_PROPOSAL:
-        if (budget.mapSeenMasternodeBudgetProposals.count(inv.hash)) {
+        if (HaveSeen(budget.cs, budget.mapSeenMasternodeBudgetProposals, inv.hash)) {
             masternodeSync.AddedBudgetItem(inv.hash);
             return true;
         }
         return false;
     case MSG_BUDGET_FINALIZED_VOTE:
-        if (budget.mapSeenFinalizedBudgetVotes.count(inv.hash)) {
+        if (HaveSeen(budget.cs, budget.mapSeenFinalizedBudgetVotes, inv.hash)) {
             masternodeSync.AddedBudgetItem(inv.hash);
             return true;
         }
         return false;
     case MSG_BUDGET_FINALIZED:
-        if (budget.mapSeenFinalizedBudgets.count(inv.hash)) {
+        if (HaveSeen(budget.cs, budget.mapSeenFinalizedBudgets, inv.hash)) {
             masternodeSync.AddedBudgetItem(inv.hash);
             return true;
         }
         return false;
     case MSG_MASTERNODE_ANNOUNCE:
-        if (mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)) {
+        if (HaveSeen(mnodeman.cs, mnodeman.mapSeenMasternodeBroadcast, inv.hash)) {
             masternodeSync.AddedMasternodeList(inv.hash);
             return true;
         }
         return false;
     case MSG_MASTERNODE_PING:
-        return mnodeman.mapSeenMasternodePing.count(inv.hash);
+        return HaveSeen(mnodeman.cs, mnodeman.mapSeenMasternodePing, inv.hash);
     }
     // Don't know what it is, just say we already got one
     return true;
@@ -5946,7 +6280,7 @@ void static ProcessGetData(CNode* pfrom)
             boost::this_thread::interruption_point();
             it++;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) {
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK) {
                 bool send = false;
                 BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
                 if (mi != mapBlockIndex.end()) {
@@ -5971,7 +6305,15 @@ void static ProcessGetData(CNode* pfrom)
                         assert(!"cannot load block from disk");
                     if (inv.type == MSG_BLOCK)
                         pfrom->PushMessage("block", block);
-                    else // MSG_FILTERED_BLOCK)
+                    else if (inv.type == MSG_CMPCT_BLOCK) {
+                        // The transactions of deeper blocks have left the peer's mempool, send those in full
+                        if (chainActive.Height() - mi->second->nHeight < MAX_CMPCTBLOCK_DEPTH) {
+                            CBlockHeaderAndShortTxIDs cmpctblock(block);
+                            pfrom->PushMessage("cmpctblock", cmpctblock);
+                        } else {
+                            pfrom->PushMessage("block", block);
+                        }
+                    } else // MSG_FILTERED_BLOCK)
                     {
                         LOCK(pfrom->cs_filter);
                         if (pfrom->pfilter) {
@@ -6016,107 +6358,104 @@ void static ProcessGetData(CNode* pfrom)
                 }
 
                 if (!pushed && inv.type == MSG_TX) {
-                    CTransaction tx;
-                    if (mempool.lookup(inv.hash, tx)) {
+                    CTransactionRef tx = mempool.get(inv.hash);
+                    if (tx) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << tx;
+                        ss << *tx;
                         pfrom->PushMessage("tx", ss);
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_TXLOCK_VOTE) {
-                    if (mapTxLockVote.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mapTxLockVote[inv.hash];
-                        pfrom->PushMessage("txlvote", ss);
-                        pushed = true;
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    {
+                        LOCK(cs_swifttx);
+                        std::map<uint256, CConsensusVote>::const_iterator it = mapTxLockVote.find(inv.hash);
+                        if (it != mapTxLockVote.end()) {
+                            ss.reserve(1000);
+                            ss << it->second;
+                            pushed = true;
+                        }
                     }
+                    if (pushed)
+                        pfrom->PushMessage("txlvote", ss);
                 }
                 if (!pushed && inv.type == MSG_TXLOCK_REQUEST) {
-                    if (mapTxLockReq.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mapTxLockReq[inv.hash];
-                        pfrom->PushMessage("ix", ss);
-                        pushed = true;
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    {
+                        LOCK(cs_swifttx);
+                        std::map<uint256, CTransaction>::const_iterator it = mapTxLockReq.find(inv.hash);
+                        if (it != mapTxLockReq.end()) {
+                            ss.reserve(1000);
+                            ss << it->second;
+                            pushed = true;
+                        }
                     }
+                    if (pushed)
+                        pfrom->PushMessage("ix", ss);
                 }
                 if (!pushed && inv.type == MSG_SPORK) {
-                    if (mapSporks.count(inv.hash)) {
+                    CSporkMessage spork;
+                    if (sporkManager.GetSporkByHash(inv.hash, spork)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mapSporks[inv.hash];
+                        ss << spork;
                         pfrom->PushMessage("spork", ss);
                         pushed = true;
                     }
                 }
                 if (!pushed && inv.type == MSG_MASTERNODE_WINNER) {
-                    if (masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << masternodePayments.mapMasternodePayeeVotes[inv.hash];
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    if (SerializeSeen(cs_mapMasternodePayeeVotes, masternodePayments.mapMasternodePayeeVotes, inv.hash, ss)) {
                         pfrom->PushMessage("mnw", ss);
                         pushed = true;
                     }
                 }
                 if (!pushed && inv.type == MSG_BUDGET_VOTE) {
-                    if (budget.mapSeenMasternodeBudgetVotes.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenMasternodeBudgetVotes[inv.hash];
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    if (SerializeSeen(budget.cs, budget.mapSeenMasternodeBudgetVotes, inv.hash, ss)) {
                         pfrom->PushMessage("mvote", ss);
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_BUDGET_PROPOSAL) {
-                    if (budget.mapSeenMasternodeBudgetProposals.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenMasternodeBudgetProposals[inv.hash];
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    if (SerializeSeen(budget.cs, budget.mapSeenMasternodeBudgetProposals, inv.hash, ss)) {
                         pfrom->PushMessage("mprop", ss);
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_BUDGET_FINALIZED_VOTE) {
-                    if (budget.mapSeenFinalizedBudgetVotes.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenFinalizedBudgetVotes[inv.hash];
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    if (SerializeSeen(budget.cs, budget.mapSeenFinalizedBudgetVotes, inv.hash, ss)) {
                         pfrom->PushMessage("fbvote", ss);
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_BUDGET_FINALIZED) {
-                    if (budget.mapSeenFinalizedBudgets.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenFinalizedBudgets[inv.hash];
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    if (SerializeSeen(budget.cs, budget.mapSeenFinalizedBudgets, inv.hash, ss)) {
                         pfrom->PushMessage("fbs", ss);
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_MASTERNODE_ANNOUNCE) {
-                    if (mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mnodeman.mapSeenMasternodeBroadcast[inv.hash];
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    if (SerializeSeen(mnodeman.cs, mnodeman.mapSeenMasternodeBroadcast, inv.hash, ss)) {
                         pfrom->PushMessage("mnb", ss);
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_MASTERNODE_PING) {
-                    if (mnodeman.mapSeenMasternodePing.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mnodeman.mapSeenMasternodePing[inv.hash];
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    if (SerializeSeen(mnodeman.cs, mnodeman.mapSeenMasternodePing, inv.hash, ss)) {
                         pfrom->PushMessage("mnp", ss);
                         pushed = true;
                     }
@@ -6142,7 +6481,7 @@ void static ProcessGetData(CNode* pfrom)
             // Track requests for our stuff.
             GetMainSignals().Inventory(inv.hash);
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
                 break;
         }
     }
@@ -6161,7 +6500,48 @@ void static ProcessGetData(CNode* pfrom)
     }
 }
 
+/** Accept a block rebuilt from a cmpctblock as if it had come in a block message */
+void static ProcessCompactBlock(CNode* pfrom, CBlock& block, const std::string& strCommand)
+{
+    CValidationState state;
+    ProcessNewBlock(state, pfrom, &block);
+    int nDoS;
+    if (state.IsInvalid(nDoS)) {
+        pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
+                           state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), block.GetHash());
+        if (nDoS > 0) {
+            TRY_LOCK(cs_main, lockMain);
+            if (lockMain) Misbehaving(pfrom->GetId(), nDoS);
+        }
+        return;
+    }
+
+    // A peer that gave us the new tip first is a good one to announce the next blocks as cmpctblock
+    LOCK(cs_main);
+    if (chainActive.Tip()->GetBlockHash() == block.GetHash())
+        MaybeSetPeerAsAnnouncingHeaderAndIDs(pfrom);
+}
+
 bool fRequestedSporksIDB = false;
+static bool IsMasternodeLaneCommand(const std::string& strCommand)
+{
+    static const std::set<std::string> setCommands = {
+        "dsee", "dseep", "dseg", "fbs", "fbvote", "getsporks", "ix", "mnb", "mnget",
+        "mnp", "mnvs", "mnw", "mprop", "mvote", "spork", "ssc", "txlvote"};
+    return setCommands.count(strCommand) > 0;
+}
+
+/** Process a masternode, budget, spork or swifttx message. The managers take the locks they need themselves. */
+static void ProcessMasternodeMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
+{
+    mnodeman.ProcessMessage(pfrom, strCommand, vRecv);
+    budget.ProcessMessage(pfrom, strCommand, vRecv);
+    masternodePayments.ProcessMessageMasternodePayments(pfrom, strCommand, vRecv);
+    ProcessMessageSwiftTX(pfrom, strCommand, vRecv);
+    sporkManager.ProcessSpork(pfrom, strCommand, vRecv);
+    masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
+}
+
 bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
     LogPrint("net", "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id);
@@ -6321,6 +6701,26 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             LOCK(cs_main);
             State(pfrom->GetId())->fCurrentlyConnected = true;
         }
+
+        if (pfrom->nVersion >= SHORT_IDS_BLOCKS_VERSION) {
+            // Tell the peer we rebuild blocks from cmpctblock. Whitelisted peers, such as the
+            // validators and masternodes of the operator, announce their blocks that way right away.
+            pfrom->PushMessage("sendcmpct", pfrom->fWhitelisted, CMPCTBLOCKS_VERSION);
+        }
+    }
+
+
+    else if (strCommand == "sendcmpct") {
+        bool fAnnounceUsingCMPCTBLOCK = false;
+        uint64_t nCMPCTBLOCKVersion = 0;
+        vRecv >> fAnnounceUsingCMPCTBLOCK >> nCMPCTBLOCKVersion;
+        // Ignore encodings we do not know
+        if (nCMPCTBLOCKVersion == CMPCTBLOCKS_VERSION) {
+            LOCK(cs_main);
+            CNodeState* nodestate = State(pfrom->GetId());
+            nodestate->fProvidesHeaderAndIDs = true;
+            nodestate->fPreferHeaderAndIDs = fAnnounceUsingCMPCTBLOCK;
+        }
     }
 
 
@@ -6400,6 +6800,9 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         LOCK(cs_main);
 
         std::vector<CInv> vToFetch;
+        // A single new block announced after the initial download is most likely made of
+        // transactions in our mempool, so ask peers that support it for a cmpctblock
+        const bool fFetchCompact = vInv.size() == 1 && State(pfrom->GetId())->fProvidesHeaderAndIDs && !IsInitialBlockDownload();
 
         for (unsigned int nInv = 0; nInv < vInv.size(); nInv++) {
             const CInv& inv = vInv[nInv];
@@ -6418,7 +6821,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                 UpdateBlockAvailability(pfrom->GetId(), inv.hash);
                 if (!fAlreadyHave && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash)) {
                     // Add this to the list of blocks to request
-                    vToFetch.push_back(inv);
+                    vToFetch.push_back(fFetchCompact ? CInv(MSG_CMPCT_BLOCK, inv.hash) : inv);
                     LogPrint("net", "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
                 }
             }
@@ -6530,7 +6933,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     else if (strCommand == "tx" || strCommand == "dstx") {
         std::vector<uint256> vWorkQueue;
         std::vector<uint256> vEraseQueue;
-        CTransaction tx;
+        CTransactionRef ptx;
 
         //masternode signed transaction
         bool ignoreFees = false;
@@ -6539,10 +6942,14 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         int64_t sigTime;
 
         if (strCommand == "tx") {
-            vRecv >> tx;
+            vRecv >> ptx;
         } else if (strCommand == "dstx") {
             //these allow masternodes to publish a limited amount of free transactions
-            vRecv >> tx >> vin >> vchSig >> sigTime;
+            vRecv >> ptx >> vin >> vchSig >> sigTime;
+        }
+        const CTransaction& tx = *ptx;
+
+        if (strCommand == "dstx") {
 
             CMasternode* pmn = mnodeman.Find(vin);
             if (pmn != NULL) {
@@ -6587,7 +6994,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
 
         mapAlreadyAskedFor.erase(inv);
 
-        if (!tx.HasZerocoinSpendInputs() && AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs, false, ignoreFees)) {
+        if (!tx.HasZerocoinSpendInputs() && AcceptToMemoryPool(mempool, state, ptx, true, &fMissingInputs, false, ignoreFees)) {
             mempool.check(pcoinsTip);
             RelayTransaction(tx);
             vWorkQueue.push_back(inv.hash);
@@ -6607,7 +7014,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                     mi != itByPrev->second.end();
                     ++mi) {
                     const uint256 &orphanHash = *mi;
-                    const CTransaction &orphanTx = mapOrphanTransactions[orphanHash].tx;
+                    const CTransactionRef orphanTx = mapOrphanTransactions[orphanHash].tx;
                     NodeId fromPeer = mapOrphanTransactions[orphanHash].fromPeer;
                     bool fMissingInputs2 = false;
                     // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
@@ -6620,7 +7027,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                         continue;
                     if(AcceptToMemoryPool(mempool, stateDummy, orphanTx, true, &fMissingInputs2)) {
                         LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
-                        RelayTransaction(orphanTx);
+                        RelayTransaction(*orphanTx);
                         vWorkQueue.push_back(orphanHash);
                         vEraseQueue.push_back(orphanHash);
                     } else if(!fMissingInputs2) {
@@ -6642,7 +7049,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
 
             for (uint256 hash : vEraseQueue) EraseOrphanTx(hash);
 
-        } else if (tx.HasZerocoinSpendInputs() && AcceptToMemoryPool(mempool, state, tx, true, &fMissingZerocoinInputs, false, ignoreFees)) {
+        } else if (tx.HasZerocoinSpendInputs() && AcceptToMemoryPool(mempool, state, ptx, true, &fMissingZerocoinInputs, false, ignoreFees)) {
             //Presstab: ZCoin has a bunch of code commented out here. Is this something that should have more going on?
             //Also there is nothing that handles fMissingZerocoinInputs. Does there need to be?
             RelayTransaction(tx);
@@ -6651,7 +7058,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                      tx.GetHash().ToString(),
                      mempool.mapTx.size());
         } else if (fMissingInputs) {
-            AddOrphanTx(tx, pfrom->GetId());
+            AddOrphanTx(ptx, pfrom->GetId());
 
             // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
             unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
@@ -6701,6 +7108,9 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
+        // Hash the run in one batch outside cs_main; AcceptBlockHeader then finds the legacy hashes memoized
+        const std::vector<uint256> vHashes = GetBlockHeaderHashes(headers);
+
         LOCK(cs_main);
 
         if (nCount == 0) {
@@ -6708,7 +7118,8 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             return true;
         }
         CBlockIndex* pindexLast = NULL;
-        for (const CBlockHeader& header : headers) {
+        for (unsigned int n = 0; n < nCount; n++) {
+            const CBlockHeader& header = headers[n];
             CValidationState state;
             if (pindexLast != NULL && header.hashPrevBlock != pindexLast->GetBlockHash()) {
                 Misbehaving(pfrom->GetId(), 20);
@@ -6723,7 +7134,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                 if (state.IsInvalid(nDoS)) {
                     if (nDoS > 0)
                         Misbehaving(pfrom->GetId(), nDoS);
-                    std::string strError = "invalid header received " + header.GetHash().ToString();
+                    std::string strError = "invalid header received " + vHashes[n].ToString();
                     return error(strError.c_str());
                 }
             }
@@ -6765,8 +7176,13 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         } else {
             pfrom->AddInventoryKnown(inv);
 
+            bool fHaveData;
+            {
+                LOCK(cs_main);
+                fHaveData = HaveBlockData(hashBlock);
+            }
             CValidationState state;
-            if (!mapBlockIndex.count(block.GetHash())) {
+            if (!fHaveData) {
                 ProcessNewBlock(state, pfrom, &block);
                 int nDoS;
                 if(state.IsInvalid(nDoS)) {
@@ -6785,6 +7201,170 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         }
     }
 
+    else if (strCommand == "cmpctblock" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+
+        const uint256 hashBlock = cmpctblock.header.GetHash();
+        const CInv inv(MSG_BLOCK, hashBlock);
+        LogPrint("net", "received cmpctblock %s peer=%d\n", hashBlock.ToString(), pfrom->id);
+        pfrom->AddInventoryKnown(inv);
+
+        CBlock block;
+        bool fBlockReconstructed = false;
+        {
+            LOCK(cs_main);
+
+            // Only peers that negotiated compact blocks may send them unasked
+            std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hashBlock);
+            const bool fRequested = itInFlight != mapBlocksInFlight.end() && itInFlight->second.first == pfrom->GetId();
+            if (!State(pfrom->GetId())->fProvidesHeaderAndIDs && !fRequested) {
+                LogPrint("net", "ignoring unsolicited cmpctblock %s from peer=%d\n", hashBlock.ToString(), pfrom->id);
+                return true;
+            }
+
+            BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+            if (mi != mapBlockIndex.end() && (mi->second->nStatus & (BLOCK_HAVE_DATA | BLOCK_FAILED_MASK)))
+                return true;
+
+            // The header is checked before any work is spent on the short ids
+            CValidationState state;
+            if (!AcceptBlockHeader(CBlock(cmpctblock.header), state)) {
+                int nDoS;
+                if (state.IsInvalid(nDoS) && nDoS > 0) {
+                    Misbehaving(pfrom->GetId(), nDoS);
+                    return error("invalid header received in cmpctblock %s", hashBlock.ToString());
+                }
+                // e.g. an unknown parent, which the full block is handled for
+                pfrom->PushMessage("getdata", std::vector<CInv>(1, inv));
+                return true;
+            }
+            UpdateBlockAvailability(pfrom->GetId(), hashBlock);
+
+            // Only a block on top of our tip can be rebuilt from our mempool, any other is
+            // requested in full and goes through the usual handling of the block message
+            if (cmpctblock.header.hashPrevBlock != chainActive.Tip()->GetBlockHash()) {
+                pfrom->PushMessage("getdata", std::vector<CInv>(1, inv));
+                return true;
+            }
+
+            // Orphans are often the transactions of the block whose parents we missed
+            std::vector<std::pair<uint256, CTransactionRef> > vExtraTxn;
+            vExtraTxn.reserve(mapOrphanTransactions.size());
+            for (const auto& it : mapOrphanTransactions)
+                vExtraTxn.push_back(std::make_pair(it.first, it.second.tx));
+
+            std::shared_ptr<PartiallyDownloadedBlock> partialBlock = std::make_shared<PartiallyDownloadedBlock>(&mempool);
+            ReadStatus status = partialBlock->InitData(cmpctblock, vExtraTxn);
+            if (status == READ_STATUS_INVALID) {
+                Misbehaving(pfrom->GetId(), 100);
+                return error("Peer %d sent us invalid compact block", pfrom->id);
+            } else if (status == READ_STATUS_FAILED) {
+                // Short id collision, just ask for the block
+                pfrom->PushMessage("getdata", std::vector<CInv>(1, inv));
+                return true;
+            }
+
+            BlockTransactionsRequest req;
+            for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
+                if (!partialBlock->IsTxAvailable(i))
+                    req.indexes.push_back(i);
+            }
+
+            if (req.indexes.empty()) {
+                status = partialBlock->FillBlock(block, std::vector<CTransactionRef>());
+                if (status == READ_STATUS_OK) {
+                    fBlockReconstructed = true;
+                } else {
+                    pfrom->PushMessage("getdata", std::vector<CInv>(1, inv));
+                    return true;
+                }
+            } else {
+                req.blockhash = hashBlock;
+                State(pfrom->GetId())->partialBlock = partialBlock;
+                pfrom->PushMessage("getblocktxn", req);
+            }
+        }
+
+        if (fBlockReconstructed)
+            ProcessCompactBlock(pfrom, block, strCommand);
+    }
+
+    else if (strCommand == "getblocktxn") {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        CBlock block;
+        {
+            LOCK(cs_main);
+
+            BlockMap::iterator mi = mapBlockIndex.find(req.blockhash);
+            if (mi == mapBlockIndex.end() || !(mi->second->nStatus & BLOCK_HAVE_DATA)) {
+                LogPrint("net", "Peer %d sent us a getblocktxn for a block we don't have\n", pfrom->id);
+                return true;
+            }
+
+            // Answer requests for old or side chain blocks as a getdata, with the full block
+            if (!chainActive.Contains(mi->second) || mi->second->nHeight < chainActive.Height() - MAX_BLOCKTXN_DEPTH) {
+                LogPrint("net", "Peer %d sent us a getblocktxn for a block not in the last %d of the chain\n", pfrom->id, MAX_BLOCKTXN_DEPTH);
+                pfrom->vRecvGetData.push_back(CInv(MSG_BLOCK, req.blockhash));
+                ProcessGetData(pfrom);
+                return true;
+            }
+
+            if (!ReadBlockFromDisk(block, mi->second))
+                assert(!"cannot load block from disk");
+        }
+
+        BlockTransactions resp(req);
+        for (size_t i = 0; i < req.indexes.size(); i++) {
+            if (req.indexes[i] >= block.vtx.size()) {
+                LOCK(cs_main);
+                Misbehaving(pfrom->GetId(), 100);
+                return error("Peer %d sent us a getblocktxn with out-of-bounds tx indices", pfrom->id);
+            }
+            resp.txn[i] = block.vtx[req.indexes[i]];
+        }
+        pfrom->PushMessage("blocktxn", resp);
+    }
+
+    else if (strCommand == "blocktxn" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        CBlock block;
+        bool fBlockReconstructed = false;
+        {
+            LOCK(cs_main);
+
+            CNodeState* nodestate = State(pfrom->GetId());
+            std::shared_ptr<PartiallyDownloadedBlock> partialBlock = nodestate->partialBlock;
+            if (!partialBlock || partialBlock->header.GetHash() != resp.blockhash) {
+                LogPrint("net", "Peer %d sent us block transactions for block we weren't expecting\n", pfrom->id);
+                return true;
+            }
+            nodestate->partialBlock.reset();
+
+            ReadStatus status = partialBlock->FillBlock(block, resp.txn);
+            if (status == READ_STATUS_INVALID) {
+                Misbehaving(pfrom->GetId(), 100);
+                return error("Peer %d sent us invalid compact block/non-matching block transactions", pfrom->id);
+            } else if (status == READ_STATUS_FAILED) {
+                // Might have collided, fall back to getdata now
+                pfrom->PushMessage("getdata", std::vector<CInv>(1, CInv(MSG_BLOCK, resp.blockhash)));
+                return true;
+            }
+
+            // The cmpctblock indexed the header already, only the data tells if the block came meanwhile
+            fBlockReconstructed = !HaveBlockData(resp.blockhash);
+        }
+
+        if (fBlockReconstructed)
+            ProcessCompactBlock(pfrom, block, strCommand);
+    }
+
     // This asymmetric behavior for inbound and outbound connections was introduced
     // to prevent a fingerprinting attack: an attacker can send specific fake addresses
     // to users' AddrMan and later request them by sending getaddr messages.
@@ -7006,12 +7586,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         }
     } else {
         //probably one the extensions
-        mnodeman.ProcessMessage(pfrom, strCommand, vRecv);
-        budget.ProcessMessage(pfrom, strCommand, vRecv);
-        masternodePayments.ProcessMessageMasternodePayments(pfrom, strCommand, vRecv);
-        ProcessMessageSwiftTX(pfrom, strCommand, vRecv);
-        sporkManager.ProcessSpork(pfrom, strCommand, vRecv);
-        masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
+        ProcessMasternodeMessage(pfrom, strCommand, vRecv);
     }
 
 
@@ -7035,6 +7610,149 @@ int ActiveProtocol()
     return MIN_PEER_PROTO_VERSION_BEFORE_ENFORCEMENT;
 }
 
+static void RecordLaneMessage(CMessageLaneStats& stats, int64_t nTimeReceived)
+{
+    int64_t nLatency = GetTimeMicros() - nTimeReceived;
+    LOCK(cs_messageLaneStats);
+    stats.nProcessed++;
+    stats.nTotalLatency += nLatency;
+    stats.nMaxLatency = std::max(stats.nMaxLatency, nLatency);
+}
+
+static void UpdateGeneralLaneDepth(NodeId nodeid, size_t nPending)
+{
+    LOCK(cs_messageLaneStats);
+    size_t& nPendingPrev = mapGeneralLanePending[nodeid];
+    statsGeneralLane.nQueueDepth += nPending;
+    statsGeneralLane.nQueueDepth -= nPendingPrev;
+    statsGeneralLane.nPeakQueueDepth = std::max(statsGeneralLane.nPeakQueueDepth, statsGeneralLane.nQueueDepth);
+    nPendingPrev = nPending;
+}
+
+void GetMessageLaneStats(std::vector<CMessageLaneStats>& vStats)
+{
+    LOCK(cs_messageLaneStats);
+    vStats.clear();
+    vStats.push_back(statsGeneralLane);
+    vStats.back().strName = "general";
+    vStats.push_back(statsMasternodeLane);
+    vStats.back().strName = "masternode";
+}
+
+bool QueueMasternodeMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(csMasternodeLane);
+        size_t& nQueued = mapMasternodeLaneQueued[pfrom->GetId()];
+        if (nQueued >= MAX_MNMSG_QUEUED_PER_PEER)
+            return false;
+        nQueued++;
+        {
+            LOCK(cs_vNodes);
+            pfrom->AddRef();
+        }
+        queueMasternodeLane.emplace_back(pfrom, strCommand, std::move(vRecv), nTimeReceived);
+    }
+    condMasternodeLane.notify_one();
+
+    LOCK(cs_messageLaneStats);
+    statsMasternodeLane.nQueueDepth++;
+    statsMasternodeLane.nPeakQueueDepth = std::max(statsMasternodeLane.nPeakQueueDepth, statsMasternodeLane.nQueueDepth);
+    return true;
+}
+
+void FinishMasternodeMessage(const CMasternodeLaneMessage& msg)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(csMasternodeLane);
+        setMasternodeLaneBusy.erase(msg.pfrom->GetId());
+    }
+    // Messages of this peer that waited behind this one can be picked up now
+    condMasternodeLane.notify_all();
+    RecordLaneMessage(statsMasternodeLane, msg.nTimeReceived);
+
+    LOCK(cs_vNodes);
+    msg.pfrom->Release();
+}
+
+std::unique_ptr<CMasternodeLaneMessage> TakeMasternodeMessage(bool fWait)
+{
+    std::unique_ptr<CMasternodeLaneMessage> pmsg;
+    {
+        boost::unique_lock<boost::mutex> lock(csMasternodeLane);
+        while (!pmsg) {
+            // Take the oldest message of a peer that no other thread is processing a message of
+            for (auto it = queueMasternodeLane.begin(); it != queueMasternodeLane.end(); ++it) {
+                if (setMasternodeLaneBusy.count(it->pfrom->GetId()))
+                    continue;
+                pmsg.reset(new CMasternodeLaneMessage(std::move(*it)));
+                queueMasternodeLane.erase(it);
+                break;
+            }
+            if (!pmsg) {
+                if (!fWait)
+                    return pmsg;
+                condMasternodeLane.wait(lock);
+            }
+        }
+        NodeId nodeid = pmsg->pfrom->GetId();
+        setMasternodeLaneBusy.insert(nodeid);
+        if (--mapMasternodeLaneQueued[nodeid] == 0)
+            mapMasternodeLaneQueued.erase(nodeid);
+    }
+
+    LOCK(cs_messageLaneStats);
+    statsMasternodeLane.nQueueDepth--;
+    return pmsg;
+}
+
+void ClearMasternodeLane()
+{
+    std::deque<CMasternodeLaneMessage> queueDropped;
+    {
+        boost::unique_lock<boost::mutex> lock(csMasternodeLane);
+        queueDropped.swap(queueMasternodeLane);
+        mapMasternodeLaneQueued.clear();
+        setMasternodeLaneBusy.clear();
+    }
+    {
+        LOCK(cs_messageLaneStats);
+        statsMasternodeLane.nQueueDepth = 0;
+    }
+
+    // Give back the references the dropped messages held on their peers
+    LOCK(cs_vNodes);
+    for (CMasternodeLaneMessage& msg : queueDropped)
+        msg.pfrom->Release();
+}
+
+void ThreadMasternodeMessageHandler()
+{
+    RenameThread("btcu-mnmsghand");
+    while (true) {
+        std::unique_ptr<CMasternodeLaneMessage> pmsg = TakeMasternodeMessage(true);
+
+        CNode* pfrom = pmsg->pfrom;
+        if (!pfrom->fDisconnect) {
+            LogPrint("net", "received: %s (%u bytes) peer=%d\n", SanitizeString(pmsg->strCommand), pmsg->vRecv.size(), pfrom->id);
+            try {
+                ProcessMasternodeMessage(pfrom, pmsg->strCommand, pmsg->vRecv);
+            } catch (const std::ios_base::failure& e) {
+                pfrom->PushMessage("reject", pmsg->strCommand, REJECT_MALFORMED, std::string("error parsing message"));
+                LogPrintf("ThreadMasternodeMessageHandler(%s): Exception '%s' caught\n", SanitizeString(pmsg->strCommand), e.what());
+            } catch (const boost::thread_interrupted&) {
+                FinishMasternodeMessage(*pmsg);
+                throw;
+            } catch (const std::exception& e) {
+                PrintExceptionContinue(&e, "ThreadMasternodeMessageHandler()");
+            } catch (...) {
+                PrintExceptionContinue(NULL, "ThreadMasternodeMessageHandler()");
+            }
+        }
+        FinishMasternodeMessage(*pmsg);
+    }
+}
+
 // requires LOCK(cs_vRecvMsg)
 bool ProcessMessages(CNode* pfrom)
 {
@@ -7107,6 +7825,13 @@ bool ProcessMessages(CNode* pfrom)
             continue;
         }
 
+        // Masternode messages go to their own lane once the peer completed the version handshake
+        if (nMasternodeMessageThreads > 0 && pfrom->nVersion != 0 && IsMasternodeLaneCommand(strCommand)) {
+            if (!QueueMasternodeMessage(pfrom, strCommand, vRecv, msg.nTime))
+                LogPrint("net", "ProcessMessages(%s, %u bytes): too many masternode messages queued for peer=%d, message dropped\n", SanitizeString(strCommand), nMessageSize, pfrom->id);
+            continue;
+        }
+
         // Process message
         bool fRet = false;
         try {
@@ -7133,13 +7858,18 @@ bool ProcessMessages(CNode* pfrom)
 
         if (!fRet)
             LogPrintf("ProcessMessage(%s, %u bytes) FAILED peer=%d\n", SanitizeString(strCommand), nMessageSize, pfrom->id);
+        RecordLaneMessage(statsGeneralLane, msg.nTime);
 
         break;
     }
 
     // In case the connection got shut down, its receive buffer was wiped
-    if (!pfrom->fDisconnect)
+    if (!pfrom->fDisconnect) {
         pfrom->vRecvMsg.erase(pfrom->vRecvMsg.begin(), it);
+        // Room was made, let the socket handler receive again
+        pfrom->UpdateRecvInterest();
+    }
+    UpdateGeneralLaneDepth(pfrom->GetId(), pfrom->vRecvMsg.size());
 
     return fOk;
 }
@@ -42,6 +42,7 @@
 #include <atomic>
 #include <exception>
 #include <map>
+#include <memory>
 #include <set>
 #include <stdint.h>
 #include <string>
@@ -69,7 +70,7 @@ struct CNodeStateStats;
 /** Default for -blockmaxsize and -blockminsize, which control the range of sizes the mining code will create **/
 static const unsigned int DEFAULT_BLOCK_MAX_SIZE = 750000;
 static const unsigned int DEFAULT_BLOCK_MIN_SIZE = 0;
-/** Default for -blockprioritysize, maximum space for zero/low-fee transactions **/
+/** Transactions smaller than this, less 1000 bytes, may be relayed without a fee **/
 static const unsigned int DEFAULT_BLOCK_PRIORITY_SIZE = 50000;
 /** Default for accepting alerts from the P2P network. */
 static const bool DEFAULT_ALERTS = true;
@@ -77,6 +78,20 @@ static const bool DEFAULT_ALERTS = true;
 static const unsigned int MAX_STANDARD_TX_SIZE = 100000;
 static const unsigned int MAX_ZEROCOIN_TX_SIZE = 150000;
 
+/** Default for -limitancestorcount, max number of in-mempool ancestors */
+static const unsigned int DEFAULT_ANCESTOR_LIMIT = 25;
+/** Default for -limitancestorsize, maximum kilobytes of tx + all in-mempool ancestors */
+static const unsigned int DEFAULT_ANCESTOR_SIZE_LIMIT = 101;
+/** Default for -limitdescendantcount, max number of in-mempool descendants */
+static const unsigned int DEFAULT_DESCENDANT_LIMIT = 25;
+/** Default for -limitdescendantsize, maximum kilobytes of in-mempool descendants */
+static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
+/** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
+static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
+/** Default for -persistmempool */
+static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -blockfilterindex, keeping a script filter of every connected block for wallet rescans */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
 /** The maximum size of a blk?????.dat file (since 0.8) */
@@ -89,6 +104,12 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of masternode message threads allowed */
+static const int MAX_MNMSG_THREADS = 4;
+/** -mnmsgthreads default (number of threads processing masternode, budget, spork and swifttx messages, 0 = process them with all other messages) */
+static const int DEFAULT_MNMSG_THREADS = 1;
+/** Number of masternode lane messages queued for a single peer before its further messages wait in its receive buffer */
+static const unsigned int MAX_MNMSG_QUEUED_PER_PEER = 500;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -105,6 +126,12 @@ static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
 static const unsigned int DATABASE_WRITE_INTERVAL = 3600;
 /** Maximum length of reject messages. */
 static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
+/** Number of peers, besides whitelisted ones, asked to announce new blocks as cmpctblock. */
+static const unsigned int MAX_CMPCTBLOCK_ANNOUNCING_PEERS = 3;
+/** Blocks at most this deep are served as cmpctblock or blocktxn, deeper ones as full blocks. */
+static const int MAX_CMPCTBLOCK_DEPTH = 5;
+/** Depth up to which getblocktxn requests are answered. */
+static const int MAX_BLOCKTXN_DEPTH = 10;
 
 /** Enable bloom filter */
  static const bool DEFAULT_PEERBLOOMFILTERS = true;
@@ -145,7 +172,9 @@ extern uint256 g_best_block;
 extern std::atomic<bool> fImporting;
 extern std::atomic<bool> fReindex;
 extern int nScriptCheckThreads;
+extern int nMasternodeMessageThreads;
 extern bool fTxIndex;
+extern bool fBlockFilterIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
 extern unsigned int nCoinCacheSize;
@@ -215,6 +244,42 @@ bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto, bool fSendTrickle);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the thread processing the masternode lane messages queued by ProcessMessages */
+void ThreadMasternodeMessageHandler();
+
+/** A masternode lane message waiting for ThreadMasternodeMessageHandler. It holds a reference to its peer. */
+struct CMasternodeLaneMessage {
+    CNode* pfrom;
+    std::string strCommand;
+    CDataStream vRecv;
+    int64_t nTimeReceived;
+
+    CMasternodeLaneMessage(CNode* pfromIn, const std::string& strCommandIn, CDataStream&& vRecvIn, int64_t nTimeReceivedIn) :
+            pfrom(pfromIn), strCommand(strCommandIn), vRecv(std::move(vRecvIn)), nTimeReceived(nTimeReceivedIn) {}
+};
+/** Queue a message for the masternode lane, returns false if the peer has MAX_MNMSG_QUEUED_PER_PEER queued already */
+bool QueueMasternodeMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived);
+/**
+ * Take the oldest queued message of a peer no other lane thread is processing a message of,
+ * waiting for one if fWait. The peer stays busy until FinishMasternodeMessage.
+ */
+std::unique_ptr<CMasternodeLaneMessage> TakeMasternodeMessage(bool fWait);
+/** Mark the peer of a taken message idle again and release the reference the message held */
+void FinishMasternodeMessage(const CMasternodeLaneMessage& msg);
+/** Drop the messages still queued at shutdown, releasing their peers */
+void ClearMasternodeLane();
+
+/** Queue depth and latency of a message processing lane */
+struct CMessageLaneStats {
+    std::string strName;
+    size_t nQueueDepth = 0;      // messages received and not processed yet
+    size_t nPeakQueueDepth = 0;
+    uint64_t nProcessed = 0;
+    int64_t nTotalLatency = 0;   // microseconds from receipt to the end of processing, summed
+    int64_t nMaxLatency = 0;
+};
+/** Get the statistics of the general and the masternode message lanes */
+void GetMessageLaneStats(std::vector<CMessageLaneStats>& vStats);
 
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
@@ -247,8 +312,18 @@ void FlushStateToDisk();
 int GetSpendHeight(const CCoinsViewCache& inputs);
 ///////////
 
-/** (try to) add transaction to memory pool **/
-bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee = false, bool ignoreFees = false);
+/** (try to) add transaction to memory pool, fOverrideMempoolLimit skips -maxmempool trimming **/
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee = false, bool ignoreFees = false, bool fOverrideMempoolLimit = false);
+/** As above, the pool keeps ptx itself instead of a copy of the transaction */
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee = false, bool ignoreFees = false, bool fOverrideMempoolLimit = false);
+/** As above, with the entry time of the transaction given, as when reloading the pool */
+bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx, bool fLimitFree, bool* pfMissingInputs, int64_t nAcceptTime, bool fRejectInsaneFee = false, bool ignoreFees = false, bool fOverrideMempoolLimit = false);
+/** Expire transactions older than age seconds, then trim the pool to limit bytes */
+void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age);
+/** Load the mempool from mempool.dat through AcceptToMemoryPool, dropping expired entries */
+bool LoadMempool();
+/** Write the mempool and its prioritisations to mempool.dat */
+bool DumpMempool();
 
 bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee = false, bool isDSTX = false);
 
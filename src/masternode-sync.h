@@ -7,6 +7,8 @@
 #ifndef MASTERNODE_SYNC_H
 #define MASTERNODE_SYNC_H
 
+#include "sync.h"
+
 #include <atomic>
 
 #define MASTERNODE_SYNC_INITIAL 0
@@ -32,6 +34,9 @@ extern CMasternodeSync masternodeSync;
 class CMasternodeSync
 {
 public:
+    // Guards the seen maps and the sum and count of inventory reported by peers
+    mutable CCriticalSection cs;
+
     std::map<uint256, int> mapSeenSyncMNB;
     std::map<uint256, int> mapSeenSyncMNW;
     std::map<uint256, int> mapSeenSyncBudget;
@@ -16,6 +16,8 @@
 std::map<uint256, int> mapSeenMasternodeScanningErrors;
 // cache block hashes as we calculate them
 std::map<int64_t, uint256> mapCacheBlockHashes;
+// spent state of the masternode collaterals
+CMasternodeCollateralWatch mnCollateralWatch;
 
 //Get the last hash that matches the modulus given. Processed in reverse order
 bool GetBlockHash(uint256& hash, int nBlockHeight)
@@ -151,6 +153,7 @@ bool CMasternode::UpdateFromNewBroadcast(CMasternodeBroadcast& mnb)
         int nDoS = 0;
         if (mnb.lastPing == CMasternodePing() || (mnb.lastPing != CMasternodePing() && mnb.lastPing.CheckAndUpdate(nDoS, false))) {
             lastPing = mnb.lastPing;
+            LOCK(mnodeman.cs);
             mnodeman.mapSeenMasternodePing.insert(std::make_pair(lastPing.GetHash(), lastPing));
         }
         return true;
@@ -221,20 +224,12 @@ void CMasternode::Check(bool forceCheck)
     }
 
     if (!unitTest) {
-        CValidationState state;
-        CMutableTransaction tx = CMutableTransaction();
-        CTxOut vout = CTxOut((MN_DEPOSIT_SIZE-0.01) * COIN, obfuScationPool.collateralPubKey);
-        tx.vin.push_back(vin);
-        tx.vout.push_back(vout);
+        bool fSpent = false;
+        if (!mnCollateralWatch.IsSpent(vin.prevout, fSpent)) return;
 
-        {
-            TRY_LOCK(cs_main, lockMain);
-            if (!lockMain) return;
-
-            if (!AcceptableInputs(mempool, state, CTransaction(tx), false, NULL)) {
-                activeState = MASTERNODE_VIN_SPENT;
-                return;
-            }
+        if (fSpent) {
+            activeState = MASTERNODE_VIN_SPENT;
+            return;
         }
     }
 
@@ -668,8 +663,14 @@ bool CMasternodeBroadcast::CheckInputsAndAdd(int& nDoS)
         TRY_LOCK(cs_main, lockMain);
         if (!lockMain) {
             // not mnb fault, let it to be checked again later
-            mnodeman.mapSeenMasternodeBroadcast.erase(GetHash());
-            masternodeSync.mapSeenSyncMNB.erase(GetHash());
+            {
+                LOCK(mnodeman.cs);
+                mnodeman.mapSeenMasternodeBroadcast.erase(GetHash());
+            }
+            {
+                LOCK(masternodeSync.cs);
+                masternodeSync.mapSeenSyncMNB.erase(GetHash());
+            }
             return false;
         }
 
@@ -685,8 +686,14 @@ bool CMasternodeBroadcast::CheckInputsAndAdd(int& nDoS)
     if (GetInputAge(vin) < MASTERNODE_MIN_CONFIRMATIONS) {
         LogPrint("masternode","mnb - Input must have at least %d confirmations\n", MASTERNODE_MIN_CONFIRMATIONS);
         // maybe we miss few blocks, let this mnb to be checked again later
-        mnodeman.mapSeenMasternodeBroadcast.erase(GetHash());
-        masternodeSync.mapSeenSyncMNB.erase(GetHash());
+        {
+            LOCK(mnodeman.cs);
+            mnodeman.mapSeenMasternodeBroadcast.erase(GetHash());
+        }
+        {
+            LOCK(masternodeSync.cs);
+            masternodeSync.mapSeenSyncMNB.erase(GetHash());
+        }
         return false;
     }
 
@@ -834,8 +841,11 @@ bool CMasternodePing::CheckAndUpdate(int& nDos, bool fRequireEnabled, bool fChec
             //mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
             CMasternodeBroadcast mnb(*pmn);
             uint256 hash = mnb.GetHash();
-            if (mnodeman.mapSeenMasternodeBroadcast.count(hash)) {
-                mnodeman.mapSeenMasternodeBroadcast[hash].lastPing = *this;
+            {
+                LOCK(mnodeman.cs);
+                std::map<uint256, CMasternodeBroadcast>::iterator it = mnodeman.mapSeenMasternodeBroadcast.find(hash);
+                if (it != mnodeman.mapSeenMasternodeBroadcast.end())
+                    it->second.lastPing = *this;
             }
 
             pmn->Check(true);
@@ -860,3 +870,58 @@ void CMasternodePing::Relay()
     CInv inv(MSG_MASTERNODE_PING, GetHash());
     RelayInv(inv);
 }
+
+bool CMasternodeCollateralWatch::IsSpent(const COutPoint& collateral, bool& fSpent)
+{
+    {
+        LOCK(cs);
+        std::map<COutPoint, bool>::const_iterator it = mapCollateral.find(collateral);
+        if (it != mapCollateral.end()) {
+            fSpent = it->second;
+            return true;
+        }
+    }
+
+    // Spends notified from now on are seen by SyncTransaction, which runs under cs_main as well
+    TRY_LOCK(cs_main, lockMain);
+    if (!lockMain) return false;
+
+    const CCoins* coins = pcoinsTip->AccessCoins(collateral.hash);
+    fSpent = !coins || !coins->IsAvailable(collateral.n);
+    if (!fSpent) {
+        LOCK(mempool.cs);
+        fSpent = mempool.mapNextTx.count(collateral) != 0;
+    }
+
+    LOCK(cs);
+    mapCollateral[collateral] = fSpent;
+    return true;
+}
+
+void CMasternodeCollateralWatch::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
+{
+    if (tx.IsCoinBase()) return;
+
+    LOCK(cs);
+    if (mapCollateral.empty()) return;
+
+    for (const CTxIn& txin : tx.vin) {
+        std::map<COutPoint, bool>::iterator it = mapCollateral.find(txin.prevout);
+        if (it != mapCollateral.end() && !it->second) {
+            LogPrint("masternode", "CMasternodeCollateralWatch: collateral %s spent by %s\n", txin.prevout.ToString(), tx.GetHash().ToString());
+            it->second = true;
+        }
+    }
+}
+
+void CMasternodeCollateralWatch::Unwatch(const COutPoint& collateral)
+{
+    LOCK(cs);
+    mapCollateral.erase(collateral);
+}
+
+void CMasternodeCollateralWatch::Clear()
+{
+    LOCK(cs);
+    mapCollateral.clear();
+}
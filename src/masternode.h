@@ -15,6 +15,7 @@
 #include "sync.h"
 #include "timedata.h"
 #include "util.h"
+#include "validationinterface.h"
 
 #define MASTERNODE_MIN_CONFIRMATIONS 30
 #define MASTERNODE_MIN_MNP_SECONDS (10 * 60)
@@ -28,7 +29,9 @@
 class CMasternode;
 class CMasternodeBroadcast;
 class CMasternodePing;
+class CMasternodeCollateralWatch;
 extern std::map<int64_t, uint256> mapCacheBlockHashes;
+extern CMasternodeCollateralWatch mnCollateralWatch;
 
 bool GetBlockHash(uint256& hash, int nBlockHeight);
 
@@ -353,4 +356,25 @@ public:
     static bool CheckDefaultPort(std::string strService, std::string& strErrorRet, std::string strContext);
 };
 
+//
+// Collateral outpoints of the known masternodes. Each one is looked up in the chainstate and the mempool
+// when first asked for, afterwards the transactions of connected blocks and of the mempool mark it spent.
+//
+class CMasternodeCollateralWatch : public CValidationInterface
+{
+private:
+    mutable CCriticalSection cs;
+    // watched outpoints, true once spent
+    std::map<COutPoint, bool> mapCollateral;
+
+protected:
+    void SyncTransaction(const CTransaction& tx, const CBlock* pblock) override;
+
+public:
+    /// Set fSpent for the collateral, false if it still has to be looked up and cs_main is busy
+    bool IsSpent(const COutPoint& collateral, bool& fSpent);
+    void Unwatch(const COutPoint& collateral);
+    void Clear();
+};
+
 #endif
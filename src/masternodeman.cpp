@@ -27,19 +27,11 @@ struct CompareLastPaid {
     }
 };
 
-struct CompareScoreTxIn {
-    bool operator()(const std::pair<int64_t, CTxIn>& t1,
-        const std::pair<int64_t, CTxIn>& t2) const
+struct CompareScoreIndex {
+    bool operator()(const std::pair<int64_t, size_t>& t1,
+        const std::pair<int64_t, size_t>& t2) const
     {
-        return t1.first < t2.first;
-    }
-};
-
-struct CompareScoreMN {
-    bool operator()(const std::pair<int64_t, CMasternode>& t1,
-        const std::pair<int64_t, CMasternode>& t2) const
-    {
-        return t1.first < t2.first;
+        return t1.first > t2.first;
     }
 };
 
@@ -210,6 +202,7 @@ bool CMasternodeMan::Add(CMasternode& mn)
     if (pmn == NULL) {
         LogPrint("masternode", "CMasternodeMan: Adding new Masternode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
         vMasternodes.push_back(mn);
+        mapScoreTables.clear();
         return true;
     }
 
@@ -262,7 +255,10 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
             std::map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
             while (it3 != mapSeenMasternodeBroadcast.end()) {
                 if ((*it3).second.vin == (*it).vin) {
-                    masternodeSync.mapSeenSyncMNB.erase((*it3).first);
+                    {
+                        LOCK(masternodeSync.cs);
+                        masternodeSync.mapSeenSyncMNB.erase((*it3).first);
+                    }
                     mapSeenMasternodeBroadcast.erase(it3++);
                 } else {
                     ++it3;
@@ -279,7 +275,9 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
                 }
             }
 
+            mnCollateralWatch.Unwatch((*it).vin.prevout);
             it = vMasternodes.erase(it);
+            mapScoreTables.clear();
         } else {
             ++it;
         }
@@ -319,8 +317,11 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
     std::map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
     while (it3 != mapSeenMasternodeBroadcast.end()) {
         if ((*it3).second.lastPing.sigTime < GetTime() - (MASTERNODE_REMOVAL_SECONDS * 2)) {
+            {
+                LOCK(masternodeSync.cs);
+                masternodeSync.mapSeenSyncMNB.erase((*it3).second.GetHash());
+            }
             mapSeenMasternodeBroadcast.erase(it3++);
-            masternodeSync.mapSeenSyncMNB.erase((*it3).second.GetHash());
         } else {
             ++it3;
         }
@@ -341,6 +342,8 @@ void CMasternodeMan::Clear()
 {
     LOCK(cs);
     vMasternodes.clear();
+    mapScoreTables.clear();
+    mnCollateralWatch.Clear();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -568,48 +571,82 @@ CMasternode* CMasternodeMan::FindRandomNotInVec(std::vector<CTxIn>& vecToExclude
     return NULL;
 }
 
+const CMasternodeMan::CScoreTable* CMasternodeMan::GetScoreTable(int64_t nBlockHeight)
+{
+    AssertLockHeld(cs);
+
+    //make sure we know about this block
+    uint256 hash = 0;
+    if (!GetBlockHash(hash, nBlockHeight)) return NULL;
+
+    std::map<int64_t, CScoreTable>::iterator it = mapScoreTables.find(nBlockHeight);
+    if (it != mapScoreTables.end() && it->second.hashBlock == hash)
+        return &it->second;
+
+    if (it == mapScoreTables.end()) {
+        if (mapScoreTables.size() >= MASTERNODES_SCORE_TABLES)
+            mapScoreTables.erase(mapScoreTables.begin());
+        it = mapScoreTables.insert(std::make_pair(nBlockHeight, CScoreTable())).first;
+    }
+
+    // the score only depends on the collateral and the block, so it is computed once per height
+    CScoreTable& table = it->second;
+    table.hashBlock = hash;
+    table.vScores.clear();
+    table.vScores.reserve(vMasternodes.size());
+    for (size_t i = 0; i < vMasternodes.size(); i++) {
+        uint256 n = vMasternodes[i].CalculateScore(1, nBlockHeight);
+        table.vScores.push_back(std::make_pair(n.GetCompact(false), i));
+    }
+
+    // highest score first, equal scores keep the list order
+    std::stable_sort(table.vScores.begin(), table.vScores.end(), CompareScoreIndex());
+
+    return &table;
+}
+
 CMasternode* CMasternodeMan::GetCurrentMasterNode(int mod, int64_t nBlockHeight, int minProtocol)
 {
-    int64_t score = 0;
-    CMasternode* winner = NULL;
+    LOCK(cs);
 
-    // scan for winner
-    for (CMasternode& mn : vMasternodes) {
+    const CScoreTable* pTable = GetScoreTable(nBlockHeight);
+    if (pTable == NULL) return NULL;
+
+    // the winner is the enabled Masternode with the highest score
+    for (const PAIRTYPE(int64_t, size_t) & s : pTable->vScores) {
+        if (s.first <= 0) break;
+
+        CMasternode& mn = vMasternodes[s.second];
         mn.Check();
         if (mn.protocolVersion < minProtocol || !mn.IsEnabled()) continue;
 
-        // calculate the score for each Masternode
-        uint256 n = mn.CalculateScore(mod, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
-
-        // determine the winner
-        if (n2 > score) {
-            score = n2;
-            winner = &mn;
-        }
+        return &mn;
     }
 
-    return winner;
+    return NULL;
 }
 
 int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CTxIn> > vecMasternodeScores;
     int64_t nMasternode_Min_Age = MN_WINNER_MINIMUM_AGE;
     int64_t nMasternode_Age = 0;
 
-    //make sure we know about this block
-    uint256 hash = 0;
-    if (!GetBlockHash(hash, nBlockHeight)) return -1;
+    LOCK(cs);
 
-    // scan for winner
-    for (CMasternode& mn : vMasternodes) {
+    const CScoreTable* pTable = GetScoreTable(nBlockHeight);
+    if (pTable == NULL) return -1;
+
+    const bool fCheckAge = sporkManager.IsSporkActive(SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT);
+
+    int rank = 0;
+    for (const PAIRTYPE(int64_t, size_t) & s : pTable->vScores) {
+        CMasternode& mn = vMasternodes[s.second];
         if (mn.protocolVersion < minProtocol) {
             LogPrint("masternode","Skipping Masternode with obsolete version %d\n", mn.protocolVersion);
             continue;                                                       // Skip obsolete versions
         }
 
-        if (sporkManager.IsSporkActive(SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT)) {
+        if (fCheckAge) {
             nMasternode_Age = GetAdjustedTime() - mn.sigTime;
             if ((nMasternode_Age) < nMasternode_Min_Age) {
                 if (fDebug) LogPrint("masternode","Skipping just activated Masternode. Age: %ld\n", nMasternode_Age);
@@ -620,18 +657,9 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
             mn.Check();
             if (!mn.IsEnabled()) continue;
         }
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(n2, mn.vin));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
 
-    int rank = 0;
-    for (PAIRTYPE(int64_t, CTxIn) & s : vecMasternodeScores) {
         rank++;
-        if (s.second.prevout == vin.prevout) {
+        if (mn.vin.prevout == vin.prevout) {
             return rank;
         }
     }
@@ -641,66 +669,54 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
 
 std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t nBlockHeight, int minProtocol)
 {
-    std::vector<std::pair<int64_t, CMasternode> > vecMasternodeScores;
     std::vector<std::pair<int, CMasternode> > vecMasternodeRanks;
+    std::vector<size_t> vDisabled;
 
-    //make sure we know about this block
-    uint256 hash = 0;
-    if (!GetBlockHash(hash, nBlockHeight)) return vecMasternodeRanks;
+    LOCK(cs);
 
-    // scan for winner
-    for (CMasternode& mn : vMasternodes) {
+    const CScoreTable* pTable = GetScoreTable(nBlockHeight);
+    if (pTable == NULL) return vecMasternodeRanks;
+
+    for (const PAIRTYPE(int64_t, size_t) & s : pTable->vScores) {
+        CMasternode& mn = vMasternodes[s.second];
         mn.Check();
 
         if (mn.protocolVersion < minProtocol) continue;
 
+        // disabled Masternodes are ranked last
         if (!mn.IsEnabled()) {
-            vecMasternodeScores.push_back(std::make_pair(9999, mn));
+            vDisabled.push_back(s.second);
             continue;
         }
 
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(n2, mn));
+        vecMasternodeRanks.push_back(std::make_pair(vecMasternodeRanks.size() + 1, mn));
     }
 
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
-
-    int rank = 0;
-    for (PAIRTYPE(int64_t, CMasternode) & s : vecMasternodeScores) {
-        rank++;
-        vecMasternodeRanks.push_back(std::make_pair(rank, s.second));
-    }
+    for (size_t i : vDisabled)
+        vecMasternodeRanks.push_back(std::make_pair(vecMasternodeRanks.size() + 1, vMasternodes[i]));
 
     return vecMasternodeRanks;
 }
 
 CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CTxIn> > vecMasternodeScores;
+    LOCK(cs);
 
-    // scan for winner
-    for (CMasternode& mn : vMasternodes) {
+    const CScoreTable* pTable = GetScoreTable(nBlockHeight);
+    if (pTable == NULL) return NULL;
+
+    int rank = 0;
+    for (const PAIRTYPE(int64_t, size_t) & s : pTable->vScores) {
+        CMasternode& mn = vMasternodes[s.second];
         if (mn.protocolVersion < minProtocol) continue;
         if (fOnlyActive) {
             mn.Check();
             if (!mn.IsEnabled()) continue;
         }
 
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(n2, mn.vin));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
-
-    int rank = 0;
-    for (PAIRTYPE(int64_t, CTxIn) & s : vecMasternodeScores) {
         rank++;
         if (rank == nRank) {
-            return Find(s.second);
+            return &mn;
         }
     }
 
@@ -734,11 +750,15 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         CMasternodeBroadcast mnb;
         vRecv >> mnb;
 
-        if (mapSeenMasternodeBroadcast.count(mnb.GetHash())) { //seen
+        bool fNew;
+        {
+            LOCK(cs);
+            fNew = mapSeenMasternodeBroadcast.insert(std::make_pair(mnb.GetHash(), mnb)).second;
+        }
+        if (!fNew) { //seen
             masternodeSync.AddedMasternodeList(mnb.GetHash());
             return;
         }
-        mapSeenMasternodeBroadcast.insert(std::make_pair(mnb.GetHash(), mnb));
 
         int nDoS = 0;
         if (!mnb.CheckAndUpdate(nDoS)) {
@@ -777,8 +797,10 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
         LogPrint("masternode", "mnp - Masternode ping, vin: %s\n", mnp.vin.prevout.hash.ToString());
 
-        if (mapSeenMasternodePing.count(mnp.GetHash())) return; //seen
-        mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
+        {
+            LOCK(cs);
+            if (!mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp)).second) return; //seen
+        }
 
         int nDoS = 0;
         if (mnp.CheckAndUpdate(nDoS)) return;
@@ -835,7 +857,10 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
                     pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
                     nInvCount++;
 
-                    if (!mapSeenMasternodeBroadcast.count(hash)) mapSeenMasternodeBroadcast.insert(std::make_pair(hash, mnb));
+                    {
+                        LOCK(cs);
+                        mapSeenMasternodeBroadcast.insert(std::make_pair(hash, mnb));
+                    }
 
                     if (vin == mn.vin) {
                         LogPrint("masternode", "dseg - Sent 1 Masternode entry to peer %i\n", pfrom->GetId());
@@ -1140,7 +1165,9 @@ void CMasternodeMan::Remove(CTxIn vin)
     while (it != vMasternodes.end()) {
         if ((*it).vin == vin) {
             LogPrint("masternode", "CMasternodeMan: Removing Masternode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
+            mnCollateralWatch.Unwatch((*it).vin.prevout);
             vMasternodes.erase(it);
+            mapScoreTables.clear();
             break;
         }
         ++it;
@@ -1149,8 +1176,11 @@ void CMasternodeMan::Remove(CTxIn vin)
 
 void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
 {
-    mapSeenMasternodePing.insert(std::make_pair(mnb.lastPing.GetHash(), mnb.lastPing));
-    mapSeenMasternodeBroadcast.insert(std::make_pair(mnb.GetHash(), mnb));
+    {
+        LOCK(cs);
+        mapSeenMasternodePing.insert(std::make_pair(mnb.lastPing.GetHash(), mnb.lastPing));
+        mapSeenMasternodeBroadcast.insert(std::make_pair(mnb.GetHash(), mnb));
+    }
     masternodeSync.AddedMasternodeList(mnb.GetHash());
 
     LogPrint("masternode","CMasternodeMan::UpdateMasternodeList() -- masternode=%s\n", mnb.vin.prevout.ToString());
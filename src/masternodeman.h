@@ -17,6 +17,7 @@
 
 #define MASTERNODES_DUMP_SECONDS (15 * 60)
 #define MASTERNODES_DSEG_SECONDS (3 * 60 * 60)
+#define MASTERNODES_SCORE_TABLES 32
 
 
 class CMasternodeMan;
@@ -51,9 +52,6 @@ public:
 class CMasternodeMan
 {
 private:
-    // critical section to protect the inner data structures
-    mutable CCriticalSection cs;
-
     // critical section to protect the inner data structures specifically on messaging
     mutable CCriticalSection cs_process_message;
 
@@ -66,7 +64,21 @@ private:
     // which Masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
 
+    // Masternodes sorted by score for the block at a height, as indexes into vMasternodes
+    struct CScoreTable {
+        uint256 hashBlock;
+        std::vector<std::pair<int64_t, size_t> > vScores;
+    };
+    // score tables of the last queried heights, cleared whenever vMasternodes changes
+    std::map<int64_t, CScoreTable> mapScoreTables;
+
+    /// Get the score table for a height, computing it on first use
+    const CScoreTable* GetScoreTable(int64_t nBlockHeight);
+
 public:
+    // critical section to protect the inner data structures, the seen maps included
+    mutable CCriticalSection cs;
+
     // Keep track of all broadcasts I've seen
     std::map<uint256, CMasternodeBroadcast> mapSeenMasternodeBroadcast;
     // Keep track of all pings I've seen
@@ -82,6 +94,8 @@ public:
     {
         LOCK(cs);
         READWRITE(vMasternodes);
+        if (ser_action.ForRead())
+            mapScoreTables.clear();
         READWRITE(mAskedUsForMasternodeList);
         READWRITE(mWeAskedForMasternodeList);
         READWRITE(mWeAskedForMasternodeListEntry);
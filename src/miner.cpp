@@ -41,7 +41,6 @@
 
 
 #include <boost/thread.hpp>
-#include <boost/tuple/tuple.hpp>
 
 ///////////////////////////////////////////// // qtum
 uint64_t minGasPrice = 1;
@@ -55,53 +54,20 @@ uint64_t txGasLimit;
 // BTCUMiner
 //
 
-//
-// Unconfirmed transactions in the memory pool often depend on other
-// transactions in the memory pool. When we select transactions from the
-// pool, we select by highest priority or fee rate, so we might consider
-// transactions that depend on transactions that aren't yet in the block.
-// The COrphan class keeps track of these 'temporary orphans' while
-// CreateBlock is figuring out which transactions to include.
-//
-class COrphan
-{
-public:
-    const CTransaction* ptx;
-    std::set<uint256> setDependsOn;
-    CFeeRate feeRate;
-    double dPriority;
-
-    COrphan(const CTransaction* ptxIn) : ptx(ptxIn), feeRate(0), dPriority(0)
+// Orders a package so every transaction comes after its in-pool ancestors,
+// which have strictly fewer ancestors themselves
+struct CompareTxIterByAncestorCount {
+    bool operator()(const CTxMemPool::txiter& a, const CTxMemPool::txiter& b) const
     {
+        if (a->GetCountWithAncestors() != b->GetCountWithAncestors())
+            return a->GetCountWithAncestors() < b->GetCountWithAncestors();
+        return CTxMemPool::CompareIteratorByHash()(a, b);
     }
 };
 
 uint64_t nLastBlockTx = 0;
 uint64_t nLastBlockSize = 0;
 
-// We want to sort transactions by priority and fee rate, so:
-typedef boost::tuple<double, CFeeRate, const CTransaction*> TxPriority;
-class TxPriorityCompare
-{
-    bool byFee;
-
-public:
-    TxPriorityCompare(bool _byFee) : byFee(_byFee) {}
-
-    bool operator()(const TxPriority& a, const TxPriority& b)
-    {
-        if (byFee) {
-            if (a.get<1>() == b.get<1>())
-                return a.get<0>() < b.get<0>();
-            return a.get<1>() < b.get<1>();
-        } else {
-            if (a.get<0>() == b.get<0>())
-                return a.get<1>() < b.get<1>();
-            return a.get<0>() < b.get<0>();
-        }
-    }
-};
-
 void UpdateTime(CBlockHeader* pblock, const CBlockIndex* pindexPrev)
 {
     pblock->nTime = std::max(pindexPrev->GetMedianTimePast() + 1, GetAdjustedTime());
@@ -128,14 +94,16 @@ void RebuildRefundTransaction(CBlock* pblock, ByteCodeExecResult &bceResult){
       refundtx=1; //1 for coinstake in PoS
    }
 
-   pblock->vtx[refundtx].vout[pblock->vtx[refundtx].vout.size() -1].nValue -= bceResult.refundSender;
+   CMutableTransaction refundTx(*pblock->vtx[refundtx]);
+   refundTx.vout[refundTx.vout.size() -1].nValue -= bceResult.refundSender;
    //note, this will need changed for MPoS
    for(CTxOut& vout : bceResult.refundOutputs){
-      pblock->vtx[refundtx].vout.push_back(vout);
+      refundTx.vout.push_back(vout);
    }
+   pblock->vtx[refundtx] = MakeTransactionRef(refundTx);
 }
 
-bool AttemptToAddContractToBlock(CTxMemPoolEntry& me, CTransaction& tx, CBlock* pblock, uint64_t minGasPrice, std::vector<CTxOut> &refund_outs) {
+bool AttemptToAddContractToBlock(const CContractSpeculationRef& speculation, const CTransaction& tx, CBlock* pblock, uint64_t minGasPrice, uint64_t& nBlockGasUsed, std::vector<CTxOut> &refund_outs) {
     //if (nTimeLimit != 0 && GetAdjustedTime() >= nTimeLimit - BYTECODE_TIME_BUFFER) {
     //    return false;
     //}
@@ -153,13 +121,7 @@ bool AttemptToAddContractToBlock(CTxMemPoolEntry& me, CTransaction& tx, CBlock*
     unsigned int contractflags = SCRIPT_EXEC_BYTE_CODE;//= GetContractScriptFlags(nHeight, chainparams.GetConsensus());
     contractflags |= SCRIPT_OUTPUT_SENDER;
 
-    std::vector<CTransactionRef> blockTransactions;
-    for (auto t: pblock->vtx)
-    {
-        blockTransactions.push_back(std::make_shared<const CTransaction>(t));
-    }
-    //TODO: Add convertation from pblock transactions
-    QtumTxConverter convert(tx, NULL, &blockTransactions, contractflags);
+    QtumTxConverter convert(tx, NULL, &pblock->vtx, contractflags);
 
     ExtractQtumTX resultConverter;
     if(!convert.extractionQtumTransactions(resultConverter)){
@@ -177,7 +139,7 @@ bool AttemptToAddContractToBlock(CTxMemPoolEntry& me, CTransaction& tx, CBlock*
             return false;
         }
 
-        if(bceResult.usedGas + qtumTransaction.gas() > softBlockGasLimit){
+        if(nBlockGasUsed + qtumTransaction.gas() > softBlockGasLimit){
             //if this transaction's gasLimit could cause block gas limit to be exceeded, then don't add it
             return false;
         }
@@ -186,9 +148,21 @@ bool AttemptToAddContractToBlock(CTxMemPoolEntry& me, CTransaction& tx, CBlock*
             return false;
         }
     }
+    // The mempool already ran this transaction on the tip's state. As long as no contract selected
+    // before it has changed that state, a failed run or one that overflows the block gas is dropped
+    // without executing it again; anything else is executed for real below.
+    CBlockIndex* pindexTip = chainActive.Tip();
+    if(speculation && speculation->hashTip == pindexTip->GetBlockHash() &&
+       oldHashStateRoot == uintToh256(pindexTip->hashStateRoot) &&
+       oldHashUTXORoot == uintToh256(pindexTip->hashUTXORoot)){
+        if(!speculation->fSuccess || nBlockGasUsed + speculation->nUsedGas > softBlockGasLimit){
+            LogPrint("staking", "%s : skipping contract tx %s, speculative run %s\n", __func__, tx.GetHash().ToString(),
+                     speculation->fSuccess ? "exceeds the block gas limit" : "failed");
+            return false;
+        }
+    }
     // We need to pass the DGP's block gas limit (not the soft limit) since it is consensus critical.
-    CBlockIndex* bi = mapBlockIndex[chainActive.Tip()->GetBlockHash()];
-    ByteCodeExec exec(*pblock, qtumTransactions, hardBlockGasLimit, chainActive.Tip());
+    ByteCodeExec exec(*pblock, qtumTransactions, hardBlockGasLimit, pindexTip);
     if(!exec.performByteCode()){
         //error, don't add contract
         globalState->setRoot(oldHashStateRoot);
@@ -203,7 +177,7 @@ bool AttemptToAddContractToBlock(CTxMemPoolEntry& me, CTransaction& tx, CBlock*
         return false;
     }
 
-    if(bceResult.usedGas + testExecResult.usedGas > softBlockGasLimit){
+    if(nBlockGasUsed + testExecResult.usedGas > softBlockGasLimit){
         //if this transaction could cause block gas limit to be exceeded, then don't add it
         globalState->setRoot(oldHashStateRoot);
         globalState->setRootUTXO(oldHashUTXORoot);
@@ -225,10 +199,10 @@ bool AttemptToAddContractToBlock(CTxMemPoolEntry& me, CTransaction& tx, CBlock*
     //calculate sigops from new refund/proof tx
 
     //first, subtract old proof tx
-    nBlockSigOpsCost -= GetLegacySigOpCount(pblock->vtx[proofTx]);
+    nBlockSigOpsCost -= GetLegacySigOpCount(*pblock->vtx[proofTx]);
 
     // manually rebuild refundtx
-    CMutableTransaction contrTx(pblock->vtx[proofTx]);
+    CMutableTransaction contrTx(*pblock->vtx[proofTx]);
     //note, this will need changed for MPoS
     int i=contrTx.vout.size();
     contrTx.vout.resize(contrTx.vout.size()+testExecResult.refundOutputs.size());
@@ -252,13 +226,14 @@ bool AttemptToAddContractToBlock(CTxMemPoolEntry& me, CTransaction& tx, CBlock*
     //block is not too big, so apply the contract execution and it's results to the actual block
 
     //apply local bytecode to global bytecode state
+    nBlockGasUsed += testExecResult.usedGas;
     bceResult.usedGas += testExecResult.usedGas;
     bceResult.refundSender += testExecResult.refundSender;
     bceResult.refundOutputs.insert(bceResult.refundOutputs.end(), testExecResult.refundOutputs.begin(), testExecResult.refundOutputs.end());
     bceResult.valueTransfers = std::move(testExecResult.valueTransfers);
 
     for (CTransaction &t : bceResult.valueTransfers)
-        pblock->vtx.push_back(t);
+        pblock->vtx.push_back(MakeTransactionRef(t));
 
     //calculate sigops from new refund/proof tx
     //this->nBlockSigOpsCost -= GetLegacySigOpCount(*pblock->vtx[proofTx]);
@@ -270,6 +245,78 @@ bool AttemptToAddContractToBlock(CTxMemPoolEntry& me, CTransaction& tx, CBlock*
     return true;
 }
 
+#ifdef ENABLE_WALLET
+/** Execute a contract transaction on its own against the state of pindexTip, as template assembly would */
+static CContractSpeculationRef SpeculateContractTransaction(const CTransaction& tx, CBlockIndex* pindexTip)
+{
+    std::shared_ptr<CContractSpeculation> speculation = std::make_shared<CContractSpeculation>();
+    speculation->hashTip = pindexTip->GetBlockHash();
+
+    QtumTxConverter convert(tx, pcoinsTip, NULL, SCRIPT_EXEC_BYTE_CODE | SCRIPT_OUTPUT_SENDER);
+    ExtractQtumTX resultConverter;
+    if(!convert.extractionQtumTransactions(resultConverter))
+        return speculation;
+
+    // stand-in for the template: no author yet and the current time as block time
+    CBlock block;
+    block.nTime = GetAdjustedTime();
+    block.nBits = pindexTip->nBits;
+    CMutableTransaction txCoinbase;
+    txCoinbase.vin.resize(1);
+    txCoinbase.vin[0].prevout.SetNull();
+    txCoinbase.vout.resize(1);
+    block.vtx.push_back(MakeTransactionRef(txCoinbase));
+
+    TemporaryState tmpState(globalState);
+    tmpState.SetRoot(uintToh256(pindexTip->hashStateRoot), uintToh256(pindexTip->hashUTXORoot));
+    try {
+        ByteCodeExec exec(block, resultConverter.first, hardBlockGasLimit, pindexTip);
+        ByteCodeExecResult result;
+        if(!exec.performByteCode(dev::eth::Permanence::Reverted) || !exec.processingResults(result))
+            return speculation;
+        speculation->fSuccess = true;
+        speculation->nUsedGas = result.usedGas;
+    } catch (const std::exception& e) {
+        LogPrint("staking", "%s : %s\n", __func__, e.what());
+    }
+    return speculation;
+}
+
+void SpeculateMempoolContracts()
+{
+    if (GetBoolArg("-disablecontractstaking", false))
+        return;
+
+    std::vector<CTransactionRef> vPending;
+    uint256 hashTip;
+    {
+        LOCK2(cs_main, mempool.cs);
+        if (!chainActive.Tip())
+            return;
+        hashTip = chainActive.Tip()->GetBlockHash();
+        for (const CTxMemPoolEntry& entry : mempool.mapTx) {
+            const CContractSpeculationRef& speculation = entry.GetContractSpeculation();
+            if (entry.GetTx().HasCreateOrCall() && (!speculation || speculation->hashTip != hashTip))
+                vPending.push_back(entry.GetSharedTx());
+            if (vPending.size() >= MAX_CONTRACT_SPECULATIONS_PER_ROUND)
+                break;
+        }
+    }
+
+    // cs_main is taken per transaction so block processing is never held up for a whole round
+    for (const CTransactionRef& tx : vPending) {
+        boost::this_thread::interruption_point();
+        LOCK(cs_main);
+        CBlockIndex* pindexTip = chainActive.Tip();
+        if (pindexTip->GetBlockHash() != hashTip)
+            return;
+        mempool.SetContractSpeculation(tx->GetHash(), SpeculateContractTransaction(*tx, pindexTip));
+    }
+    if (!vPending.empty())
+        LogPrint("staking", "%s : ran %u contract txs on tip %s\n", __func__, vPending.size(), hashTip.ToString());
+}
+#endif // ENABLE_WALLET
+
 std::pair<int, std::pair<uint256, uint256> > pCheckpointCache;
 CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet, bool fProofOfStake)
 {
@@ -300,7 +347,7 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
     txNew.vin[0].prevout.SetNull();
     txNew.vout.resize(1);
     txNew.vout[0].scriptPubKey = scriptPubKeyIn;
-    pblock->vtx.push_back(txNew);
+    pblock->vtx.push_back(MakeTransactionRef(txNew));
     pblocktemplate->vTxFees.push_back(-1);   // updated at end
     pblocktemplate->vTxSigOps.push_back(-1); // updated at end
 
@@ -315,19 +362,20 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
         }
         // Stake found
         pblock->nTime = nTxNewTime;
-        pblock->vtx[0].vout[0].SetEmpty();
-        pblock->vtx.push_back(CTransaction(txCoinStake));
+        txNew.vout[0].SetEmpty();
+        pblock->vtx[0] = MakeTransactionRef(txNew);
+        pblock->vtx.push_back(MakeTransactionRef(txCoinStake));
         staketx_index = 1;
 
         // Pay rewards for leasing
         CMutableTransaction txLeasing;
-        if (!pwallet->CreateLeasingRewards(pblock->vtx[1], *pwallet, pindexPrev, pblock->nBits, txLeasing)) {
+        if (!pwallet->CreateLeasingRewards(*pblock->vtx[1], *pwallet, pindexPrev, pblock->nBits, txLeasing)) {
             LogPrint("staking", "%s : fail to reward the leasing\n", __func__);
             return nullptr;
         }
 
         if (!txLeasing.vin.empty()) {
-            pblock->vtx.push_back(CTransaction(txLeasing));
+            pblock->vtx.push_back(MakeTransactionRef(txLeasing));
         }
     }
 
@@ -357,11 +405,6 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
     unsigned int nBlockMaxSizeNetwork = MAX_BLOCK_SIZE_CURRENT;
     nBlockMaxSize = std::max((unsigned int)1000, std::min((nBlockMaxSizeNetwork - 1000), nBlockMaxSize));
 
-    // How much of the block should be dedicated to high-priority transactions,
-    // included regardless of the fees they pay
-    unsigned int nBlockPrioritySize = GetArg("-blockprioritysize", DEFAULT_BLOCK_PRIORITY_SIZE);
-    nBlockPrioritySize = std::min(nBlockMaxSize, nBlockPrioritySize);
-
     // Minimum block size you want to create; block will be filled with free transactions
     // until there are no more or the block reaches this size:
     unsigned int nBlockMinSize = GetArg("-blockminsize", DEFAULT_BLOCK_MIN_SIZE);
@@ -373,237 +416,205 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
     {
         LOCK2(cs_main, mempool.cs);
         CCoinsViewCache view(pcoinsTip);
-
-        // Priority order to process transactions
-        std::list<COrphan> vOrphan; // list memory doesn't move
-        std::map<uint256, std::vector<COrphan*> > mapDependers;
         bool fPrintPriority = GetBoolArg("-printpriority", false);
 
-        // This vector will be sorted into a priority queue:
-        std::vector<TxPriority> vecPriority;
-        vecPriority.reserve(mempool.mapTx.size());
-        for (std::map<uint256, CTxMemPoolEntry>::iterator mi = mempool.mapTx.begin();
-             mi != mempool.mapTx.end(); ++mi) {
-            const CTransaction& tx = mi->second.GetTx();
-            if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight)){
-                continue;
-            }
-            if(sporkManager.IsSporkActive(SPORK_16_ZEROCOIN_MAINTENANCE_MODE) && tx.ContainsZerocoins()){
-                continue;
-            }
-
-            COrphan* porphan = NULL;
-            double dPriority = 0;
-            CAmount nTotalIn = 0;
-            bool fMissingInputs = false;
-            bool hasZerocoinSpends = tx.HasZerocoinSpendInputs();
-            if (hasZerocoinSpends)
-                nTotalIn = tx.GetZerocoinSpent();
-
-            for (const CTxIn& txin : tx.vin) {
-                // Read prev transaction
-                if (!view.HaveCoins(txin.prevout.hash)) {
-                    // This should never happen; all transactions in the memory
-                    // pool should connect to either transactions in the chain
-                    // or other transactions in the memory pool.
-                    if (!mempool.mapTx.count(txin.prevout.hash)) {
-                        LogPrintf("ERROR: mempool transaction missing input\n");
-                        if (fDebug) assert("mempool transaction missing input" == 0);
-                        fMissingInputs = true;
-                        if (porphan)
-                            vOrphan.pop_back();
-                        break;
-                    }
-
-                    // Has to wait for dependencies
-                    if (!porphan) {
-                        // Use list for automatic deletion
-                        vOrphan.push_back(COrphan(&tx));
-                        porphan = &vOrphan.back();
-                    }
-                    mapDependers[txin.prevout.hash].push_back(porphan);
-                    porphan->setDependsOn.insert(txin.prevout.hash);
-                    nTotalIn += mempool.mapTx[txin.prevout.hash].GetTx().vout[txin.prevout.n].nValue;
-                    continue;
-                }
-
-                //Check for invalid/fraudulent inputs. They shouldn't make it through mempool, but check anyways.
-                if (invalid_out::ContainsOutPoint(txin.prevout)) {
-                    LogPrintf("%s : found invalid input %s in tx %s", __func__, txin.prevout.ToString(), tx.GetHash().ToString());
-                    fMissingInputs = true;
-                    break;
-                }
-
-                const CCoins* coins = view.AccessCoins(txin.prevout.hash);
-                assert(coins);
-
-                CAmount nValueIn = coins->vout[txin.prevout.n].nValue;
-                nTotalIn += nValueIn;
-
-                int nConf = nHeight - coins->nHeight;
-
-                // zBTCU spends can have very large priority, use non-overflowing safe functions
-                dPriority = double_safe_addition(dPriority, ((double)nValueIn * nConf));
-
-            }
-            if (fMissingInputs) continue;
-
-            // Priority is sum(valuein * age) / modified_txsize
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            dPriority = tx.ComputePriority(dPriority, nTxSize);
-
-            uint256 hash = tx.GetHash();
-            mempool.ApplyDeltas(hash, dPriority, nTotalIn);
-
-            CFeeRate feeRate(nTotalIn - tx.GetValueOut(), nTxSize);
-
-            if (porphan) {
-                porphan->dPriority = dPriority;
-                porphan->feeRate = feeRate;
-            } else
-                vecPriority.push_back(TxPriority(dPriority, feeRate, &mi->second.GetTx()));
-        }
-
         // Collect transactions into block
         uint64_t nBlockSize = 1000;
         uint64_t nBlockTx = 0;
         int nBlockSigOps = 100;
-        bool fSortedByFee = (nBlockPrioritySize <= 0);
-
-        TxPriorityCompare comparer(fSortedByFee);
-        std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
+        const unsigned int nMaxBlockSigOps = MAX_BLOCK_SIGOPS_CURRENT;
 
         std::vector<CBigNum> vBlockSerials;
-        std::vector<CBigNum> vTxSerials;
-        while (!vecPriority.empty()) {
-            // Take highest priority transaction off the priority queue:
-            double dPriority = vecPriority.front().get<0>();
-            CFeeRate feeRate = vecPriority.front().get<1>();
-            const CTransaction& tx = *(vecPriority.front().get<2>());
-
-            std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            vecPriority.pop_back();
-
-            // Size limits
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            if (nBlockSize + nTxSize >= nBlockMaxSize)
+        CTxMemPool::setEntries inBlock;
+        CTxMemPool::setEntries failedTx;
+        const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+
+        // Walk the pool by fee rate with ancestors. Each entry goes in as a package
+        // with the ancestors that are not in the block yet, parents first.
+        CTxMemPool::indexed_transaction_set::index<ancestor_score>::type::iterator mi = mempool.mapTx.get<ancestor_score>().begin();
+        for (; mi != mempool.mapTx.get<ancestor_score>().end(); ++mi) {
+            CTxMemPool::txiter iter = mempool.mapTx.project<0>(mi);
+            if (inBlock.count(iter) || failedTx.count(iter))
                 continue;
 
-            // Legacy limits on sigOps:
-            unsigned int nMaxBlockSigOps = MAX_BLOCK_SIGOPS_CURRENT;
-            unsigned int nTxSigOps = GetLegacySigOpCount(tx);
-            if (nBlockSigOps + nTxSigOps >= nMaxBlockSigOps)
-                continue;
+            CTxMemPool::setEntries ancestors;
+            std::string dummy;
+            mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
 
-            // Skip free transactions if we're past the minimum block size:
-            const uint256& hash = tx.GetHash();
-            double dPriorityDelta = 0;
-            CAmount nFeeDelta = 0;
-            mempool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
-            if (!tx.HasZerocoinSpendInputs() && fSortedByFee && (dPriorityDelta <= 0) && (nFeeDelta <= 0) && (feeRate < ::minRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
+            std::vector<CTxMemPool::txiter> package;
+            bool fFailedAncestor = false;
+            for (CTxMemPool::txiter ancestor : ancestors) {
+                if (failedTx.count(ancestor)) {
+                    fFailedAncestor = true;
+                    break;
+                }
+                if (!inBlock.count(ancestor))
+                    package.push_back(ancestor);
+            }
+            if (fFailedAncestor) {
+                failedTx.insert(iter);
                 continue;
+            }
+            package.push_back(iter);
+            std::sort(package.begin(), package.end(), CompareTxIterByAncestorCount());
+
+            uint64_t nPackageSize = 0;
+            CAmount nPackageModFees = 0;
+            bool fHasZerocoinSpends = false;
+            for (CTxMemPool::txiter it : package) {
+                nPackageSize += it->GetTxSize();
+                nPackageModFees += it->GetModifiedFee();
+                fHasZerocoinSpends |= it->GetTx().HasZerocoinSpendInputs();
+            }
+            CFeeRate packageFeeRate(nPackageModFees, nPackageSize);
 
-            // Prioritise by fee once past the priority size or we run out of high-priority
-            // transactions:
-            if (!fSortedByFee &&
-                ((nBlockSize + nTxSize >= nBlockPrioritySize) || !AllowFree(dPriority))) {
-                fSortedByFee = true;
-                comparer = TxPriorityCompare(fSortedByFee);
-                std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
+            // Size limits, the package of any descendant is at least as large
+            if (nBlockSize + nPackageSize >= nBlockMaxSize) {
+                failedTx.insert(iter);
+                continue;
             }
 
-            if (!view.HaveInputs(tx))
+            // Skip free transactions if we're past the minimum block size:
+            if (!fHasZerocoinSpends && (packageFeeRate < ::minRelayTxFee) && (nBlockSize + nPackageSize >= nBlockMinSize))
                 continue;
 
-            // double check that there are no double spent zBTCU spends in this block or tx
-            if (tx.HasZerocoinSpendInputs()) {
-                int nHeightTx = 0;
-                if (IsTransactionInChain(tx.GetHash(), nHeightTx))
-                    continue;
-
-                bool fDoubleSerial = false;
-                for (const CTxIn& txIn : tx.vin) {
-                    bool isPublicSpend = txIn.IsZerocoinPublicSpend();
-                    if (txIn.IsZerocoinSpend() || isPublicSpend) {
-                        libzerocoin::CoinSpend* spend;
-                        if (isPublicSpend) {
-                            libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(false);
-                            PublicCoinSpend publicSpend(params);
-                            CValidationState state;
-                            if (!ZBTCUModule::ParseZerocoinPublicSpend(txIn, tx, state, publicSpend)){
-                                throw std::runtime_error("Invalid public spend parse");
-                            }
-                            spend = &publicSpend;
-                        } else {
-                            libzerocoin::CoinSpend spendObj = TxInToZerocoinSpend(txIn);
-                            spend = &spendObj;
-                        }
+            // Try the whole package on a view of its own, so a failing transaction
+            // leaves neither itself nor its ancestors in the block
+            CCoinsViewCache viewPackage(&view);
+            std::vector<CAmount> vPackageFees;
+            std::vector<int> vPackageSigOps;
+            std::vector<CBigNum> vTxSerials;
+            int nPackageSigOps = 0;
+            bool fPackageOk = true;
+            for (CTxMemPool::txiter it : package) {
+                const CTransaction& tx = it->GetTx();
+                if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight) ||
+                    (sporkManager.IsSporkActive(SPORK_16_ZEROCOIN_MAINTENANCE_MODE) && tx.ContainsZerocoins())) {
+                    fPackageOk = false;
+                    break;
+                }
+
+                // Legacy limits on sigOps:
+                unsigned int nTxSigOps = GetLegacySigOpCount(tx);
+                if (nBlockSigOps + nPackageSigOps + nTxSigOps >= nMaxBlockSigOps) {
+                    fPackageOk = false;
+                    break;
+                }
 
-                        bool fUseV1Params = spend->getCoinVersion() < libzerocoin::PrivateCoin::PUBKEY_VERSION;
-                        if (!spend->HasValidSerial(Params().Zerocoin_Params(fUseV1Params)))
-                            fDoubleSerial = true;
-                        if (std::count(vBlockSerials.begin(), vBlockSerials.end(), spend->getCoinSerialNumber()))
-                            fDoubleSerial = true;
-                        if (std::count(vTxSerials.begin(), vTxSerials.end(), spend->getCoinSerialNumber()))
-                            fDoubleSerial = true;
-                        if (fDoubleSerial)
-                            break;
-                        vTxSerials.emplace_back(spend->getCoinSerialNumber());
+                if (!viewPackage.HaveInputs(tx)) {
+                    fPackageOk = false;
+                    break;
+                }
+
+                //Check for invalid/fraudulent inputs. They shouldn't make it through mempool, but check anyways.
+                for (const CTxIn& txin : tx.vin) {
+                    if (invalid_out::ContainsOutPoint(txin.prevout)) {
+                        LogPrintf("%s : found invalid input %s in tx %s", __func__, txin.prevout.ToString(), tx.GetHash().ToString());
+                        fPackageOk = false;
+                        break;
                     }
                 }
-                //This zBTCU serial has already been included in the block, do not add this tx.
-                if (fDoubleSerial)
-                    continue;
-            }
+                if (!fPackageOk)
+                    break;
+
+                // double check that there are no double spent zBTCU spends in this block or tx
+                if (tx.HasZerocoinSpendInputs()) {
+                    int nHeightTx = 0;
+                    if (IsTransactionInChain(tx.GetHash(), nHeightTx)) {
+                        fPackageOk = false;
+                        break;
+                    }
 
-            CAmount nTxFees = view.GetValueIn(tx) - tx.GetValueOut();
+                    bool fDoubleSerial = false;
+                    for (const CTxIn& txIn : tx.vin) {
+                        bool isPublicSpend = txIn.IsZerocoinPublicSpend();
+                        if (txIn.IsZerocoinSpend() || isPublicSpend) {
+                            libzerocoin::CoinSpend* spend;
+                            if (isPublicSpend) {
+                                libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(false);
+                                PublicCoinSpend publicSpend(params);
+                                CValidationState state;
+                                if (!ZBTCUModule::ParseZerocoinPublicSpend(txIn, tx, state, publicSpend)){
+                                    throw std::runtime_error("Invalid public spend parse");
+                                }
+                                spend = &publicSpend;
+                            } else {
+                                libzerocoin::CoinSpend spendObj = TxInToZerocoinSpend(txIn);
+                                spend = &spendObj;
+                            }
 
-            nTxSigOps += GetP2SHSigOpCount(tx, view);
-            if (nBlockSigOps + nTxSigOps >= nMaxBlockSigOps)
-                continue;
+                            bool fUseV1Params = spend->getCoinVersion() < libzerocoin::PrivateCoin::PUBKEY_VERSION;
+                            if (!spend->HasValidSerial(Params().Zerocoin_Params(fUseV1Params)))
+                                fDoubleSerial = true;
+                            if (std::count(vBlockSerials.begin(), vBlockSerials.end(), spend->getCoinSerialNumber()))
+                                fDoubleSerial = true;
+                            if (std::count(vTxSerials.begin(), vTxSerials.end(), spend->getCoinSerialNumber()))
+                                fDoubleSerial = true;
+                            if (fDoubleSerial)
+                                break;
+                            vTxSerials.emplace_back(spend->getCoinSerialNumber());
+                        }
+                    }
+                    //This zBTCU serial has already been included in the block, do not add this tx.
+                    if (fDoubleSerial) {
+                        fPackageOk = false;
+                        break;
+                    }
+                }
 
-            // Note that flags: we don't want to set mempool/IsStandard()
-            // policy here, but we still have to ensure that the block we
-            // create only contains transactions that are valid in new blocks.
+                CAmount nTxFees = viewPackage.GetValueIn(tx) - tx.GetValueOut();
 
-            CValidationState state;
+                nTxSigOps += GetP2SHSigOpCount(tx, viewPackage);
+                if (nBlockSigOps + nPackageSigOps + nTxSigOps >= nMaxBlockSigOps) {
+                    fPackageOk = false;
+                    break;
+                }
 
-            PrecomputedTransactionData txdata;
-            if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true, txdata))
-                continue;
+                // Note that flags: we don't want to set mempool/IsStandard()
+                // policy here, but we still have to ensure that the block we
+                // create only contains transactions that are valid in new blocks.
 
-            CTxUndo txundo;
-            UpdateCoins(tx, state, view, txundo, nHeight);
+                CValidationState state;
 
-            // Added
-            pblock->vtx.push_back(tx);
-            pblocktemplate->vTxFees.push_back(nTxFees);
-            pblocktemplate->vTxSigOps.push_back(nTxSigOps);
-            nBlockSize += nTxSize;
-            ++nBlockTx;
-            nBlockSigOps += nTxSigOps;
-            nFees += nTxFees;
+                PrecomputedTransactionData txdata;
+                if (!CheckInputs(tx, state, viewPackage, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true, txdata)) {
+                    fPackageOk = false;
+                    break;
+                }
 
-            for (const CBigNum& bnSerial : vTxSerials)
-                vBlockSerials.emplace_back(bnSerial);
+                CTxUndo txundo;
+                UpdateCoins(tx, state, viewPackage, txundo, nHeight);
 
-            if (fPrintPriority) {
-                LogPrintf("priority %.1f fee %s txid %s\n",
-                    dPriority, feeRate.ToString(), tx.GetHash().ToString());
+                vPackageFees.push_back(nTxFees);
+                vPackageSigOps.push_back(nTxSigOps);
+                nPackageSigOps += nTxSigOps;
+            }
+            if (!fPackageOk) {
+                failedTx.insert(iter);
+                continue;
             }
 
-            // Add transactions that depend on this one to the priority queue
-            if (mapDependers.count(hash)) {
-                for (COrphan* porphan : mapDependers[hash]) {
-                    if (!porphan->setDependsOn.empty()) {
-                        porphan->setDependsOn.erase(hash);
-                        if (porphan->setDependsOn.empty()) {
-                            vecPriority.push_back(TxPriority(porphan->dPriority, porphan->feeRate, porphan->ptx));
-                            std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
-                        }
-                    }
+            // Added
+            viewPackage.Flush();
+            for (size_t i = 0; i < package.size(); i++) {
+                pblock->vtx.push_back(package[i]->GetSharedTx());
+                pblocktemplate->vTxFees.push_back(vPackageFees[i]);
+                pblocktemplate->vTxSigOps.push_back(vPackageSigOps[i]);
+                nFees += vPackageFees[i];
+                inBlock.insert(package[i]);
+
+                if (fPrintPriority) {
+                    LogPrintf("priority %.1f fee %s txid %s\n",
+                        package[i]->GetPriority(nHeight), CFeeRate(package[i]->GetModifiedFee(), package[i]->GetTxSize()).ToString(),
+                        package[i]->GetTx().GetHash().ToString());
                 }
             }
+            nBlockSize += nPackageSize;
+            nBlockTx += package.size();
+            nBlockSigOps += nPackageSigOps;
+
+            for (const CBigNum& bnSerial : vTxSerials)
+                vBlockSerials.emplace_back(bnSerial);
         }
 
         if (!fProofOfStake) {
@@ -625,11 +636,11 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
         LogPrintf("%s : total size %u\n", __func__, nBlockSize);
 
         // Compute final coinbase transaction.
-        pblock->vtx[0].vin[0].scriptSig = CScript() << nHeight << OP_0;
-        if (!fProofOfStake) {
-            pblock->vtx[0] = txNew;
+        if (fProofOfStake)
+            txNew.vin[0].scriptSig = CScript() << nHeight << OP_0;
+        else
             pblocktemplate->vTxFees[0] = -nFees;
-        }
+        pblock->vtx[0] = MakeTransactionRef(txNew);
 
         // Fill in header
         pblock->hashPrevBlock = pindexPrev->GetBlockHash();
@@ -638,7 +649,7 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
         pblock->nBits = GetNextWorkRequired(pindexPrev, pblock);
         pblock->nNonce = 0;
 
-        pblocktemplate->vTxSigOps[0] = GetLegacySigOpCount(pblock->vtx[0]);
+        pblocktemplate->vTxSigOps[0] = GetLegacySigOpCount(*pblock->vtx[0]);
 
         ////////////qtum
 
@@ -650,22 +661,27 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
 
        //addPackageTxs(nPackagesSelected, nDescendantsUpdated, minGasPrice);
        std::vector<CTxOut> refund_outs;
-       for (CTransaction tx: pblock->vtx){
-          if(tx.HasCreateOrCall()){
-             AttemptToAddContractToBlock(mempool.mapTx.begin()->second, tx,pblock, minGasPrice, refund_outs);
+       uint64_t nBlockGasUsed = 0;
+       // value transfers get appended to the block while it is walked, only visit the selected txs
+       const size_t nSelectedTx = pblock->vtx.size();
+       for (size_t i = 0; i < nSelectedTx; i++){
+          // hold on to the transaction, the block's vector grows while it executes
+          const CTransactionRef tx = pblock->vtx[i];
+          if(tx->HasCreateOrCall()){
+             AttemptToAddContractToBlock(mempool.GetContractSpeculation(tx->GetHash()), *tx, pblock, minGasPrice, nBlockGasUsed, refund_outs);
           }
        }
        //add contracts refund outputs to reward coinstake transaction and resign it
        if(refund_outs.size() > 0)
        {
+          CMutableTransaction cs_trx(*pblock->vtx[staketx_index]);
           for(auto &vout: refund_outs)
-             pblock->vtx[staketx_index].vout.emplace_back(vout);
+             cs_trx.vout.emplace_back(vout);
 
           //re-sign stake trx
           std::map<int, bilingual_str> input_errors;
-          CMutableTransaction cs_trx = pblock->vtx[staketx_index];
           SignTransaction(cs_trx, pwallet, SIGHASH_ALL, input_errors);
-          pblock->vtx[staketx_index] = cs_trx;
+          pblock->vtx[staketx_index] = MakeTransactionRef(cs_trx);
 
        }
 
@@ -711,11 +727,11 @@ void IncrementExtraNonce(CBlock* pblock, CBlockIndex* pindexPrev, unsigned int&
     }
     ++nExtraNonce;
     unsigned int nHeight = pindexPrev->nHeight + 1; // Height first in coinbase required for block.version=2
-    CMutableTransaction txCoinbase(pblock->vtx[0]);
+    CMutableTransaction txCoinbase(*pblock->vtx[0]);
     txCoinbase.vin[0].scriptSig = (CScript() << nHeight << CScriptNum(nExtraNonce)) + COINBASE_FLAGS;
     assert(txCoinbase.vin[0].scriptSig.size() <= 100);
 
-    pblock->vtx[0] = txCoinbase;
+    pblock->vtx[0] = MakeTransactionRef(txCoinbase);
     pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 }
 
@@ -757,7 +773,7 @@ CBlockTemplate* CreateNewBlockWithKey(CReserveKey& reservekey, CWallet* pwallet)
 bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey)
 {
     LogPrintf("%s\n", pblock->ToString());
-    LogPrintf("generated %s\n", FormatMoney(pblock->vtx[0].vout[0].nValue));
+    LogPrintf("generated %s\n", FormatMoney(pblock->vtx[0]->vout[0].nValue));
 
     // Found a solution
     {
@@ -1024,4 +1040,24 @@ void ThreadStakeMinter()
     LogPrintf("ThreadStakeMinter exiting,\n");
 }
 
+// Keeps the contract speculations of the mempool current for template assembly
+void ThreadContractSpeculation()
+{
+    LogPrintf("ThreadContractSpeculation started\n");
+    RenameThread("btcu-contractspec");
+    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+    try {
+        while (true) {
+            MilliSleep(CONTRACT_SPECULATION_INTERVAL);
+            SpeculateMempoolContracts();
+        }
+    } catch (const boost::thread_interrupted&) {
+        LogPrintf("ThreadContractSpeculation exiting\n");
+        throw;
+    } catch (const std::exception& e) {
+        LogPrintf("ThreadContractSpeculation() exception: %s\n", e.what());
+    }
+    LogPrintf("ThreadContractSpeculation exiting\n");
+}
+
 #endif // ENABLE_WALLET
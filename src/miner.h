@@ -31,6 +31,11 @@ void IncrementExtraNonce(CBlock* pblock, CBlockIndex* pindexPrev, unsigned int&
 /** Check mined block */
 void UpdateTime(CBlockHeader* block, const CBlockIndex* pindexPrev);
 
+/** Milliseconds between two rounds of speculative contract execution */
+static const int CONTRACT_SPECULATION_INTERVAL = 500;
+/** Contract transactions executed speculatively per round at most */
+static const size_t MAX_CONTRACT_SPECULATIONS_PER_ROUND = 100;
+
 #ifdef ENABLE_WALLET
     /** Run the miner threads */
     void GenerateBitcoins(bool fGenerate, CWallet* pwallet, int nThreads);
@@ -39,6 +44,9 @@ void UpdateTime(CBlockHeader* block, const CBlockIndex* pindexPrev);
 
     void BitcoinMiner(CWallet* pwallet, bool fProofOfStake);
     void ThreadStakeMinter();
+    void ThreadContractSpeculation();
+    /** Execute pending mempool contract transactions against the tip, for the template to skip those that fail or exceed the gas limit */
+    void SpeculateMempoolContracts();
 #endif // ENABLE_WALLET
 
 extern double dHashesPerSec;
@@ -27,6 +27,14 @@
 #include <fcntl.h>
 #endif
 
+#ifdef USE_POLL
+#include <poll.h>
+#endif
+
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -40,6 +48,12 @@
 // Dump addresses to peers.dat every 15 minutes (900s)
 #define DUMP_ADDRESSES_INTERVAL 900
 
+// How long the socket handler waits for socket events, also how often it checks for data to send
+static const int SELECT_TIMEOUT_MILLISECONDS = 50;
+
+// How many ready sockets one epoll_wait returns at most, the rest are returned by the next one
+static const int MAX_SOCKET_EVENTS = 256;
+
 #if !defined(HAVE_MSG_NOSIGNAL) && !defined(MSG_NOSIGNAL)
 #define MSG_NOSIGNAL 0
 #endif
@@ -87,6 +101,13 @@ std::string strSubVersion;
 
 std::vector<CNode*> vNodes;
 CCriticalSection cs_vNodes;
+#ifdef USE_EPOLL
+/** epoll instance of the socket handler, -1 until it runs or when poll() is used instead */
+static std::atomic<int> hEpoll(-1);
+/** Peers by the socket registered for them with hEpoll, to service only the ones epoll_wait returns */
+static std::map<SOCKET, CNode*> mapSocketNodes;
+static CCriticalSection cs_mapSocketNodes; // taken after cs_vNodes
+#endif
 std::map<CInv, CDataStream> mapRelay;
 std::deque<std::pair<int64_t, CInv> > vRelayExpiration;
 CCriticalSection cs_mapRelay;
@@ -111,6 +132,45 @@ boost::condition_variable messageHandlerCondition;
 static CNodeSignals g_signals;
 CNodeSignals& GetNodeSignals() { return g_signals; }
 
+#ifdef USE_EPOLL
+/**
+ * Events to wait for on the socket of a node. If there is data to send only sending is
+ * waited for, draining the send buffer before receiving more, see GenerateSelectSet.
+ * Errors and hangups are always reported.
+ */
+static int WantedSocketEvents(const CNode* pnode)
+{
+    return pnode->fWantSend ? EPOLLOUT : (pnode->fWantRecv ? EPOLLIN : 0);
+}
+#endif
+
+/** Register the socket of a node just added to vNodes with the socket handler's epoll instance */
+static void RegisterSocket(CNode* pnode)
+{
+    AssertLockHeld(cs_vNodes);
+#ifdef USE_EPOLL
+    if (hEpoll == -1 || pnode->hSocket == INVALID_SOCKET)
+        return;
+
+    {
+        LOCK(cs_mapSocketNodes);
+        mapSocketNodes[pnode->hSocket] = pnode;
+    }
+
+    LOCK(pnode->cs_socketEvents);
+    if (pnode->nSocketEvents != -1)
+        return;
+    struct epoll_event event = {};
+    event.events = WantedSocketEvents(pnode);
+    event.data.fd = pnode->hSocket;
+    if (epoll_ctl(hEpoll, EPOLL_CTL_ADD, pnode->hSocket, &event) == SOCKET_ERROR) {
+        LogPrint("net", "epoll_ctl for peer=%d failed: %s\n", pnode->id, NetworkErrorString(WSAGetLastError()));
+        return;
+    }
+    pnode->nSocketEvents = event.events;
+#endif
+}
+
 void AddOneShot(std::string strDest)
 {
     LOCK(cs_vOneShots);
@@ -429,6 +489,7 @@ CNode* ConnectNode(CAddress addrConnect, const char* pszDest, bool obfuScationMa
         {
             LOCK(cs_vNodes);
             vNodes.push_back(pnode);
+            RegisterSocket(pnode);
         }
 
         pnode->nTimeConnected = GetTime();
@@ -449,6 +510,21 @@ void CNode::CloseSocketDisconnect()
     fDisconnect = true;
     if (hSocket != INVALID_SOCKET) {
         LogPrint("net", "disconnecting peer=%d\n", id);
+#ifdef USE_EPOLL
+        // Unregister first, the next connection may get the same descriptor
+        {
+            LOCK(cs_socketEvents);
+            if (nSocketEvents != -1)
+                epoll_ctl(hEpoll, EPOLL_CTL_DEL, hSocket, NULL);
+            nSocketEvents = -1;
+        }
+        {
+            LOCK(cs_mapSocketNodes);
+            std::map<SOCKET, CNode*>::iterator it = mapSocketNodes.find(hSocket);
+            if (it != mapSocketNodes.end() && it->second == this)
+                mapSocketNodes.erase(it);
+        }
+#endif
         CloseSocket(hSocket);
     }
 
@@ -743,6 +819,32 @@ bool CNode::ReceiveMsgBytes(const char* pch, unsigned int nBytes)
     return true;
 }
 
+// requires LOCK(cs_vRecvMsg)
+void CNode::UpdateRecvInterest()
+{
+    fWantRecv = vRecvMsg.empty() || !vRecvMsg.front().complete() || GetTotalRecvSize() <= ReceiveFloodSize();
+    UpdateSocketEvents();
+}
+
+void CNode::UpdateSocketEvents()
+{
+#ifdef USE_EPOLL
+    LOCK(cs_socketEvents);
+    int nEvents = WantedSocketEvents(this);
+    if (nSocketEvents == -1 || nSocketEvents == nEvents)
+        return;
+
+    struct epoll_event event = {};
+    event.events = nEvents;
+    event.data.fd = hSocket;
+    if (epoll_ctl(hEpoll, EPOLL_CTL_MOD, hSocket, &event) == SOCKET_ERROR) {
+        LogPrint("net", "epoll_ctl for peer=%d failed: %s\n", id, NetworkErrorString(WSAGetLastError()));
+        return;
+    }
+    nSocketEvents = nEvents;
+#endif
+}
+
 int CNetMessage::readHeader(const char* pch, unsigned int nBytes)
 {
     // copy data to temporary parsing buffer
@@ -831,6 +933,8 @@ void SocketSendData(CNode* pnode)
         assert(pnode->nSendSize == 0);
     }
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
+    pnode->fWantSend = !pnode->vSendMsg.empty();
+    pnode->UpdateSocketEvents();
 }
 
 void CheckOffsetDisconnectedPeers(const CNetAddr& ip)
@@ -869,9 +973,262 @@ void CheckOffsetDisconnectedPeers(const CNetAddr& ip)
 
 static std::list<CNode*> vNodesDisconnected;
 
+namespace
+{
+/** A peer the socket handler found ready, referenced until it is serviced */
+struct ReadyNode {
+    CNode* pnode;
+    bool fRecv; // receive, which also finds out about errors
+    bool fSend;
+};
+}
+
+/** Collect the sockets to wait on for receiving, sending and errors, for poll() and select() */
+static void GenerateSelectSet(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    for (const ListenSocket& hListenSocket : vhListenSocket)
+        recv_set.insert(hListenSocket.socket);
+
+    LOCK(cs_vNodes);
+    for (CNode* pnode : vNodes) {
+        if (pnode->hSocket == INVALID_SOCKET)
+            continue;
+        error_set.insert(pnode->hSocket);
+
+        // Implement the following logic:
+        // * If there is data to send, select() for sending data. As this only
+        //   happens when optimistic write failed, we choose to first drain the
+        //   write buffer in this case before receiving more. This avoids
+        //   needlessly queueing received data, if the remote peer is not themselves
+        //   receiving data. This means properly utilizing TCP flow control signalling.
+        // * Otherwise, if there is no (complete) message in the receive buffer,
+        //   or there is space left in the buffer, select() for receiving data.
+        // * (if neither of the above applies, there is certainly one message
+        //   in the receiver buffer ready to be processed).
+        // Together, that means that at least one of the following is always possible,
+        // so we don't deadlock:
+        // * We send some data.
+        // * We wait for data to be received (and disconnect after timeout).
+        // * We process a message in the buffer (message handler thread).
+        bool fSend = false;
+        bool fRecv = false;
+        {
+            TRY_LOCK(pnode->cs_vSend, lockSend);
+            fSend = lockSend && !pnode->vSendMsg.empty();
+        }
+        if (!fSend) {
+            TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+            fRecv = lockRecv && (pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
+                                    pnode->GetTotalRecvSize() <= ReceiveFloodSize());
+        }
+        if (fSend)
+            send_set.insert(pnode->hSocket);
+        if (fRecv)
+            recv_set.insert(pnode->hSocket);
+    }
+}
+
+/** Wait for socket events with poll() or select(), leaving the sockets ready for receiving, sending or with an error in the sets */
+static void SelectSocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    GenerateSelectSet(recv_select_set, send_select_set, error_select_set);
+
+#ifdef USE_POLL
+    std::map<SOCKET, struct pollfd> pollfds;
+    for (SOCKET hSocket : recv_select_set) {
+        pollfds[hSocket].fd = hSocket;
+        pollfds[hSocket].events |= POLLIN;
+    }
+    for (SOCKET hSocket : send_select_set) {
+        pollfds[hSocket].fd = hSocket;
+        pollfds[hSocket].events |= POLLOUT;
+    }
+    for (SOCKET hSocket : error_select_set) {
+        pollfds[hSocket].fd = hSocket;
+        // POLLERR and POLLHUP are always reported
+    }
+
+    std::vector<struct pollfd> vpollfds;
+    vpollfds.reserve(pollfds.size());
+    for (const auto& it : pollfds)
+        vpollfds.push_back(it.second);
+
+    if (poll(vpollfds.data(), vpollfds.size(), SELECT_TIMEOUT_MILLISECONDS) == SOCKET_ERROR) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR) {
+            LogPrintf("socket poll error %s\n", NetworkErrorString(nErr));
+            MilliSleep(SELECT_TIMEOUT_MILLISECONDS);
+        }
+        return;
+    }
+
+    for (const struct pollfd& pollfd_entry : vpollfds) {
+        if (pollfd_entry.revents & POLLIN)
+            recv_set.insert(pollfd_entry.fd);
+        if (pollfd_entry.revents & POLLOUT)
+            send_set.insert(pollfd_entry.fd);
+        if (pollfd_entry.revents & (POLLERR | POLLHUP))
+            error_set.insert(pollfd_entry.fd);
+    }
+#else
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = SELECT_TIMEOUT_MILLISECONDS * 1000; // frequency to poll pnode->vSend
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+
+    for (SOCKET hSocket : recv_select_set) {
+        FD_SET(hSocket, &fdsetRecv);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    for (SOCKET hSocket : send_select_set) {
+        FD_SET(hSocket, &fdsetSend);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    for (SOCKET hSocket : error_select_set) {
+        FD_SET(hSocket, &fdsetError);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    bool have_fds = !recv_select_set.empty() || !send_select_set.empty() || !error_select_set.empty();
+
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+        &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+
+    if (nSelect == SOCKET_ERROR) {
+        if (have_fds) {
+            int nErr = WSAGetLastError();
+            LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+            // Try receiving from every socket, errors show up there
+            recv_set = recv_select_set;
+            recv_set.insert(error_select_set.begin(), error_select_set.end());
+        }
+        MilliSleep(SELECT_TIMEOUT_MILLISECONDS);
+        return;
+    }
+
+    for (SOCKET hSocket : recv_select_set) {
+        if (FD_ISSET(hSocket, &fdsetRecv))
+            recv_set.insert(hSocket);
+    }
+    for (SOCKET hSocket : send_select_set) {
+        if (FD_ISSET(hSocket, &fdsetSend))
+            send_set.insert(hSocket);
+    }
+    for (SOCKET hSocket : error_select_set) {
+        if (FD_ISSET(hSocket, &fdsetError))
+            error_set.insert(hSocket);
+    }
+#endif
+}
+
+/**
+ * Wait for socket events, returning the listening sockets with connections to accept and the
+ * peers to service. The peers are referenced, the caller releases them.
+ */
+static void SocketEvents(std::vector<SOCKET>& vListenReady, std::vector<ReadyNode>& vNodesReady)
+{
+#ifdef USE_EPOLL
+    if (hEpoll != -1) {
+        // The send and receive paths keep the interest registered, epoll_wait returns the ready sockets only
+        struct epoll_event vEvents[MAX_SOCKET_EVENTS];
+        int nReady = epoll_wait(hEpoll, vEvents, MAX_SOCKET_EVENTS, SELECT_TIMEOUT_MILLISECONDS);
+        if (nReady == SOCKET_ERROR) {
+            int nErr = WSAGetLastError();
+            if (nErr != WSAEINTR) {
+                LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(nErr));
+                MilliSleep(SELECT_TIMEOUT_MILLISECONDS);
+            }
+            return;
+        }
+
+        LOCK2(cs_vNodes, cs_mapSocketNodes);
+        for (int i = 0; i < nReady; i++) {
+            SOCKET hSocket = vEvents[i].data.fd;
+            std::map<SOCKET, CNode*>::iterator it = mapSocketNodes.find(hSocket);
+            if (it == mapSocketNodes.end()) {
+                // Not a peer, so a listening socket or one closed meanwhile
+                vListenReady.push_back(hSocket);
+                continue;
+            }
+            bool fRecv = (vEvents[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0;
+            bool fSend = (vEvents[i].events & EPOLLOUT) != 0;
+            vNodesReady.push_back(ReadyNode{it->second->AddRef(), fRecv, fSend});
+        }
+        return;
+    }
+#endif
+
+    std::set<SOCKET> recv_set, send_set, error_set;
+    SelectSocketEvents(recv_set, send_set, error_set);
+
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        if (recv_set.count(hListenSocket.socket) > 0)
+            vListenReady.push_back(hListenSocket.socket);
+    }
+
+    LOCK(cs_vNodes);
+    for (CNode* pnode : vNodes) {
+        if (pnode->hSocket == INVALID_SOCKET)
+            continue;
+        bool fRecv = recv_set.count(pnode->hSocket) > 0 || error_set.count(pnode->hSocket) > 0;
+        bool fSend = send_set.count(pnode->hSocket) > 0;
+        if (fRecv || fSend)
+            vNodesReady.push_back(ReadyNode{pnode->AddRef(), fRecv, fSend});
+    }
+}
+
+/** Disconnect a peer that stopped talking, the timeouts are in seconds */
+static void InactivityCheck(CNode* pnode, int64_t nTime)
+{
+    if (nTime - pnode->nTimeConnected > 60) {
+        if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
+            LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->id);
+            pnode->fDisconnect = true;
+        } else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL) {
+            LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
+            pnode->fDisconnect = true;
+        } else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90 * 60)) {
+            LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
+            pnode->fDisconnect = true;
+        } else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros()) {
+            LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
+            pnode->fDisconnect = true;
+        }
+    }
+}
+
 void ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
+    int64_t nLastInactivityCheck = 0;
+#ifdef USE_EPOLL
+    if (hEpoll == -1) {
+        hEpoll = epoll_create1(EPOLL_CLOEXEC);
+        if (hEpoll == -1) {
+            LogPrintf("epoll_create1 failed: %s, waiting for socket events with poll()\n", NetworkErrorString(WSAGetLastError()));
+        } else {
+            // The listening sockets stay open as long as the socket handler runs
+            for (const ListenSocket& hListenSocket : vhListenSocket) {
+                struct epoll_event event = {};
+                event.events = EPOLLIN;
+                event.data.fd = hListenSocket.socket;
+                if (epoll_ctl(hEpoll, EPOLL_CTL_ADD, hListenSocket.socket, &event) == SOCKET_ERROR)
+                    LogPrintf("epoll_ctl for listening socket failed: %s\n", NetworkErrorString(WSAGetLastError()));
+            }
+            // Peers connected before, later ones register themselves when added to vNodes
+            LOCK(cs_vNodes);
+            for (CNode* pnode : vNodes)
+                RegisterSocket(pnode);
+        }
+    }
+#endif
     while (true) {
         //
         // Disconnect nodes
@@ -935,88 +1292,18 @@ void ThreadSocketHandler()
         }
 
         //
-        // Find which sockets have data to receive
+        // Find which sockets are ready
         //
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        for (const ListenSocket& hListenSocket : vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
-        {
-            LOCK(cs_vNodes);
-            for (CNode* pnode : vNodes) {
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is no (complete) message in the receive buffer,
-                //   or there is space left in the buffer, select() for receiving data.
-                // * (if neither of the above applies, there is certainly one message
-                //   in the receiver buffer ready to be processed).
-                // Together, that means that at least one of the following is always possible,
-                // so we don't deadlock:
-                // * We send some data.
-                // * We wait for data to be received (and disconnect after timeout).
-                // * We process a message in the buffer (message handler thread).
-                {
-                    TRY_LOCK(pnode->cs_vSend, lockSend);
-                    if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
-                        continue;
-                    }
-                }
-                {
-                    TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                    if (lockRecv && (pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
-                                        pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
-                        FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
-
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-            &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
-        boost::this_thread::interruption_point();
-
-        if (nSelect == SOCKET_ERROR) {
-            if (have_fds) {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec / 1000);
-        }
+        std::vector<SOCKET> vListenReady;
+        std::vector<ReadyNode> vNodesReady;
+        SocketEvents(vListenReady, vNodesReady);
 
         //
         // Accept new connections
         //
         for (const ListenSocket& hListenSocket : vhListenSocket) {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv)) {
+            if (hListenSocket.socket != INVALID_SOCKET &&
+                std::find(vListenReady.begin(), vListenReady.end(), hListenSocket.socket) != vListenReady.end()) {
                 struct sockaddr_storage sockaddr;
                 socklen_t len = sizeof(sockaddr);
                 SOCKET hSocket = accept(hListenSocket.socket, (struct sockaddr*)&sockaddr, &len);
@@ -1056,22 +1343,17 @@ void ThreadSocketHandler()
                     {
                         LOCK(cs_vNodes);
                         vNodes.push_back(pnode);
+                        RegisterSocket(pnode);
                     }
                 }
             }
         }
 
         //
-        // Service each socket
+        // Service each ready socket
         //
-        std::vector<CNode*> vNodesCopy;
-        {
-            LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            for (CNode* pnode : vNodesCopy)
-                pnode->AddRef();
-        }
-        for (CNode* pnode : vNodesCopy) {
+        for (const ReadyNode& ready : vNodesReady) {
+            CNode* pnode = ready.pnode;
             boost::this_thread::interruption_point();
 
             //
@@ -1079,7 +1361,7 @@ void ThreadSocketHandler()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError)) {
+            if (ready.fRecv) {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                 if (lockRecv) {
                     {
@@ -1092,6 +1374,7 @@ void ThreadSocketHandler()
                             pnode->nLastRecv = GetTime();
                             pnode->nRecvBytes += nBytes;
                             pnode->RecordBytesRecv(nBytes);
+                            pnode->UpdateRecvInterest();
                         } else if (nBytes == 0) {
                             // socket closed gracefully
                             if (!pnode->fDisconnect)
@@ -1115,41 +1398,34 @@ void ThreadSocketHandler()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetSend)) {
+            if (ready.fSend) {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
                 if (lockSend)
                     SocketSendData(pnode);
             }
-
-            //
-            // Inactivity checking
-            //
-            int64_t nTime = GetTime();
-            if (nTime - pnode->nTimeConnected > 60) {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
-                    LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->id);
-                    pnode->fDisconnect = true;
-                } else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL) {
-                    LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
-                    pnode->fDisconnect = true;
-                } else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90 * 60)) {
-                    LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
-                    pnode->fDisconnect = true;
-                } else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros()) {
-                    LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
-                    pnode->fDisconnect = true;
-                }
-            }
         }
         {
             LOCK(cs_vNodes);
-            for (CNode* pnode : vNodesCopy)
-                pnode->Release();
+            for (const ReadyNode& ready : vNodesReady)
+                ready.pnode->Release();
+        }
+        boost::this_thread::interruption_point();
+
+        //
+        // Inactivity checking, once a second as the timeouts are in seconds
+        //
+        int64_t nTime = GetTime();
+        if (nTime != nLastInactivityCheck) {
+            nLastInactivityCheck = nTime;
+            LOCK(cs_vNodes);
+            for (CNode* pnode : vNodes) {
+                if (pnode->hSocket != INVALID_SOCKET)
+                    InactivityCheck(pnode, nTime);
+            }
         }
     }
 }
 
-
 #ifdef USE_UPNP
 void ThreadMapPort()
 {
@@ -2074,6 +2350,9 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
 {
     nServices = 0;
     hSocket = hSocketIn;
+    nSocketEvents = -1;
+    fWantSend = false;
+    fWantRecv = true;
     nRecvVersion = INIT_PROTO_VERSION;
     nLastSend = 0;
     nLastRecv = 0;
@@ -21,6 +21,7 @@
 #include "uint256.h"
 #include "utilstrencodings.h"
 
+#include <atomic>
 #include <deque>
 #include <stdint.h>
 
@@ -85,6 +86,7 @@ unsigned short GetListenPort();
 bool BindListenPort(const CService& bindAddr, std::string& strError, bool fWhitelisted = false);
 void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler);
 bool StopNode();
+void ThreadSocketHandler();
 void SocketSendData(CNode* pnode);
 void CheckOffsetDisconnectedPeers(const CNetAddr& ip);
 
@@ -293,6 +295,10 @@ public:
     // socket
     uint64_t nServices;
     SOCKET hSocket;
+    int nSocketEvents; // events hSocket is registered for with the socket handler's epoll instance, -1 if not registered
+    CCriticalSection cs_socketEvents; // guards nSocketEvents and the epoll registration of hSocket, taken last
+    std::atomic<bool> fWantSend; // vSendMsg has data left, set by SocketSendData
+    std::atomic<bool> fWantRecv; // vRecvMsg has room for more data, set by UpdateRecvInterest
     CDataStream ssSend;
     size_t nSendSize;   // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
@@ -424,6 +430,12 @@ public:
     // requires LOCK(cs_vRecvMsg)
     bool ReceiveMsgBytes(const char* pch, unsigned int nBytes);
 
+    // requires LOCK(cs_vRecvMsg)
+    void UpdateRecvInterest();
+
+    /** Pass fWantSend and fWantRecv on to the socket handler's epoll instance, if they changed */
+    void UpdateSocketEvents();
+
     // requires LOCK(cs_vRecvMsg)
     void SetRecvVersion(int nVersionIn)
     {
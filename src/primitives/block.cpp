@@ -10,18 +10,94 @@
 #include "hash.h"
 #include "script/standard.h"
 #include "script/sign.h"
+#include "sync.h"
 #include "tinyformat.h"
 #include "utilstrencodings.h"
 #include "util.h"
 
+#include <array>
+#include <deque>
+#include <map>
+
+namespace {
+/** The 80 header bytes Quark hashes, from nVersion to nNonce */
+typedef std::array<unsigned char, 80> QuarkHeaderBytes;
+
+CCriticalSection cs_quarkcache;
+std::map<QuarkHeaderBytes, uint256> mapQuarkCache;
+/** Cached headers, oldest first, for eviction */
+std::deque<QuarkHeaderBytes> dequeQuarkCache;
+
+QuarkHeaderBytes GetQuarkHeaderBytes(const CBlockHeader& header)
+{
+    QuarkHeaderBytes bytes;
+    std::copy(BEGIN(header.nVersion), END(header.nNonce), bytes.begin());
+    return bytes;
+}
+
+void CacheQuarkHash(const QuarkHeaderBytes& bytes, const uint256& hash)
+{
+    AssertLockHeld(cs_quarkcache);
+    if (!mapQuarkCache.emplace(bytes, hash).second)
+        return;
+    dequeQuarkCache.push_back(bytes);
+    if (dequeQuarkCache.size() > MAX_QUARK_HASH_CACHE) {
+        mapQuarkCache.erase(dequeQuarkCache.front());
+        dequeQuarkCache.pop_front();
+    }
+}
+}
+
 uint256 CBlockHeader::GetHash() const
 {
-    if (nVersion < 4)
-        return HashQuark(BEGIN(nVersion), END(nNonce));
+    if (nVersion < 4) {
+        // Keyed by the hashed bytes themselves, so a header changed since the last call misses
+        const QuarkHeaderBytes bytes = GetQuarkHeaderBytes(*this);
+        {
+            LOCK(cs_quarkcache);
+            auto it = mapQuarkCache.find(bytes);
+            if (it != mapQuarkCache.end())
+                return it->second;
+        }
+        const uint256 hash = HashQuark(bytes.data(), bytes.data() + bytes.size());
+        LOCK(cs_quarkcache);
+        CacheQuarkHash(bytes, hash);
+        return hash;
+    }
 
     return SerializeHash(*this);
 }
 
+std::vector<uint256> GetBlockHeaderHashes(const std::vector<CBlockHeader>& headers)
+{
+    std::vector<uint256> vHashes(headers.size());
+    std::vector<QuarkHeaderBytes> vLegacy;
+    std::vector<size_t> vLegacyPos;
+    for (size_t i = 0; i < headers.size(); i++) {
+        if (headers[i].nVersion < 4) {
+            vLegacy.push_back(GetQuarkHeaderBytes(headers[i]));
+            vLegacyPos.push_back(i);
+        } else {
+            vHashes[i] = headers[i].GetHash();
+        }
+    }
+    if (vLegacy.empty())
+        return vHashes;
+
+    std::vector<const unsigned char*> vInputs;
+    for (const QuarkHeaderBytes& bytes : vLegacy)
+        vInputs.push_back(bytes.data());
+    std::vector<uint256> vLegacyHashes;
+    HashQuarkBatch(vInputs, sizeof(QuarkHeaderBytes), vLegacyHashes);
+
+    LOCK(cs_quarkcache);
+    for (size_t i = 0; i < vLegacy.size(); i++) {
+        vHashes[vLegacyPos[i]] = vLegacyHashes[i];
+        CacheQuarkHash(vLegacy[i], vLegacyHashes[i]);
+    }
+    return vHashes;
+}
+
 uint256 CBTCUValidatorBlockHeader::GetHashForValidator() const
 {
     return SerializeHash(*this);
@@ -39,7 +115,7 @@ std::string CBlock::ToString() const
         vtx.size());
     for (unsigned int i = 0; i < vtx.size(); i++)
     {
-        s << "  " << vtx[i].ToString() << "\n";
+        s << "  " << vtx[i]->ToString() << "\n";
     }
     return s.str();
 }
@@ -51,5 +127,5 @@ void CBlock::print() const
 
 bool CBlock::IsZerocoinStake() const
 {
-    return IsProofOfStake() && vtx[1].HasZerocoinSpendInputs();
+    return IsProofOfStake() && vtx[1]->HasZerocoinSpendInputs();
 }
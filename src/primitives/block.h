@@ -13,6 +13,9 @@
 #include "serialize.h"
 #include "uint256.h"
 
+/** Legacy (pre-version 4) header hashes remembered by CBlockHeader::GetHash */
+static const size_t MAX_QUARK_HASH_CACHE = 5000;
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -85,6 +88,8 @@ public:
         return (nBits == 0);
     }
 
+    /** Block hash: Quark of the first 80 bytes before version 4, double SHA-256 of the header after.
+     *  Quark hashes are memoized by header content, so repeated calls on the same legacy header are cheap. */
     uint256 GetHash() const;
 
     int64_t GetBlockTime() const
@@ -93,13 +98,17 @@ public:
     }
 };
 
+/** Hashes of a run of headers, as from a headers message. The legacy ones are Quark hashed as one batch
+ *  and memoized, so the GetHash calls made while accepting the headers find them. */
+std::vector<uint256> GetBlockHeaderHashes(const std::vector<CBlockHeader>& headers);
+
 /** Is used to generate the BTCU Validator signature
  */
 class CBTCUValidatorBlockHeader: public CBlockHeader
 {
 public:
     // network and disk
-    std::vector<CTransaction> vtx;
+    std::vector<CTransactionRef> vtx;
 
     // ppcoin: block signature - signed by one of the coin base txout[N]'s owner
     std::vector<unsigned char> vchBlockSig;
@@ -139,7 +148,7 @@ public:
     // ppcoin: two types of block: proof-of-work or proof-of-stake
     bool IsProofOfStake() const
     {
-        return (vtx.size() > 1 && vtx[1].IsCoinStake());
+        return (vtx.size() > 1 && vtx[1]->IsCoinStake());
     }
 
     bool IsProofOfWork() const
@@ -207,7 +216,7 @@ public:
 
     std::pair<COutPoint, unsigned int> GetProofOfStake() const
     {
-        return IsProofOfStake()? std::make_pair(vtx[1].vin[0].prevout, nTime) : std::make_pair(COutPoint(), (unsigned int)0);
+        return IsProofOfStake()? std::make_pair(vtx[1]->vin[0].prevout, nTime) : std::make_pair(COutPoint(), (unsigned int)0);
     }
     
     std::string ToString() const;
@@ -34,7 +34,8 @@ static const char* ppszTypeName[] =
         "mn quorum",
         "mn announce",
         "mn ping",
-        "dstx"
+        "dstx",
+        "cmpctblock"
     };
 
 CMessageHeader::CMessageHeader()
@@ -140,7 +141,7 @@ bool CInv::IsKnownType() const
 }
 
 bool CInv::IsMasterNodeType() const{
-     return (type >= 6);
+     return (type >= 6 && type != MSG_CMPCT_BLOCK);
 }
 
 const char* CInv::GetCommand() const
@@ -211,7 +211,7 @@ std::string BlockToString(CBlockIndex* pBlock)
 
     std::string TxContent = table + makeHTMLTableRow(TxLabels, sizeof(TxLabels) / sizeof(std::string));
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
-        const CTransaction& tx = block.vtx[i];
+        const CTransaction& tx = *block.vtx[i];
         TxContent += TxToRow(tx);
 
         CAmount In = getTxIn(tx);
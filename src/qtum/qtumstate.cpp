@@ -4,6 +4,7 @@
 #include <chainparams.h>
 #include <qtum/qtumstate.h>
 #include <libevm/VMFace.h>
+#include <libethereum/StateCache.h>
 
 using namespace std;
 using namespace dev;
@@ -157,7 +158,13 @@ Vin* QtumState::vin(dev::Address const& _addr)
 {
     auto it = cacheUTXO.find(_addr);
     if (it == cacheUTXO.end()){
-        std::string stateBack = stateUTXO.at(_addr);
+        dev::eth::StateCache& stateCache = dev::eth::StateCache::instance();
+        dev::h256 const root = stateUTXO.root();
+        std::string stateBack;
+        if (!stateCache.utxo(root, _addr, stateBack)){
+            stateBack = stateUTXO.at(_addr);
+            stateCache.storeUtxo(root, _addr, stateBack);
+        }
         if (stateBack.empty())
             return nullptr;
             
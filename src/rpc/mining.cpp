@@ -31,6 +31,7 @@
 
 #include <univalue.h>
 #include <blocksignature.h>
+#include <libethereum/StateCache.h>
 
 
 /**
@@ -334,6 +335,16 @@ UniValue getmininginfo(const UniValue& params, bool fHelp)
             "  \"pooledtx\": n              (numeric) The size of the mem pool\n"
             "  \"testnet\": true|false      (boolean) If using testnet or not\n"
             "  \"chain\": \"xxxx\",         (string) current network name as defined in BIP70 (main, test, regtest)\n"
+            "  \"statecache\": {             (json object) EVM state cache lookups of the last connected block\n"
+            "    \"accounthits\": n,         (numeric) accounts found in the cache\n"
+            "    \"accountmisses\": n,       (numeric) accounts read from the state trie\n"
+            "    \"storagehits\": n,         (numeric) storage slots found in the cache\n"
+            "    \"storagemisses\": n,       (numeric) storage slots read from the storage tries\n"
+            "    \"codehits\": n,            (numeric) contract codes found in the cache\n"
+            "    \"codemisses\": n,          (numeric) contract codes read from the database\n"
+            "    \"utxohits\": n,            (numeric) contract UTXOs found in the cache\n"
+            "    \"utxomisses\": n           (numeric) contract UTXOs read from the UTXO trie\n"
+            "  }\n"
             "}\n"
 
             "\nExamples:\n" +
@@ -352,6 +363,18 @@ UniValue getmininginfo(const UniValue& params, bool fHelp)
     obj.push_back(Pair("pooledtx", (uint64_t)mempool.size()));
     obj.push_back(Pair("testnet", Params().TestnetToBeDeprecatedFieldRPC()));
     obj.push_back(Pair("chain", Params().NetworkIDString()));
+
+    dev::eth::StateCache::Stats stateCacheStats = dev::eth::StateCache::instance().blockStats();
+    UniValue stateCache(UniValue::VOBJ);
+    stateCache.push_back(Pair("accounthits", stateCacheStats.accountHits));
+    stateCache.push_back(Pair("accountmisses", stateCacheStats.accountMisses));
+    stateCache.push_back(Pair("storagehits", stateCacheStats.storageHits));
+    stateCache.push_back(Pair("storagemisses", stateCacheStats.storageMisses));
+    stateCache.push_back(Pair("codehits", stateCacheStats.codeHits));
+    stateCache.push_back(Pair("codemisses", stateCacheStats.codeMisses));
+    stateCache.push_back(Pair("utxohits", stateCacheStats.utxoHits));
+    stateCache.push_back(Pair("utxomisses", stateCacheStats.utxoMisses));
+    obj.push_back(Pair("statecache", stateCache));
 #ifdef ENABLE_WALLET
     obj.push_back(Pair("generate", getgenerate(params, false)));
     obj.push_back(Pair("hashespersec", gethashespersec(params, false)));
@@ -614,7 +637,8 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
     UniValue transactions(UniValue::VARR);
     std::map<uint256, int64_t> setTxIndex;
     int i = 0;
-    for (CTransaction& tx : pblock->vtx) {
+    for (const CTransactionRef& ptx : pblock->vtx) {
+        const CTransaction& tx = *ptx;
         uint256 txHash = tx.GetHash();
         setTxIndex[txHash] = i++;
 
@@ -661,7 +685,7 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
     result.push_back(Pair("previousblockhash", pblock->hashPrevBlock.GetHex()));
     result.push_back(Pair("transactions", transactions));
     result.push_back(Pair("coinbaseaux", aux));
-    result.push_back(Pair("coinbasevalue", (int64_t)pblock->vtx[0].GetValueOut()));
+    result.push_back(Pair("coinbasevalue", (int64_t)pblock->vtx[0]->GetValueOut()));
     result.push_back(Pair("longpollid", chainActive.Tip()->GetBlockHash().GetHex() + i64tostr(nTransactionsUpdatedLast)));
     result.push_back(Pair("target", hashTarget.GetHex()));
     result.push_back(Pair("mintime", (int64_t)pindexPrev->GetMedianTimePast() + 1));
@@ -679,7 +703,7 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
         CTxDestination address1;
         ExtractDestination(pblock->payee, address1);
         result.push_back(Pair("payee", EncodeDestination(address1).c_str()));
-        result.push_back(Pair("payee_amount", (int64_t)pblock->vtx[0].vout[1].nValue));
+        result.push_back(Pair("payee_amount", (int64_t)pblock->vtx[0]->vout[1].nValue));
     } else {
         result.push_back(Pair("payee", ""));
         result.push_back(Pair("payee_amount", ""));
@@ -735,10 +759,10 @@ UniValue submitblock(const UniValue& params, bool fHelp)
     if (!DecodeHexBlk(block, params[0].get_str()))
         throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block decode failed");
 
-    if (block.vtx.empty() || !block.vtx[0].IsCoinBase()) {
+    if (block.vtx.empty() || !block.vtx[0]->IsCoinBase()) {
         error("IsCoinBase: %d", int(block.vtx.size()));
         if (!block.vtx.empty())
-            error("IsCoinBase: %d %d %d %d", block.vtx[0].vin.size(), block.vtx[0].vin[0].prevout.IsNull(), block.vtx[0].ContainsZerocoins(), block.vtx[0].IsLeasingReward());
+            error("IsCoinBase: %d %d %d %d", block.vtx[0]->vin.size(), block.vtx[0]->vin[0].prevout.IsNull(), block.vtx[0]->ContainsZerocoins(), block.vtx[0]->IsLeasingReward());
         throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block does not start with a coinbase");
     }
 
@@ -213,6 +213,7 @@ UniValue mnsync(const UniValue& params, bool fHelp)
         UniValue obj(UniValue::VOBJ);
 
         obj.push_back(Pair("IsBlockchainSynced", masternodeSync.IsBlockchainSynced()));
+        LOCK(masternodeSync.cs);
         obj.push_back(Pair("lastMasternodeList", masternodeSync.lastMasternodeList));
         obj.push_back(Pair("lastMasternodeWinner", masternodeSync.lastMasternodeWinner));
         obj.push_back(Pair("lastBudgetItem", masternodeSync.lastBudgetItem));
@@ -677,6 +678,10 @@ UniValue getstakingstatus(const UniValue& params, bool fHelp)
             "  \"hashLastStakeAttempt\": xxx       (hex string) hash of last block on top of which the miner attempted to stake\n"
             "  \"heightLastStakeAttempt\": n       (integer) height of last block on top of which the miner attempted to stake\n"
             "  \"timeLastStakeAttempt\": n         (integer) time of last attempted stake\n"
+            "  \"stakeinputs\": n                  (integer) stake kernels prepared on top of the last block\n"
+            "  \"inputsLastStakeAttempt\": n       (integer) stake kernels hashed in the last attempted time slot\n"
+            "  \"searchTimeLastStakeAttempt\": n   (integer) microseconds spent on the kernel search in the last attempted time slot\n"
+            "  \"stakethreads\": n                 (integer) threads searching for stake kernels (0 = search on the staking thread)\n"
             "}\n"
 
             "\nExamples:\n" +
@@ -700,6 +705,10 @@ UniValue getstakingstatus(const UniValue& params, bool fHelp)
         obj.push_back(Pair("heightLastStakeAttempt", (mapBlockIndex.count(lastHash) > 0 ?
                                                         mapBlockIndex.at(lastHash)->nHeight : -1)) );
         obj.push_back(Pair("timeLastStakeAttempt", pwalletMain->pStakerStatus->GetLastTime()));
+        obj.push_back(Pair("stakeinputs", (int)pwalletMain->pStakerStatus->GetStakeInputs()));
+        obj.push_back(Pair("inputsLastStakeAttempt", (int)pwalletMain->pStakerStatus->GetLastInputs()));
+        obj.push_back(Pair("searchTimeLastStakeAttempt", pwalletMain->pStakerStatus->GetLastSearchTime()));
+        obj.push_back(Pair("stakethreads", nStakeKernelThreads));
         return obj;
     }
 
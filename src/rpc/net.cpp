@@ -353,7 +353,18 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
             "{\n"
             "  \"totalbytesrecv\": n,   (numeric) Total bytes received\n"
             "  \"totalbytessent\": n,   (numeric) Total bytes sent\n"
-            "  \"timemillis\": t        (numeric) Total cpu time\n"
+            "  \"timemillis\": t,       (numeric) Total cpu time\n"
+            "  \"messagelanes\": [      (array) Message processing lanes\n"
+            "    {\n"
+            "      \"name\": \"xxxx\",          (string) general, or masternode for masternode, budget, spork and swifttx messages\n"
+            "      \"queuedepth\": n,         (numeric) Messages received and not processed yet\n"
+            "      \"peakqueuedepth\": n,     (numeric) Highest queue depth seen\n"
+            "      \"processed\": n,          (numeric) Messages processed\n"
+            "      \"avglatencymillis\": n,   (numeric) Average time from receipt to the end of processing\n"
+            "      \"maxlatencymillis\": n    (numeric) Longest time from receipt to the end of processing\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
             "}\n"
 
             "\nExamples:\n" +
@@ -363,6 +374,21 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
     obj.push_back(Pair("totalbytesrecv", CNode::GetTotalBytesRecv()));
     obj.push_back(Pair("totalbytessent", CNode::GetTotalBytesSent()));
     obj.push_back(Pair("timemillis", GetTimeMillis()));
+
+    std::vector<CMessageLaneStats> vLaneStats;
+    GetMessageLaneStats(vLaneStats);
+    UniValue lanes(UniValue::VARR);
+    for (const CMessageLaneStats& stats : vLaneStats) {
+        UniValue lane(UniValue::VOBJ);
+        lane.push_back(Pair("name", stats.strName));
+        lane.push_back(Pair("queuedepth", (uint64_t)stats.nQueueDepth));
+        lane.push_back(Pair("peakqueuedepth", (uint64_t)stats.nPeakQueueDepth));
+        lane.push_back(Pair("processed", stats.nProcessed));
+        lane.push_back(Pair("avglatencymillis", stats.nProcessed ? (double)stats.nTotalLatency / stats.nProcessed / 1000 : 0.0));
+        lane.push_back(Pair("maxlatencymillis", (double)stats.nMaxLatency / 1000));
+        lanes.push_back(lane);
+    }
+    obj.push_back(Pair("messagelanes", lanes));
     return obj;
 }
 
@@ -170,7 +170,7 @@ boost::optional<std::pair<CTxIn, CKey>> GetGenesisVinKey()
 {
     boost::optional<std::pair<CTxIn, CKey>> vinKeyOpt;
     
-    auto genesisValidators = Params().GenesisBlock().vtx[0].validatorRegister;
+    auto genesisValidators = Params().GenesisBlock().vtx[0]->validatorRegister;
     for(auto &gv : genesisValidators)
     {
         CKey key;
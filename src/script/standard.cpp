@@ -664,6 +664,27 @@ bool ExtractDestinations(const CScript& scriptPubKey, txnouttype& typeRet, std::
     return true;
 }
 
+void ExtractScriptKeyHashes(const CScript& scriptPubKey, std::vector<uint160>& vHashesRet)
+{
+    vHashesRet.clear();
+    std::vector<valtype> vSolutions;
+    txnouttype whichType;
+    if (!Solver(scriptPubKey, whichType, vSolutions))
+        return;
+
+    for (const valtype& solution : vSolutions) {
+        if (solution.size() == 20) {
+            vHashesRet.push_back(uint160(solution));
+        } else if (solution.size() == 33 || solution.size() == 65) {
+            vHashesRet.push_back(CPubKey(solution).GetID());
+        } else if (solution.size() == 32) {
+            uint160 hash;
+            CRIPEMD160().Write(solution.data(), solution.size()).Finalize(hash.begin());
+            vHashesRet.push_back(hash);
+        }
+    }
+}
+
 namespace
 {
 class CScriptVisitor
@@ -203,6 +203,12 @@ bool IsStandard(const CScript& scriptPubKey, txnouttype& whichType);
 bool ExtractDestination(const CScript& scriptPubKey, CTxDestination& addressRet, bool fColdStake = false, bool fLease = false);
 bool ExtractDestination(const CScript& scriptPubKey, CTxDestination& addressRet, txnouttype *typeRet);
 bool ExtractDestinations(const CScript& scriptPubKey, txnouttype& typeRet, std::vector<CTxDestination>& addressRet, int& nRequiredRet);
+/**
+ * Hashes of the keys and redeem scripts a script refers to: key and script hashes as they
+ * appear, public keys by their key ID and P2WSH programs by their script ID. Apart from
+ * whole watch-only and multisig scripts, these are all IsMine() can recognize a script by.
+ */
+void ExtractScriptKeyHashes(const CScript& scriptPubKey, std::vector<uint160>& vHashesRet);
 /** Check whether a CTxDestination is a CNoDestination. */
 bool IsValidDestination(const CTxDestination& dest);
 
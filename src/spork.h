@@ -111,6 +111,8 @@ public:
 
     void ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
     int64_t GetSporkValue(SporkId nSporkID);
+    /** Find a relayed spork message by its hash, mapSporks is guarded by cs */
+    bool GetSporkByHash(const uint256& hash, CSporkMessage& sporkRet) const;
     void ExecuteSpork(SporkId nSporkID, int nValue);
     bool UpdateSpork(SporkId nSporkID, int64_t nValue);
 
@@ -6,6 +6,7 @@
 #include "stakeinput.h"
 
 #include "chain.h"
+#include "kernel.h"
 #include "main.h"
 #include "txdb.h"
 #include "zbtcu/deterministicmint.h"
@@ -14,32 +15,40 @@
 
 bool CBTCUStake::SetInput(CTransaction txPrev, unsigned int n)
 {
-    this->txFrom = txPrev;
-    this->nPosition = n;
+    if (n >= txPrev.vout.size())
+        return false;
+    return SetInput(COutPoint(txPrev.GetHash(), n), txPrev.vout[n]);
+}
+
+bool CBTCUStake::SetInput(const COutPoint& prevoutIn, const CTxOut& txoutIn, CBlockIndex* pindexFromIn)
+{
+    this->prevout = prevoutIn;
+    this->txout = txoutIn;
+    this->pindexFrom = pindexFromIn;
     return true;
 }
 
 bool CBTCUStake::GetTxFrom(CTransaction& tx) const
 {
-    tx = txFrom;
-    return true;
+    uint256 hashBlock;
+    return GetTransaction(prevout.hash, tx, hashBlock, true);
 }
 
 bool CBTCUStake::CreateTxIn(CWallet* pwallet, CTxIn& txIn, uint256 hashTxOut)
 {
-    txIn = CTxIn(txFrom.GetHash(), nPosition);
+    txIn = CTxIn(prevout.hash, prevout.n);
     return true;
 }
 
 CAmount CBTCUStake::GetValue() const
 {
-    return txFrom.vout[nPosition].nValue;
+    return txout.nValue;
 }
 
 bool CBTCUStake::CreateTxOuts(CWallet* pwallet, std::vector<CTxOut>& vout, CAmount nTotal) {
     std::vector<valtype> vSolutions;
     txnouttype whichType;
-    CScript scriptPubKeyKernel = txFrom.vout[nPosition].scriptPubKey;
+    CScript scriptPubKeyKernel = txout.scriptPubKey;
     if (!Solver(scriptPubKeyKernel, whichType, vSolutions))
         return error("%s: failed to parse kernel", __func__);
 
@@ -87,7 +96,7 @@ CDataStream CBTCUStake::GetUniqueness() const
 {
     //The unique identifier for a BTCU stake is the outpoint
     CDataStream ss(SER_NETWORK, 0);
-    ss << nPosition << txFrom.GetHash();
+    ss << prevout.n << prevout.hash;
     return ss;
 }
 
@@ -96,17 +105,12 @@ CBlockIndex* CBTCUStake::GetIndexFrom()
 {
     if (pindexFrom)
         return pindexFrom;
-    uint256 hashBlock = 0;
-    CTransaction tx;
-    if (GetTransaction(txFrom.GetHash(), tx, hashBlock, true)) {
+    CStakeInputInfo info;
+    if (GetStakeInputInfo(prevout, info)) {
         // If the index is in the chain, then set it as the "index from"
-        if (mapBlockIndex.count(hashBlock)) {
-            CBlockIndex* pindex = mapBlockIndex.at(hashBlock);
-            if (chainActive.Contains(pindex))
-                pindexFrom = pindex;
-        }
+        pindexFrom = info.pindexFrom;
     } else {
-        LogPrintf("%s : failed to find tx %s\n", __func__, txFrom.GetHash().GetHex());
+        LogPrintf("%s : failed to find tx %s\n", __func__, prevout.hash.GetHex());
     }
 
     return pindexFrom;
@@ -34,13 +34,15 @@ public:
 class CBTCUStake : public CStakeInput
 {
 private:
-    CTransaction txFrom;
-    unsigned int nPosition = 0;
+    COutPoint prevout;
+    CTxOut txout;
 
 public:
     CBTCUStake(){}
 
     bool SetInput(CTransaction txPrev, unsigned int n);
+    //! Set from the spent output alone, with the block it was created in when already known
+    bool SetInput(const COutPoint& prevoutIn, const CTxOut& txoutIn, CBlockIndex* pindexFromIn = nullptr);
 
     CBlockIndex* GetIndexFrom() override;
     bool GetTxFrom(CTransaction& tx) const override;
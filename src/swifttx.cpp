@@ -21,6 +21,7 @@
 #include <boost/foreach.hpp>
 
 
+CCriticalSection cs_swifttx;
 std::map<uint256, CTransaction> mapTxLockReq;
 std::map<uint256, CTransaction> mapTxLockReqRejected;
 std::map<uint256, CConsensusVote> mapTxLockVote;
@@ -52,8 +53,11 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         pfrom->AddInventoryKnown(inv);
         GetMainSignals().Inventory(inv.hash);
 
-        if (mapTxLockReq.count(tx.GetHash()) || mapTxLockReqRejected.count(tx.GetHash())) {
-            return;
+        {
+            LOCK(cs_swifttx);
+            if (mapTxLockReq.count(tx.GetHash()) || mapTxLockReqRejected.count(tx.GetHash())) {
+                return;
+            }
         }
 
         if (!IsIXTXValid(tx)) {
@@ -84,7 +88,10 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
 
             DoConsensusVote(tx, nBlockHeight);
 
-            mapTxLockReq.insert(std::make_pair(tx.GetHash(), tx));
+            {
+                LOCK(cs_swifttx);
+                mapTxLockReq.insert(std::make_pair(tx.GetHash(), tx));
+            }
 
             LogPrintf("%s : Transaction Lock Request: %s %s : accepted %s\n", __func__,
                     pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
@@ -97,35 +104,41 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
             return;
 
         } else {
-            mapTxLockReqRejected.insert(std::make_pair(tx.GetHash(), tx));
-
-            // can we get the conflicting transaction as proof?
-
             LogPrintf("%s : Transaction Lock Request: %s %s : rejected %s\n", __func__,
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
                 tx.GetHash().ToString().c_str());
 
-            for (const CTxIn& in : tx.vin) {
-                if (!mapLockedInputs.count(in.prevout)) {
-                    mapLockedInputs.insert(std::make_pair(in.prevout, tx.GetHash()));
+            bool fReprocess = false;
+            {
+                LOCK(cs_swifttx);
+                mapTxLockReqRejected.insert(std::make_pair(tx.GetHash(), tx));
+
+                // can we get the conflicting transaction as proof?
+
+                for (const CTxIn& in : tx.vin) {
+                    if (!mapLockedInputs.count(in.prevout)) {
+                        mapLockedInputs.insert(std::make_pair(in.prevout, tx.GetHash()));
+                    }
                 }
-            }
 
-            // resolve conflicts
-            std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(tx.GetHash());
-            if (i != mapTxLocks.end()) {
-                //we only care if we have a complete tx lock
-                if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
-                    if (!CheckForConflictingLocks(tx)) {
-                        LogPrintf("%s : Found Existing Complete IX Lock\n", __func__);
-
-                        //reprocess the last 15 blocks
-                        ReprocessBlocks(15);
-                        mapTxLockReq.insert(std::make_pair(tx.GetHash(), tx));
+                // resolve conflicts
+                std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(tx.GetHash());
+                if (i != mapTxLocks.end()) {
+                    //we only care if we have a complete tx lock
+                    if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
+                        if (!CheckForConflictingLocks(tx)) {
+                            LogPrintf("%s : Found Existing Complete IX Lock\n", __func__);
+                            mapTxLockReq.insert(std::make_pair(tx.GetHash(), tx));
+                            fReprocess = true;
+                        }
                     }
                 }
             }
 
+            //reprocess the last 15 blocks
+            if (fReprocess)
+                ReprocessBlocks(15);
+
             return;
         }
     } else if (strCommand == "txlvote") // SwiftX Lock Consensus Votes
@@ -136,12 +149,13 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockVote.count(ctx.GetHash())) {
-            return;
+        {
+            LOCK(cs_swifttx);
+            if (!mapTxLockVote.insert(std::make_pair(ctx.GetHash(), ctx)).second) {
+                return;
+            }
         }
 
-        mapTxLockVote.insert(std::make_pair(ctx.GetHash(), ctx));
-
         if (ProcessConsensusVote(pfrom, ctx)) {
             //Spam/Dos protection
             /*
@@ -149,26 +163,38 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
                 This tracks those messages and allows it at the same rate of the rest of the network, if
                 a peer violates it, it will simply be ignored
             */
-            if (!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash)) {
-                if (!mapUnknownVotes.count(ctx.vinMasternode.prevout.hash)) {
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
-                }
+            {
+                LOCK(cs_swifttx);
+                if (!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash)) {
+                    if (!mapUnknownVotes.count(ctx.vinMasternode.prevout.hash)) {
+                        mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
+                    }
 
-                if (mapUnknownVotes[ctx.vinMasternode.prevout.hash] > GetTime() &&
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] - GetAverageVoteTime() > 60 * 10) {
-                    LogPrintf("%s : masternode is spamming transaction votes: %s %s\n", __func__,
-                        ctx.vinMasternode.ToString().c_str(),
-                        ctx.txHash.ToString().c_str());
-                    return;
-                } else {
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
+                    if (mapUnknownVotes[ctx.vinMasternode.prevout.hash] > GetTime() &&
+                        mapUnknownVotes[ctx.vinMasternode.prevout.hash] - GetAverageVoteTime() > 60 * 10) {
+                        LogPrintf("%s : masternode is spamming transaction votes: %s %s\n", __func__,
+                            ctx.vinMasternode.ToString().c_str(),
+                            ctx.txHash.ToString().c_str());
+                        return;
+                    } else {
+                        mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
+                    }
                 }
             }
             RelayInv(inv);
         }
 
-        if (mapTxLockReq.count(ctx.txHash) && GetTransactionLockSignatures(ctx.txHash) == SWIFTTX_SIGNATURES_REQUIRED) {
-            GetMainSignals().NotifyTransactionLock(mapTxLockReq[ctx.txHash]);
+        // the wallet is notified with cs_swifttx released
+        CTransaction txLocked;
+        {
+            LOCK(cs_swifttx);
+            std::map<uint256, CTransaction>::const_iterator it = mapTxLockReq.find(ctx.txHash);
+            if (it == mapTxLockReq.end())
+                return;
+            txLocked = it->second;
+        }
+        if (GetTransactionLockSignatures(ctx.txHash) == SWIFTTX_SIGNATURES_REQUIRED) {
+            GetMainSignals().NotifyTransactionLock(txLocked);
         }
 
         return;
@@ -240,8 +266,13 @@ int64_t CreateNewLock(CTransaction tx)
         This prevents attackers from using transaction mallibility to predict which masternodes
         they'll use.
     */
-    int nBlockHeight = (chainActive.Tip()->nHeight - nTxAge) + 4;
+    int nBlockHeight;
+    {
+        LOCK(cs_main);
+        nBlockHeight = (chainActive.Tip()->nHeight - nTxAge) + 4;
+    }
 
+    LOCK(cs_swifttx);
     if (!mapTxLocks.count(tx.GetHash())) {
         LogPrintf("%s : New Transaction Lock %s !\n", __func__, tx.GetHash().ToString().c_str());
 
@@ -300,7 +331,10 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
         return;
     }
 
-    mapTxLockVote[ctx.GetHash()] = ctx;
+    {
+        LOCK(cs_swifttx);
+        mapTxLockVote[ctx.GetHash()] = ctx;
+    }
 
     CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
     RelayInv(inv);
@@ -334,31 +368,28 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
         return error("%s : Signature invalid\n", __func__);
     }
 
-    if (!mapTxLocks.count(ctx.txHash)) {
-        LogPrintf("%s : New Transaction Lock %s !\n", __func__, ctx.txHash.ToString().c_str());
-
-        CTransactionLock newLock;
-        newLock.nBlockHeight = 0;
-        newLock.nExpiration = GetTime() + (60 * 60);
-        newLock.nTimeout = GetTime() + (60 * 5);
-        newLock.txHash = ctx.txHash;
-        mapTxLocks.insert(std::make_pair(ctx.txHash, newLock));
-    } else
-        LogPrint("swiftx", "%s : Transaction Lock Exists %s !\n", __func__, ctx.txHash.ToString().c_str());
-
-    //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(ctx.txHash);
-    if (i != mapTxLocks.end()) {
+    bool fComplete = false;
+    bool fReprocess = false;
+    {
+        LOCK(cs_swifttx);
+        if (!mapTxLocks.count(ctx.txHash)) {
+            LogPrintf("%s : New Transaction Lock %s !\n", __func__, ctx.txHash.ToString().c_str());
+
+            CTransactionLock newLock;
+            newLock.nBlockHeight = 0;
+            newLock.nExpiration = GetTime() + (60 * 60);
+            newLock.nTimeout = GetTime() + (60 * 5);
+            newLock.txHash = ctx.txHash;
+            mapTxLocks.insert(std::make_pair(ctx.txHash, newLock));
+        } else
+            LogPrint("swiftx", "%s : Transaction Lock Exists %s !\n", __func__, ctx.txHash.ToString().c_str());
+
+        //compile consessus vote
+        std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(ctx.txHash);
+        if (i == mapTxLocks.end())
+            return false;
         (*i).second.AddSignature(ctx);
 
-#ifdef ENABLE_WALLET
-        if (pwalletMain) {
-            //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
-            if (pwalletMain->mapRequestCount.count(ctx.txHash))
-                pwalletMain->mapRequestCount[ctx.txHash]++;
-        }
-#endif
-
         LogPrint("swiftx", "%s : Transaction Lock Votes %d - %s !\n", __func__, (*i).second.CountSignatures(), ctx.GetHash().ToString().c_str());
 
         if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
@@ -366,13 +397,7 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
 
             CTransaction& tx = mapTxLockReq[ctx.txHash];
             if (!CheckForConflictingLocks(tx)) {
-#ifdef ENABLE_WALLET
-                if (pwalletMain) {
-                    if (pwalletMain->UpdatedTransaction((*i).second.txHash)) {
-                        nCompleteTXLocks++;
-                    }
-                }
-#endif
+                fComplete = true;
 
                 if (mapTxLockReq.count(ctx.txHash)) {
                     for (const CTxIn& in : tx.vin) {
@@ -385,16 +410,31 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
                 // resolve conflicts
 
                 //if this tx lock was rejected, we need to remove the conflicting blocks
-                if (mapTxLockReqRejected.count((*i).second.txHash)) {
-                    //reprocess the last 15 blocks
-                    ReprocessBlocks(15);
-                }
+                fReprocess = mapTxLockReqRejected.count((*i).second.txHash);
             }
         }
-        return true;
     }
 
-    return false;
+#ifdef ENABLE_WALLET
+    if (pwalletMain) {
+        {
+            //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
+            LOCK(pwalletMain->cs_wallet);
+            if (pwalletMain->mapRequestCount.count(ctx.txHash))
+                pwalletMain->mapRequestCount[ctx.txHash]++;
+        }
+        if (fComplete && pwalletMain->UpdatedTransaction(ctx.txHash)) {
+            LOCK(cs_swifttx);
+            nCompleteTXLocks++;
+        }
+    }
+#endif
+
+    //reprocess the last 15 blocks
+    if (fReprocess)
+        ReprocessBlocks(15);
+
+    return true;
 }
 
 bool CheckForConflictingLocks(CTransaction& tx)
@@ -406,6 +446,7 @@ bool CheckForConflictingLocks(CTransaction& tx)
         Blocks could have been rejected during this time, which is OK. After they cancel out, the client will
         rescan the blocks and find they're acceptable and then take the chain with the most work.
     */
+    LOCK(cs_swifttx);
     for (const CTxIn& in : tx.vin) {
         if (mapLockedInputs.count(in.prevout)) {
             if (mapLockedInputs[in.prevout] != tx.GetHash()) {
@@ -423,6 +464,7 @@ bool CheckForConflictingLocks(CTransaction& tx)
 
 int64_t GetAverageVoteTime()
 {
+    LOCK(cs_swifttx);
     std::map<uint256, int64_t>::iterator it = mapUnknownVotes.begin();
     int64_t total = 0;
     int64_t count = 0;
@@ -440,6 +482,7 @@ void CleanTransactionLocksList()
 {
     if (chainActive.Tip() == NULL) return;
 
+    LOCK(cs_swifttx);
     std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.begin();
 
     while (it != mapTxLocks.end()) {
@@ -472,6 +515,7 @@ int GetTransactionLockSignatures(uint256 txHash)
     if(fLargeWorkForkFound || fLargeWorkInvalidChainFound) return -2;
     if (!sporkManager.IsSporkActive(SPORK_2_SWIFTTX)) return -1;
 
+    LOCK(cs_swifttx);
     std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.find(txHash);
     if(it != mapTxLocks.end()) return it->second.CountSignatures();
 
@@ -34,6 +34,8 @@ class CTransactionLock;
 
 static const int MIN_SWIFTTX_PROTO_VERSION = 70103;
 
+/** Guards the maps below. Nothing else is locked while it is held. */
+extern CCriticalSection cs_swifttx;
 extern std::map<uint256, CTransaction> mapTxLockReq;
 extern std::map<uint256, CTransaction> mapTxLockReqRejected;
 extern std::map<uint256, CConsensusVote> mapTxLockVote;
@@ -0,0 +1,274 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockencodings.h"
+
+#include "consensus/merkle.h"
+#include "hash.h"
+#include "keystore.h"
+#include "main.h"
+#include "miner.h"
+#include "net.h"
+#include "pow.h"
+#include "script/sign.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "txmempool.h"
+#include "version.h"
+#include "test/test_btcu.h"
+
+#include <memory>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockencodings_tests, BasicTestingSetup)
+
+static const std::vector<std::pair<uint256, CTransactionRef> > empty_extra_txn;
+
+// A coinbase followed by a transaction with two children
+static CBlock BuildBlockTestCase()
+{
+    CBlock block;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig.resize(10);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 42;
+
+    block.vtx.resize(3);
+    block.vtx[0] = MakeTransactionRef(tx);
+    block.nVersion = 42;
+    block.hashPrevBlock = InsecureRand256();
+    block.nBits = 0x207fffff;
+
+    tx.vin[0].prevout.hash = InsecureRand256();
+    tx.vin[0].prevout.n = 0;
+    block.vtx[1] = MakeTransactionRef(tx);
+
+    tx.vin.resize(10);
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        tx.vin[i].prevout.hash = InsecureRand256();
+        tx.vin[i].prevout.n = 0;
+    }
+    block.vtx[2] = MakeTransactionRef(tx);
+
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
+
+static CBlockHeaderAndShortTxIDs RoundTrip(const CBlockHeaderAndShortTxIDs& cmpctblock)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << cmpctblock;
+    CBlockHeaderAndShortTxIDs cmpctblockRead;
+    stream >> cmpctblockRead;
+    return cmpctblockRead;
+}
+
+BOOST_AUTO_TEST_CASE(cmpctblock_rebuild_from_mempool)
+{
+    CTxMemPool pool(CFeeRate(0));
+    CBlock block(BuildBlockTestCase());
+
+    pool.addUnchecked(block.vtx[2]->GetHash(), CTxMemPoolEntry(block.vtx[2], 0, 0, 0.0, 1));
+
+    CBlockHeaderAndShortTxIDs cmpctblock = RoundTrip(CBlockHeaderAndShortTxIDs(block));
+    BOOST_CHECK_EQUAL(cmpctblock.BlockTxCount(), block.vtx.size());
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(cmpctblock, empty_extra_txn) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(0));
+    BOOST_CHECK(!partialBlock.IsTxAvailable(1));
+    BOOST_CHECK(partialBlock.IsTxAvailable(2));
+
+    CBlock blockRead;
+    std::vector<CTransactionRef> vtx_missing(1, block.vtx[1]);
+    BOOST_CHECK(partialBlock.FillBlock(blockRead, vtx_missing) == READ_STATUS_OK);
+    BOOST_CHECK(blockRead.GetHash() == block.GetHash());
+    BOOST_CHECK(BlockMerkleRoot(blockRead) == block.hashMerkleRoot);
+}
+
+BOOST_AUTO_TEST_CASE(cmpctblock_rebuild_from_extra_txn)
+{
+    CTxMemPool pool(CFeeRate(0));
+    CBlock block(BuildBlockTestCase());
+
+    std::vector<std::pair<uint256, CTransactionRef> > extra_txn;
+    extra_txn.push_back(std::make_pair(block.vtx[1]->GetHash(), block.vtx[1]));
+    extra_txn.push_back(std::make_pair(block.vtx[2]->GetHash(), block.vtx[2]));
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(RoundTrip(CBlockHeaderAndShortTxIDs(block)), extra_txn) == READ_STATUS_OK);
+    for (size_t i = 0; i < block.vtx.size(); i++)
+        BOOST_CHECK(partialBlock.IsTxAvailable(i));
+
+    CBlock blockRead;
+    BOOST_CHECK(partialBlock.FillBlock(blockRead, std::vector<CTransactionRef>()) == READ_STATUS_OK);
+    BOOST_CHECK(blockRead.GetHash() == block.GetHash());
+}
+
+BOOST_AUTO_TEST_CASE(cmpctblock_wrong_transactions)
+{
+    CTxMemPool pool(CFeeRate(0));
+    CBlock block(BuildBlockTestCase());
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(RoundTrip(CBlockHeaderAndShortTxIDs(block)), empty_extra_txn) == READ_STATUS_OK);
+    BOOST_CHECK(!partialBlock.IsTxAvailable(1));
+    BOOST_CHECK(!partialBlock.IsTxAvailable(2));
+
+    // Transactions that do not match the merkle root, as after a short id collision
+    CBlock blockRead;
+    std::vector<CTransactionRef> vtx_missing;
+    vtx_missing.push_back(block.vtx[2]);
+    vtx_missing.push_back(block.vtx[1]);
+    BOOST_CHECK(partialBlock.FillBlock(blockRead, vtx_missing) == READ_STATUS_FAILED);
+
+    // Too few transactions
+    PartiallyDownloadedBlock partialBlock2(&pool);
+    BOOST_CHECK(partialBlock2.InitData(RoundTrip(CBlockHeaderAndShortTxIDs(block)), empty_extra_txn) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock2.FillBlock(blockRead, std::vector<CTransactionRef>(1, block.vtx[1])) == READ_STATUS_INVALID);
+}
+
+BOOST_AUTO_TEST_CASE(blocktxn_request_roundtrip)
+{
+    BlockTransactionsRequest req;
+    req.blockhash = InsecureRand256();
+    req.indexes.push_back(0);
+    req.indexes.push_back(1);
+    req.indexes.push_back(3);
+    req.indexes.push_back(std::numeric_limits<uint16_t>::max());
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << req;
+    BlockTransactionsRequest reqRead;
+    stream >> reqRead;
+
+    BOOST_CHECK(reqRead.blockhash == req.blockhash);
+    BOOST_CHECK(reqRead.indexes == req.indexes);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/** Regtest chain whose coinbases can be spent, to feed blocks to the message handler */
+struct CmpctBlockTestingSetup : public TestingSetup {
+    CKey coinbaseKey;
+    CBasicKeyStore keystore;
+    CScript scriptCoinbase;
+
+    CmpctBlockTestingSetup() : TestingSetup(CBaseChainParams::REGTEST)
+    {
+        coinbaseKey.MakeNewKey(true);
+        keystore.AddKey(coinbaseKey);
+        scriptCoinbase = GetScriptForDestination(PKHash(coinbaseKey.GetPubKey()));
+    }
+
+    CBlock CreateBlock(const std::vector<CTransactionRef>& vtx)
+    {
+        std::unique_ptr<CBlockTemplate> pblocktemplate(CreateNewBlock(scriptCoinbase, nullptr, false));
+        BOOST_REQUIRE(pblocktemplate);
+        CBlock block = pblocktemplate->block;
+        block.vtx.resize(1);
+        block.vtx.insert(block.vtx.end(), vtx.begin(), vtx.end());
+        unsigned int nExtraNonce = 0;
+        IncrementExtraNonce(&block, chainActive.Tip(), nExtraNonce);
+        while (!CheckProofOfWork(block.GetHash(), block.nBits))
+            ++block.nNonce;
+        return block;
+    }
+
+    CTransactionRef SpendCoinbase(const CTransactionRef& txFrom)
+    {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(txFrom->GetHash(), 0);
+        tx.vout.push_back(CTxOut(txFrom->vout[0].nValue, scriptCoinbase));
+        BOOST_REQUIRE(SignSignature(keystore, *txFrom, tx, 0, SIGHASH_ALL));
+        return MakeTransactionRef(tx);
+    }
+};
+
+template <typename T>
+static CDataStream Payload(const T& obj)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << obj;
+    return ss;
+}
+
+/** Hand one message to the peer's handler, as the socket handler and the message handler would */
+static void ReceiveMessage(CNode& node, const std::string& strCommand, const CDataStream& ssPayload)
+{
+    CMessageHeader hdr(strCommand.c_str(), ssPayload.size());
+    uint256 hash = Hash(ssPayload.begin(), ssPayload.end());
+    memcpy(&hdr.nChecksum, &hash, sizeof(hdr.nChecksum));
+    const std::string strMsg = Payload(hdr).str() + ssPayload.str();
+
+    LOCK(node.cs_vRecvMsg);
+    BOOST_REQUIRE(node.ReceiveMsgBytes(strMsg.data(), strMsg.size()));
+    ProcessMessages(&node);
+    BOOST_CHECK(node.vRecvMsg.empty());
+}
+
+static uint256 TipHash()
+{
+    LOCK(cs_main);
+    return chainActive.Tip()->GetBlockHash();
+}
+
+BOOST_FIXTURE_TEST_SUITE(cmpctblock_handler_tests, CmpctBlockTestingSetup)
+
+BOOST_AUTO_TEST_CASE(cmpctblock_then_blocktxn_connects)
+{
+    // Coinbases to spend, the first ones are mature once these are mined
+    std::vector<CTransactionRef> vCoinbases;
+    for (int i = 0; i <= Params().COINBASE_MATURITY(); i++) {
+        CBlock block = CreateBlock(std::vector<CTransactionRef>());
+        vCoinbases.push_back(block.vtx[0]);
+        CValidationState state;
+        BOOST_REQUIRE(ProcessNewBlock(state, nullptr, &block));
+    }
+
+    // The replies of the handler, such as getblocktxn, go to the other end of the pair
+    int fds[2];
+    BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    CNode node(fds[0], CAddress(), "", true);
+    node.nVersion = PROTOCOL_VERSION;
+    node.fSuccessfullyConnected = true;
+    {
+        LOCK(node.cs_vRecvMsg);
+        node.SetRecvVersion(PROTOCOL_VERSION);
+    }
+    ReceiveMessage(node, "sendcmpct", Payload(std::make_pair(false, CMPCTBLOCKS_VERSION)));
+
+    // The spend is not in our mempool, so rebuilding the block takes a blocktxn
+    CBlock block = CreateBlock(std::vector<CTransactionRef>(1, SpendCoinbase(vCoinbases[0])));
+    ReceiveMessage(node, "cmpctblock", Payload(CBlockHeaderAndShortTxIDs(block)));
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(mapBlockIndex.count(block.GetHash()));
+        BOOST_CHECK(!(mapBlockIndex[block.GetHash()]->nStatus & BLOCK_HAVE_DATA));
+    }
+    BOOST_CHECK(TipHash() != block.GetHash());
+
+    BlockTransactionsRequest req;
+    req.blockhash = block.GetHash();
+    req.indexes.push_back(1);
+    BlockTransactions resp(req);
+    resp.txn[0] = block.vtx[1];
+    ReceiveMessage(node, "blocktxn", Payload(resp));
+    BOOST_CHECK(TipHash() == block.GetHash());
+
+    // A block that comes in full after its cmpctblock, its header indexed already
+    CBlock block2 = CreateBlock(std::vector<CTransactionRef>(1, SpendCoinbase(vCoinbases[1])));
+    ReceiveMessage(node, "cmpctblock", Payload(CBlockHeaderAndShortTxIDs(block2)));
+    ReceiveMessage(node, "block", Payload(block2));
+    BOOST_CHECK(TipHash() == block2.GetHash());
+
+    SOCKET hPeer = fds[1];
+    CloseSocket(hPeer);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
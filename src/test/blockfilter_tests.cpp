@@ -0,0 +1,96 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "key.h"
+#include "primitives/block.h"
+#include "script/standard.h"
+#include "undo.h"
+#include "test/test_btcu.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilter_tests, BasicTestingSetup)
+
+static GCSFilter::Element RandomElement()
+{
+    GCSFilter::Element element(1 + InsecureRandRange(40));
+    for (unsigned char& c : element)
+        c = InsecureRandBits(8);
+    return element;
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_match)
+{
+    const uint256 hashKey = InsecureRand256();
+    GCSFilter::ElementSet included;
+    for (int i = 0; i < 100; i++)
+        included.insert(RandomElement());
+    GCSFilter::ElementSet excluded;
+    for (int i = 0; i < 100; i++) {
+        const GCSFilter::Element element = RandomElement();
+        if (!included.count(element))
+            excluded.insert(element);
+    }
+
+    GCSFilter filter(hashKey, included);
+    GCSFilter loaded(hashKey, filter.GetEncoded());
+    BOOST_CHECK_EQUAL(loaded.GetN(), included.size());
+
+    // No false negatives, and false positives at a rate of 1 / BLOCK_FILTER_M
+    for (const GCSFilter::Element& element : included)
+        BOOST_CHECK(loaded.MatchAny(GCSFilter::ElementSet{element}));
+    BOOST_CHECK(loaded.MatchAny(included));
+    BOOST_CHECK(!loaded.MatchAny(excluded));
+    BOOST_CHECK(!loaded.MatchAny(GCSFilter::ElementSet()));
+
+    // An empty filter matches nothing, a truncated one everything
+    BOOST_CHECK(!GCSFilter(hashKey, GCSFilter::ElementSet()).MatchAny(included));
+    std::vector<unsigned char> vTruncated = filter.GetEncoded();
+    vTruncated.resize(vTruncated.size() / 2);
+    BOOST_CHECK(GCSFilter(hashKey, vTruncated).MatchAny(excluded));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_scripts)
+{
+    CKey keyOut, keySpent, keyOther;
+    keyOut.MakeNewKey(true);
+    keySpent.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vout.resize(1);
+    coinbase.vout[0].scriptPubKey = GetScriptForDestination(PKHash(keyOut.GetPubKey()));
+    CMutableTransaction spend;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+    spend.vout.resize(1);
+
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    block.vtx.push_back(MakeTransactionRef(spend));
+    CBlockUndo blockundo;
+    blockundo.vtxundo.resize(1);
+    blockundo.vtxundo[0].vprevout.emplace_back(CTxOut(1, GetScriptForDestination(PKHash(keySpent.GetPubKey()))));
+
+    const GCSFilter filter = BuildBlockFilter(block, blockundo);
+
+    // Outputs and spent outputs match by key hash, whatever the script type
+    const CKeyID idOut = keyOut.GetPubKey().GetID();
+    const CKeyID idSpent = keySpent.GetPubKey().GetID();
+    const CKeyID idOther = keyOther.GetPubKey().GetID();
+    BOOST_CHECK(filter.MatchAny(GCSFilter::ElementSet{GCSFilter::Element(idOut.begin(), idOut.end())}));
+    BOOST_CHECK(filter.MatchAny(GCSFilter::ElementSet{GCSFilter::Element(idSpent.begin(), idSpent.end())}));
+    BOOST_CHECK(!filter.MatchAny(GCSFilter::ElementSet{GCSFilter::Element(idOther.begin(), idOther.end())}));
+
+    const CScript script = coinbase.vout[0].scriptPubKey;
+    BOOST_CHECK(filter.MatchAny(GCSFilter::ElementSet{GCSFilter::Element(script.begin(), script.end())}));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -12,10 +12,12 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "hash.h"
 #include "random.h"
 #include "utilstrencodings.h"
 #include "test/test_btcu.h"
 
+#include <algorithm>
 #include <vector>
 
 #include <boost/assign/list_of.hpp>
@@ -148,6 +150,26 @@ BOOST_AUTO_TEST_CASE(sha256_testvectors) {
     TestSHA256(test1, "a316d55510b49662420f49d145d42fb83f31ef8dc016aa4e32df049991a91e26");
 }
 
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    // Every backend the CPU supports, alone and together, must match double SHA-256 through CHash256
+    for (int use = sha256_implementation::STANDARD; use <= sha256_implementation::USE_ALL; ++use) {
+        SHA256AutoDetect((sha256_implementation::UseImplementation)use);
+        for (int blocks = 0; blocks <= 34; blocks++) {
+            std::vector<unsigned char> in = InsecureRandBytes(64 * blocks);
+            std::vector<unsigned char> out1(32 * blocks), out2(32 * blocks);
+            for (int i = 0; i < blocks; i++)
+                CHash256().Write(&in[64 * i], 64).Finalize(&out1[32 * i]);
+            SHA256D64(out2.data(), in.data(), blocks);
+            BOOST_CHECK(out1 == out2);
+            // in place, as the merkle root computation uses it
+            SHA256D64(in.data(), in.data(), blocks);
+            BOOST_CHECK(std::equal(out1.begin(), out1.end(), in.begin()));
+        }
+    }
+    SHA256AutoDetect();
+}
+
 BOOST_AUTO_TEST_CASE(sha512_testvectors) {
     TestSHA512("",
                "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
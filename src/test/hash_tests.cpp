@@ -3,7 +3,11 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "hash.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "streams.h"
 #include "utilstrencodings.h"
+#include "version.h"
 #include "test/test_btcu.h"
 
 #include <vector>
@@ -46,4 +50,56 @@ BOOST_AUTO_TEST_CASE(murmurhash3)
 #undef T
 }
 
+// Header hash computed again from the serialized header, which no cache can answer
+static uint256 UncachedHeaderHash(const CBlockHeader& header)
+{
+    CDataStream ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << header;
+    if (header.nVersion < 4)
+        return HashQuark(ss.begin(), ss.end());
+    return Hash(ss.begin(), ss.end());
+}
+
+BOOST_AUTO_TEST_CASE(quark_header_batch)
+{
+    // Mixed legacy Quark and double SHA-256 headers must hash the same in a batch as one by one
+    std::vector<CBlockHeader> headers(20);
+    for (size_t i = 0; i < headers.size(); i++) {
+        CBlockHeader& header = headers[i];
+        header.nVersion = (i % 3 == 0) ? 4 : 1 + i % 3;
+        header.hashPrevBlock = InsecureRand256();
+        header.hashMerkleRoot = InsecureRand256();
+        header.nTime = InsecureRand32();
+        header.nBits = 0x1e0ffff0;
+        header.nNonce = InsecureRand32();
+    }
+
+    std::vector<const unsigned char*> vInputs;
+    std::vector<uint256> vExpected;
+    for (const CBlockHeader& header : headers) {
+        if (header.nVersion < 4) {
+            vInputs.push_back((const unsigned char*)&header.nVersion);
+            vExpected.push_back(HashQuark(BEGIN(header.nVersion), END(header.nNonce)));
+        }
+    }
+    std::vector<uint256> vBatch;
+    HashQuarkBatch(vInputs, 80, vBatch);
+    BOOST_CHECK(vBatch == vExpected);
+
+    const std::vector<uint256> vHashes = GetBlockHeaderHashes(headers);
+    BOOST_CHECK_EQUAL(vHashes.size(), headers.size());
+    for (size_t i = 0; i < headers.size(); i++)
+        BOOST_CHECK(vHashes[i] == UncachedHeaderHash(headers[i]));
+
+    // The cached hash follows the header content
+    CBlockHeader header = headers[1];
+    const uint256 hash = header.GetHash();
+    BOOST_CHECK(hash == UncachedHeaderHash(header));
+    header.nNonce++;
+    BOOST_CHECK(header.GetHash() == UncachedHeaderHash(header));
+    BOOST_CHECK(header.GetHash() != hash);
+    header.nNonce--;
+    BOOST_CHECK(header.GetHash() == hash);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
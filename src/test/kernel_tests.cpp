@@ -0,0 +1,55 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "kernel.h"
+#include "random.h"
+#include "stakeinput.h"
+#include "test/test_btcu.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(kernel_tests, BasicTestingSetup)
+
+// The staker hashes kernels from a midstate kept between time slots, which has
+// to give the proof of stake hash validation computes from the full preimage
+BOOST_AUTO_TEST_CASE(stake_kernel_midstate)
+{
+    CBlockIndex indexFrom;
+    indexFrom.nHeight = 1;
+    indexFrom.nTime = 1600000000;
+    CBlockIndex indexPrev;
+    indexPrev.nHeight = Params().LAST_POW_BLOCK() + 1000;
+    indexPrev.nTime = 1600100000;
+    indexPrev.nStakeModifierV2 = GetRandHash();
+    BOOST_REQUIRE(Params().IsStakeModifierV2(indexPrev.nHeight + 1));
+
+    // A target nearly every hash meets, so the search reports the hash it computed
+    const unsigned int nBits = 0x2100ffff;
+    std::vector<CBTCUStake> vStakes(8);
+    std::vector<CStakeKernel> vKernels(vStakes.size());
+    for (size_t i = 0; i < vStakes.size(); i++) {
+        vStakes[i].SetInput(COutPoint(GetRandHash(), i), CTxOut(100, CScript()), &indexFrom);
+        BOOST_REQUIRE(InitStakeKernel(&indexPrev, &vStakes[i], vKernels[i]));
+    }
+
+    for (unsigned int nTimeTx = indexPrev.nTime + 1; nTimeTx < indexPrev.nTime + 64; nTimeTx += 15) {
+        for (size_t i = 0; i < vStakes.size(); i++) {
+            uint256 hashCheck;
+            const bool fCheck = CheckStakeKernelHash(&indexPrev, nBits, &vStakes[i], nTimeTx, hashCheck);
+
+            uint256 hashSearch;
+            unsigned int nEvaluated = 0;
+            const std::vector<CStakeKernel> vKernel(1, vKernels[i]);
+            const bool fSearch = SearchStakeKernels(vKernel, nBits, nTimeTx, hashSearch, nEvaluated) == 0;
+            BOOST_CHECK_EQUAL(nEvaluated, 1U);
+            BOOST_CHECK_EQUAL(fSearch, fCheck);
+            if (fSearch)
+                BOOST_CHECK(hashSearch == hashCheck);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
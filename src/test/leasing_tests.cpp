@@ -0,0 +1,147 @@
+// Copyright (c) 2020 The BTCU developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "leasing/leasing_tiers.h"
+#include "test/test_btcu.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+// The if/else ladders the tier tables replaced, kept as the reference schedule
+static int64_t LadderHeightPct(int64_t nHeight)
+{
+    if (nHeight < 500000) return 15;
+    else if (nHeight < 1000000) return 14;
+    else if (nHeight < 1500000) return 13;
+    else if (nHeight < 2000000) return 12;
+    else if (nHeight < 2500000) return 11;
+    else if (nHeight < 3000000) return 10;
+    else if (nHeight < 3500000) return 9;
+    else if (nHeight < 4000000) return 8;
+    else if (nHeight < 4500000) return 7;
+    else if (nHeight < 5000000) return 6;
+    else if (nHeight < 5500000) return 5;
+    else if (nHeight < 6000000) return 4;
+    else if (nHeight < 6500000) return 3;
+    else if (nHeight < 7000000) return 2;
+    return 1;
+}
+
+static int64_t LadderSupplyPct(int64_t supply)
+{
+    if (supply < 500000) return 100;
+    else if (supply < 1000000) return 95;
+    else if (supply < 2000000) return 90;
+    else if (supply < 3000000) return 85;
+    else if (supply < 4000000) return 80;
+    else if (supply < 5000000) return 75;
+    else if (supply < 6000000) return 70;
+    else if (supply < 7000000) return 65;
+    else if (supply < 8000000) return 60;
+    else if (supply < 9000000) return 55;
+    else if (supply < 10000000) return 50;
+    return 45;
+}
+
+static int64_t LadderAmountPct(int64_t aAmount)
+{
+    if (aAmount < 5000) return 100;
+    else if (aAmount < 10000) return 95;
+    else if (aAmount < 20000) return 90;
+    else if (aAmount < 50000) return 85;
+    else if (aAmount < 100000) return 80;
+    else if (aAmount < 200000) return 75;
+    else if (aAmount < 300000) return 70;
+    else if (aAmount < 400000) return 65;
+    else if (aAmount < 500000) return 60;
+    else if (aAmount < 1000000) return 55;
+    return 50;
+}
+
+static int64_t LadderAgePct(int64_t nAge)
+{
+    if (nAge < 30000) return 100;
+    else if (nAge < 90000) return 110;
+    else if (nAge < 180000) return 120;
+    else if (nAge < 270000) return 130;
+    else if (nAge < 360000) return 140;
+    else if (nAge < 540000) return 150;
+    else if (nAge < 720000) return 160;
+    else if (nAge < 1080000) return 170;
+    else if (nAge < 1440000) return 180;
+    else if (nAge < 1800000) return 190;
+    return 200;
+}
+
+static int64_t LadderNodePct(int64_t aAmount, bool fValidator)
+{
+    static const int64_t bounds[] = {30000, 90000, 180000, 270000, 360000, 540000, 720000, 1080000, 1440000, 1800000};
+    for (int64_t i = 0; i < (int64_t)(sizeof(bounds) / sizeof(bounds[0])); ++i)
+        if (aAmount < bounds[i])
+            return fValidator ? 20 - 2 * i : 10 - i;
+    return 0;
+}
+
+// every bound of the schedule and its neighbours, plus the extremes
+template <size_t N>
+static std::vector<int64_t> ProbeValues(const CLeasingTier (&tiers)[N])
+{
+    std::vector<int64_t> values = {std::numeric_limits<int64_t>::min(), -1, 0, 1, LEASING_TIER_MAX};
+    for (const auto& tier : tiers) {
+        if (tier.nUpperBound == LEASING_TIER_MAX)
+            continue;
+        values.push_back(tier.nUpperBound - 1);
+        values.push_back(tier.nUpperBound);
+        values.push_back(tier.nUpperBound + 1);
+    }
+    return values;
+}
+
+BOOST_FIXTURE_TEST_SUITE(leasing_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(leasing_tiers_match_ladders)
+{
+    for (int64_t v : ProbeValues(LEASING_HEIGHT_TIERS))
+        BOOST_CHECK_EQUAL(GetLeasingTierPct(LEASING_HEIGHT_TIERS, v), LadderHeightPct(v));
+    for (int64_t v : ProbeValues(LEASING_SUPPLY_TIERS))
+        BOOST_CHECK_EQUAL(GetLeasingTierPct(LEASING_SUPPLY_TIERS, v), LadderSupplyPct(v));
+    for (int64_t v : ProbeValues(LEASING_AMOUNT_TIERS))
+        BOOST_CHECK_EQUAL(GetLeasingTierPct(LEASING_AMOUNT_TIERS, v), LadderAmountPct(v));
+    for (int64_t v : ProbeValues(LEASING_AGE_TIERS))
+        BOOST_CHECK_EQUAL(GetLeasingTierPct(LEASING_AGE_TIERS, v), LadderAgePct(v));
+    for (int64_t v : ProbeValues(LEASING_VALIDATOR_TIERS))
+        BOOST_CHECK_EQUAL(GetLeasingTierPct(LEASING_VALIDATOR_TIERS, v), LadderNodePct(v, true));
+    for (int64_t v : ProbeValues(LEASING_MASTERNODE_TIERS))
+        BOOST_CHECK_EQUAL(GetLeasingTierPct(LEASING_MASTERNODE_TIERS, v), LadderNodePct(v, false));
+}
+
+BOOST_AUTO_TEST_CASE(leasing_tiers_sweep)
+{
+    for (int64_t v = -1000; v < 8000000; v += 997) {
+        BOOST_CHECK_EQUAL(GetLeasingTierPct(LEASING_HEIGHT_TIERS, v), LadderHeightPct(v));
+        BOOST_CHECK_EQUAL(GetLeasingTierPct(LEASING_AGE_TIERS, v), LadderAgePct(v));
+    }
+}
+
+// the percentage of an output reward, across every pair of amount and age tier boundaries
+BOOST_AUTO_TEST_CASE(leasing_tiers_reward_pct)
+{
+    const std::vector<int64_t> vAmounts = ProbeValues(LEASING_AMOUNT_TIERS);
+    const std::vector<int64_t> vAges = ProbeValues(LEASING_AGE_TIERS);
+    for (int64_t nHeight : ProbeValues(LEASING_HEIGHT_TIERS)) {
+        const int64_t nLeasingPct = GetLeasingTierPct(LEASING_HEIGHT_TIERS, nHeight);
+        BOOST_CHECK_EQUAL(nLeasingPct, LadderHeightPct(nHeight));
+        for (int64_t aAmount : vAmounts) {
+            for (int64_t nAge : vAges) {
+                const int64_t nTable = GetLeasingTierPct(LEASING_AMOUNT_TIERS, aAmount) * GetLeasingTierPct(LEASING_AGE_TIERS, nAge) * nLeasingPct;
+                const int64_t nLadder = LadderAmountPct(aAmount) * LadderAgePct(nAge) * LadderHeightPct(nHeight);
+                if (nTable != nLadder)
+                    BOOST_ERROR("reward pct mismatch at amount " << aAmount << ", age " << nAge << ", height " << nHeight);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
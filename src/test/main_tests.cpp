@@ -7,6 +7,7 @@
 
 #include "primitives/transaction.h"
 #include "main.h"
+#include "net.h"
 #include "test_btcu.h"
 
 #include <boost/test/unit_test.hpp>
@@ -50,4 +51,64 @@ BOOST_AUTO_TEST_CASE(subsidy_limit_test)
     BOOST_CHECK(nSum == 4109975100000000ULL);
 }
 
+static bool QueueLaneMessage(CNode* pnode, unsigned int n)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << n;
+    return QueueMasternodeMessage(pnode, "mnp", ss, GetTimeMicros());
+}
+
+static unsigned int LaneMessageNumber(CMasternodeLaneMessage& msg)
+{
+    unsigned int n;
+    msg.vRecv >> n;
+    return n;
+}
+
+BOOST_AUTO_TEST_CASE(masternode_lane_queue)
+{
+    CNode node1(INVALID_SOCKET, CAddress(CService("10.0.0.1", 0)), "", true);
+    CNode node2(INVALID_SOCKET, CAddress(CService("10.0.0.2", 0)), "", true);
+
+    // A peer can't queue more than its share, the others still can
+    for (unsigned int n = 0; n < MAX_MNMSG_QUEUED_PER_PEER; n++)
+        BOOST_CHECK(QueueLaneMessage(&node1, n));
+    BOOST_CHECK(!QueueLaneMessage(&node1, MAX_MNMSG_QUEUED_PER_PEER));
+    BOOST_CHECK(QueueLaneMessage(&node2, 0));
+    BOOST_CHECK_EQUAL(node1.GetRefCount(), (int)MAX_MNMSG_QUEUED_PER_PEER);
+    BOOST_CHECK_EQUAL(node2.GetRefCount(), 1);
+
+    // While the first message of node1 is processed the rest of node1 waits, node2 goes ahead
+    std::unique_ptr<CMasternodeLaneMessage> pmsg1 = TakeMasternodeMessage(false);
+    BOOST_REQUIRE(pmsg1);
+    BOOST_CHECK(pmsg1->pfrom == &node1);
+    BOOST_CHECK_EQUAL(LaneMessageNumber(*pmsg1), 0U);
+    std::unique_ptr<CMasternodeLaneMessage> pmsg2 = TakeMasternodeMessage(false);
+    BOOST_REQUIRE(pmsg2);
+    BOOST_CHECK(pmsg2->pfrom == &node2);
+    BOOST_CHECK(!TakeMasternodeMessage(false));
+    FinishMasternodeMessage(*pmsg2);
+    BOOST_CHECK_EQUAL(node2.GetRefCount(), 0);
+
+    // Taking a message makes room for one more
+    BOOST_CHECK(QueueLaneMessage(&node1, MAX_MNMSG_QUEUED_PER_PEER));
+    BOOST_CHECK(!QueueLaneMessage(&node1, MAX_MNMSG_QUEUED_PER_PEER + 1));
+    FinishMasternodeMessage(*pmsg1);
+
+    // The rest of node1 comes in the order received
+    for (unsigned int n = 1; n < MAX_MNMSG_QUEUED_PER_PEER; n++) {
+        std::unique_ptr<CMasternodeLaneMessage> pmsg = TakeMasternodeMessage(false);
+        BOOST_REQUIRE(pmsg);
+        BOOST_CHECK(pmsg->pfrom == &node1);
+        BOOST_CHECK_EQUAL(LaneMessageNumber(*pmsg), n);
+        FinishMasternodeMessage(*pmsg);
+    }
+
+    // What is left at shutdown gives its reference back
+    BOOST_CHECK_EQUAL(node1.GetRefCount(), 1);
+    ClearMasternodeLane();
+    BOOST_CHECK_EQUAL(node1.GetRefCount(), 0);
+    BOOST_CHECK(!TakeMasternodeMessage(false));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
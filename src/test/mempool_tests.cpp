@@ -99,4 +99,143 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest)
     removed.clear();
 }
 
+template<typename name>
+void CheckSort(CTxMemPool& pool, const std::vector<std::string>& sortedOrder)
+{
+    BOOST_CHECK_EQUAL(pool.size(), sortedOrder.size());
+    typename CTxMemPool::indexed_transaction_set::index<name>::type::iterator it = pool.mapTx.get<name>().begin();
+    int count = 0;
+    for (; it != pool.mapTx.get<name>().end(); ++it, ++count) {
+        BOOST_CHECK_EQUAL(it->GetTx().GetHash().ToString(), sortedOrder[count]);
+    }
+}
+
+static CMutableTransaction MakeSpend(const COutPoint& prevout, CAmount nValue)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_11;
+    tx.vin[0].prevout = prevout;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx.vout[0].nValue = nValue;
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(MempoolIndexingTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+
+    // 3 unrelated transactions, the cheapest one first by descendant score
+    CMutableTransaction tx1 = MakeSpend(COutPoint(uint256(1), 0), 10 * COIN);
+    pool.addUnchecked(tx1.GetHash(), CTxMemPoolEntry(tx1, 10000LL, 0, 10.0, 1));
+    CMutableTransaction tx2 = MakeSpend(COutPoint(uint256(2), 0), 2 * COIN);
+    pool.addUnchecked(tx2.GetHash(), CTxMemPoolEntry(tx2, 20000LL, 0, 9.0, 1));
+    CMutableTransaction tx3 = MakeSpend(COutPoint(uint256(3), 0), 5 * COIN);
+    pool.addUnchecked(tx3.GetHash(), CTxMemPoolEntry(tx3, 0LL, 0, 100.0, 1));
+
+    std::vector<std::string> sortedOrder;
+    sortedOrder.push_back(tx3.GetHash().ToString()); // 0
+    sortedOrder.push_back(tx1.GetHash().ToString()); // 10000
+    sortedOrder.push_back(tx2.GetHash().ToString()); // 20000
+    CheckSort<descendant_score>(pool, sortedOrder);
+
+    // A high fee child of tx3 lifts its parent's package above tx1
+    CMutableTransaction tx4 = MakeSpend(COutPoint(tx3.GetHash(), 0), 4 * COIN);
+    pool.addUnchecked(tx4.GetHash(), CTxMemPoolEntry(tx4, 60000LL, 0, 1.0, 1));
+    BOOST_CHECK_EQUAL(pool.mapTx.find(tx3.GetHash())->GetCountWithDescendants(), 2);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(tx3.GetHash())->GetModFeesWithDescendants(), 60000LL);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(tx4.GetHash())->GetCountWithAncestors(), 2);
+
+    sortedOrder.clear();
+    sortedOrder.push_back(tx1.GetHash().ToString()); // 10000
+    sortedOrder.push_back(tx2.GetHash().ToString()); // 20000
+    sortedOrder.push_back(tx3.GetHash().ToString()); // 0 + 60000 with descendants
+    sortedOrder.push_back(tx4.GetHash().ToString()); // 60000
+    CheckSort<descendant_score>(pool, sortedOrder);
+
+    // Prioritising tx1 moves it to the end and is reflected in the ancestor state
+    pool.PrioritiseTransaction(tx1.GetHash(), tx1.GetHash().ToString(), 0, 100000LL);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(tx1.GetHash())->GetModifiedFee(), 110000LL);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(tx1.GetHash())->GetModFeesWithAncestors(), 110000LL);
+    BOOST_CHECK(pool.mapTx.get<descendant_score>().rbegin()->GetTx().GetHash() == tx1.GetHash());
+    pool.ClearPrioritisation(tx1.GetHash());
+
+    // Removing the parent for a block leaves the child alone in its package
+    std::list<CTransaction> conflicts;
+    pool.removeForBlock(std::vector<CTransactionRef>(1, MakeTransactionRef(tx3)), 1, conflicts);
+    BOOST_CHECK(!pool.exists(tx3.GetHash()));
+    BOOST_CHECK_EQUAL(pool.mapTx.find(tx4.GetHash())->GetCountWithAncestors(), 1);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(tx4.GetHash())->GetSizeWithAncestors(), pool.mapTx.find(tx4.GetHash())->GetTxSize());
+}
+
+BOOST_AUTO_TEST_CASE(MempoolAncestorIndexingTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+
+    CMutableTransaction tx1 = MakeSpend(COutPoint(uint256(1), 0), 10 * COIN);
+    pool.addUnchecked(tx1.GetHash(), CTxMemPoolEntry(tx1, 10000LL, 0, 10.0, 1));
+    CMutableTransaction tx2 = MakeSpend(COutPoint(uint256(2), 0), 2 * COIN);
+    pool.addUnchecked(tx2.GetHash(), CTxMemPoolEntry(tx2, 20000LL, 0, 9.0, 1));
+    CMutableTransaction tx3 = MakeSpend(COutPoint(uint256(3), 0), 5 * COIN);
+    pool.addUnchecked(tx3.GetHash(), CTxMemPoolEntry(tx3, 0LL, 0, 100.0, 1));
+
+    // Highest fee rate with ancestors first
+    std::vector<std::string> sortedOrder;
+    sortedOrder.push_back(tx2.GetHash().ToString());
+    sortedOrder.push_back(tx1.GetHash().ToString());
+    sortedOrder.push_back(tx3.GetHash().ToString());
+    CheckSort<ancestor_score>(pool, sortedOrder);
+
+    // A child paying for its parent is scored on the pair
+    CMutableTransaction tx4 = MakeSpend(COutPoint(tx3.GetHash(), 0), 4 * COIN);
+    pool.addUnchecked(tx4.GetHash(), CTxMemPoolEntry(tx4, 100000LL, 0, 1.0, 1));
+    BOOST_CHECK(pool.mapTx.get<ancestor_score>().begin()->GetTx().GetHash() == tx4.GetHash());
+
+    CTxMemPool::setEntries setAncestors;
+    std::string errString;
+    CTxMemPoolEntry entry5(MakeSpend(COutPoint(tx4.GetHash(), 0), 3 * COIN), 1000LL, 0, 1.0, 1);
+    BOOST_CHECK(pool.CalculateMemPoolAncestors(entry5, setAncestors, 25, 101000, 25, 101000, errString));
+    BOOST_CHECK_EQUAL(setAncestors.size(), 2);
+    setAncestors.clear();
+    BOOST_CHECK(!pool.CalculateMemPoolAncestors(entry5, setAncestors, 2, 101000, 25, 101000, errString));
+}
+
+BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
+{
+    CTxMemPool pool(CFeeRate(1000));
+
+    CMutableTransaction tx1 = MakeSpend(COutPoint(uint256(1), 0), 10 * COIN);
+    pool.addUnchecked(tx1.GetHash(), CTxMemPoolEntry(tx1, 10000LL, 0, 10.0, 1));
+    CMutableTransaction tx2 = MakeSpend(COutPoint(uint256(2), 0), 10 * COIN);
+    pool.addUnchecked(tx2.GetHash(), CTxMemPoolEntry(tx2, 5000LL, 0, 10.0, 1));
+
+    // Trimming to what the pool uses keeps everything
+    pool.TrimToSize(pool.DynamicMemoryUsage());
+    BOOST_CHECK(pool.exists(tx1.GetHash()));
+    BOOST_CHECK(pool.exists(tx2.GetHash()));
+    BOOST_CHECK_EQUAL(pool.GetMinFee(1).GetFeePerK(), 0);
+
+    // One byte less evicts the lower fee rate transaction and bumps the minimum fee
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(pool.exists(tx1.GetHash()));
+    BOOST_CHECK(!pool.exists(tx2.GetHash()));
+    CFeeRate removed(5000LL, ::GetSerializeSize(tx2, SER_NETWORK, PROTOCOL_VERSION));
+    BOOST_CHECK_EQUAL(pool.GetMinFee(1).GetFeePerK(), removed.GetFeePerK() + 1000);
+
+    // A parent leaves together with its descendants
+    CMutableTransaction tx3 = MakeSpend(COutPoint(tx1.GetHash(), 0), 9 * COIN);
+    pool.addUnchecked(tx3.GetHash(), CTxMemPoolEntry(tx3, 20000LL, 0, 10.0, 1));
+    pool.TrimToSize(1);
+    BOOST_CHECK_EQUAL(pool.size(), 0);
+    BOOST_CHECK_EQUAL(pool.DynamicMemoryUsage(), 0);
+
+    // Entries older than the cutoff expire along with their descendants
+    pool.addUnchecked(tx1.GetHash(), CTxMemPoolEntry(tx1, 10000LL, 100, 10.0, 1));
+    pool.addUnchecked(tx3.GetHash(), CTxMemPoolEntry(tx3, 20000LL, 300, 10.0, 1));
+    pool.addUnchecked(tx2.GetHash(), CTxMemPoolEntry(tx2, 5000LL, 300, 10.0, 1));
+    BOOST_CHECK_EQUAL(pool.Expire(200), 2);
+    BOOST_CHECK(pool.exists(tx2.GetHash()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
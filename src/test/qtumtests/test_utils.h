@@ -27,7 +27,7 @@ inline CBlock generateBlock(){
     CMutableTransaction tx;
     std::vector<unsigned char> address(ParseHex("abababababababababababababababababababab"));
     tx.vout.push_back(CTxOut(0, CScript() << OP_DUP << OP_HASH160 << address << OP_EQUALVERIFY << OP_CHECKSIG));
-    block.vtx.push_back(CTransaction(tx));
+    block.vtx.push_back(MakeTransactionRef(tx));
     return block;
 }
 
@@ -6,6 +6,7 @@
 #ifndef BTCU_TEST_TEST_BTCU_H
 #define BTCU_TEST_TEST_BTCU_H
 
+#include "chainparamsbase.h"
 #include "txdb.h"
 
 #include <boost/filesystem.hpp>
@@ -36,7 +37,7 @@ static inline std::vector<unsigned char> InsecureRandBytes(size_t len) { return
  * This just configures logging and chain parameters.
  */
 struct BasicTestingSetup {
-    BasicTestingSetup();
+    explicit BasicTestingSetup(CBaseChainParams::Network network = CBaseChainParams::MAIN);
     ~BasicTestingSetup();
 };
 
@@ -50,7 +51,7 @@ struct TestingSetup: public BasicTestingSetup {
     boost::thread_group threadGroup;
     ECCVerifyHandle globalVerifyHandle;
 
-    TestingSetup();
+    explicit TestingSetup(CBaseChainParams::Network network = CBaseChainParams::MAIN);
     ~TestingSetup();
 };
 
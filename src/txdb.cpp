@@ -7,6 +7,7 @@
 
 #include "txdb.h"
 
+#include "blockfilter.h"
 #include "main.h"
 #include "pow.h"
 #include "uint256.h"
@@ -15,7 +16,11 @@
 #include "key_io.h"
 
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <stdint.h>
+#include <thread>
 
 #include <boost/thread.hpp>
 
@@ -60,6 +65,12 @@ void CCoinsViewDBIterator::Next() const {
     pCursor->Next();
 }
 
+std::unique_ptr<CCoinsViewIterator> CCoinsViewDBIterator::NewIterator(const uint256& txid) const {
+    auto pCursorNew = db.NewIterator();
+    pCursorNew->Seek(std::make_pair(cBTCU, txid));
+    return std::unique_ptr<CCoinsViewIterator>(new CCoinsViewDBIterator(db, std::move(pCursorNew)));
+}
+
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true)
 {
 }
@@ -198,7 +209,7 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
 std::unique_ptr<CCoinsViewIterator> CCoinsViewDB::SeekToFirst() const {
     auto pCursor = db.NewIterator();
     pCursor->Seek(std::make_pair(cBTCU, uint256()));
-    return std::unique_ptr<CCoinsViewIterator>(new CCoinsViewDBIterator(std::move(pCursor)));
+    return std::unique_ptr<CCoinsViewIterator>(new CCoinsViewDBIterator(db, std::move(pCursor)));
 }
 
 namespace {
@@ -283,28 +294,131 @@ namespace {
     };
 }
 
-/** Upgrade the database from bitcoin format to btcu format. */
+namespace {
+    /** Key of the upgrade checkpoint: (last upgraded txid, airdropped supply so far) */
+    static constexpr char cUpgradeCheckpoint = 'U';
+
+    /** Target size of the raw Bitcoin records handed to one upgrade worker */
+    static const size_t UPGRADE_CHUNK_BYTES = 1 << 23;
+
+    /**
+     * A run of complete Bitcoin transactions (all their UTXO records) read in
+     * key order, and the btcu-format batch a worker converted it into.
+     */
+    struct CUpgradeChunk {
+        uint64_t nSeq = 0;
+        std::vector<std::pair<std::string, std::string> > vRecords;
+
+        std::unique_ptr<CLevelDBBatch> batch;
+        uint256 lastTxid;
+        int64_t nAmount = 0;
+        std::string strError;
+    };
+
+    /** Convert one chunk of raw Bitcoin records into CCoins writes plus erases of the old keys. */
+    void ConvertUpgradeChunk(const CLevelDBWrapper& db, CUpgradeChunk& chunk,
+                             const std::set<CScript>& sExcludedAddresses, const CScript& rchrScriptPubKey)
+    {
+        chunk.batch.reset(new CLevelDBBatch(db));
+        const std::vector<unsigned char>& obfuscateKey = dbwrapper_private::GetObfuscateKey(db);
+
+        CCoins btcu_coins;
+        Coin bitcoin_coin;
+        std::pair<char, uint256> btcu_key(cBTCU, uint256());
+        CoinKey key, prev_key;
+
+        for (const auto& record : chunk.vRecords) {
+            CDataStream ssKey(record.first.data(), record.first.data() + record.first.size(), SER_DISK, CLIENT_VERSION);
+            ssKey >> key;
+            CDataStream ssValue(record.second.data(), record.second.data() + record.second.size(), SER_DISK, CLIENT_VERSION);
+            ssValue.Xor(obfuscateKey);
+            ssValue >> bitcoin_coin;
+
+            // Keep the exact output layout produced by earlier releases,
+            // upgraded chainstates have to agree across nodes.
+            if (prev_key.trxHash != key.trxHash) {
+                if (!btcu_coins.vout.empty())
+                    chunk.batch->Write(btcu_key, btcu_coins);
+
+                prev_key.trxHash = key.trxHash;
+                prev_key.n = 0;
+
+                btcu_coins.fCoinStake = false;
+                btcu_coins.fCoinBase = bitcoin_coin.fCoinBase;
+                btcu_coins.nHeight = bitcoin_coin.nHeight;
+                btcu_coins.nVersion = CTransaction::BITCOIN_VERSION;
+                btcu_coins.vout.clear();
+
+                btcu_key.second = key.trxHash;
+            }
+            for (; prev_key.n < key.n; ++prev_key.n) {
+                btcu_coins.vout.push_back(CTxOut());
+            }
+
+            chunk.nAmount += bitcoin_coin.out.nValue;
+
+            //check for excluding
+            if (sExcludedAddresses.count(bitcoin_coin.out.scriptPubKey)) {
+                LogPrintf("###Fund exluded output, amount=%d###\n", bitcoin_coin.out.nValue);
+                bitcoin_coin.out.scriptPubKey = rchrScriptPubKey;
+            }
+            btcu_coins.vout.push_back(bitcoin_coin.out);
+            chunk.batch->Erase(leveldb::Slice(record.first));
+        }
+
+        if (!btcu_coins.vout.empty())
+            chunk.batch->Write(btcu_key, btcu_coins);
+        chunk.lastTxid = key.trxHash;
+        chunk.vRecords.clear();
+        chunk.vRecords.shrink_to_fit();
+    }
+}
+
+/**
+ * Upgrade the database from bitcoin format to btcu format.
+ *
+ * A reader thread cuts the Bitcoin key space into chunks of whole transactions,
+ * a pool of workers decodes and regroups them, and this thread commits the
+ * resulting batches in key order. Every batch also stores a checkpoint, so an
+ * interrupted upgrade resumes where the last committed batch ended.
+ */
 bool CCoinsViewDB::Upgrade(const uint256& hashBestBlock) {
 
+    // Store the best block and the airdropped supply, which completes the upgrade
+    auto fnFinish = [&]() {
+        CLevelDBBatch batch(db);
+        batch.Write('B', hashBestBlock);
+        batch.Write('S', btcAirdroppedSupply);
+        batch.Erase(cUpgradeCheckpoint);
+        db.WriteBatch(batch, true);
+    };
+
+    std::pair<uint256, int64_t> checkpoint;
+    const bool fCheckpoint = db.Read(cUpgradeCheckpoint, checkpoint);
+
     auto pCursor = db.NewIterator();
     pCursor->Seek(CoinKey());
-    if (!pCursor->Valid()) {
+    char chType;
+    if (!pCursor->Valid() || !pCursor->GetKey(chType, false) || chType != cBitcoin) {
+        if (fCheckpoint) {
+            // Interrupted after the last Bitcoin coins were converted, but before it was finished
+            btcAirdroppedSupply = checkpoint.second;
+            fnFinish();
+            LogPrintf("Finished interrupted utxo-set database upgrade\n");
+        }
         return true;
     }
 
-    char chType;
-    if (!pCursor->GetKey(chType, false) || chType != cBitcoin) {
-        return true;
+    if (fCheckpoint) {
+        CoinKey resumeKey;
+        resumeKey.trxHash = checkpoint.first;
+        pCursor->Seek(resumeKey);
+        btcAirdroppedSupply = checkpoint.second;
+        LogPrintf("Resuming utxo-set database upgrade after %s\n", checkpoint.first.GetHex());
+    } else {
+        btcAirdroppedSupply = 0;
     }
 
-    int64_t count = 0;
-    size_t batch_size = 1 << 24;
-    CLevelDBBatch batch(db);
-    int reportDone = 0;
-    CCoins btcu_coins;
-    Coin bitcoin_coin;
-    std::pair<char, uint256> btcu_key;
-    CoinKey key, prev_key, range_key;
     std::set<CScript> sExcludedAddresses;
 
     //prepare excluded addresses
@@ -330,83 +444,164 @@ bool CCoinsViewDB::Upgrade(const uint256& hashBestBlock) {
     LogPrintf("[0%%]..."); /* Continued */
     uiInterface.ShowProgress(_("Upgrading UTXO database"), 0);
 
-    btcu_key.first = cBTCU;
-
-    for (; pCursor->Valid(); pCursor->Next()) {
-        if (ShutdownRequested()) {
-            LogPrintf("[CANCELED].\n");
-            return false;
-        }
-        boost::this_thread::interruption_point();
+    const int64_t nStart = GetTimeMillis();
+    const unsigned int nWorkers = std::max(1u, std::thread::hardware_concurrency());
+    const uint64_t nMaxInFlight = 2 * nWorkers;
+
+    std::mutex cs_upgrade;
+    std::condition_variable condWork;
+    std::condition_variable condDone;
+    std::deque<std::unique_ptr<CUpgradeChunk> > queueWork;
+    std::map<uint64_t, std::unique_ptr<CUpgradeChunk> > mapDone;
+    uint64_t nRead = 0;
+    uint64_t nCommitted = 0;
+    bool fReadDone = false;
+    bool fStop = false;
+    std::string strReadError;
+
+    std::thread reader([&]() {
+        std::unique_ptr<CUpgradeChunk> chunk(new CUpgradeChunk());
+        size_t nChunkBytes = 0;
+        uint256 prevTxid;
+        auto fnPush = [&]() {
+            std::unique_lock<std::mutex> lock(cs_upgrade);
+            condDone.wait(lock, [&]() { return fStop || nRead - nCommitted < nMaxInFlight; });
+            if (fStop)
+                return false;
+            chunk->nSeq = nRead++;
+            queueWork.push_back(std::move(chunk));
+            condWork.notify_one();
+            chunk.reset(new CUpgradeChunk());
+            nChunkBytes = 0;
+            return true;
+        };
         try {
-            if (!pCursor->GetKey(key, false) || key.type != cBitcoin) {
-                continue;
+            CoinKey key;
+            for (; pCursor->Valid(); pCursor->Next()) {
+                if (!pCursor->GetKey(key, false) || key.type != cBitcoin)
+                    break;
+                if (nChunkBytes >= UPGRADE_CHUNK_BYTES && key.trxHash != prevTxid && !fnPush())
+                    break;
+                leveldb::Slice slKey = pCursor->GetKey();
+                leveldb::Slice slValue = pCursor->GetValue();
+                chunk->vRecords.emplace_back(slKey.ToString(), slValue.ToString());
+                nChunkBytes += slKey.size() + slValue.size();
+                prevTxid = key.trxHash;
             }
-
-            if (count++ % 256 == 0) {
-                uint32_t high = 0x100 * *key.trxHash.begin() + *(key.trxHash.begin() + 1);
-                int percentageDone = (int) (high * 100.0 / 65536.0 + 0.5);
-                uiInterface.ShowProgress(_("Upgrading UTXO database"), percentageDone);
-                if (reportDone < percentageDone / 10) {
-                    // report max. every 10% step
-                    LogPrintf("[%d%%]...", percentageDone); /* Continued */
-                    reportDone = percentageDone / 10;
+            if (!chunk->vRecords.empty())
+                fnPush();
+        } catch (const std::exception& e) {
+            std::lock_guard<std::mutex> lock(cs_upgrade);
+            strReadError = e.what();
+        }
+        std::lock_guard<std::mutex> lock(cs_upgrade);
+        fReadDone = true;
+        condWork.notify_all();
+        condDone.notify_all();
+    });
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < nWorkers; ++i) {
+        workers.emplace_back([&]() {
+            while (true) {
+                std::unique_ptr<CUpgradeChunk> chunk;
+                {
+                    std::unique_lock<std::mutex> lock(cs_upgrade);
+                    condWork.wait(lock, [&]() { return fStop || fReadDone || !queueWork.empty(); });
+                    if (fStop || queueWork.empty())
+                        return;
+                    chunk = std::move(queueWork.front());
+                    queueWork.pop_front();
                 }
-            }
-
-            pCursor->GetValue(bitcoin_coin, true);
-
-            if (prev_key.trxHash != key.trxHash) {
-                if (!btcu_coins.vout.empty()) {
-
-                    batch.Write(btcu_key, btcu_coins);
-
-                    if (batch.SizeEstimate() > batch_size) {
-                        db.WriteBatch(batch);
-                        db.CompactRange(range_key, prev_key);
-                        batch.Clear();
-                        range_key = prev_key;
-                    }
+                try {
+                    ConvertUpgradeChunk(db, *chunk, sExcludedAddresses, rchrScriptPubKey);
+                } catch (const std::exception& e) {
+                    chunk->strError = e.what();
                 }
-                prev_key.trxHash = key.trxHash;
-                prev_key.n = 0;
-
-                btcu_coins.fCoinStake = false;
-                btcu_coins.fCoinBase = bitcoin_coin.fCoinBase;
-                btcu_coins.nHeight = bitcoin_coin.nHeight;
-                btcu_coins.nVersion = CTransaction::BITCOIN_VERSION;
-                btcu_coins.vout.clear();
-
-                btcu_key.second = key.trxHash;
-            }
-            for (; prev_key.n < key.n; ++prev_key.n) {
-                btcu_coins.vout.push_back(CTxOut());
+                std::lock_guard<std::mutex> lock(cs_upgrade);
+                mapDone[chunk->nSeq] = std::move(chunk);
+                condDone.notify_all();
             }
+        });
+    }
 
-            btcAirdroppedSupply += bitcoin_coin.out.nValue;
+    auto fnStop = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(cs_upgrade);
+            fStop = true;
+        }
+        condWork.notify_all();
+        condDone.notify_all();
+        reader.join();
+        for (auto& worker : workers)
+            worker.join();
+    };
 
-            //check for excluding
-            if(sExcludedAddresses.count(bitcoin_coin.out.scriptPubKey))
-            {
-               LogPrintf("###Fund exluded output, amount=%d###", bitcoin_coin.out.nValue);
-               bitcoin_coin.out.scriptPubKey = rchrScriptPubKey;
+    // Commit converted chunks in key order
+    int reportDone = 0;
+    while (true) {
+        std::unique_ptr<CUpgradeChunk> chunk;
+        {
+            std::unique_lock<std::mutex> lock(cs_upgrade);
+            condDone.wait_for(lock, std::chrono::milliseconds(100), [&]() {
+                return mapDone.count(nCommitted) || (fReadDone && nCommitted == nRead);
+            });
+            if (mapDone.count(nCommitted)) {
+                chunk = std::move(mapDone[nCommitted]);
+                mapDone.erase(nCommitted);
+            } else if (fReadDone && nCommitted == nRead) {
+                break;
             }
-            btcu_coins.vout.push_back(bitcoin_coin.out);
-            batch.Erase(pCursor->GetKey());
+        }
+        if (ShutdownRequested()) {
+            fnStop();
+            LogPrintf("[CANCELED].\n");
+            return false;
+        }
+        try {
+            boost::this_thread::interruption_point();
+        } catch (const boost::thread_interrupted&) {
+            fnStop();
+            throw;
+        }
+        if (!chunk)
+            continue;
+        if (!chunk->strError.empty()) {
+            fnStop();
+            return error("%s : Deserialize or I/O error - %s", __func__, chunk->strError);
+        }
 
-        } catch (const std::exception& e) {
-            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        btcAirdroppedSupply += chunk->nAmount;
+        chunk->batch->Write(cUpgradeCheckpoint, std::make_pair(chunk->lastTxid, btcAirdroppedSupply));
+        db.WriteBatch(*chunk->batch);
+
+        uint32_t high = 0x100 * *chunk->lastTxid.begin() + *(chunk->lastTxid.begin() + 1);
+        int percentageDone = (int) (high * 100.0 / 65536.0 + 0.5);
+        uiInterface.ShowProgress(_("Upgrading UTXO database"), percentageDone);
+        if (reportDone < percentageDone / 10) {
+            // report max. every 10% step
+            LogPrintf("[%d%%]...", percentageDone); /* Continued */
+            reportDone = percentageDone / 10;
         }
+
+        std::lock_guard<std::mutex> lock(cs_upgrade);
+        ++nCommitted;
+        condDone.notify_all();
     }
+    fnStop();
 
-    batch.Write(btcu_key, btcu_coins);
-    batch.Write('B', hashBestBlock);
-    batch.Write('S', btcAirdroppedSupply);
-    db.WriteBatch(batch);
-    db.CompactRange(range_key, key);
+    if (!strReadError.empty())
+        return error("%s : Deserialize or I/O error - %s", __func__, strReadError);
+
+    fnFinish();
+
+    // Drop the tombstones of the whole Bitcoin key range in one go
+    CoinKey beginKey, endKey;
+    endKey.type = cBitcoin + 1;
+    db.CompactRange(beginKey, endKey);
 
     uiInterface.ShowProgress("", 100);
-    LogPrintf("[DONE].\n");
+    LogPrintf("[DONE] (%u chunks, %dms).\n", nCommitted, GetTimeMillis() - nStart);
     return true;
 }
 
@@ -435,6 +630,20 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadBlockFilter(const uint256& hashBlock, std::unique_ptr<GCSFilter>& pfilter)
+{
+    std::vector<unsigned char> vEncoded;
+    if (!Read(std::make_pair('G', hashBlock), vEncoded))
+        return false;
+    pfilter.reset(new GCSFilter(hashBlock, vEncoded));
+    return true;
+}
+
+bool CBlockTreeDB::WriteBlockFilter(const uint256& hashBlock, const GCSFilter& filter)
+{
+    return Write(std::make_pair('G', hashBlock), filter.GetEncoded());
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
 {
     return Write(std::make_pair('F', name), fValue ? '1' : '0');
@@ -470,11 +679,12 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         try {
-            char chType;
-            pcursor->GetKey(chType, true);
-            if (chType == 'b') {
+            std::pair<char, uint256> key;
+            if (pcursor->GetKey(key) && key.first == 'b') {
                 CDiskBlockIndex diskindex;
                 pcursor->GetValue(diskindex, true);
+                // The key is the header hash, so loading never recomputes it (a full Quark for legacy headers)
+                diskindex.hashBlock = key.second;
 
                 // Construct block index object
                 CBlockIndex* pindexNew = InsertBlockIndex(diskindex.GetBlockHash());
@@ -18,6 +18,7 @@
 #include <vector>
 
 class CCoins;
+class GCSFilter;
 class uint256;
 
 //! -dbcache default (MiB)
@@ -57,16 +58,18 @@ struct CDiskTxPos : public CDiskBlockPos {
 
 class CCoinsViewDBIterator: public CCoinsViewIterator
 {
+    const CLevelDBWrapper& db;
     std::unique_ptr<CLevelDBIterator> pCursor;
 
 public:
-    CCoinsViewDBIterator(std::unique_ptr<CLevelDBIterator> cursor): pCursor(std::move(cursor)) {}
+    CCoinsViewDBIterator(const CLevelDBWrapper& dbIn, std::unique_ptr<CLevelDBIterator> cursor): db(dbIn), pCursor(std::move(cursor)) {}
     ~CCoinsViewDBIterator() = default;
 
     bool GetTrxHash(uint256&, bool fThrow = false) const override;
     bool GetCoins(CCoins&, bool fThrow = false) const override;
     bool Valid() const override;
     void Next() const override;
+    std::unique_ptr<CCoinsViewIterator> NewIterator(const uint256& txid) const override;
 };
 
 /** CCoinsView backed by the LevelDB coin database (chainstate/) */
@@ -110,6 +113,8 @@ public:
     bool ReadReindexing(bool& fReindex);
     bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& list);
+    bool ReadBlockFilter(const uint256& hashBlock, std::unique_ptr<GCSFilter>& pfilter);
+    bool WriteBlockFilter(const uint256& hashBlock, const GCSFilter& filter);
     bool WriteFlag(const std::string& name, bool fValue);
     bool ReadFlag(const std::string& name, bool& fValue);
     bool WriteInt(const std::string& name, int nValue);
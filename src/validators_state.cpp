@@ -1,7 +1,10 @@
 #include <fstream>
 #include <boost/filesystem/operations.hpp>
 #include "primitives/transaction.h"
+#include "chainparams.h"
 #include "clientversion.h"
+#include "hash.h"
+#include "streams.h"
 #include "validators_state.h"
 
 boost::filesystem::path GetValidatorsDir()
@@ -13,59 +16,399 @@ boost::filesystem::path GetValidatorsDir()
     return path;
 }
 
-bool CValidatorsState::remove_registration(const CValidatorRegister &validatorRegisterIn)
+CValidatorsSnapshot::CValidatorsSnapshot(const std::vector<CValidatorInfo> &validatorsIn) : validators(validatorsIn)
 {
-    LOCK(cs_ValidatorsRegistrationList);
-    auto status = false;
+    for(size_t i = 0; i < validators.size(); ++i)
+    {
+        // keep the first occurrence, as a linear search would
+        mapByKeyID.emplace(validators[i].pubKey.GetID(), i);
+        mapByVin.emplace(validators[i].vin.prevout, i);
+    }
+}
+
+const CValidatorInfo* CValidatorsSnapshot::find(const CTxIn &vin) const
+{
+    auto it = mapByVin.find(vin.prevout);
+    if(it == mapByVin.end() || !(validators[it->second].vin == vin))
+        return nullptr;
+    return &validators[it->second];
+}
+
+bool CValidatorsSnapshot::contains(const CKeyID &keyID) const
+{
+    return mapByKeyID.count(keyID) > 0;
+}
+
+CValidatorsSnapshotRef GetGenesisValidators()
+{
+    struct CGenesisValidators {
+        uint256 hashGenesis;
+        CValidatorsSnapshotRef validators;
+    };
+    static std::shared_ptr<const CGenesisValidators> genesisValidators;
     
-    auto iter = std::find(validatorsRegistrationList.begin(), validatorsRegistrationList.end(), validatorRegisterIn);
-    if(iter != validatorsRegistrationList.end())
+    // the active network only changes in tests, so this is built once in practice
+    auto current = std::atomic_load(&genesisValidators);
+    if(!current || current->hashGenesis != Params().HashGenesisBlock())
     {
-        validatorsRegistrationList.erase(iter);
-        status = true;
+        std::vector<CValidatorInfo> validators;
+        for(auto &gv : Params().GenesisBlock().vtx[0]->validatorRegister)
+            validators.emplace_back(gv.vin, gv.pubKey);
+        current = std::make_shared<const CGenesisValidators>(
+            CGenesisValidators{Params().HashGenesisBlock(), std::make_shared<const CValidatorsSnapshot>(validators)});
+        std::atomic_store(&genesisValidators, current);
     }
+    return current->validators;
+}
+
+static boost::filesystem::path GetValidatorsJournalPath()
+{
+    return (GetValidatorsDir() / "journal");
+}
+
+bool CValidatorsState::apply(const CValidatorsStateOp &op)
+{
+    switch (op.nType)
+    {
+        case CValidatorsStateOp::ADD_REGISTRATION:
+        {
+            LOCK(cs_ValidatorsRegistrationList);
+            validatorsRegistrationList.push_back(op.registration);
+            return true;
+        }
+        case CValidatorsStateOp::REMOVE_REGISTRATION:
+        {
+            LOCK(cs_ValidatorsRegistrationList);
+            auto iter = std::find(validatorsRegistrationList.begin(), validatorsRegistrationList.end(), op.registration);
+            if(iter == validatorsRegistrationList.end())
+                return false;
+            validatorsRegistrationList.erase(iter);
+            return true;
+        }
+        case CValidatorsStateOp::ADD_VOTE:
+        {
+            LOCK(cs_ValidatorsVotesList);
+            validatorsVotesList.push_back(op.vote);
+            return true;
+        }
+        case CValidatorsStateOp::REMOVE_VOTE:
+        {
+            LOCK(cs_ValidatorsVotesList);
+            auto iter = std::find(validatorsVotesList.begin(), validatorsVotesList.end(), op.vote);
+            if(iter == validatorsVotesList.end())
+                return false;
+            validatorsVotesList.erase(iter);
+            return true;
+        }
+        case CValidatorsStateOp::NEW_PERIOD:
+        {
+            {
+                LOCK(cs_ValidatorsRegistrationList);
+                LOCK(cs_ValidatorsVotesList);
+                LOCK(cs_ValidatorsList);
+                validatorsList = op.validators;
+                validatorsRegistrationList.clear();
+                validatorsVotesList.clear();
+            }
+            publish_validators();
+            return true;
+        }
+        case CValidatorsStateOp::RESTORE_PERIOD:
+        {
+            {
+                LOCK(cs_ValidatorsRegistrationList);
+                LOCK(cs_ValidatorsVotesList);
+                LOCK(cs_ValidatorsList);
+                validatorsList = op.validators;
+                validatorsRegistrationList = op.registrations;
+                validatorsVotesList = op.votes;
+            }
+            publish_validators();
+            return true;
+        }
+    }
+    return false;
+}
+
+void CValidatorsState::publish_validators()
+{
+    LOCK(cs_ValidatorsList);
+    std::atomic_store(&validatorsSnapshot, CValidatorsSnapshotRef(std::make_shared<const CValidatorsSnapshot>(validatorsList)));
+}
+
+void CValidatorsState::record(CValidatorsStateOp &&op)
+{
+    LOCK(cs_Journal);
+    vPendingOps.push_back(std::move(op));
+}
+
+void CValidatorsState::add_registration(const CValidatorRegister &validatorRegisterIn)
+{
+    CValidatorsStateOp op(CValidatorsStateOp::ADD_REGISTRATION);
+    op.registration = validatorRegisterIn;
+    apply(op);
+    record(std::move(op));
+}
+
+void CValidatorsState::add_vote(const CValidatorVote &validatorVoteIn)
+{
+    CValidatorsStateOp op(CValidatorsStateOp::ADD_VOTE);
+    op.vote = validatorVoteIn;
+    apply(op);
+    record(std::move(op));
+}
+
+bool CValidatorsState::remove_registration(const CValidatorRegister &validatorRegisterIn)
+{
+    CValidatorsStateOp op(CValidatorsStateOp::REMOVE_REGISTRATION);
+    op.registration = validatorRegisterIn;
+    auto status = apply(op);
+    if(status)
+        record(std::move(op));
     return status;
 }
 
 bool CValidatorsState::remove_vote(const CValidatorVote &validatorVoteIn)
 {
-    LOCK(cs_ValidatorsVotesList);
-    auto status = false;
-    
-    auto iter = std::find(validatorsVotesList.begin(), validatorsVotesList.end(), validatorVoteIn);
-    if(iter != validatorsVotesList.end())
+    CValidatorsStateOp op(CValidatorsStateOp::REMOVE_VOTE);
+    op.vote = validatorVoteIn;
+    auto status = apply(op);
+    if(status)
+        record(std::move(op));
+    return status;
+}
+
+void CValidatorsState::start_new_period(const std::vector<CValidatorInfo> &validatorsListIn)
+{
+    CValidatorsStateOp op(CValidatorsStateOp::NEW_PERIOD);
+    op.validators = validatorsListIn;
+    op.prevValidators = get_validators();
+    op.registrations = get_registrations();
+    op.votes = get_votes();
+    apply(op);
+    record(std::move(op));
+}
+
+void CValidatorsState::restore_period(const std::vector<CValidatorRegister> &registrationsIn,
+                                      const std::vector<CValidatorVote> &votesIn,
+                                      const std::vector<CValidatorInfo> &validatorsIn)
+{
+    CValidatorsStateOp op(CValidatorsStateOp::RESTORE_PERIOD);
+    op.validators = validatorsIn;
+    op.registrations = registrationsIn;
+    op.votes = votesIn;
+    apply(op);
+    record(std::move(op));
+}
+
+bool CValidatorsState::undo_new_period(const uint256 &hashBlock)
+{
+    CValidatorsStateOp newPeriod;
+    bool found = false;
     {
-        validatorsVotesList.erase(iter);
-        status = true;
+        LOCK(cs_Journal);
+        for(auto entry = vJournal.rbegin(); entry != vJournal.rend() && !found; ++entry)
+        {
+            if(entry->hashBlock != hashBlock || !entry->fConnect)
+                continue;
+            for(auto &op : entry->vOps)
+            {
+                if(op.nType == CValidatorsStateOp::NEW_PERIOD)
+                {
+                    newPeriod = op;
+                    found = true;
+                }
+            }
+        }
     }
-    return status;
+    if(found)
+        restore_period(newPeriod.registrations, newPeriod.votes, newPeriod.prevValidators);
+    return found;
 }
 
-bool CValidatorsState::load(const boost::filesystem::path &fileName)
+bool CValidatorsState::restore_snapshot(const boost::filesystem::path &fileName)
+{
+    CValidatorsState snapshot;
+    uint64_t nSeq = 0;
+    if(!snapshot.read_base(fileName, nSeq))
+        return false;
+    restore_period(snapshot.get_registrations(), snapshot.get_votes(), snapshot.get_validators());
+    return true;
+}
+
+bool CValidatorsState::read_base(const boost::filesystem::path &fileName, uint64_t &nBaseSeq)
 {
     bool status = false;
+    nBaseSeq = 0;
     
     std::fstream file(fileName.string(), std::fstream::in | std::ios::binary);
     if(file)
     {
         Unserialize(file, SER_DISK, CLIENT_VERSION);
+        publish_validators();
+        // files written before the journal existed have no sequence number
+        if(file.peek() != EOF)
+            ::Unserialize(file, nBaseSeq, SER_DISK, CLIENT_VERSION);
         file.close();
         status = true;
     }
     return status;
 }
 
-bool CValidatorsState::flush(const boost::filesystem::path &fileName)
+bool CValidatorsState::write_base(const boost::filesystem::path &fileName, uint64_t nBaseSeq)
 {
     bool status = false;
-
-    std::fstream file(fileName.string(), std::fstream::out | std::ios::binary);
+    boost::filesystem::path pathTmp = fileName;
+    pathTmp += ".new";
+    
+    std::fstream file(pathTmp.string(), std::fstream::out | std::ios::binary);
     if(file)
     {
         Serialize(file, SER_DISK, CLIENT_VERSION);
+        ::Serialize(file, nBaseSeq, SER_DISK, CLIENT_VERSION);
         file.flush();
         file.close();
+        status = RenameOver(pathTmp, fileName);
+    }
+    return status;
+}
+
+static void WriteJournalEntry(std::fstream &file, const CValidatorsJournalEntry &entry)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << entry;
+    std::vector<unsigned char> vchEntry(ss.begin(), ss.end());
+    ::Serialize(file, vchEntry, SER_DISK, CLIENT_VERSION);
+    ::Serialize(file, Hash(vchEntry.begin(), vchEntry.end()), SER_DISK, CLIENT_VERSION);
+}
+
+bool CValidatorsState::write_journal(const std::vector<CValidatorsJournalEntry> &vEntries)
+{
+    bool status = false;
+    boost::filesystem::path pathTmp = GetValidatorsJournalPath();
+    pathTmp += ".new";
+    
+    std::fstream file(pathTmp.string(), std::fstream::out | std::ios::binary);
+    if(file)
+    {
+        for(auto &entry : vEntries)
+            WriteJournalEntry(file, entry);
+        file.flush();
+        file.close();
+        status = RenameOver(pathTmp, GetValidatorsJournalPath());
+    }
+    return status;
+}
+
+bool CValidatorsState::load(const boost::filesystem::path &fileName)
+{
+    uint64_t nBaseSeq = 0;
+    bool status = read_base(fileName, nBaseSeq);
+    
+    LOCK(cs_Journal);
+    vPendingOps.clear();
+    vJournal.clear();
+    nJournalSeq = nBaseSeq;
+    
+    bool fTruncated = false;
+    std::fstream file(GetValidatorsJournalPath().string(), std::fstream::in | std::ios::binary);
+    while(file && file.peek() != EOF)
+    {
+        CValidatorsJournalEntry entry;
+        try {
+            std::vector<unsigned char> vchEntry;
+            uint256 hashEntry;
+            ::Unserialize(file, vchEntry, SER_DISK, CLIENT_VERSION);
+            ::Unserialize(file, hashEntry, SER_DISK, CLIENT_VERSION);
+            if(!file || hashEntry != Hash(vchEntry.begin(), vchEntry.end())) {
+                fTruncated = true;
+                break;
+            }
+            CDataStream ss(vchEntry, SER_DISK, CLIENT_VERSION);
+            ss >> entry;
+        } catch (const std::exception& e) {
+            fTruncated = true;
+            break;
+        }
+        // entries already folded into the base by an interrupted compaction
+        if(entry.nSeq <= nBaseSeq)
+            continue;
+        for(auto &op : entry.vOps)
+            apply(op);
+        nJournalSeq = entry.nSeq;
+        vJournal.push_back(std::move(entry));
         status = true;
     }
+    file.close();
+    
+    if(fTruncated) {
+        LogPrintf("%s : Dropping incomplete tail of the validators journal after %u entries\n", __func__, vJournal.size());
+        write_journal(vJournal);
+    }
     return status;
 }
+
+bool CValidatorsState::flush(const boost::filesystem::path &fileName)
+{
+    LOCK(cs_Journal);
+    if(!write_base(fileName, nJournalSeq))
+        return false;
+    vJournal.clear();
+    return write_journal(vJournal);
+}
+
+bool CValidatorsState::commit(const uint256 &hashBlock, int nHeight, bool fConnect)
+{
+    LOCK(cs_Journal);
+    if(vPendingOps.empty())
+        return true;
+    
+    CValidatorsJournalEntry entry(hashBlock, nHeight, fConnect);
+    entry.nSeq = ++nJournalSeq;
+    entry.vOps.swap(vPendingOps);
+    
+    std::fstream file(GetValidatorsJournalPath().string(), std::fstream::out | std::fstream::app | std::ios::binary);
+    if(!file)
+        return error("%s : Failed to open validators journal", __func__);
+    WriteJournalEntry(file, entry);
+    file.flush();
+    file.close();
+    vJournal.push_back(std::move(entry));
+    
+    if(vJournal.size() > VALIDATORS_JOURNAL_COMPACT_ENTRIES)
+        return compact_journal(nHeight);
+    return true;
+}
+
+bool CValidatorsState::compact_journal(int nHeight)
+{
+    // keep whatever a reorg may still have to roll back
+    size_t nFold = 0;
+    while(nFold < vJournal.size() && vJournal[nFold].nHeight + Params().MaxReorganizationDepth() < nHeight)
+        ++nFold;
+    if(nFold == 0)
+        return true;
+    
+    const boost::filesystem::path pathBase = GetValidatorsDir() / "state";
+    CValidatorsState base;
+    uint64_t nBaseSeq = 0;
+    base.read_base(pathBase, nBaseSeq);
+    for(size_t i = 0; i < nFold; ++i)
+    {
+        if(vJournal[i].nSeq <= nBaseSeq)
+            continue;
+        for(auto &op : vJournal[i].vOps)
+            base.apply(op);
+    }
+    
+    // the base goes first: should we stop in between, the folded entries
+    // left in the journal are skipped by their sequence number
+    if(!base.write_base(pathBase, vJournal[nFold - 1].nSeq))
+        return error("%s : Failed to write validators state", __func__);
+    vJournal.erase(vJournal.begin(), vJournal.begin() + nFold);
+    if(!write_journal(vJournal))
+        return error("%s : Failed to rewrite validators journal", __func__);
+    
+    LogPrint("validators", "%s : folded %u entries into the validators state, %u kept\n", __func__, nFold, vJournal.size());
+    return true;
+}
@@ -1,68 +1,181 @@
 #ifndef BTCU_VALIDATORS_STATE_H
 #define BTCU_VALIDATORS_STATE_H
 
+#include <memory>
 #include <vector>
+#include <boost/unordered_map.hpp>
 #include "sync.h"
 #include "masternode-validators.h"
 #include "primitives/transaction.h"
+#include "pubkey.h"
 #include "util.h"
 
 boost::filesystem::path GetValidatorsDir();
 
-class CValidatorsState
+/** Compact the journal once it holds that many block entries */
+static const size_t VALIDATORS_JOURNAL_COMPACT_ENTRIES = 1000;
+
+/** A single change of the validators voting state, as recorded in the journal */
+class CValidatorsStateOp
 {
 public:
+    enum Type : uint8_t {
+        ADD_REGISTRATION = 0,
+        REMOVE_REGISTRATION = 1,
+        ADD_VOTE = 2,
+        REMOVE_VOTE = 3,
+        NEW_PERIOD = 4,     // validators replaced, registrations and votes cleared
+        RESTORE_PERIOD = 5  // reverse of NEW_PERIOD
+    };
+    
+    uint8_t nType;
+    CValidatorRegister registration;
+    CValidatorVote vote;
+    // NEW_PERIOD: the new validators list; RESTORE_PERIOD: the restored one
+    std::vector<CValidatorInfo> validators;
+    // NEW_PERIOD: the state that was replaced, kept so the period can be rolled back
+    std::vector<CValidatorInfo> prevValidators;
+    std::vector<CValidatorRegister> registrations;
+    std::vector<CValidatorVote> votes;
+    
+    CValidatorsStateOp() : nType(ADD_REGISTRATION) {}
+    explicit CValidatorsStateOp(uint8_t nTypeIn) : nType(nTypeIn) {}
     
-    std::vector<CValidatorInfo> get_validators()
+    ADD_SERIALIZE_METHODS;
+    
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
-        LOCK(cs_ValidatorsList);
-        return validatorsList;
+        READWRITE(this->nType);
+        if (this->nType == ADD_REGISTRATION || this->nType == REMOVE_REGISTRATION)
+            READWRITE(registration);
+        if (this->nType == ADD_VOTE || this->nType == REMOVE_VOTE)
+            READWRITE(vote);
+        if (this->nType == NEW_PERIOD || this->nType == RESTORE_PERIOD) {
+            READWRITE(validators);
+            READWRITE(registrations);
+            READWRITE(votes);
+        }
+        if (this->nType == NEW_PERIOD)
+            READWRITE(prevValidators);
     }
+};
+
+/** The changes a connected or disconnected block made to the validators voting state */
+class CValidatorsJournalEntry
+{
+public:
+    uint64_t nSeq;
+    uint256 hashBlock;
+    int nHeight;
+    bool fConnect;
+    std::vector<CValidatorsStateOp> vOps;
     
-    std::vector<CValidatorRegister> get_registrations()
+    CValidatorsJournalEntry() : nSeq(0), hashBlock(), nHeight(0), fConnect(true) {}
+    CValidatorsJournalEntry(const uint256& hashBlockIn, int nHeightIn, bool fConnectIn) :
+        nSeq(0), hashBlock(hashBlockIn), nHeight(nHeightIn), fConnect(fConnectIn) {}
+    
+    ADD_SERIALIZE_METHODS;
+    
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
-        LOCK(cs_ValidatorsRegistrationList);
-        return validatorsRegistrationList;
+        READWRITE(nSeq);
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+        READWRITE(fConnect);
+        READWRITE(vOps);
     }
+};
+
+struct ValidatorKeyIDHasher {
+    size_t operator()(const CKeyID& keyID) const { return keyID.GetLow64(); }
+};
+
+struct ValidatorOutPointHasher {
+    size_t operator()(const COutPoint& outpoint) const { return outpoint.hash.GetLow64() ^ outpoint.n; }
+};
+
+/**
+ * Immutable validators list indexed by key id and by vin outpoint.
+ * Shared with readers through an atomic pointer, so lookups neither lock nor copy.
+ */
+class CValidatorsSnapshot
+{
+public:
+    const std::vector<CValidatorInfo> validators;
     
-    std::vector<CValidatorVote> get_votes()
+    CValidatorsSnapshot() {}
+    explicit CValidatorsSnapshot(const std::vector<CValidatorInfo> &validatorsIn);
+    
+    const CValidatorInfo* find(const CTxIn &vin) const;
+    bool contains(const CKeyID &keyID) const;
+    
+private:
+    boost::unordered_map<CKeyID, size_t, ValidatorKeyIDHasher> mapByKeyID;
+    boost::unordered_map<COutPoint, size_t, ValidatorOutPointHasher> mapByVin;
+};
+
+typedef std::shared_ptr<const CValidatorsSnapshot> CValidatorsSnapshotRef;
+
+/** Indexed validators registered in the genesis block of the active network */
+CValidatorsSnapshotRef GetGenesisValidators();
+
+/**
+ * Registrations, votes and the validators list of the current voting period.
+ *
+ * The "state" file holds a base snapshot and the "journal" file the per-block
+ * changes made since, so connecting a block only appends its own delta.
+ * Entries within the max reorg depth are never compacted away: they carry
+ * everything needed to roll a voting period back on DisconnectBlock.
+ */
+class CValidatorsState
+{
+public:
+    
+    std::vector<CValidatorInfo> get_validators()
     {
-        LOCK(cs_ValidatorsVotesList);
-        return validatorsVotesList;
+        LOCK(cs_ValidatorsList);
+        return validatorsList;
     }
     
-    void set_validators(const std::vector<CValidatorInfo> &validatorsListIn)
+    /** Current validators list, published whenever it changes at a voting period boundary */
+    CValidatorsSnapshotRef get_validators_snapshot() const
     {
-        LOCK(cs_ValidatorsList);
-        validatorsList = validatorsListIn;
+        return std::atomic_load(&validatorsSnapshot);
     }
     
-    void add_registration(const CValidatorRegister &validatorRegisterIn)
+    std::vector<CValidatorRegister> get_registrations()
     {
         LOCK(cs_ValidatorsRegistrationList);
-        validatorsRegistrationList.push_back(validatorRegisterIn);
+        return validatorsRegistrationList;
     }
     
-    void add_vote(const CValidatorVote &validatorVoteIn)
+    std::vector<CValidatorVote> get_votes()
     {
         LOCK(cs_ValidatorsVotesList);
-        validatorsVotesList.push_back(validatorVoteIn);
+        return validatorsVotesList;
     }
     
+    void add_registration(const CValidatorRegister &validatorRegisterIn);
+    void add_vote(const CValidatorVote &validatorVoteIn);
     bool remove_registration(const CValidatorRegister &validatorRegisterIn);
     bool remove_vote(const CValidatorVote &validatorVoteIn);
     
-    void clear_registrations()
-    {
-        LOCK(cs_ValidatorsRegistrationList);
-        validatorsRegistrationList.clear();
-    }
+    /** Set the new validators list and clear registrations and votes for the next voting period */
+    void start_new_period(const std::vector<CValidatorInfo> &validatorsListIn);
+    /** Roll back the period started by the given block, false if the journal no longer covers it */
+    bool undo_new_period(const uint256 &hashBlock);
+    /** Restore a whole voting state, e.g. from a legacy per-period snapshot */
+    void restore_period(const std::vector<CValidatorRegister> &registrationsIn,
+                        const std::vector<CValidatorVote> &votesIn,
+                        const std::vector<CValidatorInfo> &validatorsIn);
     
-    void clear_votes()
-    {
-        LOCK(cs_ValidatorsVotesList);
-        validatorsVotesList.clear();
-    }
+    /** Restore the voting state stored in a legacy per-period snapshot file */
+    bool restore_snapshot(const boost::filesystem::path &fileName);
+    
+    /** Append the changes made since the last commit to the journal as one block entry */
+    bool commit(const uint256 &hashBlock, int nHeight, bool fConnect);
     
     ADD_SERIALIZE_METHODS;
     
@@ -72,17 +185,27 @@ public:
         LOCK(cs_ValidatorsRegistrationList);
         LOCK(cs_ValidatorsVotesList);
         LOCK(cs_ValidatorsList);
-        
+    
         READWRITE(validatorsRegistrationList);
         READWRITE(validatorsVotesList);
         READWRITE(validatorsList);
     }
     
+    /** Load the base snapshot and replay the journal on top of it */
     bool load (const boost::filesystem::path &fileName = (GetValidatorsDir() / "state"));
+    /** Write the full state as the base snapshot and truncate the journal */
     bool flush(const boost::filesystem::path &fileName = (GetValidatorsDir() / "state"));
     
 private:
     
+    bool apply(const CValidatorsStateOp &op);
+    void record(CValidatorsStateOp &&op);
+    void publish_validators();
+    bool read_base(const boost::filesystem::path &fileName, uint64_t &nBaseSeq);
+    bool write_base(const boost::filesystem::path &fileName, uint64_t nBaseSeq);
+    bool write_journal(const std::vector<CValidatorsJournalEntry> &vEntries);
+    bool compact_journal(int nHeight);
+    
     CCriticalSection cs_ValidatorsRegistrationList;
     std::vector<CValidatorRegister> validatorsRegistrationList;
     
@@ -91,6 +214,15 @@ private:
     
     CCriticalSection cs_ValidatorsList;
     std::vector<CValidatorInfo> validatorsList;
+    CValidatorsSnapshotRef validatorsSnapshot = std::make_shared<const CValidatorsSnapshot>();
+    
+    CCriticalSection cs_Journal;
+    // changes not committed to the journal yet
+    std::vector<CValidatorsStateOp> vPendingOps;
+    // entries of the journal file, in order
+    std::vector<CValidatorsJournalEntry> vJournal;
+    // sequence number of the last entry committed or folded into the base
+    uint64_t nJournalSeq = 0;
 };
 
 #endif // BTCU_VALIDATORS_STATE_H
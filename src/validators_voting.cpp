@@ -76,22 +76,19 @@ void UpdateValidators(CBlockIndex *pBlockIndex, bool bForward)
     {
         if(bForward)
         {
-            // make snapshot of the current voting state and the validators list from a previous voting period before they are both cleared
-            g_ValidatorsState.flush(GetSnapshotName(pBlockIndex->GetBlockHash()));
-            
-            // count votes, create and set new validators list
-            g_ValidatorsState.set_validators(ComposeValidatorsList(CountVotes()));
-    
-            // the next block is the beginning of a new voting period, so reset the voting state beforehand
-            g_ValidatorsState.clear_registrations();
-            g_ValidatorsState.clear_votes();
-    
-            g_ValidatorsState.flush();
+            // count votes, set the new validators list and reset the voting state, as the next block is the beginning
+            // of a new voting period; the journal keeps the replaced state for a rollback
+            g_ValidatorsState.start_new_period(ComposeValidatorsList(CountVotes()));
         }
         else
         {
-            // restore snapshot of the specific voting state
-            g_ValidatorsState.load(GetSnapshotName(pBlockIndex->GetBlockHash()));
+            // restore the voting state replaced by this block, periods started before
+            // the journal existed are covered by their snapshot files
+            if(!g_ValidatorsState.undo_new_period(pBlockIndex->GetBlockHash()) &&
+               !g_ValidatorsState.restore_snapshot(GetSnapshotName(pBlockIndex->GetBlockHash())))
+            {
+                LogPrintf("%s : No voting state to restore for block %s\n", __func__, pBlockIndex->GetBlockHash().ToString());
+            }
         }
     }
 }
@@ -105,7 +102,6 @@ void UpdateValidatorsVotingState(const CTransaction& tx, bool bForward)
         } else {
             g_ValidatorsState.remove_registration(tx.validatorRegister.front());
         }
-        g_ValidatorsState.flush();
     }
     else if(tx.IsValidatorVote())
     {
@@ -114,23 +110,24 @@ void UpdateValidatorsVotingState(const CTransaction& tx, bool bForward)
         } else {
             g_ValidatorsState.remove_vote(tx.validatorVote.front());
         }
-        g_ValidatorsState.flush();
     }
 }
 
+void CommitValidatorsVotingState(const CBlockIndex *pBlockIndex, bool bForward)
+{
+    if(!g_ValidatorsState.commit(pBlockIndex->GetBlockHash(), pBlockIndex->nHeight, bForward))
+        LogPrintf("%s : Failed to journal validators state of block %s\n", __func__, pBlockIndex->GetBlockHash().ToString());
+}
+
 boost::optional<CValidatorInfo> GetValidatorInfo(const CTxIn &validatorVin)
 {
-    auto validatorsList = g_ValidatorsState.get_validators();
-    
-    auto is_validatorVin = [validatorVin](CValidatorInfo valInfo) -> bool {
-        return (valInfo.vin == validatorVin);
-    };
+    auto validators = g_ValidatorsState.get_validators_snapshot();
     
     boost::optional<CValidatorInfo> infoOpt;
     
-    auto valInfoIter = std::find_if(validatorsList.begin(), validatorsList.end(), is_validatorVin);
-    if(valInfoIter != validatorsList.end()){
-        infoOpt.emplace(*valInfoIter);
+    auto valInfo = validators->find(validatorVin);
+    if(valInfo){
+        infoOpt.emplace(*valInfo);
     }
     return infoOpt;
 }
@@ -152,14 +149,9 @@ boost::optional<CPubKey> GetGenesisValidatorPubKey(const CTxIn &validatorVin)
     
     if(VinIsGenesis(validatorVin))
     {
-        auto genesisValidators = Params().GenesisBlock().vtx[0].validatorRegister;
-        for(auto &gv : genesisValidators)
-        {
-            if(gv.vin == validatorVin)
-            {
-                pubKeyOpt.emplace(gv.pubKey);
-                break;
-            }
+        auto genesisValidator = GetGenesisValidators()->find(validatorVin);
+        if(genesisValidator){
+            pubKeyOpt.emplace(genesisValidator->pubKey);
         }
     }
     return pubKeyOpt;
@@ -186,27 +178,7 @@ bool CheckValidator(const CBlock& block, const CCoinsViewCache &view)
 
 bool isAddressValidator(const CKeyID &address)
 {
-   bool bSCValidatorFound = false;
-   //genesis validators
-   auto genesisValidators = Params().GenesisBlock().vtx[0].validatorRegister;
-   for(auto &gv : genesisValidators){
-      if(address == gv.pubKey.GetID()){
-         bSCValidatorFound = true;
-         break;
-      }
-   }
-
-   //voted validators
-   if(!bSCValidatorFound)
-   {
-      auto validatorsRegistrationList = g_ValidatorsState.get_validators();
-      for (auto& rv: validatorsRegistrationList)
-      {
-         if(address == rv.pubKey.GetID()){
-            bSCValidatorFound = true;
-            break;
-         }
-      }
-   }
-   return bSCValidatorFound;
+   //genesis validators, then voted validators
+   return GetGenesisValidators()->contains(address) ||
+          g_ValidatorsState.get_validators_snapshot()->contains(address);
 }
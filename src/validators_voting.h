@@ -6,6 +6,7 @@
 
 void UpdateValidators(CBlockIndex *pBlockIndex, bool bForward = true);
 void UpdateValidatorsVotingState(const CTransaction& tx, bool bForward = true);
+void CommitValidatorsVotingState(const CBlockIndex *pBlockIndex, bool bForward = true);
 bool CheckValidator(const CBlock& block, const CCoinsViewCache &view);
 boost::optional<CValidatorInfo> GetValidatorInfo(const CTxIn &validatorVin);
 boost::optional<CPubKey> GetValidatorPubKey(const CTxIn &validatorVin);
@@ -361,7 +361,7 @@ UniValue createcontract(const UniValue& params, bool fHelp){
           CPubKey pubkey = key.GetPubKey();
           bool bSCValidatorFound = false;
           //genesis validators
-          auto genesisValidators = Params().GenesisBlock().vtx[0].validatorRegister;
+          auto genesisValidators = Params().GenesisBlock().vtx[0]->validatorRegister;
           for(auto &gv : genesisValidators){
              if(pubkey == gv.pubKey){
                 bSCValidatorFound = true;
@@ -1409,8 +1409,8 @@ void SendMoney(const CTxDestination& address, CAmount nValue, CWalletTx& wtxNew,
 
     //check validators before committing
    std::vector<CTransaction> validatorTransactions;
-   for(auto &t: mempool.mapTx){
-      const CTransaction &valTx = t.second.GetTx();
+   for(const CTxMemPoolEntry &t: mempool.mapTx){
+      const CTransaction &valTx = t.GetTx();
       if(valTx.IsValidatorVote() || valTx.IsValidatorRegister())
          validatorTransactions.push_back(valTx);
    }
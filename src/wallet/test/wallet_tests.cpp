@@ -6,6 +6,10 @@
 
 #include "wallet/wallet.h"
 
+#include "init.h"
+#include "main.h"
+#include "txmempool.h"
+
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -306,4 +310,76 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
     empty_wallet();
 }
 
+BOOST_AUTO_TEST_CASE(wallet_script_filter)
+{
+    CBasicKeyStore keystore;
+    CKey key;
+    key.MakeNewKey(true);
+    keystore.AddKey(key);
+    const CPubKey pubkey = key.GetPubKey();
+    const CScript redeemScript = GetScriptForMultisig(1, std::vector<CPubKey>(1, pubkey));
+    keystore.AddCScript(redeemScript);
+
+    CWalletScriptFilter filter(keystore);
+    const uint256 hashFilter = filter.GetHash();
+
+    // Everything IsMine() accepts for this key store must match
+    std::vector<CScript> vMine;
+    vMine.push_back(GetScriptForDestination(PKHash(pubkey)));
+    vMine.push_back(GetScriptForRawPubKey(pubkey));
+    vMine.push_back(GetScriptForDestination(ScriptHash(redeemScript)));
+    vMine.push_back(redeemScript);
+    for (const CScript& script : vMine) {
+        BOOST_CHECK(IsMine(keystore, script) != ISMINE_NO);
+        BOOST_CHECK(filter.Match(script));
+    }
+
+    CKey other;
+    other.MakeNewKey(true);
+    const CScript scriptOther = GetScriptForDestination(PKHash(other.GetPubKey()));
+    BOOST_CHECK(!filter.Match(scriptOther));
+
+    filter.AddScript(scriptOther);
+    BOOST_CHECK(filter.Match(scriptOther));
+    BOOST_CHECK(filter.GetHash() != hashFilter);
+}
+
+// Cached balances follow a wallet transaction out of the mempool and back
+BOOST_AUTO_TEST_CASE(wallet_balances_mempool)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    BOOST_CHECK(pwalletMain->AddKeyPubKey(key, key.GetPubKey()));
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash = InsecureRand256();
+    tx.vin[0].prevout.n = 0;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 5 * COIN;
+    tx.vout[0].scriptPubKey = GetScriptForDestination(PKHash(key.GetPubKey()));
+    const CTransactionRef ptx = MakeTransactionRef(tx);
+    const uint256 hash = ptx->GetHash();
+
+    BOOST_CHECK(pwalletMain->AddToWallet(CWalletTx(pwalletMain, *ptx), false, NULL));
+    mempool.addUnchecked(hash, CTxMemPoolEntry(ptx, 0, 0, 0.0, 1));
+    BOOST_CHECK_EQUAL(pwalletMain->GetBalances().nUnconfirmed, 5 * COIN);
+
+    // Expiry evicts the entry, which entered the mempool at time 0
+    {
+        LOCK(cs_main);
+        LimitMempoolSize(mempool, std::numeric_limits<size_t>::max(), 0);
+    }
+    BOOST_CHECK(!mempool.exists(hash));
+    BOOST_CHECK_EQUAL(pwalletMain->GetBalances().nUnconfirmed, 0);
+
+    // Back in the mempool, the wallet hears of it the way AcceptToMemoryPool tells it
+    mempool.addUnchecked(hash, CTxMemPoolEntry(ptx, 0, GetTime(), 0.0, 1));
+    pwalletMain->SyncTransaction(*ptx, NULL);
+    BOOST_CHECK_EQUAL(pwalletMain->GetBalances().nUnconfirmed, 5 * COIN);
+
+    mempool.clear();
+    pwalletMain->EraseFromWallet(hash);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -9,11 +9,13 @@
 #include "wallet/wallet.h"
 
 #include "coincontrol.h"
+#include "crypto/common.h"
 #include "init.h"
 #include "masternode-budget.h"
 #include "script/sign.h"
 #include "spork.h"
 #include "swifttx.h"    // mapTxLockReq
+#include "txdb.h"
 #include "util.h"
 #include "utilmoneystr.h"
 #include "zbtcuchain.h"
@@ -29,7 +31,11 @@
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
 #include <key_io.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <random>
+#include <thread>
 
 /**
  * Settings
@@ -954,6 +960,9 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     if (!AddToWalletIfInvolvingMe(tx, pblock, [&](CMerkleTx& wtx){if (pblock) wtx.SetMerkleBranch(*pblock);}, true))
         return; // Not one of ours
 
+    // A known transaction entering the mempool or a block moves between the balances
+    MarkBalancesDirty();
+
     // If a transaction changes 'conflicted' state, that changes the balance
     // available of the outputs it spends. So force those to be
     // recomputed, also:
@@ -963,14 +972,22 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     }
 }
 
+void CWallet::UpdatedBlockTip(const CBlockIndex* pindex)
+{
+    // Depths changed: coins may have matured, confirmed or been disconnected
+    MarkBalancesDirty();
+}
+
 void CWallet::EraseFromWallet(const uint256& hash)
 {
     if (!fFileBacked)
         return;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        if (mapWallet.erase(hash)) {
             CWalletDB(strWalletFile).EraseTx(hash);
+            MarkBalancesDirty();
+        }
         LogPrintf("%s: Erased wtx %s from wallet\n", __func__, hash.GetHex());
     }
     return;
@@ -1580,16 +1597,99 @@ bool CWalletTx::WriteToDisk(CWalletDB *pwalletdb)
     return CWalletDB(pwallet->strWalletFile).WriteTx(GetHash(), *this);
 }
 
+CWalletScriptFilter CWallet::GetScriptFilter() const
+{
+    AssertLockHeld(cs_wallet);
+    CWalletScriptFilter filter(*this);
+    for (const CScript& script : setWatchOnly)
+        filter.AddScript(script);
+    for (const CScript& script : setMultiSig)
+        filter.AddScript(script);
+    return filter;
+}
+
+namespace {
+/** The chainstate rescan splits the txid key space into this many ranges, by leading key byte */
+const int CHAINSTATE_SCAN_RANGES = 64;
+/** Coins a scan worker reads before handing its matches and position over to the committer */
+const size_t CHAINSTATE_SCAN_BATCH = 4096;
+/** Seconds between writes of the rescan progress to the wallet database */
+const int64_t CHAINSTATE_SCAN_SAVE_INTERVAL = 30;
+
+int ChainstateScanRange(const uint256& txid)
+{
+    return *txid.begin() * CHAINSTATE_SCAN_RANGES / 256;
+}
+
+uint256 ChainstateScanRangeBegin(int nRange)
+{
+    uint256 txid;
+    *txid.begin() = nRange * 256 / CHAINSTATE_SCAN_RANGES;
+    return txid;
+}
+
+/** Part of a range that lies before txid, judged by its two leading key bytes */
+double ChainstateScanRangeProgress(int nRange, const uint256& txid)
+{
+    const double nRangeSize = 0x10000 / CHAINSTATE_SCAN_RANGES;
+    const double nPos = 0x100 * *txid.begin() + *(txid.begin() + 1);
+    return std::min(1.0, std::max(0.0, (nPos - nRangeSize * nRange) / nRangeSize));
+}
+
+/** What a scan worker found in a stretch of one range */
+struct CChainstateScanBatch {
+    int nRange = -1;
+    std::vector<std::pair<uint256, CCoins> > vMatches;
+    //! First txid after this stretch, unless the range is done
+    uint256 txidNext;
+    bool fDone = false;
+    std::string strError;
+};
+}
+
+/**
+ * Scan the chainstate for outputs to the wallet.
+ *
+ * Workers scan disjoint txid ranges on their own cursors and only match the outputs
+ * against a snapshot of the wallet's key and script hashes, so they never take the
+ * wallet lock. Candidate transactions are handed to this thread, which holds cs_wallet
+ * and runs the full AddToWalletIfInvolvingMe() on them. The position reached in every
+ * range is stored in the wallet database, so an interrupted scan for the same keys
+ * resumes where it stopped.
+ */
 int CWallet::ScanBitcoinStateForWalletTransactions(std::unique_ptr<CCoinsViewIterator> pCursor, bool fUpdate, bool fromStartup) {
     if (!pCursor) {
         return 0;
     }
+    AssertLockHeld(cs_wallet);
+
+    const CWalletScriptFilter filter = GetScriptFilter();
+
+    CChainstateScanProgress progress;
+    if (fFileBacked && CWalletDB(strWalletFile).ReadChainstateScan(progress) &&
+        progress.hashFilter == filter.GetHash() &&
+        progress.vNext.size() == CHAINSTATE_SCAN_RANGES && progress.vDone.size() == CHAINSTATE_SCAN_RANGES) {
+        LogPrintf("Resuming the chainstate scan for wallet transactions\n");
+    } else {
+        progress.hashFilter = filter.GetHash();
+        progress.vNext.clear();
+        for (int nRange = 0; nRange < CHAINSTATE_SCAN_RANGES; nRange++)
+            progress.vNext.push_back(ChainstateScanRangeBegin(nRange));
+        progress.vDone.assign(CHAINSTATE_SCAN_RANGES, false);
+    }
+
+    std::vector<int> vRanges;
+    std::vector<double> vRangeProgress(CHAINSTATE_SCAN_RANGES, 1.0);
+    for (int nRange = 0; nRange < CHAINSTATE_SCAN_RANGES; nRange++) {
+        if (!progress.vDone[nRange]) {
+            vRanges.push_back(nRange);
+            vRangeProgress[nRange] = ChainstateScanRangeProgress(nRange, progress.vNext[nRange]);
+        }
+    }
+    const std::vector<uint256> vStart = progress.vNext;
 
     int ret = 0;
-    int64_t count = 0;
     int reportDone = 0;
-    uint256 trxHash;
-    CCoins coins;
     int prevPctDone = 0;
 
     auto merkleClb = [&](CMerkleTx& wtx){
@@ -1601,68 +1701,247 @@ int CWallet::ScanBitcoinStateForWalletTransactions(std::unique_ptr<CCoinsViewIte
     LogPrintf("[0%%]..."); /* Continued */
     m_node->showProgress(_("Rescanning the chainstate state..."), 0);
 
-    for (; pCursor->Valid(); pCursor->Next()) {
-        if (fromStartup && ShutdownRequested()) {
-            LogPrintf("[CANCELED].\n");
-            return -1;
+    const unsigned int nWorkers = std::max(1u, std::min<unsigned int>(std::thread::hardware_concurrency(), vRanges.size()));
+    const size_t nMaxQueued = 2 * nWorkers;
+
+    std::mutex cs_scan;
+    std::condition_variable condBatch;
+    std::condition_variable condSpace;
+    std::deque<CChainstateScanBatch> queueBatches;
+    size_t nNextRange = 0;
+    unsigned int nWorkersDone = 0;
+    bool fStop = false;
+
+    auto fnPush = [&](CChainstateScanBatch& batch) {
+        std::unique_lock<std::mutex> lock(cs_scan);
+        condSpace.wait(lock, [&]() { return fStop || queueBatches.size() < nMaxQueued; });
+        if (fStop)
+            return false;
+        queueBatches.push_back(std::move(batch));
+        condBatch.notify_one();
+        return true;
+    };
+
+    // Scan one range from its resume point, handing over a batch every CHAINSTATE_SCAN_BATCH coins
+    auto fnScanRange = [&](int nRange) {
+        CChainstateScanBatch batch;
+        batch.nRange = nRange;
+        try {
+            uint256 trxHash;
+            CCoins coins;
+            size_t nScanned = 0;
+            for (auto pRangeCursor = pCursor->NewIterator(vStart[nRange]); pRangeCursor->Valid(); pRangeCursor->Next()) {
+                pRangeCursor->GetTrxHash(trxHash, true);
+                if (ChainstateScanRange(trxHash) != nRange)
+                    break;
+                if (nScanned == CHAINSTATE_SCAN_BATCH) {
+                    batch.txidNext = trxHash;
+                    if (!fnPush(batch))
+                        return false;
+                    batch = CChainstateScanBatch();
+                    batch.nRange = nRange;
+                    nScanned = 0;
+                }
+                nScanned++;
+
+                pRangeCursor->GetCoins(coins, true);
+                if (coins.nVersion != CTransaction::BITCOIN_VERSION && coins.nVersion != CTransaction::BTCU_START_VERSION)
+                    continue;
+                for (const CTxOut& out : coins.vout) {
+                    if (!out.IsNull() && filter.Match(out.scriptPubKey)) {
+                        batch.vMatches.emplace_back(trxHash, coins);
+                        break;
+                    }
+                }
+            }
+            batch.fDone = true;
+        } catch (const std::exception& e) {
+            batch.strError = e.what();
         }
-        boost::this_thread::interruption_point();
-        try
+        const bool fError = !batch.strError.empty();
+        return fnPush(batch) && !fError;
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < nWorkers; ++i) {
+        workers.emplace_back([&]() {
+            while (true) {
+                int nRange;
+                {
+                    std::lock_guard<std::mutex> lock(cs_scan);
+                    if (fStop || nNextRange == vRanges.size())
+                        break;
+                    nRange = vRanges[nNextRange++];
+                }
+                if (!fnScanRange(nRange))
+                    break;
+            }
+            std::lock_guard<std::mutex> lock(cs_scan);
+            nWorkersDone++;
+            condBatch.notify_all();
+        });
+    }
+
+    auto fnStop = [&]() {
         {
-           pCursor->GetTrxHash(trxHash, true);
-           if (count++ % 256 == 0)
-           {
-
-              uint32_t high = 0x100 * *trxHash.begin() + *(trxHash.begin() + 1);
-              int pctDone = (int) (high * 100.0 / 65536.0 + 0.5);
-              if (pctDone != prevPctDone)
-              {
-                 m_node->showProgress(_("Rescanning the chainstate state..."), pctDone);
-                 prevPctDone = pctDone;
-              }
-              if (reportDone < pctDone / 10)
-              {
-                 // report max. every 10% step
-                 LogPrintf("[%d%%]...", pctDone); /* Continued */
-                 reportDone = pctDone / 10;
-              }
-           }
-
-           pCursor->GetCoins(coins, true);
-           if (coins.nVersion != CTransaction::BITCOIN_VERSION && coins.nVersion != CTransaction::BTCU_START_VERSION)
-           {
-              continue;
-           }
-           if (coins.nVersion == CTransaction::BITCOIN_VERSION)
-           {
-              if (AddToWalletIfInvolvingMe(CTransaction(trxHash, coins), nullptr, merkleClb, fUpdate))
-                 ++ret;
-
-           } else if (coins.nVersion == CTransaction::BTCU_START_VERSION)
-           {
-              // First try finding the transaction in database
-              CTransaction tx; uint256 hashBlock;
-              if (!GetTransaction(trxHash, tx, hashBlock, true))
-                 return -1;
-              if (AddToWalletIfInvolvingMe(tx, nullptr, merkleClb, fUpdate))
-                 ++ret;
-
-           }
+            std::lock_guard<std::mutex> lock(cs_scan);
+            fStop = true;
+        }
+        condSpace.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable())
+                worker.join();
+        }
+    };
+    auto fnSave = [&]() {
+        if (fFileBacked)
+            CWalletDB(strWalletFile).WriteChainstateScan(progress);
+    };
 
-        } catch (const std::exception& e) {
-            error("%s : Deserialize or I/O error - %s", __func__, e.what());
-            throw;
+    // Commit the candidates in the order they arrive, and advance each range past what was committed
+    int64_t nLastSave = GetTime();
+    try {
+        while (true) {
+            CChainstateScanBatch batch;
+            {
+                std::unique_lock<std::mutex> lock(cs_scan);
+                condBatch.wait_for(lock, std::chrono::milliseconds(100), [&]() { return !queueBatches.empty() || nWorkersDone == nWorkers; });
+                if (queueBatches.empty() && nWorkersDone == nWorkers)
+                    break;
+                if (!queueBatches.empty()) {
+                    batch = std::move(queueBatches.front());
+                    queueBatches.pop_front();
+                    condSpace.notify_one();
+                }
+            }
+
+            if (fromStartup && ShutdownRequested()) {
+                fnStop();
+                fnSave();
+                LogPrintf("[CANCELED].\n");
+                return -1;
+            }
+            boost::this_thread::interruption_point();
+            if (batch.nRange < 0)
+                continue;
+
+            if (!batch.strError.empty()) {
+                fnStop();
+                fnSave();
+                error("%s : Deserialize or I/O error - %s", __func__, batch.strError);
+                throw std::runtime_error(batch.strError);
+            }
+
+            for (const auto& match : batch.vMatches) {
+                const uint256& trxHash = match.first;
+                const CCoins& coins = match.second;
+                if (coins.nVersion == CTransaction::BITCOIN_VERSION) {
+                    if (AddToWalletIfInvolvingMe(CTransaction(trxHash, coins), nullptr, merkleClb, fUpdate))
+                        ++ret;
+                } else {
+                    // First try finding the transaction in database
+                    CTransaction tx; uint256 hashBlock;
+                    if (!GetTransaction(trxHash, tx, hashBlock, true)) {
+                        fnStop();
+                        fnSave();
+                        return -1;
+                    }
+                    if (AddToWalletIfInvolvingMe(tx, nullptr, merkleClb, fUpdate))
+                        ++ret;
+                }
+            }
+
+            if (batch.fDone) {
+                progress.vDone[batch.nRange] = true;
+                vRangeProgress[batch.nRange] = 1.0;
+            } else {
+                progress.vNext[batch.nRange] = batch.txidNext;
+                vRangeProgress[batch.nRange] = ChainstateScanRangeProgress(batch.nRange, batch.txidNext);
+            }
+
+            double dProgress = 0;
+            for (double dRangeProgress : vRangeProgress)
+                dProgress += dRangeProgress;
+            int pctDone = (int) (dProgress * 100.0 / CHAINSTATE_SCAN_RANGES + 0.5);
+            if (pctDone != prevPctDone) {
+                m_node->showProgress(_("Rescanning the chainstate state..."), pctDone);
+                prevPctDone = pctDone;
+            }
+            if (reportDone < pctDone / 10) {
+                // report max. every 10% step
+                LogPrintf("[%d%%]...", pctDone); /* Continued */
+                reportDone = pctDone / 10;
+            }
+
+            if (GetTime() - nLastSave >= CHAINSTATE_SCAN_SAVE_INTERVAL) {
+                fnSave();
+                nLastSave = GetTime();
+            }
         }
+    } catch (...) {
+        fnStop();
+        throw;
     }
+    fnStop();
+
+    if (fFileBacked)
+        CWalletDB(strWalletFile).EraseChainstateScan();
 
     LogPrintf("[DONE].\n");
     return ret;
 }
 
+namespace {
+/** Blocks the rescan may read ahead of the block being added to the wallet */
+const size_t RESCAN_READ_AHEAD = 64;
+
+/** A block on its way through the rescan pipeline */
+struct CRescanBlock {
+    size_t nIndex = 0;
+    //! The block filter rules out that the block involves the wallet
+    bool fSkip = false;
+    std::vector<unsigned char> vRaw;
+    //! Null if the block could not be read or decoded
+    std::unique_ptr<CBlock> pblock;
+    //! Per transaction, whether one of its outputs may be ours
+    std::vector<bool> vMayBeMine;
+};
+
+/** Read a serialized block, keeping the block file open while consecutive reads stay in it */
+bool ReadRawBlockFromDisk(FILE*& file, int& nFile, const CDiskBlockPos& pos, std::vector<unsigned char>& vRaw)
+{
+    if (!file || nFile != pos.nFile) {
+        if (file)
+            fclose(file);
+        file = OpenBlockFile(CDiskBlockPos(pos.nFile, 0), true);
+        nFile = pos.nFile;
+        if (!file)
+            return false;
+    }
+
+    // The block is preceded by its size, see WriteBlockToDisk()
+    unsigned char size[4];
+    if (pos.nPos < sizeof(size) || fseek(file, pos.nPos - sizeof(size), SEEK_SET) != 0 || fread(size, 1, sizeof(size), file) != sizeof(size))
+        return false;
+    const uint32_t nSize = ReadLE32(size);
+    if (nSize > MAX_SIZE)
+        return false;
+    vRaw.resize(nSize);
+    return fread(vRaw.data(), 1, nSize, file) == nSize;
+}
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
+ *
+ * A reader thread streams the blocks from the block files in chain order and
+ * skips those whose block filter (-blockfilterindex) rules out the wallet's keys.
+ * Worker threads decode the blocks and match their outputs against a snapshot
+ * of the wallet's keys, and this thread adds the transactions in chain order.
+ * Transactions with no output that may be ours and no input the wallet knows
+ * are not looked at any further.
  * @returns -1 if process was cancelled or the number of tx added to the wallet.
  */
 int CWallet::ScanForWalletTransactions(std::unique_ptr<CCoinsViewIterator> pCoins, CBlockIndex* pindexStart, bool fUpdate, bool fromStartup)
@@ -1692,80 +1971,233 @@ int CWallet::ScanForWalletTransactions(std::unique_ptr<CCoinsViewIterator> pCoin
         double dProgressStart = Checkpoints::GuessVerificationProgress(pindex, false);
         double dProgressTip = Checkpoints::GuessVerificationProgress(chainActive.Tip(), false);
         std::set<uint256> setAddedToWallet;
-        while (pindex) {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0) {
-                int nProgress = std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100)));
-                if (prevPctDone != nProgress) {
-                    m_node->showProgress(_("Scanning blocks for wallet transactions..."), nProgress);
-                    prevPctDone = nProgress;
-                }
-                if (nProgress / 10 > nPrevProgress) {
-                    nPrevProgress = nProgress / 10;
-                    LogPrintf("[%d%%]...", nPrevProgress * 10); /* Continued */
+
+        std::vector<CBlockIndex*> vBlocks;
+        for (; pindex; pindex = chainActive.Next(pindex))
+            vBlocks.push_back(pindex);
+
+        const CWalletScriptFilter filter = GetScriptFilter();
+        GCSFilter::ElementSet filterElements;
+        filter.GetFilterElements(filterElements);
+        // zBTCU recovery needs every block, whatever it pays to
+        const bool fUseBlockFilters = fBlockFilterIndex && !fCheckZBTCU;
+
+        const unsigned int nWorkers = std::max(1u, std::thread::hardware_concurrency());
+
+        std::mutex cs_rescan;
+        std::condition_variable condSpace;
+        std::condition_variable condRaw;
+        std::condition_variable condReady;
+        std::deque<std::unique_ptr<CRescanBlock> > queueRaw;
+        std::map<size_t, std::unique_ptr<CRescanBlock> > mapReady;
+        size_t nCommitted = 0;
+        bool fReadDone = false;
+        bool fStop = false;
+
+        std::thread reader([&]() {
+            FILE* file = nullptr;
+            int nFile = -1;
+            for (size_t nIndex = 0; nIndex < vBlocks.size(); nIndex++) {
+                {
+                    std::unique_lock<std::mutex> lock(cs_rescan);
+                    condSpace.wait(lock, [&]() { return fStop || nIndex < nCommitted + RESCAN_READ_AHEAD; });
+                    if (fStop)
+                        break;
                 }
+                std::unique_ptr<CRescanBlock> item(new CRescanBlock());
+                item->nIndex = nIndex;
+                std::unique_ptr<GCSFilter> pfilter;
+                if (fUseBlockFilters && pblocktree->ReadBlockFilter(vBlocks[nIndex]->GetBlockHash(), pfilter) && !pfilter->MatchAny(filterElements))
+                    item->fSkip = true;
+                else
+                    ReadRawBlockFromDisk(file, nFile, vBlocks[nIndex]->GetBlockPos(), item->vRaw);
+
+                std::lock_guard<std::mutex> lock(cs_rescan);
+                queueRaw.push_back(std::move(item));
+                condRaw.notify_one();
             }
+            if (file)
+                fclose(file);
+            std::lock_guard<std::mutex> lock(cs_rescan);
+            fReadDone = true;
+            condRaw.notify_all();
+        });
+
+        std::vector<std::thread> workers;
+        for (unsigned int i = 0; i < nWorkers; ++i) {
+            workers.emplace_back([&]() {
+                while (true) {
+                    std::unique_ptr<CRescanBlock> item;
+                    {
+                        std::unique_lock<std::mutex> lock(cs_rescan);
+                        condRaw.wait(lock, [&]() { return fStop || fReadDone || !queueRaw.empty(); });
+                        if (fStop || queueRaw.empty())
+                            return;
+                        item = std::move(queueRaw.front());
+                        queueRaw.pop_front();
+                    }
+                    if (!item->vRaw.empty()) {
+                        try {
+                            std::unique_ptr<CBlock> pblock(new CBlock());
+                            CDataStream ss(item->vRaw, SER_DISK, CLIENT_VERSION);
+                            ss >> *pblock;
+                            if (pblock->GetHash() == vBlocks[item->nIndex]->GetBlockHash()) {
+                                for (const CTransactionRef& tx : pblock->vtx) {
+                                    bool fMayBeMine = false;
+                                    for (const CTxOut& out : tx->vout) {
+                                        if (filter.Match(out.scriptPubKey)) {
+                                            fMayBeMine = true;
+                                            break;
+                                        }
+                                    }
+                                    item->vMayBeMine.push_back(fMayBeMine);
+                                }
+                                item->pblock = std::move(pblock);
+                            }
+                        } catch (const std::exception&) {
+                            // Left to ReadBlockFromDisk() in the committing thread, which reports the error
+                        }
+                        std::vector<unsigned char>().swap(item->vRaw);
+                    }
+                    std::lock_guard<std::mutex> lock(cs_rescan);
+                    const size_t nIndex = item->nIndex;
+                    mapReady[nIndex] = std::move(item);
+                    condReady.notify_all();
+                }
+            });
+        }
 
-            if (fromStartup && ShutdownRequested()) {
-                LogPrintf("[CANCELED].\n");
-                return -1;
+        auto fnStop = [&]() {
+            {
+                std::lock_guard<std::mutex> lock(cs_rescan);
+                fStop = true;
+            }
+            condSpace.notify_all();
+            condRaw.notify_all();
+            if (reader.joinable())
+                reader.join();
+            for (auto& worker : workers) {
+                if (worker.joinable())
+                    worker.join();
             }
+        };
 
-            CBlock block;
-            ReadBlockFromDisk(block, pindex);
-            for (CTransaction& tx : block.vtx) {
-                if (AddToWalletIfInvolvingMe(tx, &block, [&](CMerkleTx& wtx){wtx.SetMerkleBranch(block);}, fUpdate))
-                    ret++;
+        // Whether a transaction without outputs to us can still concern the wallet:
+        // it is known already, spends from the wallet or conflicts with a wallet transaction
+        auto fnInputsMayInvolveWallet = [&](const CTransaction& tx) {
+            if (mapWallet.count(tx.GetHash()))
+                return true;
+            for (const CTxIn& txin : tx.vin) {
+                if (mapWallet.count(txin.prevout.hash) || mapTxSpends.count(txin.prevout))
+                    return true;
             }
+            return false;
+        };
+
+        try {
+            for (size_t nIndex = 0; nIndex < vBlocks.size(); nIndex++) {
+                pindex = vBlocks[nIndex];
+                if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0) {
+                    int nProgress = std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100)));
+                    if (prevPctDone != nProgress) {
+                        m_node->showProgress(_("Scanning blocks for wallet transactions..."), nProgress);
+                        prevPctDone = nProgress;
+                    }
+                    if (nProgress / 10 > nPrevProgress) {
+                        nPrevProgress = nProgress / 10;
+                        LogPrintf("[%d%%]...", nPrevProgress * 10); /* Continued */
+                    }
+                }
 
-            //If this is a zapwallettx, need to readd zbtcu
-            if (fCheckZBTCU && pindex->nHeight >= Params().Zerocoin_StartHeight()) {
-                std::list<CZerocoinMint> listMints;
-                BlockToZerocoinMintList(block, listMints, true);
-                CWalletDB walletdb(strWalletFile);
-
-                for (auto& m : listMints) {
-                    if (IsMyMint(m.GetValue())) {
-                        LogPrint("zero", "%s: found mint\n", __func__);
-                        pwalletMain->UpdateMint(m.GetValue(), pindex->nHeight, m.GetTxHash(), m.GetDenomination());
-
-                        // Add the transaction to the wallet
-                        for (auto& tx : block.vtx) {
-                            uint256 txid = tx.GetHash();
-                            if (setAddedToWallet.count(txid) || mapWallet.count(txid))
-                                continue;
-                            if (txid == m.GetTxHash()) {
-                                CWalletTx wtx(pwalletMain, tx);
-                                wtx.nTimeReceived = block.GetBlockTime();
-                                wtx.SetMerkleBranch(block);
-                                pwalletMain->AddToWallet(wtx, false, &walletdb);
-                                setAddedToWallet.insert(txid);
+                std::unique_ptr<CRescanBlock> item;
+                {
+                    std::unique_lock<std::mutex> lock(cs_rescan);
+                    while (!mapReady.count(nIndex) && !(fromStartup && ShutdownRequested()))
+                        condReady.wait_for(lock, std::chrono::milliseconds(100));
+                    if (mapReady.count(nIndex)) {
+                        item = std::move(mapReady[nIndex]);
+                        mapReady.erase(nIndex);
+                    }
+                    nCommitted = nIndex + 1;
+                    condSpace.notify_one();
+                }
+
+                if (fromStartup && ShutdownRequested()) {
+                    fnStop();
+                    LogPrintf("[CANCELED].\n");
+                    return -1;
+                }
+
+                if (item->fSkip)
+                    continue;
+                if (!item->pblock) {
+                    item->pblock.reset(new CBlock());
+                    ReadBlockFromDisk(*item->pblock, pindex);
+                    item->vMayBeMine.assign(item->pblock->vtx.size(), true);
+                }
+                const CBlock& block = *item->pblock;
+
+                for (size_t i = 0; i < block.vtx.size(); i++) {
+                    const CTransaction& tx = *block.vtx[i];
+                    if (!item->vMayBeMine[i] && !fnInputsMayInvolveWallet(tx))
+                        continue;
+                    if (AddToWalletIfInvolvingMe(tx, &block, [&](CMerkleTx& wtx){wtx.SetMerkleBranch(block);}, fUpdate))
+                        ret++;
+                }
+
+                //If this is a zapwallettx, need to readd zbtcu
+                if (fCheckZBTCU && pindex->nHeight >= Params().Zerocoin_StartHeight()) {
+                    std::list<CZerocoinMint> listMints;
+                    BlockToZerocoinMintList(block, listMints, true);
+                    CWalletDB walletdb(strWalletFile);
+
+                    for (auto& m : listMints) {
+                        if (IsMyMint(m.GetValue())) {
+                            LogPrint("zero", "%s: found mint\n", __func__);
+                            pwalletMain->UpdateMint(m.GetValue(), pindex->nHeight, m.GetTxHash(), m.GetDenomination());
+
+                            // Add the transaction to the wallet
+                            for (const CTransactionRef& tx : block.vtx) {
+                                uint256 txid = tx->GetHash();
+                                if (setAddedToWallet.count(txid) || mapWallet.count(txid))
+                                    continue;
+                                if (txid == m.GetTxHash()) {
+                                    CWalletTx wtx(pwalletMain, *tx);
+                                    wtx.nTimeReceived = block.GetBlockTime();
+                                    wtx.SetMerkleBranch(block);
+                                    pwalletMain->AddToWallet(wtx, false, &walletdb);
+                                    setAddedToWallet.insert(txid);
+                                }
                             }
-                        }
 
-                        //Check if the mint was ever spent
-                        int nHeightSpend = 0;
-                        uint256 txidSpend;
-                        CTransaction txSpend;
-                        if (IsSerialInBlockchain(GetSerialHash(m.GetSerialNumber()), nHeightSpend, txidSpend, txSpend)) {
-                            if (setAddedToWallet.count(txidSpend) || mapWallet.count(txidSpend))
-                                continue;
-
-                            CWalletTx wtx(pwalletMain, txSpend);
-                            CBlockIndex* pindexSpend = chainActive[nHeightSpend];
-                            CBlock blockSpend;
-                            if (ReadBlockFromDisk(blockSpend, pindexSpend))
-                                wtx.SetMerkleBranch(blockSpend);
-
-                            wtx.nTimeReceived = pindexSpend->nTime;
-                            pwalletMain->AddToWallet(wtx, false, &walletdb);
-                            setAddedToWallet.emplace(txidSpend);
+                            //Check if the mint was ever spent
+                            int nHeightSpend = 0;
+                            uint256 txidSpend;
+                            CTransaction txSpend;
+                            if (IsSerialInBlockchain(GetSerialHash(m.GetSerialNumber()), nHeightSpend, txidSpend, txSpend)) {
+                                if (setAddedToWallet.count(txidSpend) || mapWallet.count(txidSpend))
+                                    continue;
+
+                                CWalletTx wtx(pwalletMain, txSpend);
+                                CBlockIndex* pindexSpend = chainActive[nHeightSpend];
+                                CBlock blockSpend;
+                                if (ReadBlockFromDisk(blockSpend, pindexSpend))
+                                    wtx.SetMerkleBranch(blockSpend);
+
+                                wtx.nTimeReceived = pindexSpend->nTime;
+                                pwalletMain->AddToWallet(wtx, false, &walletdb);
+                                setAddedToWallet.emplace(txidSpend);
+                            }
                         }
                     }
                 }
             }
-
-            pindex = chainActive.Next(pindex);
+        } catch (...) {
+            fnStop();
+            throw;
         }
+        fnStop();
+
         m_node->showProgress("Scanning blocks for wallet transactions...", 100); // hide progress dialog in GUI
         LogPrintf("[DONE].\n");
     }
@@ -1822,7 +2254,10 @@ void CWalletTx::RelayWalletTransaction(std::string strCommand)
             LogPrintf("Relaying wtx %s\n", hash.ToString());
 
             if (strCommand == "ix") {
-                mapTxLockReq.insert(std::make_pair(hash, (CTransaction) * this));
+                {
+                    LOCK(cs_swifttx);
+                    mapTxLockReq.insert(std::make_pair(hash, (CTransaction) * this));
+                }
                 CreateNewLock(((CTransaction) * this));
                 RelayTransactionLockReq((CTransaction) * this, true);
             } else {
@@ -1899,8 +2334,77 @@ CAmount CWallet::loopTxsBalance(std::function<void(const uint256&, const CWallet
     return nTotal;
 }
 
+CWalletBalances CWallet::GetBalances() const
+{
+    {
+        LOCK(cs_balances);
+        if (!fBalancesDirty)
+            return cachedBalances;
+    }
+
+    CWalletBalances balances;
+    {
+        LOCK2(cs_main, cs_wallet);
+        for (const auto& it : mapWallet) {
+            const CWalletTx& pcoin = it.second;
+            bool fConflicted = false;
+            int nDepth = 0;
+            const bool fTrusted = pcoin.IsTrusted(nDepth, fConflicted);
+
+            if (fTrusted) {
+                balances.nTrusted += pcoin.GetAvailableCredit(true, ISMINE_SPENDABLE_ALL);
+                balances.nWatchOnly += pcoin.GetAvailableWatchOnlyCredit();
+                if (pcoin.HasP2CSOutputs()) {
+                    balances.nColdStaking += pcoin.GetColdStakingCredit();
+                    balances.nDelegated += pcoin.GetStakeDelegationCredit();
+                }
+                if (pcoin.HasP2LOutputs()) {
+                    balances.nLeasing += pcoin.GetLeasingCredit();
+                    balances.nLeased += pcoin.GetLeasedCredit() + pcoin.GetLeasedLockedCLTVCredit();
+                }
+                if (nDepth > 0) {
+                    if (!fLiteMode) {
+                        balances.nUnlocked += pcoin.GetUnlockedCredit();
+                        balances.nLocked += pcoin.GetLockedCredit();
+                    }
+                    balances.nLockedWatchOnly += pcoin.GetLockedWatchOnlyCredit();
+                }
+            } else if (pcoin.GetDepthInMainChain() == 0 && pcoin.InMempool()) {
+                balances.nUnconfirmed += pcoin.GetAvailableCredit();
+                balances.nUnconfirmedWatchOnly += pcoin.GetAvailableWatchOnlyCredit();
+            }
+
+            // Coinbase and coinstake outputs leave these sums as the tip passes their maturity
+            if (pcoin.IsInMainChainImmature()) {
+                balances.nImmature += pcoin.GetImmatureCredit(false);
+                balances.nImmatureColdStaking += pcoin.GetImmatureCredit(false, ISMINE_COLD);
+                balances.nImmatureDelegated += pcoin.GetImmatureCredit(false, ISMINE_SPENDABLE_DELEGATED);
+                balances.nImmatureLeasing += pcoin.GetImmatureCredit(false, ISMINE_LEASING);
+                balances.nImmatureLeased += pcoin.GetImmatureCredit(false, ISMINE_LEASED);
+                balances.nImmatureWatchOnly += pcoin.GetImmatureWatchOnlyCredit();
+            }
+        }
+
+        // Transactions, the tip and locked coins only change under cs_main or cs_wallet,
+        // so nothing marked the balances dirty while they were summed
+        LOCK(cs_balances);
+        cachedBalances = balances;
+        fBalancesDirty = false;
+    }
+    return balances;
+}
+
+void CWallet::MarkBalancesDirty() const
+{
+    LOCK(cs_balances);
+    fBalancesDirty = true;
+}
+
 CAmount CWallet::GetBalance(int filter) const
 {
+    if (filter == ISMINE_SPENDABLE_ALL)
+        return GetBalances().nTrusted;
+
     return loopTxsBalance([&filter](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal){
         if (pcoin.IsTrusted())
             nTotal += pcoin.GetAvailableCredit(true, filter);
@@ -1909,136 +2413,88 @@ CAmount CWallet::GetBalance(int filter) const
 
 CAmount CWallet::GetColdStakingBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-        if (pcoin.HasP2CSOutputs() && pcoin.IsTrusted())
-            nTotal += pcoin.GetColdStakingCredit();
-    });
+    return GetBalances().nColdStaking;
 }
 
 CAmount CWallet::GetLeasingBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-        if (pcoin.HasP2LOutputs() && pcoin.IsTrusted())
-            nTotal += pcoin.GetLeasingCredit();
-    });
+    return GetBalances().nLeasing;
 }
 
 CAmount CWallet::GetStakingBalance(const bool fIncludeColdStaking, const bool fIncludeLeasing) const
 {
-    return GetBalance() + (fIncludeColdStaking ? GetColdStakingBalance() : 0) + (fIncludeLeasing ? GetLeasingBalance() : 0);
+    const CWalletBalances balances = GetBalances();
+    return balances.nTrusted + (fIncludeColdStaking ? balances.nColdStaking : 0) + (fIncludeLeasing ? balances.nLeasing : 0);
 }
 
 CAmount CWallet::GetDelegatedBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            if (pcoin.HasP2CSOutputs() && pcoin.IsTrusted())
-                nTotal += pcoin.GetStakeDelegationCredit();
-    });
+    return GetBalances().nDelegated;
 }
 
 CAmount CWallet::GetLeasedBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-        if (pcoin.HasP2LOutputs() && pcoin.IsTrusted())
-        {
-           nTotal += pcoin.GetLeasedCredit();
-           nTotal += pcoin.GetLeasedLockedCLTVCredit();
-        }
-    });
+    return GetBalances().nLeased;
 }
 
 CAmount CWallet::GetUnlockedCoins() const
 {
-    if (fLiteMode) return 0;
-
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            if (pcoin.IsTrusted() && pcoin.GetDepthInMainChain() > 0)
-                nTotal += pcoin.GetUnlockedCredit();
-    });
+    return GetBalances().nUnlocked;
 }
 
 CAmount CWallet::GetLockedCoins() const
 {
-    if (fLiteMode) return 0;
-
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            if (pcoin.IsTrusted() && pcoin.GetDepthInMainChain() > 0)
-                nTotal += pcoin.GetLockedCredit();
-    });
+    return GetBalances().nLocked;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            if (!pcoin.IsTrusted() && pcoin.GetDepthInMainChain() == 0 && pcoin.InMempool())
-                nTotal += pcoin.GetAvailableCredit();
-    });
+    return GetBalances().nUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            nTotal += pcoin.GetImmatureCredit(false);
-    });
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetImmatureColdStakingBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            nTotal += pcoin.GetImmatureCredit(false, ISMINE_COLD);
-    });
+    return GetBalances().nImmatureColdStaking;
 }
 
 CAmount CWallet::GetImmatureDelegatedBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            nTotal += pcoin.GetImmatureCredit(false, ISMINE_SPENDABLE_DELEGATED);
-    });
+    return GetBalances().nImmatureDelegated;
 }
 
 CAmount CWallet::GetImmatureLeasingBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-        nTotal += pcoin.GetImmatureCredit(false, ISMINE_LEASING);
-    });
+    return GetBalances().nImmatureLeasing;
 }
 
 CAmount CWallet::GetImmatureLeasedBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-        nTotal += pcoin.GetImmatureCredit(false, ISMINE_LEASED);
-    });
+    return GetBalances().nImmatureLeased;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            if (pcoin.IsTrusted())
-                nTotal += pcoin.GetAvailableWatchOnlyCredit();
-    });
+    return GetBalances().nWatchOnly;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            if (!pcoin.IsTrusted() && pcoin.GetDepthInMainChain() == 0 && pcoin.InMempool())
-                nTotal += pcoin.GetAvailableWatchOnlyCredit();
-    });
+    return GetBalances().nUnconfirmedWatchOnly;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            nTotal += pcoin.GetImmatureWatchOnlyCredit();
-    });
+    return GetBalances().nImmatureWatchOnly;
 }
 
 CAmount CWallet::GetLockedWatchOnlyBalance() const
 {
-    return loopTxsBalance([](const uint256& id, const CWalletTx& pcoin, CAmount& nTotal) {
-            if (pcoin.IsTrusted() && pcoin.GetDepthInMainChain() > 0)
-                nTotal += pcoin.GetLockedWatchOnlyCredit();
-    });
+    return GetBalances().nLockedWatchOnly;
 }
 
 void CWallet::GetAvailableP2CSCoins(std::vector<COutput>& vCoins) const {
@@ -2920,6 +3376,67 @@ bool CWallet::CreateTransaction(CScript scriptPubKey, const CAmount& nValue, CWa
     return CreateTransaction(vecSend, wtxNew, reservekey, nFeeRet, strFailReason, coinControl, coin_type, useIX, nFeePay, fIncludeDelegated, fIncludeLeased, sign, signSenderAddress, validatorRegister, validatorVote);
 }
 
+bool CStakeInputCache::Update(const CBlockIndex* pindexPrev, const std::vector<COutput>& vCoins)
+{
+    std::vector<COutPoint> vCoinsNew;
+    vCoinsNew.reserve(vCoins.size());
+    for (const COutput& out : vCoins)
+        vCoinsNew.emplace_back(out.tx->GetHash(), out.i);
+    std::sort(vCoinsNew.begin(), vCoinsNew.end());
+    if (hashTip == pindexPrev->GetBlockHash() && vCoinsNew == vCoinsOut)
+        return false;
+
+    // Resolving the block an input comes from is the slow part, keep the inputs still on the chain
+    std::map<COutPoint, std::unique_ptr<CStakeInput> > mapPrevInputs;
+    for (auto& input : vInputs) {
+        CBlockIndex* pindexFrom = input.second->GetIndexFrom();
+        if (pindexFrom && chainActive.Contains(pindexFrom))
+            mapPrevInputs.emplace(input.first, std::move(input.second));
+    }
+    Clear();
+
+    std::map<COutPoint, const COutput*> mapCoins;
+    for (const COutput& out : vCoins)
+        mapCoins.emplace(COutPoint(out.tx->GetHash(), out.i), &out);
+
+    for (const COutPoint& outpoint : vCoinsNew) {
+        std::unique_ptr<CStakeInput> input;
+        auto it = mapPrevInputs.find(outpoint);
+        if (it != mapPrevInputs.end()) {
+            input = std::move(it->second);
+        } else {
+            const COutput* out = mapCoins.at(outpoint);
+            std::unique_ptr<CBTCUStake> btcuInput(new CBTCUStake());
+            btcuInput->SetInput(outpoint, out->tx->vout[out->i]);
+            input = std::move(btcuInput);
+        }
+
+        CStakeKernel kernel;
+        if (!InitStakeKernel(pindexPrev, input.get(), kernel))
+            continue;
+        vInputs.emplace_back(outpoint, std::move(input));
+        vKernels.push_back(kernel);
+    }
+
+    hashTip = pindexPrev->GetBlockHash();
+    vCoinsOut.swap(vCoinsNew);
+    return true;
+}
+
+void CStakeInputCache::Erase(size_t nIndex)
+{
+    vInputs.erase(vInputs.begin() + nIndex);
+    vKernels.erase(vKernels.begin() + nIndex);
+}
+
+void CStakeInputCache::Clear()
+{
+    hashTip.SetNull();
+    vCoinsOut.clear();
+    vInputs.clear();
+    vKernels.clear();
+}
+
 // ppcoin: create coin stake transaction
 bool CWallet::CreateCoinStake(
         const CKeyStore& keystore,
@@ -2936,53 +3453,56 @@ bool CWallet::CreateCoinStake(
         return false;
     }
 
-    // Parse utxos into CBTCUStakes
-    std::list<std::unique_ptr<CStakeInput> > listInputs;
-    for (const COutput &out : vCoins) {
-        std::unique_ptr<CBTCUStake> input(new CBTCUStake());
-        input->SetInput((CTransaction) *out.tx, out.i);
-        listInputs.emplace_back(std::move(input));
+    // Prepare the kernels of the utxos, unless done for this tip and these coins already
+    LOCK(stakeInputCache.cs);
+    if (stakeInputCache.Update(pindexPrev, vCoins)) {
+        LogPrint("staking", "%s: prepared %d stake kernels on top of %s\n", __func__,
+                 stakeInputCache.vKernels.size(), pindexPrev->GetBlockHash().GetHex());
     }
-
-    // Mark coin stake transaction
-    txNew.vin.clear();
-    txNew.vout.clear();
-    txNew.vout.push_back(CTxOut(0, CScript()));
+    pStakerStatus->SetStakeInputs(stakeInputCache.vKernels.size());
 
     // update staker status (hash)
     pStakerStatus->SetLastTip(pindexPrev);
 
+    const bool fRegTest = Params().IsRegTestNet();
+    nTxNewTime = (fRegTest ? GetAdjustedTime() : GetCurrentTimeSlot());
+
+    // update staker status (time)
+    pStakerStatus->SetLastTime(nTxNewTime);
+
+    // double check that we are not on the same slot as prev block
+    if (nTxNewTime <= pindexPrev->nTime && !fRegTest)
+        return false;
+
     // Kernel Search
     CAmount nCredit;
-    CScript scriptPubKeyKernel;
     bool fKernelFound = false;
-    int nAttempts = 0;
-    for (std::unique_ptr<CStakeInput>& stakeInput : listInputs) {
+    unsigned int nAttempts = 0;
+    const int64_t nTimeStart = GetTimeMicros();
+    while (!stakeInputCache.vKernels.empty()) {
         //new block came in, move on
         if (chainActive.Height() != pindexPrev->nHeight) return false;
 
         // Make sure the wallet is unlocked and shutdown hasn't been requested
         if (IsLocked() || ShutdownRequested()) return false;
 
-        // This should never happen
-        if (stakeInput->IsZBTCU()) {
-            LogPrintf("%s: ERROR - zPOS is disabled\n", __func__);
-            continue;
-        }
+        // Mark coin stake transaction
+        txNew.vin.clear();
+        txNew.vout.clear();
+        txNew.vout.push_back(CTxOut(0, CScript()));
 
-        nCredit = 0;
         uint256 hashProofOfStake = 0;
-        nAttempts++;
-        fKernelFound = Stake(pindexPrev, stakeInput.get(), nBits, nTxNewTime, hashProofOfStake);
-
-        // update staker status (time)
-        pStakerStatus->SetLastTime(nTxNewTime);
-
-        if (!fKernelFound) continue;
+        unsigned int nEvaluated = 0;
+        const int nFound = SearchStakeKernels(stakeInputCache.vKernels, nBits, nTxNewTime, hashProofOfStake, nEvaluated);
+        nAttempts += nEvaluated;
+        if (nFound < 0)
+            break;
 
         // Found a kernel
         LogPrintf("CreateCoinStake : kernel found\n");
-        nCredit += stakeInput->GetValue();
+        LogPrint("staking", "%s: hashProofOfStake=%s nTimeTx=%d\n", __func__, hashProofOfStake.GetHex(), nTxNewTime);
+        CStakeInput* stakeInput = stakeInputCache.vInputs[nFound].second.get();
+        nCredit = stakeInput->GetValue();
 
         // Calculate reward
         CAmount nReward;
@@ -2993,6 +3513,7 @@ bool CWallet::CreateCoinStake(
         std::vector<CTxOut> vout;
         if (!stakeInput->CreateTxOuts(this, vout, nCredit)) {
             LogPrintf("%s : failed to create output\n", __func__);
+            stakeInputCache.Erase(nFound);
             continue;
         }
         txNew.vout.insert(txNew.vout.end(), vout.begin(), vout.end());
@@ -3025,14 +3546,16 @@ bool CWallet::CreateCoinStake(
         CTxIn in;
         if (!stakeInput->CreateTxIn(this, in, hashTxOut)) {
             LogPrintf("%s : failed to create TxIn\n", __func__);
-            txNew.vin.clear();
-            txNew.vout.clear();
+            stakeInputCache.Erase(nFound);
             continue;
         }
         txNew.vin.emplace_back(in);
 
+        fKernelFound = true;
         break;
     }
+    pStakerStatus->SetLastSearch(nAttempts, GetTimeMicros() - nTimeStart);
+    pStakerStatus->SetStakeInputs(stakeInputCache.vKernels.size());
     LogPrint("staking", "%s: attempted staking %d times\n", __func__, nAttempts);
 
     if (!fKernelFound)
@@ -3698,6 +4221,7 @@ bool CWallet::UpdatedTransaction(const uint256& hashTx)
         // Only notify UI if this transaction is in this wallet
         std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
         if (mi != mapWallet.end()) {
+            MarkBalancesDirty();
             NotifyTransactionChanged(this, hashTx, CT_UPDATED);
             return true;
         }
@@ -3709,18 +4233,21 @@ void CWallet::LockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.insert(output);
+    MarkBalancesDirty();
 }
 
 void CWallet::UnlockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.erase(output);
+    MarkBalancesDirty();
 }
 
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.clear();
+    MarkBalancesDirty();
 }
 
 bool CWallet::IsLockedCoin(const uint256& hash, unsigned int n) const
@@ -4163,7 +4690,7 @@ int CMerkleTx::SetMerkleBranch(const CBlock& block)
 
     // Locate the transaction
     for (nIndex = 0; nIndex < (int)block.vtx.size(); nIndex++)
-        if (block.vtx[nIndex] == *(CTransaction*)this)
+        if (*block.vtx[nIndex] == *(CTransaction*)this)
             break;
     if (nIndex == (int)block.vtx.size()) {
         nIndex = -1;
@@ -4263,6 +4790,7 @@ int CMerkleTx::GetTransactionLockSignatures() const
     if (!fEnableSwiftTX) return -1;
 
     //compile consessus vote
+    LOCK(cs_swifttx);
     std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
     if (i != mapTxLocks.end()) {
         return (*i).second.CountSignatures();
@@ -4276,6 +4804,7 @@ bool CMerkleTx::IsTransactionLockTimedOut() const
     if (!fEnableSwiftTX) return 0;
 
     //compile consessus vote
+    LOCK(cs_swifttx);
     std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
     if (i != mapTxLocks.end()) {
         return GetTime() > (*i).second.nTimeout;
@@ -4672,6 +5201,8 @@ void CWalletTx::MarkDirty()
     fLeasingCreditCached = false;
     fLeasedDebitCached = false;
     fLeasedCreditCached = false;
+    if (pwallet)
+        pwallet->MarkBalancesDirty();
 }
 
 void CWalletTx::BindWallet(CWallet* pwalletIn)
@@ -167,6 +167,9 @@ class CStakerStatus {
 private:
     const CBlockIndex* tipLastStakeAttempt = nullptr;
     int64_t timeLastStakeAttempt;
+    unsigned int nStakeInputs = 0;
+    unsigned int nInputsLastStakeAttempt = 0;
+    int64_t nSearchTimeLastStakeAttempt = 0;
 public:
     const CBlockIndex* GetLastTip() const { return tipLastStakeAttempt; }
     uint256 GetLastHash() const
@@ -174,16 +177,83 @@ public:
         return (tipLastStakeAttempt == nullptr ? 0 : tipLastStakeAttempt->GetBlockHash());
     }
     int64_t GetLastTime() const { return timeLastStakeAttempt; }
+    //! Kernels cached for the current tip
+    unsigned int GetStakeInputs() const { return nStakeInputs; }
+    //! Kernels hashed in the last time slot
+    unsigned int GetLastInputs() const { return nInputsLastStakeAttempt; }
+    //! Time spent on the kernel search in the last time slot, in microseconds
+    int64_t GetLastSearchTime() const { return nSearchTimeLastStakeAttempt; }
     void SetLastTip(const CBlockIndex* lastTip) { tipLastStakeAttempt = lastTip; }
     void SetLastTime(const uint64_t lastTime) { timeLastStakeAttempt = lastTime; }
+    void SetStakeInputs(unsigned int nInputs) { nStakeInputs = nInputs; }
+    void SetLastSearch(unsigned int nInputs, int64_t nTime)
+    {
+        nInputsLastStakeAttempt = nInputs;
+        nSearchTimeLastStakeAttempt = nTime;
+    }
     void SetNull()
     {
         SetLastTip(nullptr);
         SetLastTime(0);
+        SetStakeInputs(0);
+        SetLastSearch(0, 0);
     }
     bool IsActive() { return (timeLastStakeAttempt + 30) >= GetTime(); }
 };
 
+/**
+ * Balances of the wallet by category, summed in a single pass over mapWallet.
+ * The wallet keeps the last result until a transaction, the chain tip or the
+ * set of locked coins changes, so the balance getters do not walk mapWallet
+ * or take cs_main in between.
+ */
+struct CWalletBalances
+{
+    CAmount nTrusted = 0;
+    CAmount nColdStaking = 0;
+    CAmount nLeasing = 0;
+    CAmount nDelegated = 0;
+    CAmount nLeased = 0;
+    CAmount nUnlocked = 0;
+    CAmount nLocked = 0;
+    CAmount nUnconfirmed = 0;
+    CAmount nImmature = 0;
+    CAmount nImmatureColdStaking = 0;
+    CAmount nImmatureDelegated = 0;
+    CAmount nImmatureLeasing = 0;
+    CAmount nImmatureLeased = 0;
+    CAmount nWatchOnly = 0;
+    CAmount nUnconfirmedWatchOnly = 0;
+    CAmount nImmatureWatchOnly = 0;
+    CAmount nLockedWatchOnly = 0;
+};
+
+/**
+ * Stake inputs of the wallet with their kernels prepared on top of a chain tip.
+ * The kernels are reused for every time slot until the tip or the set of
+ * stakeable coins changes. On refresh the inputs of coins still stakeable are
+ * kept, so only the stake modifiers are looked up again.
+ */
+class CStakeInputCache
+{
+private:
+    uint256 hashTip;
+    //! sorted outpoints of the stakeable coins the cache was built from
+    std::vector<COutPoint> vCoinsOut;
+
+public:
+    mutable CCriticalSection cs;
+    std::vector<std::pair<COutPoint, std::unique_ptr<CStakeInput> > > vInputs;
+    //! kernels of vInputs, index for index
+    std::vector<CStakeKernel> vKernels;
+
+    /** Rebuild the kernels for vCoins on top of pindexPrev, returns false if they were still current */
+    bool Update(const CBlockIndex* pindexPrev, const std::vector<COutput>& vCoins);
+    /** Drop an input that cannot be staked until the next refresh */
+    void Erase(size_t nIndex);
+    void Clear();
+};
+
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
@@ -224,6 +294,9 @@ private:
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
     int ScanBitcoinStateForWalletTransactions(std::unique_ptr<CCoinsViewIterator> pCoins, bool fUpdate, bool fromStartup);
+
+    //! Snapshot of the wallet's keys and scripts for matching without cs_wallet
+    CWalletScriptFilter GetScriptFilter() const;
 public:
 
     static const int STAKE_SPLIT_THRESHOLD = 2000;
@@ -255,6 +328,13 @@ public:
     uint64_t nStakeSplitThreshold;
     // Staker status (last hashed block and time)
     CStakerStatus* pStakerStatus = nullptr;
+    // Stake kernels kept between time slots
+    CStakeInputCache stakeInputCache;
+
+    // Balances summed by GetBalances(), current unless fBalancesDirty
+    mutable CCriticalSection cs_balances;
+    mutable CWalletBalances cachedBalances;
+    mutable bool fBalancesDirty = true;
 
     CLeasingManager* pLeasingManager = nullptr;
 
@@ -392,6 +472,7 @@ public:
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+    void UpdatedBlockTip(const CBlockIndex* pindex);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, std::function<void(CWalletTx&)> merkleClb, bool fUpdate);
     void EraseFromWallet(const uint256& hash);
     int ScanForWalletTransactions(std::unique_ptr<CCoinsViewIterator> pCoins, CBlockIndex* pindexStart, bool fUpdate = false, bool fromStartup = false);
@@ -399,6 +480,9 @@ public:
     void ResendWalletTransactions();
 
     CAmount loopTxsBalance(std::function<void(const uint256&, const CWalletTx&, CAmount&)>method) const;
+    /** Balances by category, summed again only after MarkBalancesDirty() */
+    CWalletBalances GetBalances() const;
+    void MarkBalancesDirty() const;
     CAmount GetBalance(int filter = ISMINE_SPENDABLE_ALL) const;
     CAmount GetColdStakingBalance() const;  // delegated coins for which we have the staking key
     CAmount GetImmatureColdStakingBalance() const;
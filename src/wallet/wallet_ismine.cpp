@@ -7,6 +7,7 @@
 
 #include "wallet_ismine.h"
 
+#include "hash.h"
 #include "key.h"
 #include "keystore.h"
 #include "script/script.h"
@@ -221,4 +222,53 @@ isminetype IsMine(const CKeyStore& keystore, const CTxDestination& dest)
 {
     CScript script = GetScriptForDestination(dest);
     return IsMine(keystore, script, IsMineSigVersion::TOP);
+}
+
+CWalletScriptFilter::CWalletScriptFilter(const CKeyStore& keystore)
+{
+    std::set<CKeyID> setKeys;
+    keystore.GetKeys(setKeys);
+    setHashes.insert(setKeys.begin(), setKeys.end());
+
+    std::set<CScriptID> setScriptIDs;
+    keystore.GetCScripts(setScriptIDs);
+    for (const CScriptID& scriptID : setScriptIDs)
+        setHashes.insert(uint160(std::vector<unsigned char>(scriptID.begin(), scriptID.end())));
+}
+
+void CWalletScriptFilter::AddScript(const CScript& script)
+{
+    setScripts.insert(script);
+}
+
+bool CWalletScriptFilter::Match(const CScript& scriptPubKey) const
+{
+    if (setScripts.count(scriptPubKey))
+        return true;
+
+    std::vector<uint160> vHashes;
+    ExtractScriptKeyHashes(scriptPubKey, vHashes);
+    for (const uint160& hash : vHashes) {
+        if (setHashes.count(hash))
+            return true;
+    }
+    return false;
+}
+
+void CWalletScriptFilter::GetFilterElements(GCSFilter::ElementSet& elements) const
+{
+    for (const uint160& hash : setHashes)
+        elements.insert(GCSFilter::Element(hash.begin(), hash.end()));
+    for (const CScript& script : setScripts)
+        elements.insert(GCSFilter::Element(script.begin(), script.end()));
+}
+
+uint256 CWalletScriptFilter::GetHash() const
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    for (const uint160& hash : setHashes)
+        ss << hash;
+    for (const CScript& script : setScripts)
+        ss << script;
+    return ss.GetHash();
 }
\ No newline at end of file
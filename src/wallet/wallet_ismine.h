@@ -8,9 +8,12 @@
 #ifndef BITCOIN_WALLET_ISMINE_H
 #define BITCOIN_WALLET_ISMINE_H
 
+#include "blockfilter.h"
 #include "key.h"
 #include "script/standard.h"
 
+#include <set>
+
 class CKeyStore;
 class CScript;
 
@@ -45,4 +48,30 @@ typedef uint8_t isminefilter;
 isminetype IsMine(const CKeyStore& keystore, const CScript& scriptPubKey);
 isminetype IsMine(const CKeyStore& keystore, const CTxDestination& dest);
 
+/**
+ * Snapshot of the key and script hashes of a key store, for matching scripts without
+ * holding the wallet lock. Match() is true for every script IsMine() could consider
+ * ours, and for some it does not, so a match still needs the full IsMine() check.
+ */
+class CWalletScriptFilter
+{
+public:
+    explicit CWalletScriptFilter(const CKeyStore& keystore);
+
+    //! Add a script that is matched as a whole (watch-only and multisig scripts)
+    void AddScript(const CScript& script);
+
+    bool Match(const CScript& scriptPubKey) const;
+
+    //! What a block filter has to contain for a block to possibly involve these keys
+    void GetFilterElements(GCSFilter::ElementSet& elements) const;
+
+    //! Identifies the keys and scripts being matched
+    uint256 GetHash() const;
+
+private:
+    std::set<uint160> setHashes;
+    std::set<CScript> setScripts;
+};
+
 #endif // BITCOIN_WALLET_ISMINE_H
@@ -161,6 +161,23 @@ bool CWalletDB::WriteOrderPosNext(int64_t nOrderPosNext)
     return Write(std::string("orderposnext"), nOrderPosNext);
 }
 
+bool CWalletDB::WriteChainstateScan(const CChainstateScanProgress& progress)
+{
+    nWalletDBUpdated++;
+    return Write(std::string("chainstatescan"), progress);
+}
+
+bool CWalletDB::ReadChainstateScan(CChainstateScanProgress& progress)
+{
+    return Read(std::string("chainstatescan"), progress);
+}
+
+bool CWalletDB::EraseChainstateScan()
+{
+    nWalletDBUpdated++;
+    return Erase(std::string("chainstatescan"));
+}
+
 // presstab HyperStake
 bool CWalletDB::WriteStakeSplitThreshold(uint64_t nStakeSplitThreshold)
 {
@@ -81,6 +81,28 @@ public:
     }
 };
 
+/** Progress of a chainstate rescan, so an interrupted one resumes (see CWallet::ScanBitcoinStateForWalletTransactions) */
+class CChainstateScanProgress
+{
+public:
+    //! CWalletScriptFilter::GetHash() of the keys scanned for; a scan for other keys starts over
+    uint256 hashFilter;
+    //! Per txid range, the first txid not scanned yet
+    std::vector<uint256> vNext;
+    //! Per txid range, whether it was scanned to its end
+    std::vector<unsigned char> vDone;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(hashFilter);
+        READWRITE(vNext);
+        READWRITE(vDone);
+    }
+};
+
 /** Access to the wallet database (wallet.dat) */
 class CWalletDB : public CDB
 {
@@ -115,6 +137,10 @@ public:
 
     bool WriteOrderPosNext(int64_t nOrderPosNext);
 
+    bool WriteChainstateScan(const CChainstateScanProgress& progress);
+    bool ReadChainstateScan(CChainstateScanProgress& progress);
+    bool EraseChainstateScan();
+
     // presstab
     bool WriteStakeSplitThreshold(uint64_t nStakeSplitThreshold);
     bool WriteMultiSend(std::vector<std::pair<std::string, int> > vMultiSend);